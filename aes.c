@@ -0,0 +1,132 @@
+/*
+AES-128 encryption (FIPS-197) with T-tables, see aes.h
+
+A round combines SubBytes, ShiftRows and MixColumns into 16 table lookups:
+    e0 = T[s0 >> 24] ^ ROR(T[(s1 >> 16) & 0xFF], 8) ^ ROR(T[(s2 >> 8) & 0xFF], 16) ^ ROR(T[s3 & 0xFF], 24) ^ rk
+with one 1 KB table T[x] = {02 * S[x], S[x], S[x], 03 * S[x]} (big endian words).
+The other three tables of the usual 4 KB version are rotations of it, and on the M3
+a rotated operand is free (EOR r, r, x, ROR #8), so they aren't stored. The last
+round has no MixColumns and uses the S-box itself.
+
+Only the S-box is written out (FIPS-197 Figure 7). Both tables are generated from
+that list by the compiler (AES_SBOX is an X-macro), like the tables in lut.h.
+*/
+
+#include "aes.h"
+
+#define ROR(x, n) (((x) >> (n)) | ((x) << (32U - (n))))
+
+// FIPS-197 Figure 7, S-box values in row order (S[0x00] .. S[0xFF])
+#define AES_SBOX(X) \
+    X(0x63) X(0x7C) X(0x77) X(0x7B) X(0xF2) X(0x6B) X(0x6F) X(0xC5) X(0x30) X(0x01) X(0x67) X(0x2B) X(0xFE) X(0xD7) X(0xAB) X(0x76) \
+    X(0xCA) X(0x82) X(0xC9) X(0x7D) X(0xFA) X(0x59) X(0x47) X(0xF0) X(0xAD) X(0xD4) X(0xA2) X(0xAF) X(0x9C) X(0xA4) X(0x72) X(0xC0) \
+    X(0xB7) X(0xFD) X(0x93) X(0x26) X(0x36) X(0x3F) X(0xF7) X(0xCC) X(0x34) X(0xA5) X(0xE5) X(0xF1) X(0x71) X(0xD8) X(0x31) X(0x15) \
+    X(0x04) X(0xC7) X(0x23) X(0xC3) X(0x18) X(0x96) X(0x05) X(0x9A) X(0x07) X(0x12) X(0x80) X(0xE2) X(0xEB) X(0x27) X(0xB2) X(0x75) \
+    X(0x09) X(0x83) X(0x2C) X(0x1A) X(0x1B) X(0x6E) X(0x5A) X(0xA0) X(0x52) X(0x3B) X(0xD6) X(0xB3) X(0x29) X(0xE3) X(0x2F) X(0x84) \
+    X(0x53) X(0xD1) X(0x00) X(0xED) X(0x20) X(0xFC) X(0xB1) X(0x5B) X(0x6A) X(0xCB) X(0xBE) X(0x39) X(0x4A) X(0x4C) X(0x58) X(0xCF) \
+    X(0xD0) X(0xEF) X(0xAA) X(0xFB) X(0x43) X(0x4D) X(0x33) X(0x85) X(0x45) X(0xF9) X(0x02) X(0x7F) X(0x50) X(0x3C) X(0x9F) X(0xA8) \
+    X(0x51) X(0xA3) X(0x40) X(0x8F) X(0x92) X(0x9D) X(0x38) X(0xF5) X(0xBC) X(0xB6) X(0xDA) X(0x21) X(0x10) X(0xFF) X(0xF3) X(0xD2) \
+    X(0xCD) X(0x0C) X(0x13) X(0xEC) X(0x5F) X(0x97) X(0x44) X(0x17) X(0xC4) X(0xA7) X(0x7E) X(0x3D) X(0x64) X(0x5D) X(0x19) X(0x73) \
+    X(0x60) X(0x81) X(0x4F) X(0xDC) X(0x22) X(0x2A) X(0x90) X(0x88) X(0x46) X(0xEE) X(0xB8) X(0x14) X(0xDE) X(0x5E) X(0x0B) X(0xDB) \
+    X(0xE0) X(0x32) X(0x3A) X(0x0A) X(0x49) X(0x06) X(0x24) X(0x5C) X(0xC2) X(0xD3) X(0xAC) X(0x62) X(0x91) X(0x95) X(0xE4) X(0x79) \
+    X(0xE7) X(0xC8) X(0x37) X(0x6D) X(0x8D) X(0xD5) X(0x4E) X(0xA9) X(0x6C) X(0x56) X(0xF4) X(0xEA) X(0x65) X(0x7A) X(0xAE) X(0x08) \
+    X(0xBA) X(0x78) X(0x25) X(0x2E) X(0x1C) X(0xA6) X(0xB4) X(0xC6) X(0xE8) X(0xDD) X(0x74) X(0x1F) X(0x4B) X(0xBD) X(0x8B) X(0x8A) \
+    X(0x70) X(0x3E) X(0xB5) X(0x66) X(0x48) X(0x03) X(0xF6) X(0x0E) X(0x61) X(0x35) X(0x57) X(0xB9) X(0x86) X(0xC1) X(0x1D) X(0x9E) \
+    X(0xE1) X(0xF8) X(0x98) X(0x11) X(0x69) X(0xD9) X(0x8E) X(0x94) X(0x9B) X(0x1E) X(0x87) X(0xE9) X(0xCE) X(0x55) X(0x28) X(0xDF) \
+    X(0x8C) X(0xA1) X(0x89) X(0x0D) X(0xBF) X(0xE6) X(0x42) X(0x68) X(0x41) X(0x99) X(0x2D) X(0x0F) X(0xB0) X(0x54) X(0xBB) X(0x16)
+
+// Multiplication by 02 in GF(2^8) (FIPS-197 4.2.1)
+#define XTIME(s) ((((s) << 1) ^ ((((s) >> 7) & 1U) * 0x1BU)) & 0xFFU)
+
+#define SBOX_ENTRY(s) s,
+#define T_ENTRY(s) (((uint32_t)XTIME(s) << 24) | ((uint32_t)(s) << 16) | ((uint32_t)(s) << 8) | (uint32_t)(XTIME(s) ^ (s))),
+
+static const uint8_t sbox[256] = { AES_SBOX(SBOX_ENTRY) };
+static const uint32_t t[256] = { AES_SBOX(T_ENTRY) };
+
+static uint32_t load_be(const uint8_t *p) {
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
+
+static void store_be(uint8_t *p, uint32_t v) {
+    p[0] = (uint8_t)(v >> 24);
+    p[1] = (uint8_t)(v >> 16);
+    p[2] = (uint8_t)(v >> 8);
+    p[3] = (uint8_t)v;
+}
+
+// SubWord(w) (5.2)
+static uint32_t sub_word(uint32_t w) {
+    return ((uint32_t)sbox[w >> 24] << 24) | ((uint32_t)sbox[(w >> 16) & 0xFFU] << 16) |
+        ((uint32_t)sbox[(w >> 8) & 0xFFU] << 8) | sbox[w & 0xFFU];
+}
+
+void aes128_init(struct aes128 *a, const uint8_t key[AES128_KEY_SIZE]) {
+    uint32_t rcon = 0x01;
+
+    // 5.2 Key Expansion
+    for (uint32_t i = 0; i < 4U; i++) {
+        a->rk[i] = load_be(&key[4U * i]);
+    }
+    for (uint32_t i = 4U; i < 44U; i++) {
+        uint32_t w = a->rk[i - 1U];
+        if ((i & 3U) == 0) {
+            w = sub_word(ROR(w, 24U)) ^ (rcon << 24); // RotWord is a left rotation
+            rcon = XTIME(rcon);
+        }
+        a->rk[i] = a->rk[i - 4U] ^ w;
+    }
+}
+
+void aes128_encrypt(const struct aes128 *a, const uint8_t in[AES_BLOCK], uint8_t out[AES_BLOCK]) {
+    const uint32_t *rk = a->rk;
+    uint32_t s0 = load_be(&in[0]) ^ rk[0];
+    uint32_t s1 = load_be(&in[4]) ^ rk[1];
+    uint32_t s2 = load_be(&in[8]) ^ rk[2];
+    uint32_t s3 = load_be(&in[12]) ^ rk[3];
+
+    for (uint32_t round = 1; round < 10U; round++) {
+        rk += 4;
+        uint32_t e0 = t[s0 >> 24] ^ ROR(t[(s1 >> 16) & 0xFFU], 8U) ^ ROR(t[(s2 >> 8) & 0xFFU], 16U) ^ ROR(t[s3 & 0xFFU], 24U) ^ rk[0];
+        uint32_t e1 = t[s1 >> 24] ^ ROR(t[(s2 >> 16) & 0xFFU], 8U) ^ ROR(t[(s3 >> 8) & 0xFFU], 16U) ^ ROR(t[s0 & 0xFFU], 24U) ^ rk[1];
+        uint32_t e2 = t[s2 >> 24] ^ ROR(t[(s3 >> 16) & 0xFFU], 8U) ^ ROR(t[(s0 >> 8) & 0xFFU], 16U) ^ ROR(t[s1 & 0xFFU], 24U) ^ rk[2];
+        uint32_t e3 = t[s3 >> 24] ^ ROR(t[(s0 >> 16) & 0xFFU], 8U) ^ ROR(t[(s1 >> 8) & 0xFFU], 16U) ^ ROR(t[s2 & 0xFFU], 24U) ^ rk[3];
+        s0 = e0;
+        s1 = e1;
+        s2 = e2;
+        s3 = e3;
+    }
+
+    // Last round: SubBytes and ShiftRows only
+    rk += 4;
+    store_be(&out[0], (((uint32_t)sbox[s0 >> 24] << 24) | ((uint32_t)sbox[(s1 >> 16) & 0xFFU] << 16) |
+        ((uint32_t)sbox[(s2 >> 8) & 0xFFU] << 8) | sbox[s3 & 0xFFU]) ^ rk[0]);
+    store_be(&out[4], (((uint32_t)sbox[s1 >> 24] << 24) | ((uint32_t)sbox[(s2 >> 16) & 0xFFU] << 16) |
+        ((uint32_t)sbox[(s3 >> 8) & 0xFFU] << 8) | sbox[s0 & 0xFFU]) ^ rk[1]);
+    store_be(&out[8], (((uint32_t)sbox[s2 >> 24] << 24) | ((uint32_t)sbox[(s3 >> 16) & 0xFFU] << 16) |
+        ((uint32_t)sbox[(s0 >> 8) & 0xFFU] << 8) | sbox[s1 & 0xFFU]) ^ rk[2]);
+    store_be(&out[12], (((uint32_t)sbox[s3 >> 24] << 24) | ((uint32_t)sbox[(s0 >> 16) & 0xFFU] << 16) |
+        ((uint32_t)sbox[(s1 >> 8) & 0xFFU] << 8) | sbox[s2 & 0xFFU]) ^ rk[3]);
+}
+
+void aes128_ctr_keystream(const struct aes128 *a, const uint8_t iv[AES_BLOCK], uint32_t block,
+    uint8_t *out, uint32_t blocks) {
+    uint8_t counter[AES_BLOCK];
+
+    // counter = iv + block, a 128 bit big endian addition
+    uint32_t carry = block;
+    for (uint32_t i = AES_BLOCK; i-- > 0;) {
+        carry += iv[i];
+        counter[i] = (uint8_t)carry;
+        carry >>= 8;
+    }
+    while (blocks--) {
+        aes128_encrypt(a, counter, out);
+        out += AES_BLOCK;
+        for (uint32_t i = AES_BLOCK; i-- > 0;) {
+            if (++counter[i] != 0) {
+                break;
+            }
+        }
+    }
+}
@@ -0,0 +1,32 @@
+/*
+AES-128 (FIPS-197), encryption direction only, and the CTR mode keystream
+
+CTR mode (NIST SP 800-38A 6.5) decrypts by XORing the data with the encrypted
+counter blocks, so only the forward cipher is needed, and the keystream doesn't
+depend on the data: it can be computed before the data arrives (updater.c).
+The counter block is iv + block number, a 128 bit big endian addition (what
+`openssl enc -aes-128-ctr -iv` does).
+
+Estimated cost (ARMv7-M instruction timings, 0 wait states): ~45 cycles per round
+column (4 lookups with rotated EORs) -> ~800 cycles per 16 byte block, ~50 cycles/byte.
+*/
+#ifndef AES_H
+#define AES_H
+
+#include <stdint.h>
+
+#define AES128_KEY_SIZE 16U
+#define AES_BLOCK 16U
+
+struct aes128 {
+    uint32_t rk[44]; // expanded key, 11 round keys
+};
+
+void aes128_init(struct aes128 *a, const uint8_t key[AES128_KEY_SIZE]);
+void aes128_encrypt(const struct aes128 *a, const uint8_t in[AES_BLOCK], uint8_t out[AES_BLOCK]);
+
+// Keystream blocks block .. block + blocks - 1 of the counter sequence starting at iv
+void aes128_ctr_keystream(const struct aes128 *a, const uint8_t iv[AES_BLOCK], uint32_t block,
+    uint8_t *out, uint32_t blocks);
+
+#endif
@@ -0,0 +1,41 @@
+/*
+Binary code modulation, see bcm.h
+*/
+
+#include "bcm.h"
+#include "wave.h"
+
+#define MAX_UNIT ((0xFFFFU + 1U) >> (BCM_BITS - 1U)) // slice 7 in the 16-bit counter
+
+// Bit plane k: BSRR word for slice k. Read by the DMA.
+static uint32_t planes[BCM_BITS];
+static uint16_t reload[BCM_BITS];
+static uint16_t started;
+
+int bcm_start(uint32_t port, uint16_t pins, uint32_t unit) {
+    if (unit < BCM_MIN_UNIT || unit > MAX_UNIT || wave_init(port, pins) != 0) {
+        return -1;
+    }
+    started = pins;
+    for (uint32_t k = 0; k < BCM_BITS; k++) {
+        planes[k] = WAVE_RESET(pins);
+        reload[k] = (uint16_t)((unit << k) - 1U);
+    }
+    return wave_start_timed(planes, reload, BCM_BITS, 1);
+}
+
+void bcm_set(uint32_t pin, uint8_t level) {
+    if (pin > 15U) {
+        return;
+    }
+    uint32_t bit = 1U << pin;
+
+    if (!(started & bit)) {
+        return;
+    }
+    // One word store per plane: the DMA never sees half of it
+    for (uint32_t k = 0; k < BCM_BITS; k++) {
+        planes[k] = (planes[k] & ~(WAVE_SET(bit) | WAVE_RESET(bit))) |
+            ((level >> k) & 1U ? WAVE_SET(bit) : WAVE_RESET(bit));
+    }
+}
@@ -0,0 +1,35 @@
+/*
+Binary code modulation: 8-bit brightness (or heater power) on up to 16 pins of a port
+
+Each pin's level is a byte. Bit k of it decides whether the pin is on during the
+k-th slice of the period, and slice k lasts 2^k units: the pin is on for exactly
+level units of the 255. All pins of the port switch together, so a period is 8 BSRR
+words (bit planes), one per slice, played by the waveform engine with a length per
+step (wave.h, wave_start_timed()): 8 timer events per period however many pins,
+instead of an interrupt for every edge of every channel as with software PWM.
+
+- The period is 255 units of unit timer cycles, at least BCM_MIN_UNIT: 510 us
+  (~2 kHz, no flicker) at the minimum with the 8 MHz clock.
+- bcm_set() rewrites the bit planes in place, the DMA picks them up as they are:
+  a new level shows within one period, that period may mix old and new bits.
+- The planes are in RAM, so the outputs keep going through flash erases.
+- Levels are duty cycles, linear (a heater); for LEDs square a perceived brightness
+  first (led.h).
+
+Uses TIM2 and DMA1 channels 1 and 2, the same as the waveform engine: one or the other.
+*/
+#ifndef BCM_H
+#define BCM_H
+
+#include <stdint.h>
+
+#define BCM_BITS 8U
+#define BCM_MIN_UNIT 16U // timer cycles (2 us): slice 0 still fits both transfers of a step
+
+// Make pins of port outputs (off) and start the period, unit timer cycles per unit. Returns 0, or -1.
+int bcm_start(uint32_t port, uint16_t pins, uint32_t unit);
+
+// Level 0 (off) .. 255 (on) for pin (one of the pins started)
+void bcm_set(uint32_t pin, uint8_t level);
+
+#endif
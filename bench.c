@@ -0,0 +1,207 @@
+/*
+Math kernel timings, see bench.h
+*/
+
+#include <math.h>
+#include "bench.h"
+#include "dsp.h"
+#include "lut.h"
+#include "fft.h"
+#include "intmath.h"
+#include "sha256.h"
+
+#define REG32(addr) (*(volatile uint32_t *)(addr))
+
+// Cycle counter (ARMv7-M ARM C1.6.5 Debug Exception and Monitor Control Register, C1.8 DWT)
+#define DEMCR REG32(0xE000EDFCUL)
+#define DEMCR_TRCENA (1U << 24) // enables the DWT
+#define DWT_CTRL REG32(0xE0001000UL)
+#define DWT_CTRL_CYCCNTENA (1U << 0)
+#define DWT_CYCCNT REG32(0xE0001004UL)
+
+#define CALLS 64U // per timed loop: cycles / 2^6 per call
+#define SHA256_BYTES (16U * 1024U) // the bootloader's flash: cycles / 2^14 per byte
+#define IMATH_INPUTS 256U // 4 KB of struct imath_bench_input in the work buffer: cycles / 2^8 per call
+#define FIR_TAPS 32U
+#define FIR_BLOCK 64U // samples per call of the filters
+#define BIQUAD_STAGES 2U
+
+#define PI_F 3.14159265f
+
+_Static_assert(IMATH_INPUTS * sizeof(struct imath_bench_input) <= 2U * FFT_MAX_N * sizeof(int16_t), "work buffer too small");
+_Static_assert((2U * FIR_TAPS + 3U * FIR_BLOCK) * sizeof(q31_t) <= 2U * FFT_MAX_N * sizeof(int16_t), "work buffer too small");
+_Static_assert(BENCH_SAT_ADD_S32 - BENCH_LOG2 == IMATH_BENCH_SAT_ADD_S32 - IMATH_BENCH_LOG2, "enum bench out of step");
+
+/*
+Time one loop over the inputs. Every result goes to a volatile (sink_q for the
+kernels, sink_f for the references), so nothing is optimized away; a loop storing
+just the input into the same volatile is taken off.
+*/
+#define TIMED(cycles, sink, expr) do { \
+    uint32_t start = DWT_CYCCNT; \
+    for (uint32_t i = 0; i < CALLS; i++) { \
+        (sink) = (expr); \
+    } \
+    (cycles) = DWT_CYCCNT - start; \
+} while (0)
+
+static volatile int32_t sink_q;
+static volatile float sink_f;
+
+static uint32_t per_call(uint32_t cycles, uint32_t loop, uint32_t log2_calls) {
+    return cycles > loop ? (cycles - loop) >> log2_calls : 0U;
+}
+
+/* One loop of imath_bench_run() (intmath_ref.c, built like the app) over the inputs */
+static uint32_t time_imath(enum imath_bench helper, int ref, const struct imath_bench_input *in) {
+    uint32_t start = DWT_CYCCNT;
+    sink_q = (int32_t)imath_bench_run(helper, ref, in, IMATH_INPUTS);
+    return DWT_CYCCNT - start;
+}
+
+/* Hash the bootloader's flash with one of the SHA-256 compression functions, state in h */
+static uint32_t time_sha256(void (*blocks)(uint32_t state[8], const uint8_t *p, uint32_t blocks), struct sha256 *h) {
+    sha256_init(h);
+    uint32_t start = DWT_CYCCNT;
+    blocks(h->h, (const uint8_t *)0x08000000UL, SHA256_BYTES / SHA256_BLOCK);
+    return DWT_CYCCNT - start;
+}
+
+/* n samples of noise at half scale */
+static void noise_q15(q15_t *x, uint32_t n, uint32_t *s) {
+    for (uint32_t i = 0; i < n; i++) {
+        *s = *s * 1664525UL + 1013904223UL;
+        x[i] = (q15_t)((int32_t)*s >> 17);
+    }
+}
+
+static void noise_q31(q31_t *x, uint32_t n, uint32_t *s) {
+    for (uint32_t i = 0; i < n; i++) {
+        *s = *s * 1664525UL + 1013904223UL;
+        x[i] = (q31_t)*s >> 1;
+    }
+}
+
+/*
+One block of noise through FIR_TAPS taps of noise, both at half scale (SMULL and SMLAL
+terminate early on small operands, so the Q31 filter gets large ones). The work buffer
+holds the coefficients, the state, the input and the output, in that order.
+*/
+static uint32_t time_fir_q15(q15_t *work, uint32_t *s) {
+    struct dsp_fir_q15 f;
+    q15_t *coeffs = work, *state = coeffs + FIR_TAPS, *in = state + FIR_TAPS + FIR_BLOCK, *out = in + FIR_BLOCK;
+    noise_q15(coeffs, FIR_TAPS, s);
+    noise_q15(in, FIR_BLOCK, s);
+    dsp_fir_q15_init(&f, FIR_TAPS, coeffs, state, FIR_BLOCK);
+    uint32_t start = DWT_CYCCNT;
+    dsp_fir_q15(&f, in, out, FIR_BLOCK);
+    return DWT_CYCCNT - start;
+}
+
+static uint32_t time_fir_q31(q31_t *work, uint32_t *s) {
+    struct dsp_fir_q31 f;
+    q31_t *coeffs = work, *state = coeffs + FIR_TAPS, *in = state + FIR_TAPS + FIR_BLOCK, *out = in + FIR_BLOCK;
+    noise_q31(coeffs, FIR_TAPS, s);
+    noise_q31(in, FIR_BLOCK, s);
+    dsp_fir_q31_init(&f, FIR_TAPS, coeffs, state, FIR_BLOCK);
+    uint32_t start = DWT_CYCCNT;
+    dsp_fir_q31(&f, in, out, FIR_BLOCK);
+    return DWT_CYCCNT - start;
+}
+
+/* One block of noise through BIQUAD_STAGES stages of a stable low-pass */
+static uint32_t time_biquad_q15(q15_t *work, uint32_t *s) {
+    static const q15_t coeffs[5U * BIQUAD_STAGES] = {
+        Q14(0.25), Q14(0.5), Q14(0.25), Q14(0.5), Q14(-0.25),
+        Q14(0.25), Q14(0.5), Q14(0.25), Q14(0.5), Q14(-0.25),
+    };
+    struct dsp_biquad_q15 f;
+    q15_t *state = work, *in = state + 4U * BIQUAD_STAGES, *out = in + FIR_BLOCK;
+    noise_q15(in, FIR_BLOCK, s);
+    dsp_biquad_q15_init(&f, BIQUAD_STAGES, coeffs, state);
+    uint32_t start = DWT_CYCCNT;
+    dsp_biquad_q15(&f, in, out, FIR_BLOCK);
+    return DWT_CYCCNT - start;
+}
+
+/* One n point transform of complex noise at half scale (every butterfly does its full work) */
+static uint32_t time_fft(int16_t *work, uint32_t n, uint32_t *s) {
+    noise_q15(work, 2U * n, s);
+    uint32_t start = DWT_CYCCNT;
+    fft_q15(work, n);
+    return DWT_CYCCNT - start;
+}
+
+void bench_run(struct bench_result r[BENCH_COUNT], int16_t *work) {
+    int32_t q[CALLS]; // kernel inputs
+    float f[CALLS]; // the same values for the references
+    uint32_t s = 1U;
+    uint32_t loop_q, loop_f, cycles, ref_cycles;
+
+    DEMCR |= DEMCR_TRCENA;
+    DWT_CTRL |= DWT_CTRL_CYCCNTENA;
+
+    // Random inputs from an LCG (Numerical Recipes), the top 16 bits
+    for (uint32_t i = 0; i < CALLS; i++) {
+        s = s * 1664525UL + 1013904223UL;
+        q[i] = (int32_t)(s >> 16);
+        f[i] = (float)q[i] * (2.0f * PI_F / 65536.0f);
+    }
+    TIMED(loop_q, sink_q, q[i]);
+    TIMED(loop_f, sink_f, f[i]);
+    TIMED(cycles, sink_q, lut_sin_q15((uint16_t)q[i]));
+    TIMED(ref_cycles, sink_f, sinf(f[i]));
+    r[BENCH_SIN].cycles = per_call(cycles, loop_q, 6U);
+    r[BENCH_SIN].ref_cycles = per_call(ref_cycles, loop_f, 6U);
+
+    for (uint32_t i = 0; i < CALLS; i++) {
+        s = s * 1664525UL + 1013904223UL;
+        q[i] = (int32_t)(s >> 12) - 8 * 65536; // [-8, 8) in Q16
+        f[i] = (float)q[i] / 65536.0f;
+    }
+    TIMED(cycles, sink_q, (int32_t)lut_exp_q16(q[i]));
+    TIMED(ref_cycles, sink_f, expf(f[i]));
+    r[BENCH_EXP].cycles = per_call(cycles, loop_q, 6U);
+    r[BENCH_EXP].ref_cycles = per_call(ref_cycles, loop_f, 6U);
+
+    for (uint32_t i = 0; i < CALLS; i++) {
+        s = s * 1664525UL + 1013904223UL;
+        q[i] = (int32_t)((s >> 1) | 1U); // (0, 32768) in Q16
+        f[i] = (float)q[i] / 65536.0f;
+    }
+    TIMED(cycles, sink_q, lut_ln_q16((uint32_t)q[i]));
+    TIMED(ref_cycles, sink_f, logf(f[i]));
+    r[BENCH_LN].cycles = per_call(cycles, loop_q, 6U);
+    r[BENCH_LN].ref_cycles = per_call(ref_cycles, loop_f, 6U);
+
+    // The intmath.h helpers and their naive forms, the same inputs for both
+    struct imath_bench_input *in = (struct imath_bench_input *)work;
+    imath_bench_inputs(in, IMATH_INPUTS, 1U);
+    uint32_t loop_imath = time_imath(IMATH_BENCH_NONE, 0, in);
+    for (uint32_t h = IMATH_BENCH_LOG2; h < IMATH_BENCH_COUNT; h++) {
+        struct bench_result *b = &r[BENCH_LOG2 + h - IMATH_BENCH_LOG2];
+        b->cycles = per_call(time_imath((enum imath_bench)h, 0, in), loop_imath, 8U);
+        b->ref_cycles = per_call(time_imath((enum imath_bench)h, 1, in), loop_imath, 8U);
+    }
+
+    struct sha256 fast, ref;
+    r[BENCH_SHA256].cycles = time_sha256(sha256_blocks, &fast) >> 14;
+    r[BENCH_SHA256].ref_cycles = time_sha256(sha256_blocks_ref, &ref) >> 14;
+    for (uint32_t i = 0; i < 8U; i++) {
+        if (fast.h[i] != ref.h[i]) {
+            r[BENCH_SHA256].cycles = 0; // the unrolled code is wrong
+        }
+    }
+
+    r[BENCH_FIR_Q15].cycles = time_fir_q15(work, &s);
+    r[BENCH_FIR_Q15].ref_cycles = 0;
+    r[BENCH_FIR_Q31].cycles = time_fir_q31((q31_t *)work, &s);
+    r[BENCH_FIR_Q31].ref_cycles = 0;
+    r[BENCH_BIQUAD_Q15].cycles = time_biquad_q15(work, &s);
+    r[BENCH_BIQUAD_Q15].ref_cycles = 0;
+
+    r[BENCH_FFT256].cycles = time_fft(work, 256U, &s);
+    r[BENCH_FFT256].ref_cycles = 0;
+    r[BENCH_FFT1024].cycles = time_fft(work, 1024U, &s);
+    r[BENCH_FFT1024].ref_cycles = 0;
+}
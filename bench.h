@@ -0,0 +1,61 @@
+/*
+Math kernel timings on the board, in a BENCH=1 build (build.sh)
+
+The kernels run on the same inputs as the float functions they replace, timed with
+the DWT cycle counter (loop overhead taken off), once at boot before the rest of the
+app starts. main() logs the results (EVLOG_ID_BENCH). The references are newlib's
+soft-float libm, the naive integer forms (intmath_ref.c) and the plain SHA-256 loop
+(sha256_ref.c), which only a BENCH=1 build links (with libgcc).
+
+    benchmark           kernel          reference       cycles
+    BENCH_SIN           lut_sin_q15     sinf            per call, 64 random angles
+    BENCH_EXP           lut_exp_q16     expf            per call, 64 random x in [-8, 8)
+    BENCH_LN            lut_ln_q16      logf            per call, 64 random x in (0, 32768)
+    BENCH_FFT256        fft_q15         -               one 256 point transform of noise
+    BENCH_FFT1024       fft_q15         -               one 1024 point transform of noise
+    BENCH_LOG2          imath_log2      naive form      per call, 256 random inputs of random
+    BENCH_SQRT32        imath_sqrt32    (intmath_ref.c) bit length (imath_bench_inputs()),
+    BENCH_UDIV64        imath_udiv64                    the same for both
+    BENCH_RECIP_DIV     imath_recip_div UDIV
+    BENCH_SAT_ADD_S32   imath_sat_add_s32
+    BENCH_SHA256        sha256_blocks   sha256_blocks_ref per byte, the bootloader's 16 KB of flash
+                                                        (0 for sha256_blocks: the two disagree)
+    BENCH_FIR_Q15       dsp_fir_q15     -               one 64 sample block of noise through 32 taps:
+    BENCH_FIR_Q31       dsp_fir_q31     -               cycles / 2048 per tap per output
+    BENCH_BIQUAD_Q15    dsp_biquad_q15  -               one 64 sample block through 2 stages:
+                                                        cycles / 128 per sample per stage
+
+SysTick keeps running meanwhile: a few per mille more than the real cost.
+*/
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <stdint.h>
+
+enum bench {
+    BENCH_SIN,
+    BENCH_EXP,
+    BENCH_LN,
+    BENCH_FFT256,
+    BENCH_FFT1024,
+    BENCH_LOG2, // .. BENCH_SAT_ADD_S32 in the order of enum imath_bench
+    BENCH_SQRT32,
+    BENCH_UDIV64,
+    BENCH_RECIP_DIV,
+    BENCH_SAT_ADD_S32,
+    BENCH_SHA256,
+    BENCH_FIR_Q15,
+    BENCH_FIR_Q31,
+    BENCH_BIQUAD_Q15,
+    BENCH_COUNT,
+};
+
+struct bench_result {
+    uint32_t cycles; // the kernel
+    uint32_t ref_cycles; // the reference, 0: none
+};
+
+// Run every benchmark, results indexed by enum bench. work: 2 * FFT_MAX_N samples (4 KB, word aligned) not in use yet.
+void bench_run(struct bench_result r[BENCH_COUNT], int16_t *work);
+
+#endif
@@ -12,21 +12,66 @@ For every register we want to use, we need:
 This program uses:
 - RCC (to enable GPIOA clock)
 - GPIOA (configure and toggle PA5 (LED on nucleo board))
+- USART2 (command channel over the ST-LINK virtual COM port, uart.h)
 
 This is the bootloader program, responsible for either jumping into the main program,
 or staying in the bootloader program (in this example, if button is pressed on boot)
+
+If the app crashed (fault.c left a crash dump in noinit RAM), the dump is printed on
+the UART at boot. While staying in the bootloader, single character commands:
+- 'd': print the crash dump
+- 'c': clear the crash dump
+- 'w': print the watchdog record (last task to check in, overdue tasks)
+- 'z': zero the watchdog reset count (the app is started again on the next reset)
+
+The CRC, flash and UART drivers are shared with the app through a service table at a
+fixed address (svc.h).
+
+The app can also ask for the bootloader (reboot_to_bootloader(), reboot.h): it leaves
+BOOT_REQUEST_MAGIC in noinit RAM before resetting, checked before anything else here.
+
+Reset flags (RCC_CSR) are saved for the app in noinit RAM and cleared. Consecutive
+watchdog resets are counted there too (any other reset starts the count over):
+after BOOT_MAX_WDG_RESETS in a row the app is considered broken and the bootloader
+doesn't start it, until any other reset (the reset button, a power cycle) or 'z'.
+
+Updates (update.h): the app downloads a new image into slot B and marks it pending.
+The bootloader checks its CRC and swaps it with slot A, then starts it, without the
+button for as long as it is on trial. If the new app then causes BOOT_MAX_WDG_RESETS
+watchdog resets before confirming itself, the swap is undone and the previous app
+runs again.
+
+Only signed images (image.h) are installed and started. The signature check takes a
+few million cycles; its duration is printed, and a token in noinit RAM lets the
+following warm resets of the same app skip it.
 */
 
 #include <stdint.h>
+#include "uart.h"
+#include "noinit.h"
+#include "crc.h"
+#include "flash.h"
+#include "svc.h"
+#include "update.h"
+#include "image.h"
 
 
-#define APP_BASE 0x08004000UL // shown in linker scripts (after 16KB bootloader)
+#define APP_BASE UPDATE_SLOT_A // shown in linker scripts (after 16KB bootloader)
 #define SRAM_BASE 0x20000000UL
 #define SRAM_SIZE (20U * 1024U)
 #define SRAM_END (SRAM_BASE + SRAM_SIZE)
 
 #define SCB_VTOR REG32(0xE000ED08UL) // Vector table offset register
 
+// Cycle counter (ARMv7-M ARM C1.6.5 Debug Exception and Monitor Control Register, C1.8 DWT)
+#define DEMCR REG32(0xE000EDFCUL)
+#define DEMCR_TRCENA (1U << 24) // enables the DWT
+#define DWT_CTRL REG32(0xE0001000UL)
+#define DWT_CTRL_CYCCNTENA (1U << 0)
+#define DWT_CYCCNT REG32(0xE0001004UL)
+
+#define BOOT_MAX_WDG_RESETS UPDATE_MAX_WDG_RESETS // also what reverts an update on trial
+
 #define LED_PIN 5U // LED on Nucleo-F103RB is PA5
 #define BUTTON_PIN 13U // Button on Nucleo-F103RB is PC13
 
@@ -47,6 +92,7 @@ or staying in the bootloader program (in this example, if button is pressed on b
 
 // (Reset and clock control RCC in Table 3, link to Table 18 (RCC Register map))
 #define RCC_APB2ENR_OFFSET 0x18UL // APB2 peripheral clock enable register
+#define RCC_CSR_OFFSET 0x24UL // Control/status register (reset flags)
 
 // (GPIOx Table 3, link to Table 59 (GPIO register map))
 #define GPIOx_CRL_OFFSET 0x00UL // Configuration register LOW (pins 0..7)
@@ -60,6 +106,7 @@ or staying in the bootloader program (in this example, if button is pressed on b
 #define REG32(addr) (*(volatile uint32_t *)(addr))
 
 #define RCC_APB2ENR REG32(RCC_BASE + RCC_APB2ENR_OFFSET)
+#define RCC_CSR REG32(RCC_BASE + RCC_CSR_OFFSET)
 
 #define GPIOA_CRL REG32(GPIOA_BASE + GPIOx_CRL_OFFSET) // Configuration Register Low
 #define GPIOA_BSRR REG32(GPIOA_BASE + GPIOx_BSRR_OFFSET) // Bit Set/Reset Register
@@ -73,6 +120,11 @@ or staying in the bootloader program (in this example, if button is pressed on b
 #define RCC_APB2ENR_IOPAEN_BIT 2U // I/O port a enable
 #define RCC_APB2ENR_IOPCEN_BIT 4U // I/O port c enable
 
+// 7.3.10 Control/status register
+#define RCC_CSR_RMVF (1U << 24) // Write 1 to clear the reset flags
+#define RCC_CSR_IWDGRSTF (1U << 29) // Independent watchdog reset
+#define RCC_CSR_RESET_FLAGS 0xFC000000UL // [31:26] PINRSTF .. LPWRRSTF
+
 /* 9.2 GPIO registers -> 9.2.1 port configuration register low
 Each pin uses 4 bits: 
  - [1:0] MODEy (input/output(with max speeds))
@@ -92,12 +144,225 @@ For output:
 #define GPIO_CRH_INPUT_F 0b0100 // CNF[3:2] MODE[1:0]
 
 /* Simple delay that just use empty instructions */
-static void delay (volatile uint32_t n) {
-    while (n--) {
+void delay(uint32_t n) {
+    volatile uint32_t i = n;
+
+    while (i--) {
         __asm volatile ("nop"); // No OPeration
     }
 }
 
+/*
+Flash functions for the app: the bootloader and the app's own slot are off limits
+(slot A only changes through a signed update, which the warm-boot token relies on)
+*/
+static int svc_flash_erase_page(uint32_t addr) {
+    if (addr < UPDATE_SLOT_B) {
+        return -1;
+    }
+    return flash_erase_page(addr);
+}
+
+static int svc_flash_program(uint32_t addr, const void *data, uint32_t len) {
+    if (addr < UPDATE_SLOT_B) {
+        return -1;
+    }
+    return flash_program(addr, data, len);
+}
+
+// Placed at BL_SERVICES_ADDR by the linker script
+__attribute__((section(".bl_services"), used))
+const struct bl_services bl_services = {
+    .magic = BL_SERVICES_MAGIC,
+    .version = BL_SERVICES_VERSION,
+    .size = sizeof(struct bl_services),
+    .delay = delay,
+    .crc32 = crc32,
+    .crc16_ccitt = crc16_ccitt,
+    .flash_erase_page = svc_flash_erase_page,
+    .flash_program = svc_flash_program,
+    .uart_init = uart_init,
+    .uart_putc = uart_putc,
+    .uart_write = uart_write,
+    .uart_puts = uart_puts,
+    .uart_puthex32 = uart_puthex32,
+    .uart_getc = uart_getc,
+};
+
+static void print_reg(const char *name, uint32_t value) {
+    uart_puts(name);
+    uart_putc('=');
+    uart_puthex32(value);
+    uart_putc(' ');
+}
+
+static void print_crash_dump(void) {
+    const volatile struct crash_dump *d = &NOINIT->crash;
+
+    if (!crash_dump_valid(d)) {
+        uart_puts("no crash dump\r\n");
+        return;
+    }
+    uart_puts("crash dump\r\n");
+    print_reg("vector", d->vector);
+    print_reg("sp", d->sp);
+    print_reg("exc_return", d->exc_return);
+    uart_puts("\r\n");
+    print_reg("pc", d->pc);
+    print_reg("lr", d->lr);
+    print_reg("xpsr", d->xpsr);
+    uart_puts("\r\n");
+    print_reg("r0", d->r0);
+    print_reg("r1", d->r1);
+    print_reg("r2", d->r2);
+    print_reg("r3", d->r3);
+    print_reg("r12", d->r12);
+    uart_puts("\r\n");
+    print_reg("cfsr", d->cfsr);
+    print_reg("hfsr", d->hfsr);
+    print_reg("mmfar", d->mmfar);
+    print_reg("bfar", d->bfar);
+    uart_puts("\r\nstack");
+    for (uint32_t i = 0; i < d->stack_words && i < CRASH_STACK_WORDS; i++) {
+        if (i & 7U) {
+            uart_putc(' ');
+        }
+        else {
+            uart_puts("\r\n");
+        }
+        uart_puthex32(d->stack[i]);
+    }
+    uart_puts("\r\n");
+}
+
+static void print_wdg_record(void) {
+    const volatile struct wdg_record *r = &NOINIT->wdg;
+
+    print_reg("reset_flags", NOINIT->boot.reset_flags);
+    print_reg("wdg_resets", NOINIT->boot.wdg_resets);
+    uart_puts("\r\n");
+    if (!wdg_record_valid(r)) {
+        uart_puts("no watchdog record\r\n");
+        return;
+    }
+    print_reg("last_task", r->last_task);
+    print_reg("last_tick", r->last_tick);
+    print_reg("overdue", r->overdue);
+    uart_puts("\r\n");
+}
+
+/* Save and clear the reset flags, count consecutive watchdog resets */
+static void check_reset_cause(void) {
+    volatile struct boot_status *b = &NOINIT->boot;
+    uint32_t flags = RCC_CSR & RCC_CSR_RESET_FLAGS;
+
+    RCC_CSR |= RCC_CSR_RMVF;
+    b->reset_flags = flags;
+
+    // Power-on: the count is random RAM
+    if (b->wdg_resets_check != ~b->wdg_resets) {
+        b->wdg_resets = 0;
+    }
+    if (flags & RCC_CSR_IWDGRSTF) {
+        b->wdg_resets++;
+    }
+    else {
+        b->wdg_resets = 0; // not in a row any more
+    }
+    b->wdg_resets_check = ~b->wdg_resets;
+}
+
+/* Install a pending update, or revert one that keeps failing (update_boot()). Returns 1 to start the app without the button. */
+static int check_update(void) {
+    volatile struct boot_status *b = &NOINIT->boot;
+
+    switch (update_boot(b->wdg_resets, image_verify)) {
+    case UPDATE_BOOT_INSTALLED:
+        uart_puts("update installed\r\n");
+        return 1;
+    case UPDATE_BOOT_TESTING:
+        return 1; // it must run to confirm itself, or to be reverted
+    case UPDATE_BOOT_REVERTED:
+        uart_puts("update reverted\r\n");
+        b->wdg_resets = 0; // the previous app gets a fresh start
+        b->wdg_resets_check = ~0U;
+        return 1;
+    case UPDATE_BOOT_FAILED:
+        uart_puts("update failed\r\n");
+        return 0;
+    default:
+        return 0;
+    }
+}
+
+/* Restart the DWT cycle counter */
+static void cycles_start(void) {
+    DEMCR |= DEMCR_TRCENA;
+    DWT_CYCCNT = 0;
+    DWT_CTRL |= DWT_CTRL_CYCCNTENA;
+}
+
+/*
+1 if the app in slot A is signed. A token left by an earlier check of the same image
+(same image_id(), slot A can't have changed in between) saves the check on warm resets.
+*/
+static int app_verified(void) {
+    volatile struct boot_token *t = &NOINIT->token;
+    uint32_t id = image_id(APP_BASE);
+
+    if (id != 0 && boot_token_valid(t) && t->image == id) {
+        return 1;
+    }
+    t->magic = 0;
+
+    cycles_start();
+    int ok = image_verify(APP_BASE) == 0;
+    uint32_t cycles = DWT_CYCCNT;
+
+    uart_puts(ok ? "signature ok " : "signature BAD ");
+    print_reg("cycles", cycles);
+    print_reg("version", ((const struct image_header *)(APP_BASE + IMAGE_HEADER_OFFSET))->version);
+    uart_puts("\r\n");
+    if (!ok) {
+        return 0;
+    }
+    t->image = id;
+    t->cycles = cycles;
+    t->check = BOOT_TOKEN_MAGIC ^ id ^ cycles;
+    t->magic = BOOT_TOKEN_MAGIC;
+    return 1;
+}
+
+/* Handle a command from the UART, if one came in */
+static void poll_commands(void) {
+    switch (uart_getc()) {
+    case 'd':
+        print_crash_dump();
+        break;
+    case 'c':
+        NOINIT->crash.magic = 0;
+        uart_puts("cleared\r\n");
+        break;
+    case 'w':
+        print_wdg_record();
+        break;
+    case 'z':
+        NOINIT->boot.wdg_resets = 0;
+        NOINIT->boot.wdg_resets_check = ~0U;
+        uart_puts("cleared\r\n");
+        break;
+    default:
+        break;
+    }
+}
+
+/* Delay loop that keeps answering commands */
+static void delay_polling(uint32_t n) {
+    while (n--) {
+        poll_commands();
+    }
+}
+
 static void jump_to_app(uint32_t app_base) {
     uint32_t app_sp = REG32(app_base + 0x0);
     uint32_t app_pc = REG32(app_base + 0x4);
@@ -123,6 +388,12 @@ static void jump_to_app(uint32_t app_base) {
 }
 
 int main(void) {
+    // Requested by the app: one load and compare on the normal boot path
+    int stay = NOINIT->boot_request == BOOT_REQUEST_MAGIC;
+    if (stay) {
+        NOINIT->boot_request = 0; // only for this boot
+    }
+
     RCC_APB2ENR |= (1U << RCC_APB2ENR_IOPAEN_BIT); // enable peripheral clock to GPIOA
     RCC_APB2ENR |= (1U << RCC_APB2ENR_IOPCEN_BIT); // enable peripheral clock to GPIOC
     
@@ -131,17 +402,29 @@ int main(void) {
 
     GPIOC_CRH &= ~(GPIO_CRH_PIN_MASK << GPIO_CRH_PIN13_SHIFT);
     GPIOC_CRH |= (GPIO_CRH_INPUT_F << GPIO_CRH_PIN13_SHIFT);
-    
 
-    if ((GPIOC_IDR & (1U << BUTTON_PIN)) == 0) jump_to_app(APP_BASE);
+    check_reset_cause();
+
+    uart_init(UART_BAUD);
+    if (crash_dump_valid(&NOINIT->crash)) {
+        print_crash_dump(); // kept until cleared, so it can be read again
+    }
+    if (NOINIT->boot.reset_flags & RCC_CSR_IWDGRSTF) {
+        print_wdg_record();
+    }
+
+    // After an install or revert, and while a new app is on trial, the app is started without the button
+    int updated = check_update();
+
+    if (!stay && ((GPIOC_IDR & (1U << BUTTON_PIN)) == 0 || updated) && NOINIT->boot.wdg_resets < BOOT_MAX_WDG_RESETS && app_verified()) jump_to_app(APP_BASE);
 
     int delay_time = 40000U;
 
     while(1) {
         GPIOA_BSRR = (1U << LED_PIN); // set LED
-        delay(delay_time);
+        delay_polling(delay_time);
 
         GPIOA_BSRR = (1U << (LED_PIN + 16)); // reset LED
-        delay(delay_time);
+        delay_polling(delay_time);
     } 
 }
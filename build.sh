@@ -2,18 +2,130 @@
 
 mkdir -p output
 
+# ---- Signing key ----
+# The private key stays in keys/ (not in git). Images signed with it are the only ones
+# the bootloader starts, so keep it: a new key needs a new bootloader.
+mkdir -p keys
+if [ ! -f keys/signing_key.pem ]; then
+    openssl genpkey -algorithm ed25519 -out keys/signing_key.pem
+fi
+# The raw 32 byte public key (end of its DER encoding) as a C initializer for image.c
+{
+    printf '%s\n' '#define IMAGE_PUBLIC_KEY { \'
+    openssl pkey -in keys/signing_key.pem -pubout -outform DER | tail -c 32 | od -An -v -tx1 | sed 's/ \([0-9a-f][0-9a-f]\)/0x\1, /g; s/$/\\/'
+    printf '%s\n' '}'
+} > output/image_key.h
+# AES-128 key of the update transfers (updater.h), built into the app
+if [ ! -f keys/update_key.bin ]; then
+    openssl rand -out keys/update_key.bin 16
+fi
+{
+    printf '%s\n' '#define UPDATE_AES_KEY { \'
+    od -An -v -tx1 keys/update_key.bin | sed 's/ \([0-9a-f][0-9a-f]\)/0x\1, /g; s/$/\\/'
+    printf '%s\n' '}'
+} > output/update_key.h
+
 # ---- Build bootloader ----
 # Generate object file
 arm-none-eabi-gcc -c -g -Og -Wall -Wextra -mcpu=cortex-m3 -mthumb bootloader.c -o output/bootloader.o
-# Link the object file
-arm-none-eabi-gcc -nostdlib -nostartfiles -Wl,-Tbootloader_memory.ld output/bootloader.o -o output/bootloader.elf
+arm-none-eabi-gcc -c -g -Og -Wall -Wextra -mcpu=cortex-m3 -mthumb uart.c -o output/bl_uart.o
+arm-none-eabi-gcc -c -g -Og -Wall -Wextra -mcpu=cortex-m3 -mthumb crc.c -o output/bl_crc.o
+arm-none-eabi-gcc -c -g -Og -Wall -Wextra -mcpu=cortex-m3 -mthumb flash.c -o output/bl_flash.o
+arm-none-eabi-gcc -c -g -Og -Wall -Wextra -mcpu=cortex-m3 -mthumb update.c -o output/bl_update.o
+arm-none-eabi-gcc -c -g -Og -Wall -Wextra -mcpu=cortex-m3 -mthumb -Ioutput image.c -o output/bl_image.o
+# -O2: hashing a slot is on the boot path, the reference is compiled the same way for the benchmark
+arm-none-eabi-gcc -c -g -O2 -Wall -Wextra -mcpu=cortex-m3 -mthumb sha256.c -o output/bl_sha256.o
+# -O2: the field arithmetic is most of the signature check's boot time
+arm-none-eabi-gcc -c -g -O2 -Wall -Wextra -mcpu=cortex-m3 -mthumb ed25519.c -o output/bl_ed25519.o
+# Link the object files
+arm-none-eabi-gcc -nostdlib -nostartfiles -Wl,-Tbootloader_memory.ld output/bootloader.o output/bl_uart.o output/bl_crc.o output/bl_flash.o output/bl_update.o output/bl_image.o output/bl_sha256.o output/bl_ed25519.o -o output/bootloader.elf
 # Generate binary file
 arm-none-eabi-objcopy -O binary output/bootloader.elf output/bootloader.bin
 
 # ---- Build main application ----
+# Version in the signed image header (image.h): bump it for every release
+IMAGE_VERSION=${IMAGE_VERSION:-1}
+# BENCH=1: time the math kernels at boot next to newlib's float functions and the naive
+# integer forms, results in the event log (bench.h). Only this build links libm and libgcc
+# (soft-float), intmath_ref.c, compiled like the app code that calls the helpers, and the
+# two SHA-256 compression functions at -O2, as the bootloader builds sha256.c.
+BENCH=${BENCH:-0}
+BENCH_FLAGS=
+BENCH_OBJS=
+BENCH_LIBS=
+if [ "$BENCH" = 1 ]; then
+    BENCH_FLAGS=-DBENCH
+    BENCH_OBJS="output/bench.o output/intmath_ref.o output/sha256.o output/sha256_ref.o"
+    BENCH_LIBS="-lm -lc -lgcc"
+    arm-none-eabi-gcc -c -g -O2 -Wall -Wextra -mcpu=cortex-m3 -mthumb bench.c -o output/bench.o
+    arm-none-eabi-gcc -c -g -Og -Wall -Wextra -mcpu=cortex-m3 -mthumb intmath_ref.c -o output/intmath_ref.o
+    arm-none-eabi-gcc -c -g -O2 -Wall -Wextra -mcpu=cortex-m3 -mthumb sha256.c -o output/sha256.o
+    arm-none-eabi-gcc -c -g -O2 -Wall -Wextra -mcpu=cortex-m3 -mthumb sha256_ref.c -o output/sha256_ref.o
+fi
+# DEMO=1: the demo outputs, brightness ramps on PB8..PB15 (bcm.h) and a rainbow on a WS2812
+# strip on PA6 (ws2812.h). Off by default: they drive pins a board may use otherwise.
+DEMO=${DEMO:-0}
+DEMO_FLAGS=
+if [ "$DEMO" = 1 ]; then
+    DEMO_FLAGS=-DDEMO_OUTPUTS
+fi
+# (CRC, flash and UART drivers come from the bootloader's service table, svc.c)
 # Generate object file
-arm-none-eabi-gcc -c -g -Og -Wall -Wextra -mcpu=cortex-m3 -mthumb main.c -o output/main.o
-# Link the object file
-arm-none-eabi-gcc -nostdlib -nostartfiles -Wl,-Tmain_memory.ld output/main.o -o output/main.elf
+arm-none-eabi-gcc -c -g -Og -Wall -Wextra -mcpu=cortex-m3 -mthumb $BENCH_FLAGS $DEMO_FLAGS main.c -o output/main.o
+arm-none-eabi-gcc -c -g -Og -Wall -Wextra -mcpu=cortex-m3 -mthumb dsp.c -o output/dsp.o
+arm-none-eabi-gcc -c -g -Og -Wall -Wextra -mcpu=cortex-m3 -mthumb fft.c -o output/fft.o
+arm-none-eabi-gcc -c -g -Og -Wall -Wextra -mcpu=cortex-m3 -mthumb lut.c -o output/lut.o
+arm-none-eabi-gcc -c -g -Og -Wall -Wextra -mcpu=cortex-m3 -mthumb startup.c -o output/startup.o
+arm-none-eabi-gcc -c -g -Og -Wall -Wextra -mcpu=cortex-m3 -mthumb kv.c -o output/kv.o
+arm-none-eabi-gcc -c -g -Og -Wall -Wextra -mcpu=cortex-m3 -mthumb evlog.c -o output/evlog.o
+arm-none-eabi-gcc -c -g -Og -Wall -Wextra -mcpu=cortex-m3 -mthumb fault.c -o output/fault.o
+arm-none-eabi-gcc -c -g -Og -Wall -Wextra -mcpu=cortex-m3 -mthumb tick.c -o output/tick.o
+arm-none-eabi-gcc -c -g -Og -Wall -Wextra -mcpu=cortex-m3 -mthumb wdg.c -o output/wdg.o
+arm-none-eabi-gcc -c -g -Og -Wall -Wextra -mcpu=cortex-m3 -mthumb svc.c -o output/svc.o
+arm-none-eabi-gcc -c -g -Og -Wall -Wextra -mcpu=cortex-m3 -mthumb reboot.c -o output/reboot.o
+arm-none-eabi-gcc -c -g -Og -Wall -Wextra -mcpu=cortex-m3 -mthumb update.c -o output/update.o
+arm-none-eabi-gcc -c -g -Og -Wall -Wextra -mcpu=cortex-m3 -mthumb -Ioutput updater.c -o output/updater.o
+arm-none-eabi-gcc -c -g -O2 -Wall -Wextra -mcpu=cortex-m3 -mthumb aes.c -o output/aes.o
+arm-none-eabi-gcc -c -g -Og -Wall -Wextra -mcpu=cortex-m3 -mthumb cobs.c -o output/cobs.o
+arm-none-eabi-gcc -c -g -Og -Wall -Wextra -mcpu=cortex-m3 -mthumb wave.c -o output/wave.o
+arm-none-eabi-gcc -c -g -Og -Wall -Wextra -mcpu=cortex-m3 -mthumb bcm.c -o output/bcm.o
+arm-none-eabi-gcc -c -g -O2 -Wall -Wextra -mcpu=cortex-m3 -mthumb logic.c -o output/logic.o
+arm-none-eabi-gcc -c -g -Og -Wall -Wextra -mcpu=cortex-m3 -mthumb led.c -o output/led.o
+arm-none-eabi-gcc -c -g -O2 -Wall -Wextra -mcpu=cortex-m3 -mthumb ws2812.c -o output/ws2812.o
+# Link the object files (-mcpu: the Cortex-M3 builds of the libraries a BENCH=1 build links)
+arm-none-eabi-gcc -nostdlib -nostartfiles -mcpu=cortex-m3 -mthumb -Wl,-Tmain_memory.ld -Wl,--defsym=__image_version="$IMAGE_VERSION" output/main.o output/dsp.o output/fft.o output/lut.o output/startup.o output/kv.o output/evlog.o output/fault.o output/tick.o output/wdg.o output/svc.o output/reboot.o output/update.o output/updater.o output/aes.o output/cobs.o output/wave.o output/bcm.o output/logic.o output/led.o output/ws2812.o $BENCH_OBJS -o output/main.elf $BENCH_LIBS
 # Generate binary file
-arm-none-eabi-objcopy -O binary output/main.elf output/main.bin
\ No newline at end of file
+arm-none-eabi-objcopy -O binary output/main.elf output/main.bin
+
+# ---- Sign the main application ----
+# Ed25519 signature of the SHA-256 digest of main.bin, appended after "SIGN" (image.h)
+openssl dgst -sha256 -binary output/main.bin > output/main.sha256
+openssl pkeyutl -sign -rawin -inkey keys/signing_key.pem -in output/main.sha256 -out output/main.sig
+{ cat output/main.bin; printf 'SIGN'; cat output/main.sig; } > output/main_signed.bin
+
+# ---- Host tools ----
+# Update uploader for the serial port, with simulated devices (tools/update_link.c)
+cc -O2 -Wall -Wextra -I. tools/update_link.c tools/link.c tools/sign.c cobs.c crc.c aes.c sha256.c -o output/update_link
+# The update code on a simulated board: transfer benchmark, resume and rollback checks (tools/devsim.c)
+cc -O2 -Wall -Wextra -I. -Ioutput tools/devsim.c tools/sim.c tools/link.c tools/sign.c updater.c update.c image.c ed25519.c sha256.c aes.c crc.c cobs.c -o output/devsim
+# Logic analyzer captures to VCD files (tools/logic_vcd.c)
+cc -O2 -Wall -Wextra -I. tools/logic_vcd.c cobs.c crc.c -o output/logic_vcd
+# The DSP kernels against a double precision reference, bit for bit (tools/dsp_test.c): stop on a mismatch
+cc -O2 -Wall -Wextra -I. tools/dsp_test.c dsp.c -lm -o output/dsp_test
+output/dsp_test || exit 1
+# The integer math helpers and their naive forms against exact arithmetic, host timings (tools/intmath_test.c): stop on a failure
+cc -O2 -Wall -Wextra -I. tools/intmath_test.c intmath_ref.c -o output/intmath_test
+output/intmath_test || exit 1
+# The lookups of lut.h against libm, checked against the errors it states (tools/lut_test.c): stop when one is exceeded
+cc -O2 -Wall -Wextra -I. tools/lut_test.c lut.c -lm -o output/lut_test
+output/lut_test || exit 1
+# The key-value store on the simulated flash with power losses at random flash operations (tools/kv_test.c): stop on a failure
+cc -O2 -Wall -Wextra -I. tools/kv_test.c tools/sim.c kv.c crc.c -o output/kv_test
+output/kv_test || exit 1
+# Factory image and update package (tools/pack.c)
+cc -O2 -Wall -Wextra -I. -Ioutput tools/pack.c tools/sign.c ed25519.c sha256.c aes.c crc.c -o output/pack
+
+# ---- Package ----
+# One image for a new board (bootloader + app, programmed at 0x08000000 in one pass), and
+# the app encrypted for update_link (fresh iv every time, updater.h)
+output/pack -b output/bootloader.bin -f output/factory.bin -u output/main_update.pkg output/main_signed.bin
@@ -0,0 +1,52 @@
+/*
+COBS framing, see cobs.h
+*/
+
+#include "cobs.h"
+
+uint32_t cobs_encode(uint8_t *dst, const uint8_t *src, uint32_t len) {
+    uint32_t code_at = 0; // where the current block's code byte goes
+    uint32_t out = 1;
+    uint8_t code = 1;
+
+    for (uint32_t i = 0; i < len; i++) {
+        if (src[i] == 0) {
+            dst[code_at] = code;
+            code_at = out++;
+            code = 1;
+        }
+        else {
+            dst[out++] = src[i];
+            code++;
+            if (code == 0xFFU) {
+                // Block full, the next one starts without a 0 in between
+                dst[code_at] = code;
+                code_at = out++;
+                code = 1;
+            }
+        }
+    }
+    dst[code_at] = code;
+    return out;
+}
+
+void cobs_reset(struct cobs_decoder *d) {
+    d->left = 0;
+    d->zero = 0;
+}
+
+int cobs_decode(struct cobs_decoder *d, uint8_t c) {
+    if (c == 0) {
+        cobs_reset(d);
+        return COBS_END;
+    }
+    if (d->left) {
+        d->left--;
+        return c;
+    }
+    // Code byte: the previous block (if any) ended with a 0, unless it was a full one
+    int out = d->zero ? 0 : COBS_SKIP;
+    d->left = (uint8_t)(c - 1U);
+    d->zero = c != 0xFFU;
+    return out;
+}
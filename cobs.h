@@ -0,0 +1,43 @@
+/*
+Consistent Overhead Byte Stuffing (COBS) framing
+
+A frame is encoded without 0 bytes and ended by a single 0, so a receiver that
+lost bytes (or started listening mid-frame) is back in sync at the next 0. The
+cost is one byte per 254 plus the delimiter (~0.5% for a 1 KB page), vs doubling
+every escaped byte with SLIP-style escaping in the worst case.
+
+Encoding: every 0 of the data is replaced by the distance to the next one, and a
+code byte in front points at the first:
+
+    data     11 22 00 33          ->  03 11 22 02 33 00
+    data     00                   ->  01 01 00
+    254 non-zero bytes            ->  FF <254 bytes> 01 00
+
+Decoding is done one byte at a time (from a receive interrupt), no frame buffer needed.
+*/
+#ifndef COBS_H
+#define COBS_H
+
+#include <stdint.h>
+
+// Largest encoding of len bytes (without the delimiter)
+#define COBS_MAX(len) ((len) + (len) / 254U + 1U)
+
+// Encode len bytes to dst (COBS_MAX(len) bytes). Returns the encoded length, the 0 delimiter isn't added.
+uint32_t cobs_encode(uint8_t *dst, const uint8_t *src, uint32_t len);
+
+struct cobs_decoder {
+    uint8_t left; // data bytes left in the current block
+    uint8_t zero; // a 0 comes after the current block
+};
+
+#define COBS_SKIP (-1) // code byte, nothing decoded
+#define COBS_END (-2) // delimiter, the frame is complete (the decoder is ready for the next one)
+
+// Initial state (or use a zeroed struct)
+void cobs_reset(struct cobs_decoder *d);
+
+// Feed one received byte. Returns the decoded byte (0..255), COBS_SKIP or COBS_END.
+int cobs_decode(struct cobs_decoder *d, uint8_t c);
+
+#endif
@@ -0,0 +1,74 @@
+/*
+CRC32 / CRC16-CCITT, see crc.h
+
+A CRC table is linear: T[a ^ b] = T[a] ^ T[b]. So every entry is the XOR of the
+entries for its set bits, and only those 8 single-bit entries need the bit by bit
+division. For the single-bit entries:
+ - reflected CRC32: T[0x80] = poly, T[0x40] = step(T[0x80]), ...
+ - MSB first CRC16: T[0x01] = poly, T[0x02] = step(T[0x01]), ...
+*/
+
+#include "crc.h"
+#include "lut.h"
+
+/* --- CRC32 table --- */
+#define CRC32_POLY 0xEDB88320UL
+#define CRC32_STEP(c) (((c) >> 1) ^ (CRC32_POLY & (0UL - ((c) & 1UL))))
+
+#define CRC32_B7 CRC32_POLY
+#define CRC32_B6 CRC32_STEP(CRC32_B7)
+#define CRC32_B5 CRC32_STEP(CRC32_B6)
+#define CRC32_B4 CRC32_STEP(CRC32_B5)
+#define CRC32_B3 CRC32_STEP(CRC32_B4)
+#define CRC32_B2 CRC32_STEP(CRC32_B3)
+#define CRC32_B1 CRC32_STEP(CRC32_B2)
+#define CRC32_B0 CRC32_STEP(CRC32_B1)
+
+#define CRC_BIT(i, b, v) ((0UL - (((i) >> (b)) & 1UL)) & (v))
+#define CRC32_ENTRY(i) (uint32_t)(CRC_BIT(i, 0, CRC32_B0) ^ CRC_BIT(i, 1, CRC32_B1) ^ CRC_BIT(i, 2, CRC32_B2) ^ \
+    CRC_BIT(i, 3, CRC32_B3) ^ CRC_BIT(i, 4, CRC32_B4) ^ CRC_BIT(i, 5, CRC32_B5) ^ CRC_BIT(i, 6, CRC32_B6) ^ \
+    CRC_BIT(i, 7, CRC32_B7)),
+
+static const uint32_t crc32_table[256] = {
+    LUT_R256(CRC32_ENTRY, 0)
+};
+
+/* --- CRC16-CCITT table --- */
+#define CRC16_POLY 0x1021UL
+#define CRC16_STEP(c) ((((c) << 1) ^ (CRC16_POLY & (0UL - (((c) >> 15) & 1UL)))) & 0xFFFFUL)
+
+#define CRC16_B0 CRC16_POLY
+#define CRC16_B1 CRC16_STEP(CRC16_B0)
+#define CRC16_B2 CRC16_STEP(CRC16_B1)
+#define CRC16_B3 CRC16_STEP(CRC16_B2)
+#define CRC16_B4 CRC16_STEP(CRC16_B3)
+#define CRC16_B5 CRC16_STEP(CRC16_B4)
+#define CRC16_B6 CRC16_STEP(CRC16_B5)
+#define CRC16_B7 CRC16_STEP(CRC16_B6)
+
+#define CRC16_ENTRY(i) (uint16_t)(CRC_BIT(i, 0, CRC16_B0) ^ CRC_BIT(i, 1, CRC16_B1) ^ CRC_BIT(i, 2, CRC16_B2) ^ \
+    CRC_BIT(i, 3, CRC16_B3) ^ CRC_BIT(i, 4, CRC16_B4) ^ CRC_BIT(i, 5, CRC16_B5) ^ CRC_BIT(i, 6, CRC16_B6) ^ \
+    CRC_BIT(i, 7, CRC16_B7)),
+
+static const uint16_t crc16_table[256] = {
+    LUT_R256(CRC16_ENTRY, 0)
+};
+
+uint32_t crc32(uint32_t crc, const void *data, uint32_t len) {
+    const uint8_t *p = data;
+
+    crc = ~crc;
+    while (len--) {
+        crc = (crc >> 8) ^ crc32_table[(crc ^ *p++) & 0xFFU];
+    }
+    return ~crc;
+}
+
+uint16_t crc16_ccitt(uint16_t crc, const void *data, uint32_t len) {
+    const uint8_t *p = data;
+
+    while (len--) {
+        crc = (uint16_t)((crc << 8) ^ crc16_table[((crc >> 8) ^ *p++) & 0xFFU]);
+    }
+    return crc;
+}
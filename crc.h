@@ -0,0 +1,21 @@
+/*
+Table driven CRCs, tables generated at compile time (see lut.h)
+
+- crc32: IEEE 802.3 / zlib (reflected, polynomial 0xEDB88320). Pass 0 to start,
+  pass the previous result to continue: crc32(crc32(0, a, n), b, m) == crc32 of a then b.
+- crc16_ccitt: CCITT-FALSE (polynomial 0x1021, MSB first). Pass CRC16_CCITT_INIT to start.
+
+The STM32F103 CRC unit only does the non-reflected 32-bit polynomial one word at a time,
+which doesn't match what host tools compute, so these run in software (~8 cycles per byte).
+*/
+#ifndef CRC_H
+#define CRC_H
+
+#include <stdint.h>
+
+#define CRC16_CCITT_INIT 0xFFFFU
+
+uint32_t crc32(uint32_t crc, const void *data, uint32_t len);
+uint16_t crc16_ccitt(uint16_t crc, const void *data, uint32_t len);
+
+#endif
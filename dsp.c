@@ -0,0 +1,325 @@
+/*
+Fixed-point DSP kernels (Q15 / Q31), see dsp.h for formats and cycle counts.
+
+We link with -nostdlib, so there is no libgcc: no 64-bit division and no
+64-bit shifts by a variable amount in here (shifts by a constant are inlined).
+*/
+
+#include "dsp.h"
+#include "intmath.h"
+
+/* --- Saturation helpers --- */
+
+// Saturate a 64-bit value to 32 bits (fast path: one compare when it already fits)
+static inline int32_t clamp32(int64_t v) {
+    int32_t hi = (int32_t)(v >> 32);
+    int32_t lo = (int32_t)v;
+
+    if (hi != (lo >> 31)) {
+        lo = (hi >> 31) ^ 0x7FFFFFFF; // INT32_MIN if negative, INT32_MAX if positive
+    }
+    return lo;
+}
+
+// Q30 (product of two Q15) accumulator -> Q15, rounded and saturated
+static inline q15_t q30_to_q15(int64_t acc) {
+    return (q15_t)IMATH_SSAT(clamp32((acc + (1 << 14)) >> 15), 16);
+}
+
+// Q29 (product of Q14 coefficient and Q15 sample) accumulator -> Q15, rounded and saturated
+static inline q15_t q29_to_q15(int64_t acc) {
+    return (q15_t)IMATH_SSAT(clamp32((acc + (1 << 13)) >> 14), 16);
+}
+
+// Q62 (product of two Q31) accumulator -> Q31, rounded and saturated
+static inline q31_t q62_to_q31(int64_t acc) {
+    return clamp32((acc + (1 << 30)) >> 31);
+}
+
+/* --- Dot product --- */
+
+int64_t dsp_dot_q15(const q15_t *a, const q15_t *b, uint32_t n) {
+    int64_t acc = 0;
+    uint32_t blocks = n >> 2;
+
+    // The product of two Q15 fits in 32 bits: MUL (1 cycle) + 64-bit add (ADDS/ADC)
+    // is cheaper than SMLAL (4-7 cycles)
+    while (blocks--) {
+        acc += (int32_t)(a[0] * b[0]);
+        acc += (int32_t)(a[1] * b[1]);
+        acc += (int32_t)(a[2] * b[2]);
+        acc += (int32_t)(a[3] * b[3]);
+        a += 4;
+        b += 4;
+    }
+
+    n &= 3;
+    while (n--) {
+        acc += (int32_t)(*a++ * *b++);
+    }
+    return acc;
+}
+
+int64_t dsp_dot_q31(const q31_t *a, const q31_t *b, uint32_t n) {
+    int64_t acc = 0;
+    uint32_t blocks = n >> 2;
+
+    while (blocks--) {
+        acc += ((int64_t)a[0] * b[0]) >> 14;
+        acc += ((int64_t)a[1] * b[1]) >> 14;
+        acc += ((int64_t)a[2] * b[2]) >> 14;
+        acc += ((int64_t)a[3] * b[3]) >> 14;
+        a += 4;
+        b += 4;
+    }
+
+    n &= 3;
+    while (n--) {
+        acc += ((int64_t)*a++ * *b++) >> 14;
+    }
+    return acc;
+}
+
+/* --- FIR filter --- */
+
+void dsp_fir_q15_init(struct dsp_fir_q15 *f, uint16_t num_taps, const q15_t *coeffs, q15_t *state, uint32_t block_size) {
+    f->num_taps = num_taps;
+    f->coeffs = coeffs;
+    f->state = state;
+
+    for (uint32_t i = 0; i < num_taps + block_size - 1; i++) {
+        state[i] = 0;
+    }
+}
+
+/*
+state layout during a call: [ previous num_taps - 1 samples | new block ]
+Output i uses state[i .. i + num_taps - 1].
+
+Outputs are computed in pairs: each coefficient is loaded once and each sample
+is loaded once and used for both outputs (register blocking), which halves the loads.
+*/
+void dsp_fir_q15(struct dsp_fir_q15 *f, const q15_t *in, q15_t *out, uint32_t block_size) {
+    const uint32_t taps = f->num_taps;
+    const q15_t *coeffs = f->coeffs;
+    q15_t *state = f->state;
+    uint32_t i;
+
+    for (i = 0; i < block_size; i++) {
+        state[taps - 1 + i] = in[i];
+    }
+
+    for (i = 0; i + 1 < block_size; i += 2) {
+        const q15_t *x = &state[i];
+        const q15_t *c = coeffs;
+        int64_t acc0 = 0;
+        int64_t acc1 = 0;
+        int32_t x0 = x[0];
+        uint32_t k = taps >> 1;
+
+        while (k--) {
+            int32_t c0 = c[0];
+            int32_t c1 = c[1];
+            int32_t x1 = x[1];
+            int32_t x2 = x[2];
+
+            acc0 += (int32_t)(c0 * x0);
+            acc1 += (int32_t)(c0 * x1);
+            acc0 += (int32_t)(c1 * x1);
+            acc1 += (int32_t)(c1 * x2);
+
+            x0 = x2;
+            x += 2;
+            c += 2;
+        }
+        if (taps & 1) {
+            acc0 += (int32_t)(c[0] * x0);
+            acc1 += (int32_t)(c[0] * x[1]);
+        }
+
+        out[i] = q30_to_q15(acc0);
+        out[i + 1] = q30_to_q15(acc1);
+    }
+
+    // Odd block size: one output left over
+    if (i < block_size) {
+        out[i] = q30_to_q15(dsp_dot_q15(&state[i], coeffs, taps));
+    }
+
+    // Keep the last num_taps - 1 samples for the next block
+    for (i = 0; i < taps - 1; i++) {
+        state[i] = state[block_size + i];
+    }
+}
+
+void dsp_fir_q31_init(struct dsp_fir_q31 *f, uint16_t num_taps, const q31_t *coeffs, q31_t *state, uint32_t block_size) {
+    f->num_taps = num_taps;
+    f->coeffs = coeffs;
+    f->state = state;
+
+    for (uint32_t i = 0; i < num_taps + block_size - 1; i++) {
+        state[i] = 0;
+    }
+}
+
+/*
+Same structure as the Q15 version, accumulating the full Q62 products with SMLAL.
+Like CMSIS, there are no guard bits: scale the input down by log2(num_taps) bits
+if the filter gain can exceed 1.
+*/
+void dsp_fir_q31(struct dsp_fir_q31 *f, const q31_t *in, q31_t *out, uint32_t block_size) {
+    const uint32_t taps = f->num_taps;
+    const q31_t *coeffs = f->coeffs;
+    q31_t *state = f->state;
+    uint32_t i;
+
+    for (i = 0; i < block_size; i++) {
+        state[taps - 1 + i] = in[i];
+    }
+
+    for (i = 0; i + 1 < block_size; i += 2) {
+        const q31_t *x = &state[i];
+        const q31_t *c = coeffs;
+        int64_t acc0 = 0;
+        int64_t acc1 = 0;
+        int32_t x0 = x[0];
+        uint32_t k = taps >> 1;
+
+        while (k--) {
+            int32_t c0 = c[0];
+            int32_t c1 = c[1];
+            int32_t x1 = x[1];
+            int32_t x2 = x[2];
+
+            acc0 += (int64_t)c0 * x0;
+            acc1 += (int64_t)c0 * x1;
+            acc0 += (int64_t)c1 * x1;
+            acc1 += (int64_t)c1 * x2;
+
+            x0 = x2;
+            x += 2;
+            c += 2;
+        }
+        if (taps & 1) {
+            acc0 += (int64_t)c[0] * x0;
+            acc1 += (int64_t)c[0] * x[1];
+        }
+
+        out[i] = q62_to_q31(acc0);
+        out[i + 1] = q62_to_q31(acc1);
+    }
+
+    if (i < block_size) {
+        int64_t acc = 0;
+        for (uint32_t k = 0; k < taps; k++) {
+            acc += (int64_t)coeffs[k] * state[i + k];
+        }
+        out[i] = q62_to_q31(acc);
+    }
+
+    for (i = 0; i < taps - 1; i++) {
+        state[i] = state[block_size + i];
+    }
+}
+
+/* --- Biquad IIR --- */
+
+void dsp_biquad_q15_init(struct dsp_biquad_q15 *f, uint8_t num_stages, const q15_t *coeffs, q15_t *state) {
+    f->num_stages = num_stages;
+    f->coeffs = coeffs;
+    f->state = state;
+
+    for (uint32_t i = 0; i < 4U * num_stages; i++) {
+        state[i] = 0;
+    }
+}
+
+/*
+Each stage runs over the whole block before the next one (output of stage n is the
+input of stage n + 1), so the coefficients and state stay in registers for the inner loop.
+*/
+void dsp_biquad_q15(struct dsp_biquad_q15 *f, const q15_t *in, q15_t *out, uint32_t block_size) {
+    const q15_t *c = f->coeffs;
+    q15_t *s = f->state;
+
+    for (uint32_t stage = 0; stage < f->num_stages; stage++) {
+        const int32_t b0 = c[0], b1 = c[1], b2 = c[2], a1 = c[3], a2 = c[4];
+        int32_t x1 = s[0], x2 = s[1], y1 = s[2], y2 = s[3];
+
+        for (uint32_t n = 0; n < block_size; n++) {
+            int32_t x0 = in[n];
+            int64_t acc = (int32_t)(b0 * x0);
+
+            acc += (int32_t)(b1 * x1);
+            acc += (int32_t)(b2 * x2);
+            acc += (int32_t)(a1 * y1);
+            acc += (int32_t)(a2 * y2);
+
+            x2 = x1;
+            x1 = x0;
+            y2 = y1;
+            y1 = q29_to_q15(acc);
+
+            out[n] = (q15_t)y1;
+        }
+
+        s[0] = (q15_t)x1;
+        s[1] = (q15_t)x2;
+        s[2] = (q15_t)y1;
+        s[3] = (q15_t)y2;
+
+        in = out; // next stage filters in place
+        c += 5;
+        s += 4;
+    }
+}
+
+/* --- Moving average --- */
+
+void dsp_movavg_q15_init(struct dsp_movavg_q15 *m, q15_t *history, uint16_t length) {
+    m->length = length;
+    m->index = 0;
+    m->sum = 0;
+    m->history = history;
+
+    for (uint32_t i = 0; i < length; i++) {
+        history[i] = 0;
+    }
+}
+
+void dsp_movavg_q15(struct dsp_movavg_q15 *m, const q15_t *in, q15_t *out, uint32_t block_size) {
+    const int32_t length = m->length;
+    uint32_t index = m->index;
+    int32_t sum = m->sum;
+    q15_t *history = m->history;
+
+    for (uint32_t n = 0; n < block_size; n++) {
+        int32_t x = in[n];
+
+        sum += x - history[index];
+        history[index] = (q15_t)x;
+        if (++index == (uint32_t)length) {
+            index = 0;
+        }
+        out[n] = (q15_t)(sum / length); // SDIV, 2-12 cycles. The mean of Q15 values always fits in Q15
+    }
+
+    m->index = (uint16_t)index;
+    m->sum = sum;
+}
+
+/* --- RMS --- */
+
+q15_t dsp_rms_q15(const q15_t *x, uint32_t n) {
+    if (n == 0) {
+        return 0;
+    }
+
+    uint64_t sum = (uint64_t)dsp_dot_q15(x, x, n); // Q30, >= 0
+
+    // sum <= n * 2^30, so the mean fits in 32 bits (and the high word is < n)
+    uint32_t mean = imath_udiv64((uint32_t)(sum >> 32), (uint32_t)sum, n);
+    uint32_t root = imath_sqrt32(mean);
+
+    return (q15_t)(root > 32767U ? 32767U : root);
+}
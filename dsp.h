@@ -0,0 +1,121 @@
+/*
+Fixed-point DSP kernels (Q15 / Q31) for the Cortex-M3
+
+The STM32F103 has no FPU and the M3 has no SIMD DSP instructions (no SMLAD, QADD, ...).
+What it does have:
+ - MUL / MLA: 32 x 32 -> 32 in 1 / 2 cycles
+ - SMULL / SMLAL: 32 x 32 -> 64 in 3-5 / 4-7 cycles (early terminating)
+ - SSAT / USAT: single cycle saturation to any bit width
+
+So the kernels here:
+ - Q15: multiply with MUL (the product of two Q15 values always fits in 32 bits)
+   and add the product into a 64-bit accumulator (ADDS + ADC)
+ - Q31: multiply-accumulate with SMULL / SMLAL
+ - Are unrolled (4 samples per loop, or 2 outputs per tap for the FIR), except the
+   recursive ones, dsp_biquad_q15 and dsp_movavg_q15: each output needs the one before
+   it (y[n-1], the running sum), so unrolling would only save the loop branch
+ - Round to nearest (add half an LSB before the shift) and saturate with SSAT
+
+Number formats:
+ - Q15: int16_t, value = x / 2^15, range [-1, 1)
+ - Q31: int32_t, value = x / 2^31, range [-1, 1)
+
+Estimated cycle counts (from the ARMv7-M instruction timings, 0 flash wait states,
+i.e. running at the default 8 MHz HSI. At 72 MHz with 2 wait states add ~10-20%
+unless the loop fits in the prefetch buffer). A BENCH=1 build times the FIR filters
+and the biquad on the board with the DWT cycle counter (bench.h):
+
+    kernel              cycles                        notes
+    dsp_dot_q15         ~4   per element              LDRSH x2, MUL, ADDS/ADC
+    dsp_dot_q31         ~7   per element              LDR x2, SMULL, shift, ADDS/ADC
+    dsp_fir_q15         ~4   per tap per output       2 outputs per pass share loads
+    dsp_fir_q31         ~6.5 per tap per output       SMLAL
+    dsp_biquad_q15      ~30  per sample per stage     5 MACs + state shuffle
+    dsp_movavg_q15      ~12  per sample               independent of window length
+    dsp_rms_q15         ~4   per element + ~150       64/32 divide + integer sqrt
+*/
+#ifndef DSP_H
+#define DSP_H
+
+#include <stdint.h>
+
+typedef int16_t q15_t;
+typedef int32_t q31_t;
+
+#define Q15_MAX ((q15_t)0x7FFF)
+#define Q15_MIN ((q15_t)0x8000)
+#define Q31_MAX ((q31_t)0x7FFFFFFF)
+#define Q31_MIN ((q31_t)0x80000000)
+
+/* Convert a constant to Q15 / Q31 at compile time, e.g. Q15(0.5) */
+#define Q15(x) ((q15_t)((x) >= 1.0 ? 32767 : (x) * 32768.0 + ((x) < 0 ? -0.5 : 0.5)))
+#define Q31(x) ((q31_t)((x) >= 1.0 ? 2147483647 : (x) * 2147483648.0 + ((x) < 0 ? -0.5 : 0.5)))
+
+/* --- Dot product --- */
+
+// Returns the sum of a[i] * b[i] as Q34.30 (no saturation, 33 guard bits)
+int64_t dsp_dot_q15(const q15_t *a, const q15_t *b, uint32_t n);
+
+// Returns the sum of a[i] * b[i] as Q16.48 (each product is shifted down by 14, like CMSIS)
+int64_t dsp_dot_q31(const q31_t *a, const q31_t *b, uint32_t n);
+
+/* --- FIR filter ---
+Coefficients are stored time reversed: coeffs[0] = b[num_taps - 1], ..., coeffs[num_taps - 1] = b[0]
+(this is the CMSIS convention, symmetric filters don't care).
+state must hold num_taps + block_size - 1 samples, where block_size is the largest block passed in.
+*/
+struct dsp_fir_q15 {
+    uint16_t num_taps;
+    const q15_t *coeffs;
+    q15_t *state;
+};
+
+struct dsp_fir_q31 {
+    uint16_t num_taps;
+    const q31_t *coeffs;
+    q31_t *state;
+};
+
+void dsp_fir_q15_init(struct dsp_fir_q15 *f, uint16_t num_taps, const q15_t *coeffs, q15_t *state, uint32_t block_size);
+void dsp_fir_q15(struct dsp_fir_q15 *f, const q15_t *in, q15_t *out, uint32_t block_size);
+
+void dsp_fir_q31_init(struct dsp_fir_q31 *f, uint16_t num_taps, const q31_t *coeffs, q31_t *state, uint32_t block_size);
+void dsp_fir_q31(struct dsp_fir_q31 *f, const q31_t *in, q31_t *out, uint32_t block_size);
+
+/* --- Biquad IIR (cascade of direct form I sections) ---
+Per stage coefficients are {b0, b1, b2, a1, a2} in Q14 (range [-2, 2), which most filter designs need), with
+    y[n] = b0 x[n] + b1 x[n-1] + b2 x[n-2] + a1 y[n-1] + a2 y[n-2]
+Note the sign of a1 / a2: they are the negated denominator coefficients (CMSIS convention).
+state holds 4 samples per stage {x[n-1], x[n-2], y[n-1], y[n-2]}.
+*/
+#define Q14(x) ((q15_t)((x) * 16384.0 + ((x) < 0 ? -0.5 : 0.5)))
+
+struct dsp_biquad_q15 {
+    uint8_t num_stages;
+    const q15_t *coeffs;
+    q15_t *state;
+};
+
+void dsp_biquad_q15_init(struct dsp_biquad_q15 *f, uint8_t num_stages, const q15_t *coeffs, q15_t *state);
+void dsp_biquad_q15(struct dsp_biquad_q15 *f, const q15_t *in, q15_t *out, uint32_t block_size);
+
+/* --- Moving average ---
+Running sum over the last `length` samples, so the cost doesn't depend on the window length.
+history must hold `length` samples.
+*/
+struct dsp_movavg_q15 {
+    uint16_t length;
+    uint16_t index;
+    int32_t sum;
+    q15_t *history;
+};
+
+void dsp_movavg_q15_init(struct dsp_movavg_q15 *m, q15_t *history, uint16_t length);
+void dsp_movavg_q15(struct dsp_movavg_q15 *m, const q15_t *in, q15_t *out, uint32_t block_size);
+
+/* --- RMS --- */
+
+// sqrt(sum(x[i]^2) / n) in Q15 (truncated)
+q15_t dsp_rms_q15(const q15_t *x, uint32_t n);
+
+#endif
@@ -0,0 +1,595 @@
+/*
+Ed25519 verification, see ed25519.h
+
+A signature (R, S) of message M under public key A is valid when
+    [S]B = R + [k]A,  k = SHA-512(R || A || M) mod L
+checked here as R == encode([S]B + [k](-A)), both scalar multiplications in one
+double-and-add pass (Straus): 253 doublings and ~190 additions.
+
+Points use extended twisted Edwards coordinates (X : Y : Z : T), x = X/Z, y = Y/Z,
+x * y = T/Z (Hisil, Wong, Carter, Dawson: "Twisted Edwards Curves Revisited", 2008).
+
+No libgcc: 64 bit values are only multiplied from 32 bit halves, added, and shifted
+by constants, which all compile to inline instructions.
+*/
+
+#include "ed25519.h"
+
+/* --- SHA-512 (FIPS 180-4), only for k --- */
+
+#define ROTR64(x, n) (((x) >> (n)) | ((x) << (64 - (n))))
+
+struct sha512 {
+    uint64_t h[8];
+    uint32_t bytes;
+    uint32_t used;
+    uint8_t block[128];
+};
+
+static const uint64_t k512[80] = {
+    0x428A2F98D728AE22ULL, 0x7137449123EF65CDULL, 0xB5C0FBCFEC4D3B2FULL, 0xE9B5DBA58189DBBCULL,
+    0x3956C25BF348B538ULL, 0x59F111F1B605D019ULL, 0x923F82A4AF194F9BULL, 0xAB1C5ED5DA6D8118ULL,
+    0xD807AA98A3030242ULL, 0x12835B0145706FBEULL, 0x243185BE4EE4B28CULL, 0x550C7DC3D5FFB4E2ULL,
+    0x72BE5D74F27B896FULL, 0x80DEB1FE3B1696B1ULL, 0x9BDC06A725C71235ULL, 0xC19BF174CF692694ULL,
+    0xE49B69C19EF14AD2ULL, 0xEFBE4786384F25E3ULL, 0x0FC19DC68B8CD5B5ULL, 0x240CA1CC77AC9C65ULL,
+    0x2DE92C6F592B0275ULL, 0x4A7484AA6EA6E483ULL, 0x5CB0A9DCBD41FBD4ULL, 0x76F988DA831153B5ULL,
+    0x983E5152EE66DFABULL, 0xA831C66D2DB43210ULL, 0xB00327C898FB213FULL, 0xBF597FC7BEEF0EE4ULL,
+    0xC6E00BF33DA88FC2ULL, 0xD5A79147930AA725ULL, 0x06CA6351E003826FULL, 0x142929670A0E6E70ULL,
+    0x27B70A8546D22FFCULL, 0x2E1B21385C26C926ULL, 0x4D2C6DFC5AC42AEDULL, 0x53380D139D95B3DFULL,
+    0x650A73548BAF63DEULL, 0x766A0ABB3C77B2A8ULL, 0x81C2C92E47EDAEE6ULL, 0x92722C851482353BULL,
+    0xA2BFE8A14CF10364ULL, 0xA81A664BBC423001ULL, 0xC24B8B70D0F89791ULL, 0xC76C51A30654BE30ULL,
+    0xD192E819D6EF5218ULL, 0xD69906245565A910ULL, 0xF40E35855771202AULL, 0x106AA07032BBD1B8ULL,
+    0x19A4C116B8D2D0C8ULL, 0x1E376C085141AB53ULL, 0x2748774CDF8EEB99ULL, 0x34B0BCB5E19B48A8ULL,
+    0x391C0CB3C5C95A63ULL, 0x4ED8AA4AE3418ACBULL, 0x5B9CCA4F7763E373ULL, 0x682E6FF3D6B2B8A3ULL,
+    0x748F82EE5DEFB2FCULL, 0x78A5636F43172F60ULL, 0x84C87814A1F0AB72ULL, 0x8CC702081A6439ECULL,
+    0x90BEFFFA23631E28ULL, 0xA4506CEBDE82BDE9ULL, 0xBEF9A3F7B2C67915ULL, 0xC67178F2E372532BULL,
+    0xCA273ECEEA26619CULL, 0xD186B8C721C0C207ULL, 0xEADA7DD6CDE0EB1EULL, 0xF57D4F7FEE6ED178ULL,
+    0x06F067AA72176FBAULL, 0x0A637DC5A2C898A6ULL, 0x113F9804BEF90DAEULL, 0x1B710B35131C471BULL,
+    0x28DB77F523047D84ULL, 0x32CAAB7B40C72493ULL, 0x3C9EBE0A15C9BEBCULL, 0x431D67C49C100D4CULL,
+    0x4CC5D4BECB3E42B6ULL, 0x597F299CFC657E2AULL, 0x5FCB6FAB3AD6FAECULL, 0x6C44198C4A475817ULL,
+};
+
+static void sha512_compress(uint64_t h[8], const uint8_t *p) {
+    uint64_t w[16];
+    uint64_t a = h[0], b = h[1], c = h[2], d = h[3], e = h[4], f = h[5], g = h[6], hh = h[7];
+
+    for (uint32_t i = 0; i < 80U; i++) {
+        if (i < 16U) {
+            uint64_t x = 0;
+            for (uint32_t j = 0; j < 8U; j++) {
+                x = (x << 8) | p[8U * i + j];
+            }
+            w[i] = x;
+        }
+        else {
+            uint64_t w15 = w[(i - 15U) & 15U];
+            uint64_t w2 = w[(i - 2U) & 15U];
+            w[i & 15U] += (ROTR64(w15, 1) ^ ROTR64(w15, 8) ^ (w15 >> 7)) + w[(i - 7U) & 15U] +
+                (ROTR64(w2, 19) ^ ROTR64(w2, 61) ^ (w2 >> 6));
+        }
+        uint64_t t1 = hh + (ROTR64(e, 14) ^ ROTR64(e, 18) ^ ROTR64(e, 41)) + ((e & f) ^ (~e & g)) + k512[i] + w[i & 15U];
+        uint64_t t2 = (ROTR64(a, 28) ^ ROTR64(a, 34) ^ ROTR64(a, 39)) + ((a & b) ^ (a & c) ^ (b & c));
+        hh = g;
+        g = f;
+        f = e;
+        e = d + t1;
+        d = c;
+        c = b;
+        b = a;
+        a = t1 + t2;
+    }
+    h[0] += a;
+    h[1] += b;
+    h[2] += c;
+    h[3] += d;
+    h[4] += e;
+    h[5] += f;
+    h[6] += g;
+    h[7] += hh;
+}
+
+static void sha512_init(struct sha512 *s) {
+    s->h[0] = 0x6A09E667F3BCC908ULL;
+    s->h[1] = 0xBB67AE8584CAA73BULL;
+    s->h[2] = 0x3C6EF372FE94F82BULL;
+    s->h[3] = 0xA54FF53A5F1D36F1ULL;
+    s->h[4] = 0x510E527FADE682D1ULL;
+    s->h[5] = 0x9B05688C2B3E6C1FULL;
+    s->h[6] = 0x1F83D9ABFB41BD6BULL;
+    s->h[7] = 0x5BE0CD19137E2179ULL;
+    s->bytes = 0;
+    s->used = 0;
+}
+
+static void sha512_update(struct sha512 *s, const uint8_t *p, uint32_t len) {
+    s->bytes += len;
+    while (len--) {
+        s->block[s->used++] = *p++;
+        if (s->used == sizeof(s->block)) {
+            sha512_compress(s->h, s->block);
+            s->used = 0;
+        }
+    }
+}
+
+static void sha512_final(struct sha512 *s, uint8_t digest[64]) {
+    uint32_t bits_hi = s->bytes >> 29;
+    uint32_t bits_lo = s->bytes << 3;
+
+    s->block[s->used++] = 0x80;
+    if (s->used > sizeof(s->block) - 16U) {
+        while (s->used < sizeof(s->block)) {
+            s->block[s->used++] = 0;
+        }
+        sha512_compress(s->h, s->block);
+        s->used = 0;
+    }
+    while (s->used < sizeof(s->block) - 8U) {
+        s->block[s->used++] = 0;
+    }
+    for (uint32_t i = 0; i < 4U; i++) {
+        s->block[120U + i] = (uint8_t)(bits_hi >> (24U - 8U * i));
+        s->block[124U + i] = (uint8_t)(bits_lo >> (24U - 8U * i));
+    }
+    sha512_compress(s->h, s->block);
+
+    // In 32 bit halves: a variable 64 bit shift would need libgcc
+    for (uint32_t i = 0; i < 8U; i++) {
+        uint32_t hi = (uint32_t)(s->h[i] >> 32);
+        uint32_t lo = (uint32_t)s->h[i];
+        for (uint32_t j = 0; j < 4U; j++) {
+            digest[8U * i + j] = (uint8_t)(hi >> (24U - 8U * j));
+            digest[8U * i + 4U + j] = (uint8_t)(lo >> (24U - 8U * j));
+        }
+    }
+}
+
+/* --- Field arithmetic mod p = 2^255 - 19 --- */
+
+// Little endian words, any value below 2^256 (so not unique: x and x + p both fit)
+typedef uint32_t fe[8];
+
+static const fe fe_p = { 0xFFFFFFEDUL, 0xFFFFFFFFUL, 0xFFFFFFFFUL, 0xFFFFFFFFUL,
+    0xFFFFFFFFUL, 0xFFFFFFFFUL, 0xFFFFFFFFUL, 0x7FFFFFFFUL };
+static const fe fe_one = { 1 };
+// d = -121665 / 121666, 2 * d, sqrt(-1) = 2^((p - 1) / 4)
+static const fe fe_d = { 0x135978A3UL, 0x75EB4DCAUL, 0x4141D8ABUL, 0x00700A4DUL,
+    0x7779E898UL, 0x8CC74079UL, 0x2B6FFE73UL, 0x52036CEEUL };
+static const fe fe_d2 = { 0x26B2F159UL, 0xEBD69B94UL, 0x8283B156UL, 0x00E0149AUL,
+    0xEEF3D130UL, 0x198E80F2UL, 0x56DFFCE7UL, 0x2406D9DCUL };
+static const fe fe_sqrtm1 = { 0x4A0EA0B0UL, 0xC4EE1B27UL, 0xAD2FE478UL, 0x2F431806UL,
+    0x3DFBD7A7UL, 0x2B4D0099UL, 0x4FC1DF0BUL, 0x2B832480UL };
+
+static void fe_copy(fe r, const fe a) {
+    for (uint32_t i = 0; i < 8U; i++) {
+        r[i] = a[i];
+    }
+}
+
+// r += carry * 2^256 (= carry * 38)
+static void fe_fold(fe r, uint32_t carry) {
+    while (carry) {
+        uint64_t c = (uint64_t)carry * 38U;
+        for (uint32_t i = 0; i < 8U && c; i++) {
+            c += r[i];
+            r[i] = (uint32_t)c;
+            c >>= 32;
+        }
+        carry = (uint32_t)c; // wrapped past 2^256 again (only when r was just below)
+    }
+}
+
+// r -= borrow * 2^256 (= borrow * 38)
+static void fe_unfold(fe r, uint32_t borrow) {
+    while (borrow) {
+        uint32_t b = 38U;
+        for (uint32_t i = 0; i < 8U && b; i++) {
+            uint64_t t = (uint64_t)r[i] - b;
+            r[i] = (uint32_t)t;
+            b = (uint32_t)(t >> 63);
+        }
+        borrow = b;
+    }
+}
+
+static void fe_add(fe r, const fe a, const fe b) {
+    uint64_t c = 0;
+
+    for (uint32_t i = 0; i < 8U; i++) {
+        c += (uint64_t)a[i] + b[i];
+        r[i] = (uint32_t)c;
+        c >>= 32;
+    }
+    fe_fold(r, (uint32_t)c);
+}
+
+static void fe_sub(fe r, const fe a, const fe b) {
+    uint32_t borrow = 0;
+
+    for (uint32_t i = 0; i < 8U; i++) {
+        uint64_t t = (uint64_t)a[i] - b[i] - borrow;
+        r[i] = (uint32_t)t;
+        borrow = (uint32_t)(t >> 63);
+    }
+    fe_unfold(r, borrow);
+}
+
+// 512 bit product t -> r: low half + 38 * high half
+static void fe_reduce(fe r, const uint32_t t[16]) {
+    uint64_t c = 0;
+
+    for (uint32_t i = 0; i < 8U; i++) {
+        c += (uint64_t)t[i + 8U] * 38U + t[i];
+        r[i] = (uint32_t)c;
+        c >>= 32;
+    }
+    fe_fold(r, (uint32_t)c);
+}
+
+static void fe_mul(fe r, const fe a, const fe b) {
+    uint32_t t[16] = { 0 };
+
+    // Schoolbook, one row per word of a. (2^32 - 1)^2 + 2 * (2^32 - 1) still fits 64 bits.
+    for (uint32_t i = 0; i < 8U; i++) {
+        uint64_t c = 0;
+        for (uint32_t j = 0; j < 8U; j++) {
+            c += (uint64_t)a[i] * b[j] + t[i + j];
+            t[i + j] = (uint32_t)c;
+            c >>= 32;
+        }
+        t[i + 8U] = (uint32_t)c;
+    }
+    fe_reduce(r, t);
+}
+
+static void fe_sq(fe r, const fe a) {
+    uint32_t t[16] = { 0 };
+    uint64_t c;
+
+    // Products a[i] * a[j] with i < j once, doubled, then the squares a[i]^2
+    for (uint32_t i = 0; i < 7U; i++) {
+        c = 0;
+        for (uint32_t j = i + 1U; j < 8U; j++) {
+            c += (uint64_t)a[i] * a[j] + t[i + j];
+            t[i + j] = (uint32_t)c;
+            c >>= 32;
+        }
+        t[i + 8U] = (uint32_t)c;
+    }
+    for (uint32_t i = 15U; i > 0; i--) {
+        t[i] = (t[i] << 1) | (t[i - 1U] >> 31);
+    }
+    t[0] <<= 1;
+    c = 0;
+    for (uint32_t i = 0; i < 8U; i++) {
+        c += (uint64_t)a[i] * a[i] + t[2U * i];
+        t[2U * i] = (uint32_t)c;
+        c >>= 32;
+        c += t[2U * i + 1U];
+        t[2U * i + 1U] = (uint32_t)c;
+        c >>= 32;
+    }
+    fe_reduce(r, t);
+}
+
+// r = a^(2^n)
+static void fe_sqn(fe r, const fe a, uint32_t n) {
+    fe_sq(r, a);
+    while (--n) {
+        fe_sq(r, r);
+    }
+}
+
+/*
+a^(2^250 - 1), and a^11 in a11: the common start of the two exponents below
+(the addition chain from the ref10 implementation)
+*/
+static void fe_pow250(fe r, fe a11, const fe a) {
+    fe t0, t1, t2;
+
+    fe_sq(t0, a); // 2
+    fe_sqn(t1, t0, 2); // 8
+    fe_mul(t1, t1, a); // 9
+    fe_mul(a11, t0, t1); // 11
+    fe_sq(t0, a11); // 22
+    fe_mul(t0, t0, t1); // 2^5 - 1
+    fe_sqn(t1, t0, 5);
+    fe_mul(t0, t1, t0); // 2^10 - 1
+    fe_sqn(t1, t0, 10);
+    fe_mul(t1, t1, t0); // 2^20 - 1
+    fe_sqn(t2, t1, 20);
+    fe_mul(t1, t2, t1); // 2^40 - 1
+    fe_sqn(t1, t1, 10);
+    fe_mul(t0, t1, t0); // 2^50 - 1
+    fe_sqn(t1, t0, 50);
+    fe_mul(t1, t1, t0); // 2^100 - 1
+    fe_sqn(t2, t1, 100);
+    fe_mul(t1, t2, t1); // 2^200 - 1
+    fe_sqn(t1, t1, 50);
+    fe_mul(r, t1, t0); // 2^250 - 1
+}
+
+// 1 / a = a^(p - 2) = a^(2^255 - 21)
+static void fe_invert(fe r, const fe a) {
+    fe t, a11;
+
+    fe_pow250(t, a11, a);
+    fe_sqn(t, t, 5);
+    fe_mul(r, t, a11);
+}
+
+// a^((p - 5) / 8) = a^(2^252 - 3), for the square root
+static void fe_pow22523(fe r, const fe a) {
+    fe t, a11;
+
+    fe_pow250(t, a11, a);
+    fe_sqn(t, t, 2);
+    fe_mul(r, t, a);
+}
+
+// The unique representative below p
+static void fe_canon(fe r, const fe a) {
+    fe_copy(r, a);
+    // 2^256 - 1 = 2p + 37: at most two subtractions
+    for (uint32_t n = 0; n < 2U; n++) {
+        fe t;
+        uint32_t borrow = 0;
+        for (uint32_t i = 0; i < 8U; i++) {
+            uint64_t d = (uint64_t)r[i] - fe_p[i] - borrow;
+            t[i] = (uint32_t)d;
+            borrow = (uint32_t)(d >> 63);
+        }
+        if (borrow) {
+            break;
+        }
+        fe_copy(r, t);
+    }
+}
+
+static int fe_equal(const fe a, const fe b) {
+    fe ca, cb;
+
+    fe_canon(ca, a);
+    fe_canon(cb, b);
+    for (uint32_t i = 0; i < 8U; i++) {
+        if (ca[i] != cb[i]) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+static uint32_t fe_is_odd(const fe a) {
+    fe c;
+
+    fe_canon(c, a);
+    return c[0] & 1U;
+}
+
+static void fe_load(fe r, const uint8_t s[32]) {
+    for (uint32_t i = 0; i < 8U; i++) {
+        r[i] = s[4U * i] | ((uint32_t)s[4U * i + 1U] << 8) | ((uint32_t)s[4U * i + 2U] << 16) |
+            ((uint32_t)s[4U * i + 3U] << 24);
+    }
+}
+
+/* --- Curve points --- */
+
+struct ge {
+    fe x, y, z, t;
+};
+
+// Base point B (RFC 8032 5.1: y = 4/5, x even)
+static const struct ge ge_base = {
+    { 0x8F25D51AUL, 0xC9562D60UL, 0x9525A7B2UL, 0x692CC760UL, 0xFDD6DC5CUL, 0xC0A4E231UL, 0xCD6E53FEUL, 0x216936D3UL },
+    { 0x66666658UL, 0x66666666UL, 0x66666666UL, 0x66666666UL, 0x66666666UL, 0x66666666UL, 0x66666666UL, 0x66666666UL },
+    { 1 },
+    { 0xA5B7DDA3UL, 0x6DDE8AB3UL, 0x775152F5UL, 0x20F09F80UL, 0x64ABE37DUL, 0x66EA4E8EUL, 0xD78B7665UL, 0x67875F0FUL },
+};
+
+// add-2008-hwcd-3: 9 multiplications
+static void ge_add(struct ge *r, const struct ge *p, const struct ge *q) {
+    fe a, b, c, d, e, f, g, h;
+
+    fe_sub(a, p->y, p->x);
+    fe_sub(e, q->y, q->x);
+    fe_mul(a, a, e); // (Y1 - X1) * (Y2 - X2)
+    fe_add(b, p->y, p->x);
+    fe_add(e, q->y, q->x);
+    fe_mul(b, b, e); // (Y1 + X1) * (Y2 + X2)
+    fe_mul(c, p->t, fe_d2);
+    fe_mul(c, c, q->t); // 2d * T1 * T2
+    fe_mul(d, p->z, q->z);
+    fe_add(d, d, d); // 2 * Z1 * Z2
+    fe_sub(e, b, a);
+    fe_sub(f, d, c);
+    fe_add(g, d, c);
+    fe_add(h, b, a);
+    fe_mul(r->x, e, f);
+    fe_mul(r->y, g, h);
+    fe_mul(r->t, e, h);
+    fe_mul(r->z, f, g);
+}
+
+// dbl-2008-hwcd with a = -1: 4 squares, 4 multiplications
+static void ge_dbl(struct ge *r, const struct ge *p) {
+    fe a, b, c, e, f, g, h;
+
+    fe_sq(a, p->x);
+    fe_sq(b, p->y);
+    fe_sq(c, p->z);
+    fe_add(c, c, c);
+    fe_add(e, p->x, p->y);
+    fe_sq(e, e);
+    fe_sub(e, e, a);
+    fe_sub(e, e, b); // 2 * X1 * Y1
+    fe_sub(g, b, a); // -A + B
+    fe_sub(f, g, c);
+    fe_add(h, a, b);
+    fe_sub(h, fe_p, h); // -A - B (p = 0)
+    fe_mul(r->x, e, f);
+    fe_mul(r->y, g, h);
+    fe_mul(r->t, e, h);
+    fe_mul(r->z, f, g);
+}
+
+// RFC 8032 5.1.3. Returns 0, or -1 if s isn't a point.
+static int ge_decode(struct ge *r, const uint8_t s[32]) {
+    fe y2, u, v, v3, x, t;
+    uint32_t sign = s[31] >> 7;
+
+    fe_load(r->y, s);
+    r->y[7] &= 0x7FFFFFFFUL;
+    fe_canon(t, r->y);
+    if (t[0] != r->y[0]) { // y >= p (only p .. p + 18 fit in 255 bits)
+        return -1;
+    }
+
+    // x^2 = u / v = (y^2 - 1) / (d y^2 + 1), candidate x = u v^3 (u v^7)^((p - 5) / 8)
+    fe_sq(y2, r->y);
+    fe_sub(u, y2, fe_one);
+    fe_mul(v, y2, fe_d);
+    fe_add(v, v, fe_one);
+    fe_sq(v3, v);
+    fe_mul(v3, v3, v);
+    fe_sq(x, v3);
+    fe_mul(x, x, v);
+    fe_mul(x, x, u);
+    fe_pow22523(x, x);
+    fe_mul(x, x, v3);
+    fe_mul(x, x, u);
+
+    fe_sq(t, x);
+    fe_mul(t, t, v);
+    if (!fe_equal(t, u)) {
+        fe_add(t, t, u);
+        if (!fe_equal(t, fe_p)) { // v x^2 != -u: no square root
+            return -1;
+        }
+        fe_mul(x, x, fe_sqrtm1);
+    }
+    if (fe_is_odd(x) != sign) {
+        if (fe_equal(x, fe_p)) { // x = 0 has no odd version
+            return -1;
+        }
+        fe_sub(x, fe_p, x);
+    }
+    fe_copy(r->x, x);
+    fe_copy(r->z, fe_one);
+    fe_mul(r->t, x, r->y);
+    return 0;
+}
+
+static void ge_encode(uint8_t s[32], const struct ge *p) {
+    fe zi, x, y;
+
+    fe_invert(zi, p->z);
+    fe_mul(x, p->x, zi);
+    fe_mul(y, p->y, zi);
+    fe_canon(y, y);
+    for (uint32_t i = 0; i < 32U; i++) {
+        s[i] = (uint8_t)(y[i / 4U] >> (8U * (i & 3U)));
+    }
+    s[31] |= (uint8_t)(fe_is_odd(x) << 7);
+}
+
+/* --- Scalars mod L = 2^252 + 27742317777372353535851937790883648493 --- */
+
+static const uint32_t sc_l[8] = { 0x5CF5D3EDUL, 0x5812631AUL, 0xA2F79CD6UL, 0x14DEF9DEUL, 0, 0, 0, 0x10000000UL };
+
+// a < L
+static int sc_below_l(const uint32_t a[8]) {
+    for (uint32_t i = 8U; i-- > 0;) {
+        if (a[i] != sc_l[i]) {
+            return a[i] < sc_l[i];
+        }
+    }
+    return 0;
+}
+
+// r = h mod L for a 512 bit little endian h, one bit at a time (~25 k cycles, next to nothing here)
+static void sc_reduce(uint32_t r[8], const uint8_t h[64]) {
+    for (uint32_t i = 0; i < 8U; i++) {
+        r[i] = 0;
+    }
+    for (uint32_t bit = 512U; bit-- > 0;) {
+        // r = 2r + bit, stays below 2L < 2^254
+        for (uint32_t i = 7U; i > 0; i--) {
+            r[i] = (r[i] << 1) | (r[i - 1U] >> 31);
+        }
+        r[0] = (r[0] << 1) | ((h[bit / 8U] >> (bit & 7U)) & 1U);
+        if (!sc_below_l(r)) {
+            uint32_t borrow = 0;
+            for (uint32_t i = 0; i < 8U; i++) {
+                uint64_t d = (uint64_t)r[i] - sc_l[i] - borrow;
+                r[i] = (uint32_t)d;
+                borrow = (uint32_t)(d >> 63);
+            }
+        }
+    }
+}
+
+static uint32_t sc_bit(const uint32_t a[8], uint32_t bit) {
+    return (a[bit / 32U] >> (bit & 31U)) & 1U;
+}
+
+/* --- Verification --- */
+
+int ed25519_verify(const uint8_t sig[ED25519_SIG_SIZE], const void *msg, uint32_t len,
+    const uint8_t key[ED25519_KEY_SIZE]) {
+    struct ge a, ba, p;
+    struct sha512 h;
+    uint8_t digest[64];
+    uint32_t s[8], k[8];
+
+    // S must be reduced (otherwise S + L would be a second valid signature)
+    fe_load(s, &sig[32]);
+    if (!sc_below_l(s)) {
+        return -1;
+    }
+    if (ge_decode(&a, key) != 0) {
+        return -1;
+    }
+    fe_sub(a.x, fe_p, a.x); // -A
+    fe_sub(a.t, fe_p, a.t);
+
+    sha512_init(&h);
+    sha512_update(&h, sig, 32U);
+    sha512_update(&h, key, ED25519_KEY_SIZE);
+    sha512_update(&h, msg, len);
+    sha512_final(&h, digest);
+    sc_reduce(k, digest);
+
+    // [S]B + [k](-A), both scalars below 2^253. Where both bits are set, add B - A at once.
+    ge_add(&ba, &ge_base, &a);
+    for (uint32_t i = 0; i < 8U; i++) {
+        p.x[i] = 0;
+        p.y[i] = 0;
+        p.z[i] = 0;
+        p.t[i] = 0;
+    }
+    p.y[0] = 1; // neutral element (0, 1)
+    p.z[0] = 1;
+    for (uint32_t bit = 253U; bit-- > 0;) {
+        ge_dbl(&p, &p);
+        uint32_t sb = sc_bit(s, bit);
+        uint32_t kb = sc_bit(k, bit);
+        if (sb && kb) {
+            ge_add(&p, &p, &ba);
+        }
+        else if (sb) {
+            ge_add(&p, &p, &ge_base);
+        }
+        else if (kb) {
+            ge_add(&p, &p, &a);
+        }
+    }
+
+    uint8_t check[32];
+    ge_encode(check, &p);
+    uint32_t diff = 0;
+    for (uint32_t i = 0; i < 32U; i++) {
+        diff |= (uint32_t)(check[i] ^ sig[i]);
+    }
+    return diff ? -1 : 0;
+}
@@ -0,0 +1,25 @@
+/*
+Ed25519 signature verification (RFC 8032), for the bootloader
+
+Only verification: the private key never leaves the build machine (build.sh signs
+with openssl). Everything the check uses is public, so the code doesn't try to run
+in constant time.
+
+Field elements are 8 x 32 bit words with 2^256 = 38 (mod 2^255 - 19), so a product
+is 64 UMULL/UMLAL (36 for a square) and the reduction folds the upper half back in
+with one multiply by 38 per word. A verification is ~4300 field multiplications and
+squares, roughly 3 M cycles (the bootloader prints what it measures, see image.h).
+*/
+#ifndef ED25519_H
+#define ED25519_H
+
+#include <stdint.h>
+
+#define ED25519_KEY_SIZE 32U
+#define ED25519_SIG_SIZE 64U
+
+// 0 if sig is key's signature of msg, -1 otherwise (also for malformed keys and signatures)
+int ed25519_verify(const uint8_t sig[ED25519_SIG_SIZE], const void *msg, uint32_t len,
+    const uint8_t key[ED25519_KEY_SIZE]);
+
+#endif
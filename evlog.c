@@ -0,0 +1,242 @@
+/*
+Flash event log ring, see evlog.h
+
+Page layout (1 KB):
+    header (16 bytes): magic, first_seq, ~first_seq, reserved
+    63 entries       : struct evlog_entry (16 bytes each)
+
+Sequence numbers start at 1 in page 0 and every page holds the next 63, so page k of the
+ring (k = 0, 1, 2, ...) is flash page k % EVLOG_NUM_PAGES with first_seq = 1 + 63 k, and
+entry seq is in slot (seq - 1) % 63. Walking the ring from the oldest page, first_seq
+only goes up until it drops back at the oldest page (a rotated sorted array): that
+drop is what evlog_init() binary searches for.
+
+Entries are programmed in address order, so within a page the used slots are a prefix
+(a torn entry is used but has a bad CRC) and the first free slot is binary searched too.
+*/
+
+#include "evlog.h"
+#include "flash.h"
+#include "crc.h"
+
+#define PAGE_ADDR(i) (EVLOG_BASE + (i) * FLASH_PAGE_SIZE)
+
+#define EVLOG_MAGIC 0x45564C47UL // "EVLG"
+#define ERASED_WORD 0xFFFFFFFFUL
+
+struct evlog_page_header {
+    uint32_t magic;
+    uint32_t first_seq;
+    uint32_t first_seq_check; // ~first_seq, catches a header torn by a power loss
+    uint32_t reserved;
+};
+
+#define HEADER_SIZE ((uint32_t)sizeof(struct evlog_page_header))
+#define ENTRY_SIZE ((uint32_t)sizeof(struct evlog_entry))
+#define ENTRIES_PER_PAGE ((FLASH_PAGE_SIZE - HEADER_SIZE) / ENTRY_SIZE)
+
+static struct {
+    uint32_t page; // newest page
+    uint32_t first_seq; // of the newest page
+    uint32_t slot; // first free slot in the newest page (ENTRIES_PER_PAGE when full)
+    uint32_t boot;
+    uint32_t count; // entries waiting in batch
+    struct evlog_entry batch[EVLOG_BATCH];
+} ev;
+
+static const struct evlog_page_header *page_header(uint32_t page) {
+    return (const struct evlog_page_header *)PAGE_ADDR(page);
+}
+
+static const struct evlog_entry *entry_at(uint32_t page, uint32_t slot) {
+    return (const struct evlog_entry *)(PAGE_ADDR(page) + HEADER_SIZE + slot * ENTRY_SIZE);
+}
+
+static uint16_t entry_crc(const struct evlog_entry *e) {
+    return crc16_ccitt(CRC16_CCITT_INIT, e, ENTRY_SIZE - 2U);
+}
+
+// first_seq of a valid page, 0 for an erased or damaged one (sequence numbers start at 1)
+static uint32_t page_seq(uint32_t page) {
+    const struct evlog_page_header *h = page_header(page);
+
+    if (h->magic != EVLOG_MAGIC || h->first_seq_check != ~h->first_seq) {
+        return 0;
+    }
+    return h->first_seq;
+}
+
+static int slot_used(uint32_t page, uint32_t slot) {
+    const uint32_t *p = (const uint32_t *)entry_at(page, slot);
+
+    return (p[0] & p[1] & p[2] & p[3]) != ERASED_WORD;
+}
+
+static int page_blank(uint32_t page) {
+    const uint32_t *p = (const uint32_t *)PAGE_ADDR(page);
+
+    for (uint32_t i = 0; i < FLASH_PAGE_SIZE / 4U; i++) {
+        if (p[i] != ERASED_WORD) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+// Erase page (if needed) and make it the newest one, starting at first_seq
+static int page_start(uint32_t page, uint32_t first_seq) {
+    struct evlog_page_header h = { EVLOG_MAGIC, first_seq, ~first_seq, ERASED_WORD };
+
+    if (!page_blank(page) && flash_erase_page(PAGE_ADDR(page)) != 0) {
+        return -1;
+    }
+    if (flash_program(PAGE_ADDR(page), &h, HEADER_SIZE) != 0) {
+        return -1;
+    }
+    ev.page = page;
+    ev.first_seq = first_seq;
+    ev.slot = 0;
+    return 0;
+}
+
+void evlog_init(uint32_t boot) {
+    uint32_t seq0 = page_seq(0);
+    uint32_t lo = 0;
+    uint32_t hi = EVLOG_NUM_PAGES - 1U;
+
+    ev.boot = boot;
+    ev.count = 0;
+
+    /*
+    Newest page = last page whose first_seq is >= the one of page 0.
+    Pages after it are older or erased (0), so the predicate is true for a prefix.
+    If page 0 itself is erased (first boot, or its erase was interrupted when the
+    ring wrapped) the search ends on the last page, which is then the newest one.
+    */
+    while (lo < hi) {
+        uint32_t mid = (lo + hi + 1U) / 2U;
+
+        if (page_seq(mid) >= seq0) {
+            lo = mid;
+        }
+        else {
+            hi = mid - 1U;
+        }
+    }
+
+    ev.page = lo;
+    ev.first_seq = page_seq(lo);
+
+    // Empty, or not a layout we wrote: start over at page 0
+    if (ev.first_seq == 0 || (ev.first_seq - 1U) / ENTRIES_PER_PAGE % EVLOG_NUM_PAGES != lo) {
+        for (uint32_t page = 1; page < EVLOG_NUM_PAGES; page++) {
+            if (!page_blank(page)) {
+                flash_erase_page(PAGE_ADDR(page));
+            }
+        }
+        page_start(0, 1);
+        return;
+    }
+
+    // First free slot
+    lo = 0;
+    hi = ENTRIES_PER_PAGE;
+    while (lo < hi) {
+        uint32_t mid = (lo + hi) / 2U;
+
+        if (slot_used(ev.page, mid)) {
+            lo = mid + 1U;
+        }
+        else {
+            hi = mid;
+        }
+    }
+    ev.slot = lo;
+}
+
+void evlog_write(uint16_t id, uint32_t arg) {
+    struct evlog_entry *e = &ev.batch[ev.count++];
+
+    e->boot = ev.boot;
+    e->arg = arg;
+    e->id = id;
+
+    if (ev.count == EVLOG_BATCH) {
+        evlog_flush();
+    }
+}
+
+int evlog_flush(void) {
+    uint32_t i = 0;
+    int result = 0;
+
+    while (i < ev.count) {
+        if (ev.slot == ENTRIES_PER_PAGE) {
+            // Newest page full: the oldest one is erased and takes the next sequence numbers
+            if (page_start((ev.page + 1U) % EVLOG_NUM_PAGES, ev.first_seq + ENTRIES_PER_PAGE) != 0) {
+                result = -1;
+                break;
+            }
+        }
+
+        // As many entries as fit in this page, in one flash_program() call
+        uint32_t run = ev.count - i;
+        if (run > ENTRIES_PER_PAGE - ev.slot) {
+            run = ENTRIES_PER_PAGE - ev.slot;
+        }
+        for (uint32_t k = 0; k < run; k++) {
+            struct evlog_entry *e = &ev.batch[i + k];
+
+            e->seq = ev.first_seq + ev.slot + k;
+            e->crc = entry_crc(e);
+        }
+
+        uint32_t addr = (uint32_t)(uintptr_t)entry_at(ev.page, ev.slot);
+        ev.slot += run; // skip these slots even if programming fails half way
+        if (flash_program(addr, &ev.batch[i], run * ENTRY_SIZE) != 0) {
+            result = -1;
+        }
+        i += run;
+    }
+
+    ev.count = 0; // on a failure the rest of the batch is dropped (a gap in the sequence numbers)
+    return result;
+}
+
+uint32_t evlog_range(uint32_t *oldest, uint32_t *next) {
+    *next = ev.first_seq + ev.slot;
+    *oldest = ev.first_seq;
+
+    // Walk back from the newest page while the pages hold the previous sequence numbers
+    uint32_t page = ev.page;
+    for (uint32_t n = 1; n < EVLOG_NUM_PAGES && *oldest > ENTRIES_PER_PAGE; n++) {
+        page = (page + EVLOG_NUM_PAGES - 1U) % EVLOG_NUM_PAGES;
+        if (page_seq(page) != *oldest - ENTRIES_PER_PAGE) {
+            break;
+        }
+        *oldest -= ENTRIES_PER_PAGE;
+    }
+    return *next - *oldest;
+}
+
+int evlog_read(uint32_t seq, struct evlog_entry *out) {
+    if (seq == 0) {
+        return -1;
+    }
+
+    // Where seq would be (see the top of the file), then check it's really there
+    uint32_t page = (seq - 1U) / ENTRIES_PER_PAGE % EVLOG_NUM_PAGES;
+    uint32_t slot = (seq - 1U) % ENTRIES_PER_PAGE;
+    const struct evlog_entry *e = entry_at(page, slot);
+
+    if (page_seq(page) != seq - slot || e->seq != seq || e->crc != entry_crc(e)) {
+        return -1;
+    }
+
+    out->seq = e->seq;
+    out->boot = e->boot;
+    out->arg = e->arg;
+    out->id = e->id;
+    out->crc = e->crc;
+    return 0;
+}
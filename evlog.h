@@ -0,0 +1,50 @@
+/*
+Persistent event log (field diagnostics that survive resets)
+
+An append-only ring of EVLOG_NUM_PAGES flash pages just below the key-value store.
+- evlog_write() only appends to a RAM batch. The batch is programmed into flash when
+  it is full or on evlog_flush() (call it before an intentional reset or after an
+  important event), so the slow flash programming happens in bursts.
+- Every entry has a sequence number: seq = page first_seq + slot, so the position of
+  an entry follows from its number and gaps show what was lost (unflushed batch,
+  torn write, overwritten oldest page).
+- Sequence numbers start at 1 and map directly to a page and slot, so evlog_read()
+  is a single lookup.
+- When the log is full the oldest page is erased (its 63 entries are dropped).
+- evlog_init() finds the newest page with a binary search over the page headers and
+  the first free slot with a binary search inside that page: O(log n) flash reads,
+  no linear scan of the log.
+*/
+#ifndef EVLOG_H
+#define EVLOG_H
+
+#include <stdint.h>
+
+#define EVLOG_BASE 0x0801E800UL // 4 KB below the key-value store (kv.h), excluded in main_memory.ld
+#define EVLOG_NUM_PAGES 4U
+#define EVLOG_BATCH 16U // entries buffered in RAM before they are written (16 bytes each)
+
+struct evlog_entry {
+    uint32_t seq;
+    uint32_t boot; // boot count passed to evlog_init()
+    uint32_t arg;
+    uint16_t id;
+    uint16_t crc; // CRC16 of the fields above, a torn entry doesn't match
+};
+
+// Locate the end of the log. boot is stored in every entry written from now on.
+void evlog_init(uint32_t boot);
+
+// Queue an event (no flash access unless the batch is full)
+void evlog_write(uint16_t id, uint32_t arg);
+
+// Program the queued events into flash. Returns 0, or -1 on a flash error.
+int evlog_flush(void);
+
+// Sequence number range in flash: [*oldest, *next). Returns the number of slots in that range.
+uint32_t evlog_range(uint32_t *oldest, uint32_t *next);
+
+// Read the entry with sequence number seq. Returns 0, or -1 if it isn't in flash or is damaged.
+int evlog_read(uint32_t seq, struct evlog_entry *out);
+
+#endif
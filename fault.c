@@ -0,0 +1,127 @@
+/*
+Fault handlers with crash dump, see fault.h
+
+On exception entry the core pushes r0-r3, r12, lr, pc and xpsr onto the active stack
+(MSP or PSP, EXC_RETURN bit 2 tells which) and puts EXC_RETURN in lr. The assembly
+entry passes both to fault_capture(), which must not trust that stack: after a stack
+overflow it may point outside RAM.
+
+PM0056 (STM32F10xxx Cortex-M3 programming manual) has the system control block registers.
+*/
+
+#include "fault.h"
+#include "noinit.h"
+#include "crc.h"
+
+// The handler runs on the top NOINIT_FAULT_STACK bytes of the noinit area (noinit.h)
+#define FAULT_STACK_TOP 0x20000400
+#define STR_(x) #x
+#define STR(x) STR_(x)
+#define FAULT_STACK_TOP_STR STR(FAULT_STACK_TOP)
+_Static_assert(FAULT_STACK_TOP == NOINIT_BASE + NOINIT_SIZE, "fault stack must end the noinit area");
+
+#define SRAM_BASE 0x20000000UL
+#define SRAM_END (SRAM_BASE + 20U * 1024U)
+
+// volatile prevents compiler from optimizing (important for hardware access)
+#define REG32(addr) (*(volatile uint32_t *)(addr))
+
+// (PM0056 Table 41 (System control block registers summary))
+#define SCB_AIRCR REG32(0xE000ED0CUL) // Application interrupt and reset control register
+#define SCB_CCR REG32(0xE000ED14UL) // Configuration and control register
+#define SCB_SHCSR REG32(0xE000ED24UL) // System handler control and state register
+#define SCB_CFSR REG32(0xE000ED28UL) // Configurable fault status register (MMFSR, BFSR, UFSR)
+#define SCB_HFSR REG32(0xE000ED2CUL) // HardFault status register
+#define SCB_MMFAR REG32(0xE000ED34UL) // MemManage fault address register
+#define SCB_BFAR REG32(0xE000ED38UL) // BusFault address register
+
+// PM0056 4.4.5 AIRCR: writes need the key in [31:16]
+#define SCB_AIRCR_VECTKEY (0x05FAUL << 16)
+#define SCB_AIRCR_SYSRESETREQ (1U << 2)
+
+// PM0056 4.4.7 CCR
+#define SCB_CCR_DIV_0_TRP (1U << 4)
+
+// PM0056 4.4.9 SHCSR
+#define SCB_SHCSR_MEMFAULTENA (1U << 16)
+#define SCB_SHCSR_BUSFAULTENA (1U << 17)
+#define SCB_SHCSR_USGFAULTENA (1U << 18)
+
+void fault_init(void) {
+    SCB_SHCSR |= SCB_SHCSR_MEMFAULTENA | SCB_SHCSR_BUSFAULTENA | SCB_SHCSR_USGFAULTENA;
+    SCB_CCR |= SCB_CCR_DIV_0_TRP;
+}
+
+static int in_sram(uint32_t addr, uint32_t size) {
+    return addr >= SRAM_BASE && addr <= SRAM_END - size;
+}
+
+// Called from HardFault_Handler (not static: referenced from assembly only)
+__attribute__((used, noreturn)) void fault_capture(const uint32_t *frame, uint32_t exc_return) {
+    volatile struct crash_dump *d = &NOINIT->crash;
+    uint32_t ipsr;
+
+    __asm volatile ("mrs %0, ipsr" : "=r"(ipsr));
+
+    d->magic = 0; // not valid until the CRC is written
+    d->vector = ipsr & 0x1FFU;
+    d->sp = (uint32_t)(uintptr_t)frame;
+    d->exc_return = exc_return;
+
+    if (in_sram(d->sp, 8U * 4U)) {
+        d->r0 = frame[0];
+        d->r1 = frame[1];
+        d->r2 = frame[2];
+        d->r3 = frame[3];
+        d->r12 = frame[4];
+        d->lr = frame[5];
+        d->pc = frame[6];
+        d->xpsr = frame[7];
+    }
+    else {
+        // The core couldn't stack the frame (stack overflow): only the status registers tell
+        d->r0 = d->r1 = d->r2 = d->r3 = d->r12 = d->lr = d->pc = d->xpsr = 0;
+    }
+
+    d->cfsr = SCB_CFSR;
+    d->hfsr = SCB_HFSR;
+    d->mmfar = SCB_MMFAR;
+    d->bfar = SCB_BFAR;
+
+    // Stack above the frame, up to the top of RAM
+    uint32_t n = 0;
+    const uint32_t *p = frame + 8;
+    while (n < CRASH_STACK_WORDS && in_sram((uint32_t)(uintptr_t)p, 4U)) {
+        d->stack[n++] = *p++;
+    }
+    d->stack_words = n;
+
+    d->magic = CRASH_MAGIC;
+    d->crc = crc32(0, (const void *)d, offsetof(struct crash_dump, crc)); // written last: a reset before this leaves the dump invalid
+
+    __asm volatile ("dsb"); // make sure the dump is in RAM before the reset
+    SCB_AIRCR = SCB_AIRCR_VECTKEY | SCB_AIRCR_SYSRESETREQ;
+    __asm volatile ("dsb");
+
+    while (1) {
+        // wait for the reset
+    }
+}
+
+/*
+Shared by all four fault vectors. Naked: no prologue, so nothing is pushed onto a
+stack that may be the reason we are here. fault_capture() then runs on its own
+stack, so it works after a stack overflow and leaves the old stack as it was.
+*/
+__attribute__((naked)) void HardFault_Handler(void) {
+    __asm volatile (
+        "tst lr, #4\n" // EXC_RETURN bit 2: 0 = frame on MSP, 1 = on PSP
+        "ite eq\n"
+        "mrseq r0, msp\n"
+        "mrsne r0, psp\n"
+        "mov r1, lr\n"
+        "ldr r2, =" FAULT_STACK_TOP_STR "\n"
+        "mov sp, r2\n"
+        "b fault_capture\n"
+    );
+}
@@ -0,0 +1,21 @@
+/*
+Fault handlers with crash dump
+
+HardFault, MemManage, BusFault and UsageFault all save the stacked registers, the
+fault status registers and a bounded snapshot of the stack into the crash dump in
+noinit RAM (noinit.h), then reset the chip. The bootloader finds the dump on the
+next boot and reports it over the UART.
+*/
+#ifndef FAULT_H
+#define FAULT_H
+
+#include <stdint.h>
+
+// Give MemManage, BusFault and UsageFault their own vectors (otherwise they escalate
+// to HardFault) and trap integer division by zero (otherwise it returns 0)
+void fault_init(void);
+
+// Vector table entries (main_memory.ld)
+void HardFault_Handler(void);
+
+#endif
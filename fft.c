@@ -0,0 +1,166 @@
+/*
+Q15 fixed-point FFT, see fft.h
+
+Decimation in time on bit reversed input. Two consecutive radix-2 stages
+(half sizes h and 2h) are merged into one radix-4 butterfly over
+x[k], x[k + h], x[k + 2h], x[k + 3h] with twiddles W^2k, W^k, W^3k (W = e^(-j 2 pi / 4h)):
+
+    b = W^2k x[k + h]    c = W^k x[k + 2h]    d = W^3k x[k + 3h]
+    X[k]      = (x[k] + b) + (c + d)
+    X[k + 2h] = (x[k] + b) - (c + d)
+    X[k + h]  = (x[k] - b) - j (c - d)
+    X[k + 3h] = (x[k] - b) + j (c - d)
+*/
+
+#include "fft.h"
+#include "lut.h"
+#include "intmath.h"
+
+// The quarter-wave sine table (lut.c) has 256 steps per quarter turn, enough for FFT_MAX_N = 1024
+#define FFT_QUARTER LUT_SIN_QUARTER
+
+/* Twiddle W^m = cos(2 pi m / FFT_MAX_N) - j sin(2 pi m / FFT_MAX_N), for m in [0, 3/4 turn) */
+static inline void twiddle(uint32_t m, int32_t *c, int32_t *s) {
+    if (m <= FFT_QUARTER) {
+        *c = lut_sin_table[FFT_QUARTER - m];
+        *s = lut_sin_table[m];
+    }
+    else if (m <= 2U * FFT_QUARTER) {
+        *c = -lut_sin_table[m - FFT_QUARTER];
+        *s = lut_sin_table[2U * FFT_QUARTER - m];
+    }
+    else {
+        *c = -lut_sin_table[3U * FFT_QUARTER - m];
+        *s = -lut_sin_table[m - 2U * FFT_QUARTER];
+    }
+}
+
+/* In place bit reversal permutation of n complex points */
+static void bit_reverse(uint32_t *data, uint32_t n) {
+    uint32_t j = 0;
+
+    // Each complex q15 pair is moved as one 32-bit word
+    for (uint32_t i = 0; i < n - 1; i++) {
+        if (i < j) {
+            uint32_t tmp = data[i];
+            data[i] = data[j];
+            data[j] = tmp;
+        }
+        uint32_t bit = n >> 1;
+        while (j & bit) {
+            j ^= bit;
+            bit >>= 1;
+        }
+        j |= bit;
+    }
+}
+
+int fft_q15(q15_t *data, uint32_t n) {
+    if (n < 4U || n > FFT_MAX_N || (n & (n - 1U)) != 0) {
+        return -1;
+    }
+
+    bit_reverse((uint32_t *)data, n);
+
+    uint32_t h = 1;
+
+    // log2(n) odd: one radix-2 stage with trivial twiddles first
+    if (__builtin_ctz(n) & 1) {
+        for (uint32_t i = 0; i < 2U * n; i += 4) {
+            int32_t ar = data[i], ai = data[i + 1];
+            int32_t br = data[i + 2], bi = data[i + 3];
+
+            data[i] = (q15_t)((ar + br) >> 1);
+            data[i + 1] = (q15_t)((ai + bi) >> 1);
+            data[i + 2] = (q15_t)((ar - br) >> 1);
+            data[i + 3] = (q15_t)((ai - bi) >> 1);
+        }
+        h = 2;
+    }
+
+    // Radix-4 stages, each one combines groups of 4h points
+    for (; h < n; h <<= 2) {
+        const uint32_t step = FFT_MAX_N / (4U * h); // twiddle table stride for this stage
+        const uint32_t span = 2U * h; // distance between butterfly legs, in q15 units
+
+        for (uint32_t k = 0; k < h; k++) {
+            int32_t c1, s1, c2, s2, c3, s3;
+
+            // Twiddles only depend on k, so fetch them once for every group
+            twiddle(k * step, &c1, &s1);
+            twiddle(2U * k * step, &c2, &s2);
+            twiddle(3U * k * step, &c3, &s3);
+
+            for (q15_t *p = data + 2U * k; p < data + 2U * n; p += 4U * span) {
+                int32_t ar = p[0], ai = p[1];
+                int32_t xr, xi;
+
+                // W x = (c - j s)(xr + j xi) = (c xr + s xi) + j (c xi - s xr), in Q15
+                xr = p[span]; xi = p[span + 1];
+                int32_t br = (c2 * xr + s2 * xi + (1 << 14)) >> 15;
+                int32_t bi = (c2 * xi - s2 * xr + (1 << 14)) >> 15;
+
+                xr = p[2U * span]; xi = p[2U * span + 1];
+                int32_t cr = (c1 * xr + s1 * xi + (1 << 14)) >> 15;
+                int32_t ci = (c1 * xi - s1 * xr + (1 << 14)) >> 15;
+
+                xr = p[3U * span]; xi = p[3U * span + 1];
+                int32_t dr = (c3 * xr + s3 * xi + (1 << 14)) >> 15;
+                int32_t di = (c3 * xi - s3 * xr + (1 << 14)) >> 15;
+
+                int32_t t0r = ar + br, t0i = ai + bi;
+                int32_t t1r = ar - br, t1i = ai - bi;
+                int32_t t2r = cr + dr, t2i = ci + di;
+                int32_t t3r = cr - dr, t3i = ci - di;
+
+                // Scale by 1/4 per radix-4 stage
+                p[0] = (q15_t)IMATH_SSAT((t0r + t2r) >> 2, 16);
+                p[1] = (q15_t)IMATH_SSAT((t0i + t2i) >> 2, 16);
+                p[span] = (q15_t)IMATH_SSAT((t1r + t3i) >> 2, 16);
+                p[span + 1] = (q15_t)IMATH_SSAT((t1i - t3r) >> 2, 16);
+                p[2U * span] = (q15_t)IMATH_SSAT((t0r - t2r) >> 2, 16);
+                p[2U * span + 1] = (q15_t)IMATH_SSAT((t0i - t2i) >> 2, 16);
+                p[3U * span] = (q15_t)IMATH_SSAT((t1r - t3i) >> 2, 16);
+                p[3U * span + 1] = (q15_t)IMATH_SSAT((t1i + t3r) >> 2, 16);
+            }
+        }
+    }
+    return 0;
+}
+
+void fft_magnitude_q15(q15_t *data, uint32_t n) {
+    // Writing data[k] after reading data[2k], data[2k + 1] never clobbers unread bins
+    for (uint32_t k = 0; k < n; k++) {
+        int32_t re = data[2U * k];
+        int32_t im = data[2U * k + 1U];
+        uint32_t mag = imath_sqrt32((uint32_t)(re * re) + (uint32_t)(im * im));
+
+        data[k] = (q15_t)(mag > 32767U ? 32767U : mag);
+    }
+}
+
+uint32_t fft_peak_q15(const q15_t *mag, uint32_t n, q15_t *peak_mag) {
+    uint32_t peak = 1;
+
+    for (uint32_t k = 2; k < n / 2U; k++) {
+        if (mag[k] > mag[peak]) {
+            peak = k;
+        }
+    }
+    if (peak_mag) {
+        *peak_mag = mag[peak];
+    }
+
+    uint32_t pos = peak << 8;
+
+    // Parabola through the peak and its neighbours: offset = (l - r) / (2 (l - 2m + r)), in [-0.5, 0.5]
+    if (peak + 1U < n / 2U) {
+        int32_t l = mag[peak - 1U], m = mag[peak], r = mag[peak + 1U];
+        int32_t den = l - 2 * m + r;
+
+        if (den != 0) {
+            pos += (uint32_t)(((l - r) * 128) / den);
+        }
+    }
+    return pos;
+}
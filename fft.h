@@ -0,0 +1,41 @@
+/*
+Q15 fixed-point FFT for spectral analysis (e.g. vibration monitoring)
+
+- Complex, in place, interleaved data: data[2k] = re, data[2k + 1] = im
+  A 1024 point transform needs 4 KB of SRAM and nothing else.
+- Radix-4 stages (3 complex multiplies per 4 points instead of 4), plus one
+  radix-2 stage first when log2(n) is odd.
+- Every stage scales by 1/2 (radix-2) or 1/4 (radix-4), so the output is X[k] / n
+  and can't overflow for inputs with magnitude <= 1.
+- Twiddles come from the 257 entry quarter-wave sine table in lut.c, which the
+  compiler evaluates (no code runs at boot) and places in flash.
+
+Estimated cycle counts (ARMv7-M instruction timings). Not measured yet: a BENCH=1
+build times both sizes on the board (bench.h), replace these with what it logs.
+
+    n       cycles      time at 72 MHz (2 wait states, ~+15%)
+    256     ~18000      ~290 us
+    1024    ~90000      ~1.45 ms
+*/
+#ifndef FFT_H
+#define FFT_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "dsp.h"
+
+#define FFT_MAX_N 1024U
+
+// Forward FFT of n complex points (n a power of two, 4 <= n <= FFT_MAX_N), output is X[k] / n.
+// Returns 0, or -1 if n is not supported.
+int fft_q15(q15_t *data, uint32_t n);
+
+// Replace the n complex bins with their magnitudes, in place: data[k] = |X[k]| for k < n
+void fft_magnitude_q15(q15_t *data, uint32_t n);
+
+// Find the largest bin in mag[1 .. n/2 - 1] (skips DC, real input only has n/2 useful bins).
+// Returns the peak position in bins as Q8 (refined by parabolic interpolation),
+// so the frequency is (peak * sample_rate / n) >> 8. peak_mag may be NULL.
+uint32_t fft_peak_q15(const q15_t *mag, uint32_t n, q15_t *peak_mag);
+
+#endif
@@ -0,0 +1,104 @@
+/*
+Internal flash erase / program, see flash.h
+*/
+
+#include "flash.h"
+
+// volatile prevents compiler from optimizing (important for hardware access)
+#define REG32(addr) (*(volatile uint32_t *)(addr))
+#define REG16(addr) (*(volatile uint16_t *)(addr))
+
+// Flash interface starts at 0x4002_2000 (Flash memory interface in Table 3 (Register boundary addresses))
+#define FLASH_R_BASE 0x40022000UL
+
+// (PM0075 Table 6 (Flash interface - register map))
+#define FLASH_KEYR REG32(FLASH_R_BASE + 0x04UL) // Key register (unlocks FLASH_CR)
+#define FLASH_SR REG32(FLASH_R_BASE + 0x0CUL) // Status register
+#define FLASH_CR REG32(FLASH_R_BASE + 0x10UL) // Control register
+#define FLASH_AR REG32(FLASH_R_BASE + 0x14UL) // Address register (page to erase)
+
+// PM0075 3.3.1 Flash key register: write these two keys in order to unlock FLASH_CR
+#define FLASH_KEY1 0x45670123UL
+#define FLASH_KEY2 0xCDEF89ABUL
+
+// PM0075 3.3.4 Flash status register
+#define FLASH_SR_BSY (1U << 0) // Operation in progress
+#define FLASH_SR_PGERR (1U << 2) // Programming error (target was not erased)
+#define FLASH_SR_WRPRTERR (1U << 4) // Write protection error
+#define FLASH_SR_EOP (1U << 5) // End of operation
+
+// PM0075 3.3.5 Flash control register
+#define FLASH_CR_PG (1U << 0) // Programming
+#define FLASH_CR_PER (1U << 1) // Page erase
+#define FLASH_CR_STRT (1U << 6) // Start erase
+#define FLASH_CR_LOCK (1U << 7) // Locked (set to lock, unlock with the key sequence)
+
+static void flash_unlock(void) {
+    if (FLASH_CR & FLASH_CR_LOCK) {
+        FLASH_KEYR = FLASH_KEY1;
+        FLASH_KEYR = FLASH_KEY2;
+    }
+}
+
+static void flash_lock(void) {
+    FLASH_CR |= FLASH_CR_LOCK;
+}
+
+/* Wait for the current operation, then clear and return the error flags */
+static uint32_t flash_wait(void) {
+    while (FLASH_SR & FLASH_SR_BSY) {
+    }
+    uint32_t errors = FLASH_SR & (FLASH_SR_PGERR | FLASH_SR_WRPRTERR);
+
+    FLASH_SR = errors | FLASH_SR_EOP; // flags are cleared by writing 1
+    return errors;
+}
+
+int flash_erase_page(uint32_t addr) {
+    flash_unlock();
+    flash_wait();
+
+    FLASH_CR |= FLASH_CR_PER;
+    FLASH_AR = addr;
+    FLASH_CR |= FLASH_CR_STRT;
+    uint32_t errors = flash_wait();
+    FLASH_CR &= ~FLASH_CR_PER;
+
+    flash_lock();
+
+    if (errors) {
+        return -1;
+    }
+    // Check the whole page is erased
+    const uint32_t *p = (const uint32_t *)(addr & ~(FLASH_PAGE_SIZE - 1U));
+    for (uint32_t i = 0; i < FLASH_PAGE_SIZE / 4U; i++) {
+        if (p[i] != 0xFFFFFFFFUL) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+int flash_program(uint32_t addr, const void *data, uint32_t len) {
+    const uint8_t *src = data;
+    int result = 0;
+
+    flash_unlock();
+    flash_wait();
+    FLASH_CR |= FLASH_CR_PG;
+
+    for (uint32_t i = 0; i < len; i += 2) {
+        // Assemble byte by byte, the source doesn't have to be aligned
+        uint16_t half = (uint16_t)(src[i] | ((i + 1U < len ? src[i + 1U] : 0xFFU) << 8));
+
+        REG16(addr + i) = half;
+        if (flash_wait() || REG16(addr + i) != half) {
+            result = -1;
+            break;
+        }
+    }
+
+    FLASH_CR &= ~FLASH_CR_PG;
+    flash_lock();
+    return result;
+}
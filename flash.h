@@ -0,0 +1,26 @@
+/*
+Internal flash programming (STM32F103xB: 128 pages of 1 KB)
+
+RM0008 doesn't cover flash programming, see PM0075 (STM32F10xxx Flash memory
+microcontrollers programming manual):
+- Erased flash reads as 0xFF
+- Programming is done one half-word (16 bits) at a time and can only clear bits:
+  a half-word can only be programmed if it is erased (0xFFFF), or written to 0x0000
+- Erasing is per page (1 KB), ~20 ms
+- While the flash is busy, any fetch from flash (code or constants) stalls the CPU
+*/
+#ifndef FLASH_H
+#define FLASH_H
+
+#include <stdint.h>
+
+#define FLASH_PAGE_SIZE 1024U
+
+// Erase the page containing addr. Returns 0, or -1 on error.
+int flash_erase_page(uint32_t addr);
+
+// Program len bytes at addr (addr must be half-word aligned, an odd length is padded with 0xFF).
+// The target must be erased. Returns 0, or -1 on error / readback mismatch.
+int flash_program(uint32_t addr, const void *data, uint32_t len);
+
+#endif
@@ -0,0 +1,51 @@
+/*
+Signed app images, see image.h (bootloader only)
+*/
+
+#include "image.h"
+#include "sha256.h"
+#include "crc.h"
+#include "update.h"
+#include "image_key.h" // IMAGE_PUBLIC_KEY, generated by build.sh from keys/
+
+static const uint8_t public_key[ED25519_KEY_SIZE] = IMAGE_PUBLIC_KEY;
+
+/* The trailer of the image at base, or 0 if the header doesn't describe one inside the slot */
+static const struct image_trailer *find_trailer(uint32_t base) {
+    const struct image_header *h = (const struct image_header *)(uintptr_t)(base + IMAGE_HEADER_OFFSET);
+    uint32_t size = h->size;
+
+    if (h->magic != IMAGE_MAGIC || size < IMAGE_HEADER_OFFSET + sizeof(*h) || (size & 3U) ||
+        size > UPDATE_SLOT_SIZE - sizeof(struct image_trailer)) {
+        return 0;
+    }
+    const struct image_trailer *t = (const struct image_trailer *)(uintptr_t)(base + size);
+    if (t->magic != IMAGE_SIG_MAGIC) {
+        return 0;
+    }
+    return t;
+}
+
+int image_verify(uint32_t base) {
+    const struct image_trailer *t = find_trailer(base);
+    struct sha256 s;
+    uint8_t digest[SHA256_DIGEST];
+
+    if (!t) {
+        return -1;
+    }
+    sha256_init(&s);
+    sha256_update(&s, (const void *)(uintptr_t)base, (uint32_t)(uintptr_t)t - base);
+    sha256_final(&s, digest);
+    return ed25519_verify(t->sig, digest, sizeof(digest), public_key);
+}
+
+uint32_t image_id(uint32_t base) {
+    const struct image_trailer *t = find_trailer(base);
+
+    if (!t) {
+        return 0;
+    }
+    uint32_t id = crc32(0, (const void *)(uintptr_t)(base + IMAGE_HEADER_OFFSET), sizeof(struct image_header));
+    return crc32(id, t, sizeof(*t));
+}
@@ -0,0 +1,44 @@
+/*
+Signed app images
+
+The bootloader only starts (and only installs) an app signed with the private key
+kept on the build machine (keys/, build.sh). Layout of a signed image in a slot:
+    0x000  vector table (main_memory.ld)
+    0x14C  header: IMAGE_MAGIC, size, version (the linker fills them in)
+    ...    rest of the app
+    size   trailer: IMAGE_SIG_MAGIC, Ed25519 signature (appended by build.sh)
+
+The signature (ed25519.h) covers the SHA-256 digest (sha256.h) of the first size
+bytes, so the ~50 KB image is only hashed once and the curve arithmetic runs on 32
+bytes. The whole check costs a few million cycles, i.e. a noticeable part of a second
+at 8 MHz: after one successful check the bootloader leaves a token in noinit RAM
+(noinit.h) and skips the check on the following warm resets of the same image.
+*/
+#ifndef IMAGE_H
+#define IMAGE_H
+
+#include <stdint.h>
+#include "ed25519.h"
+
+#define IMAGE_HEADER_OFFSET 0x14CUL // right after the 83 vector table entries
+#define IMAGE_MAGIC 0x474D4941UL // "AIMG"
+#define IMAGE_SIG_MAGIC 0x4E474953UL // "SIGN"
+
+struct image_header {
+    uint32_t magic;
+    uint32_t size; // bytes covered by the signature, the trailer starts there
+    uint32_t version; // IMAGE_VERSION of build.sh, signed along with the rest
+};
+
+struct image_trailer {
+    uint32_t magic;
+    uint8_t sig[ED25519_SIG_SIZE];
+};
+
+// 0 if the image at base carries a valid signature by the built-in key, -1 otherwise
+int image_verify(uint32_t base);
+
+// Cheap identity of the image at base (crc32 of its header and signature), 0 if it has none
+uint32_t image_id(uint32_t base);
+
+#endif
@@ -0,0 +1,216 @@
+/*
+Integer math helpers for code without an FPU (control loops, ISRs)
+
+The helpers are static inline and avoid libgcc (we link with -nostdlib):
+ - log2 from CLZ (single cycle instruction)
+ - integer square root, bit by bit with masks instead of branches
+ - 64 / 32 -> 32 division built from two UDIVs (no __aeabi_uldivmod)
+ - division by a constant (or a divisor fixed at init) as multiply + shifts
+ - saturating add / sub, and SSAT / USAT
+
+The naive forms they replace are in intmath_ref.c, with a benchmark loop per helper:
+tools/intmath_test.c checks all of them against exact host arithmetic.
+
+Cycles per call vs the naive form. The cycles are estimates from the ARMv7-M
+instruction timings: a BENCH=1 build measures each helper next to its naive form
+(bench.h).
+
+    helper                  cycles          naive form (intmath_ref.c)
+    imath_log2              ~2              shift loop: up to ~3 per bit (~90)
+    imath_sqrt32            ~6 per result   same algorithm with branches: ~8 per
+                            bit pair (~96)  bit pair and data dependent; sqrtf ~500
+    imath_udiv64            ~40             long division a bit at a time: ~8 per
+                                            bit (~260); __aeabi_uldivmod (libgcc,
+                                            not linked) ~100-200
+    imath_recip_div         ~8, constant    UDIV 2-12, data dependent
+    imath_sat_add_s32       ~4              compare + branch ~6-8 (pipeline flush)
+
+UDIV on the M3 is already fast, reciprocal division mostly buys a constant
+execution time (useful for jitter in ISRs) and works for 64-bit intermediate results.
+*/
+#ifndef INTMATH_H
+#define INTMATH_H
+
+#include <stdint.h>
+
+/* --- log2 --- */
+
+// floor(log2(x)), x > 0
+static inline uint32_t imath_log2(uint32_t x) {
+    return 31U - (uint32_t)__builtin_clz(x);
+}
+
+// ceil(log2(x)), x > 0
+static inline uint32_t imath_log2_ceil(uint32_t x) {
+    return x <= 1U ? 0U : 32U - (uint32_t)__builtin_clz(x - 1U);
+}
+
+/* --- Square root --- */
+
+// floor(sqrt(x))
+static inline uint32_t imath_sqrt32(uint32_t x) {
+    if (x == 0) {
+        return 0;
+    }
+
+    uint32_t res = 0;
+    uint32_t bit = 1UL << (imath_log2(x) & ~1U); // skip the leading zero bit pairs
+
+    while (bit) {
+        uint32_t t = res + bit;
+        uint32_t mask = 0U - (uint32_t)(x >= t); // all ones if this bit is set in the result
+
+        x -= t & mask;
+        res = (res >> 1) + (bit & mask);
+        bit >>= 2;
+    }
+    return res;
+}
+
+/* --- Division --- */
+
+/*
+(hi:lo) / d for a 64-bit dividend whose quotient fits in 32 bits (hi < d).
+Normalise d, then two 32 / 16 digit steps with UDIV (Hacker's Delight, divlu).
+*/
+static inline uint32_t imath_udiv64(uint32_t hi, uint32_t lo, uint32_t d) {
+    const uint32_t b = 65536U;
+    uint32_t s = (uint32_t)__builtin_clz(d);
+
+    d <<= s;
+    uint32_t dn1 = d >> 16;
+    uint32_t dn0 = d & 0xFFFFU;
+    uint32_t un32 = (hi << s) | (s ? lo >> (32U - s) : 0U);
+    uint32_t un10 = lo << s;
+    uint32_t un1 = un10 >> 16;
+    uint32_t un0 = un10 & 0xFFFFU;
+
+    uint32_t q1 = un32 / dn1;
+    uint32_t rhat = un32 - q1 * dn1;
+    while (q1 >= b || q1 * dn0 > b * rhat + un1) {
+        q1--;
+        rhat += dn1;
+        if (rhat >= b) {
+            break;
+        }
+    }
+
+    uint32_t un21 = un32 * b + un1 - q1 * d;
+    uint32_t q0 = un21 / dn1;
+    rhat = un21 - q0 * dn1;
+    while (q0 >= b || q0 * dn0 > b * rhat + un0) {
+        q0--;
+        rhat += dn1;
+        if (rhat >= b) {
+            break;
+        }
+    }
+    return q1 * b + q0;
+}
+
+/*
+Division by an invariant divisor d as a multiply (Granlund & Montgomery):
+    l = ceil(log2(d)), m = floor(2^32 (2^l - d) / d) + 1
+    t = (m * x) >> 32, x / d = (t + ((x - t) >> 1)) >> (l - 1)
+Exact for every 32-bit x and every d >= 2.
+
+IMATH_RECIP(d) is a constant expression for a constant d (the compiler does the 64-bit
+division), imath_recip_init() computes the same thing at run time with imath_udiv64.
+*/
+struct imath_recip {
+    uint32_t m;
+    uint32_t shift; // l - 1
+};
+
+#define IMATH_RECIP_L(d) (32U - (uint32_t)__builtin_clz((d) - 1U))
+#define IMATH_RECIP(d) { \
+    (uint32_t)(((((uint64_t)1 << IMATH_RECIP_L(d)) - (d)) << 32) / (d) + 1U), \
+    IMATH_RECIP_L(d) - 1U \
+}
+
+// d >= 2
+static inline struct imath_recip imath_recip_init(uint32_t d) {
+    uint32_t l = imath_log2_ceil(d);
+    uint32_t n = l == 32U ? 0U - d : (1UL << l) - d; // 2^l - d < d, so the quotient fits in 32 bits
+    struct imath_recip r = { imath_udiv64(n, 0, d) + 1U, l - 1U };
+
+    return r;
+}
+
+static inline uint32_t imath_recip_div(uint32_t x, struct imath_recip r) {
+    uint32_t t = (uint32_t)(((uint64_t)r.m * x) >> 32); // UMULL, keep the high word
+
+    return (t + ((x - t) >> 1)) >> r.shift;
+}
+
+/* --- Saturating arithmetic --- */
+
+static inline int32_t imath_sat_add_s32(int32_t a, int32_t b) {
+    int32_t r = (int32_t)((uint32_t)a + (uint32_t)b);
+
+    // Overflow when a and b have the same sign and r doesn't. Compiles to an IT block, not a branch.
+    return ((a ^ r) & (b ^ r)) < 0 ? (a >> 31) ^ INT32_MAX : r;
+}
+
+static inline int32_t imath_sat_sub_s32(int32_t a, int32_t b) {
+    int32_t r = (int32_t)((uint32_t)a - (uint32_t)b);
+
+    return ((a ^ b) & (a ^ r)) < 0 ? (a >> 31) ^ INT32_MAX : r;
+}
+
+static inline uint32_t imath_sat_add_u32(uint32_t a, uint32_t b) {
+    uint32_t r = a + b;
+
+    return r | (0U - (uint32_t)(r < a));
+}
+
+static inline uint32_t imath_sat_sub_u32(uint32_t a, uint32_t b) {
+    uint32_t r = a - b;
+
+    return r & (0U - (uint32_t)(r <= a));
+}
+
+// Saturate x to a signed / unsigned `bits` wide value (bits must be a constant)
+#if defined(__ARM_ARCH_7M__)
+#define IMATH_SSAT(x, bits) __extension__ ({ int32_t __v = (x); \
+    __asm ("ssat %0, %1, %2" : "=r"(__v) : "I"(bits), "r"(__v)); __v; })
+#define IMATH_USAT(x, bits) __extension__ ({ int32_t __v = (x); \
+    __asm ("usat %0, %1, %2" : "=r"(__v) : "I"(bits), "r"(__v)); __v; })
+#else
+#define IMATH_SSAT(x, bits) __extension__ ({ int32_t __v = (x); int32_t __max = (1L << ((bits) - 1)) - 1; \
+    __v > __max ? __max : (__v < -__max - 1 ? -__max - 1 : __v); })
+#define IMATH_USAT(x, bits) __extension__ ({ int32_t __v = (x); int32_t __max = (int32_t)((1UL << (bits)) - 1U); \
+    __v > __max ? __max : (__v < 0 ? 0 : __v); })
+#endif
+
+/* --- Naive forms and benchmark (intmath_ref.c) --- */
+
+uint32_t imath_log2_ref(uint32_t x); // shift loop, x > 0
+uint32_t imath_sqrt32_ref(uint32_t x); // bit pairs with branches
+uint32_t imath_udiv64_ref(uint32_t hi, uint32_t lo, uint32_t d); // a bit at a time, hi < d
+int32_t imath_sat_add_s32_ref(int32_t a, int32_t b); // compare against the limits first
+
+enum imath_bench {
+    IMATH_BENCH_NONE, // the loop alone (reading the inputs, summing the results)
+    IMATH_BENCH_LOG2,
+    IMATH_BENCH_SQRT32,
+    IMATH_BENCH_UDIV64,
+    IMATH_BENCH_RECIP_DIV, // by in[0].d, naive form: UDIV
+    IMATH_BENCH_SAT_ADD_S32,
+    IMATH_BENCH_COUNT,
+};
+
+// Inputs of random bit lengths, d >= 2 and h < d (for imath_udiv64)
+struct imath_bench_input {
+    uint32_t x;
+    uint32_t y;
+    uint32_t d;
+    uint32_t h;
+};
+
+void imath_bench_inputs(struct imath_bench_input *in, uint32_t n, uint32_t seed);
+
+// Run helper (ref: its naive form) on each of n inputs, returns the sum of the results (the same for both)
+uint32_t imath_bench_run(enum imath_bench helper, int ref, const struct imath_bench_input *in, uint32_t n);
+
+#endif
@@ -0,0 +1,147 @@
+/*
+Naive forms of the intmath.h helpers, and the loops that benchmark both (bench.c in a
+BENCH=1 build, tools/intmath_test.c)
+
+Each naive form is what the code would look like without the helper: loops and
+branches, and a long division a bit at a time where libgcc's __aeabi_uldivmod isn't
+linked. Built with the app's flags (-Og), like the helpers' callers.
+*/
+
+#include "intmath.h"
+
+uint32_t imath_log2_ref(uint32_t x) {
+    uint32_t r = 0;
+
+    while (x >>= 1) {
+        __asm volatile ("" : "+r"(x)); // or GCC turns the loop into CLZ itself
+        r++;
+    }
+    return r;
+}
+
+uint32_t imath_sqrt32_ref(uint32_t x) {
+    uint32_t res = 0;
+    uint32_t bit = 1UL << 30;
+
+    while (bit > x) {
+        bit >>= 2;
+    }
+    while (bit) {
+        if (x >= res + bit) {
+            x -= res + bit;
+            res = (res >> 1) + bit;
+        }
+        else {
+            res >>= 1;
+        }
+        bit >>= 2;
+    }
+    return res;
+}
+
+uint32_t imath_udiv64_ref(uint32_t hi, uint32_t lo, uint32_t d) {
+    uint32_t q = 0;
+
+    for (uint32_t i = 0; i < 32U; i++) {
+        uint32_t carry = hi >> 31;
+
+        hi = (hi << 1) | (lo >> 31);
+        lo <<= 1;
+        q <<= 1;
+        if (carry || hi >= d) {
+            hi -= d;
+            q |= 1U;
+        }
+    }
+    return q;
+}
+
+int32_t imath_sat_add_s32_ref(int32_t a, int32_t b) {
+    if (b > 0 && a > INT32_MAX - b) {
+        return INT32_MAX;
+    }
+    if (b < 0 && a < INT32_MIN - b) {
+        return INT32_MIN;
+    }
+    return a + b;
+}
+
+/* --- Benchmark --- */
+
+// Random bit length (1 .. 32), so the data dependent forms see short and long inputs alike
+static uint32_t random_width(uint32_t r, uint32_t bits) {
+    return r >> (bits & 31U);
+}
+
+void imath_bench_inputs(struct imath_bench_input *in, uint32_t n, uint32_t seed) {
+    uint32_t s = seed;
+
+    for (uint32_t i = 0; i < n; i++) {
+        uint32_t r[5];
+        for (uint32_t k = 0; k < 5U; k++) {
+            s = s * 1664525UL + 1013904223UL; // Numerical Recipes LCG, the top bits are the random ones
+            r[k] = s;
+        }
+        in[i].x = random_width(r[0], r[4] >> 27) | 1U;
+        in[i].y = r[1];
+        in[i].d = random_width(r[2], r[4] >> 22) | 2U;
+        in[i].h = r[3] % in[i].d;
+    }
+}
+
+// One loop per form: no test of ref in the loop (only -O3 unswitches loops)
+#define BENCH_LOOP(expr) do { for (uint32_t i = 0; i < n; i++) { sum += (uint32_t)(expr); } } while (0)
+
+uint32_t imath_bench_run(enum imath_bench helper, int ref, const struct imath_bench_input *in, uint32_t n) {
+    uint32_t sum = 0;
+
+    switch (helper) {
+    case IMATH_BENCH_LOG2:
+        if (ref) {
+            BENCH_LOOP(imath_log2_ref(in[i].x));
+        }
+        else {
+            BENCH_LOOP(imath_log2(in[i].x));
+        }
+        break;
+    case IMATH_BENCH_SQRT32:
+        if (ref) {
+            BENCH_LOOP(imath_sqrt32_ref(in[i].y));
+        }
+        else {
+            BENCH_LOOP(imath_sqrt32(in[i].y));
+        }
+        break;
+    case IMATH_BENCH_UDIV64:
+        if (ref) {
+            BENCH_LOOP(imath_udiv64_ref(in[i].h, in[i].y, in[i].d));
+        }
+        else {
+            BENCH_LOOP(imath_udiv64(in[i].h, in[i].y, in[i].d));
+        }
+        break;
+    case IMATH_BENCH_RECIP_DIV: {
+        const uint32_t d = in[0].d;
+        const struct imath_recip r = imath_recip_init(d);
+        if (ref) {
+            BENCH_LOOP(in[i].y / d);
+        }
+        else {
+            BENCH_LOOP(imath_recip_div(in[i].y, r));
+        }
+        break;
+    }
+    case IMATH_BENCH_SAT_ADD_S32:
+        if (ref) {
+            BENCH_LOOP(imath_sat_add_s32_ref((int32_t)in[i].x, (int32_t)in[i].y));
+        }
+        else {
+            BENCH_LOOP(imath_sat_add_s32((int32_t)in[i].x, (int32_t)in[i].y));
+        }
+        break;
+    default:
+        BENCH_LOOP(in[i].x);
+        break;
+    }
+    return sum;
+}
@@ -0,0 +1,368 @@
+/*
+Flash key-value store, see kv.h
+
+Page layout (1 KB):
+    header (16 bytes): erase_count, generation, ~generation, state, erase_count_check
+    records...       : key (16), len (16), value (len bytes, padded to even), crc16 (16)
+
+A record with len = 0 is a tombstone (key deleted).
+Records are programmed in address order (header, value, CRC), so a record torn by a
+power loss has a bad CRC (skipped) or a len of 0xFFFF (page treated as full).
+*/
+
+#include <stddef.h>
+#include "kv.h"
+#include "flash.h"
+#include "crc.h"
+
+#define PAGE_ADDR(i) (KV_BASE + (i) * FLASH_PAGE_SIZE)
+
+#define STATE_ERASED 0xFFFFU
+#define STATE_RECEIVING 0xEEEEU
+#define STATE_ACTIVE 0x0000U
+
+#define ERASED_WORD 0xFFFFFFFFUL
+
+struct kv_page_header {
+    uint32_t erase_count;
+    uint32_t generation; // bumped on every compaction, the highest valid one is the active page
+    uint32_t generation_check; // ~generation, catches headers damaged by an interrupted erase
+    uint16_t state;
+    uint16_t erase_count_check; // CRC16 of erase_count, catches a count torn by a power loss
+};
+
+struct kv_record {
+    uint16_t key;
+    uint16_t len;
+    uint8_t value[]; // padded to an even length, followed by the CRC16 of key, len and value
+};
+
+#define HEADER_SIZE ((uint32_t)sizeof(struct kv_page_header))
+#define RECORD_SIZE(len) (4U + (((len) + 1U) & ~1U) + 2U)
+
+static struct {
+    uint32_t active; // active page index
+    uint32_t write_offset; // first free byte in the active page
+    uint32_t generation;
+    uint32_t erase_counts[KV_NUM_PAGES];
+    uint32_t num_keys;
+    uint16_t keys[KV_INDEX_SIZE];
+    uint16_t offsets[KV_INDEX_SIZE]; // record offset in the active page
+} kv;
+
+static const struct kv_page_header *page_header(uint32_t page) {
+    return (const struct kv_page_header *)PAGE_ADDR(page);
+}
+
+static const struct kv_record *record_at(uint32_t offset) {
+    return (const struct kv_record *)(PAGE_ADDR(kv.active) + offset);
+}
+
+static uint16_t record_crc(const struct kv_record *r) {
+    return crc16_ccitt(CRC16_CCITT_INIT, r, 4U + r->len);
+}
+
+/* --- Hash index (open addressing, linear probing) --- */
+
+static uint32_t index_slot(uint16_t key) {
+    // Fibonacci hashing: multiply by 2^32 / golden ratio, keep the top bits
+    uint32_t slot = (uint32_t)(key * 2654435761UL) >> (32U - __builtin_ctz(KV_INDEX_SIZE));
+
+    while (kv.keys[slot] != key && kv.keys[slot] != KV_KEY_INVALID) {
+        slot = (slot + 1U) & (KV_INDEX_SIZE - 1U);
+    }
+    return slot;
+}
+
+static void index_clear(void) {
+    for (uint32_t i = 0; i < KV_INDEX_SIZE; i++) {
+        kv.keys[i] = KV_KEY_INVALID;
+    }
+    kv.num_keys = 0;
+}
+
+static int index_put(uint16_t key, uint32_t offset) {
+    uint32_t slot = index_slot(key);
+
+    if (kv.keys[slot] == KV_KEY_INVALID) {
+        if (kv.num_keys >= KV_MAX_KEYS) {
+            return -1;
+        }
+        kv.keys[slot] = key;
+        kv.num_keys++;
+    }
+    kv.offsets[slot] = (uint16_t)offset;
+    return 0;
+}
+
+/* Build the index from the active page, and find the end of the log */
+static void index_build(void) {
+    uint32_t offset = HEADER_SIZE;
+
+    index_clear();
+
+    while (offset + RECORD_SIZE(0) <= FLASH_PAGE_SIZE) {
+        const struct kv_record *r = record_at(offset);
+
+        if (r->key == KV_KEY_INVALID && r->len == 0xFFFFU) {
+            break; // end of the log
+        }
+        if (r->len > KV_MAX_VALUE || offset + RECORD_SIZE(r->len) > FLASH_PAGE_SIZE) {
+            offset = FLASH_PAGE_SIZE; // torn header: don't append after it, compact on the next write
+            break;
+        }
+
+        const uint16_t *crc = (const uint16_t *)((uintptr_t)r + RECORD_SIZE(r->len) - 2U);
+        if (*crc == record_crc(r)) {
+            index_put(r->key, offset);
+        }
+        offset += RECORD_SIZE(r->len);
+    }
+    kv.write_offset = offset;
+}
+
+/* --- Pages --- */
+
+static uint16_t erase_count_check(uint32_t count) {
+    return crc16_ccitt(CRC16_CCITT_INIT, &count, sizeof(count));
+}
+
+// Blank apart from a valid erase count: a page with a lost or torn one (never erased
+// by the store, or cut short) is erased again, so every active page has its count
+static int page_blank(uint32_t page) {
+    const struct kv_page_header *h = page_header(page);
+    const uint32_t *p = (const uint32_t *)PAGE_ADDR(page);
+
+    if (h->erase_count_check != erase_count_check(h->erase_count) || h->generation != ERASED_WORD ||
+        h->generation_check != ERASED_WORD || h->state != STATE_ERASED) {
+        return 0;
+    }
+    for (uint32_t i = HEADER_SIZE / 4U; i < FLASH_PAGE_SIZE / 4U; i++) {
+        if (p[i] != ERASED_WORD) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+static int page_erase(uint32_t page) {
+    uint32_t count = kv.erase_counts[page] + 1U;
+    uint16_t check = erase_count_check(count);
+
+    if (flash_erase_page(PAGE_ADDR(page)) != 0) {
+        return -1;
+    }
+    kv.erase_counts[page] = count;
+    // If power fails before both are written, the count falls back to the highest one seen (kv_init)
+    if (flash_program(PAGE_ADDR(page) + offsetof(struct kv_page_header, erase_count), &count, sizeof(count)) != 0) {
+        return -1;
+    }
+    return flash_program(PAGE_ADDR(page) + offsetof(struct kv_page_header, erase_count_check), &check, sizeof(check));
+}
+
+static int page_set_state(uint32_t page, uint16_t state) {
+    return flash_program(PAGE_ADDR(page) + offsetof(struct kv_page_header, state), &state, sizeof(state));
+}
+
+static int page_set_generation(uint32_t page, uint32_t generation) {
+    uint32_t words[2] = { generation, ~generation };
+
+    return flash_program(PAGE_ADDR(page) + offsetof(struct kv_page_header, generation), words, sizeof(words));
+}
+
+/*
+Copy the live records into the next page and make it the active one:
+    target: ERASED -> generation written -> RECEIVING -> records copied -> ACTIVE
+    old page: erased
+A power loss before ACTIVE leaves the old page active (kv_init erases the target),
+after it kv_init picks the higher generation.
+*/
+static int compact(void) {
+    uint32_t target = (kv.active + 1U) % KV_NUM_PAGES;
+    uint32_t generation = kv.generation + 1U;
+    uint32_t offset = HEADER_SIZE;
+
+    if (!page_blank(target) && page_erase(target) != 0) {
+        return -1;
+    }
+    if (page_set_generation(target, generation) != 0 || page_set_state(target, STATE_RECEIVING) != 0) {
+        return -1;
+    }
+
+    for (uint32_t slot = 0; slot < KV_INDEX_SIZE; slot++) {
+        if (kv.keys[slot] == KV_KEY_INVALID) {
+            continue;
+        }
+        const struct kv_record *r = record_at(kv.offsets[slot]);
+        if (r->len == 0) {
+            continue; // tombstone, dropped
+        }
+        // Copied as is: the CRC doesn't depend on the position
+        if (flash_program(PAGE_ADDR(target) + offset, r, RECORD_SIZE(r->len)) != 0) {
+            return -1;
+        }
+        offset += RECORD_SIZE(r->len);
+    }
+
+    if (page_set_state(target, STATE_ACTIVE) != 0) {
+        return -1;
+    }
+
+    uint32_t old = kv.active;
+    kv.active = target;
+    kv.generation = generation;
+    index_build();
+
+    return page_erase(old);
+}
+
+int kv_init(void) {
+    uint32_t max_count = 0;
+    int best = -1;
+
+    for (uint32_t page = 0; page < KV_NUM_PAGES; page++) {
+        const struct kv_page_header *h = page_header(page);
+
+        kv.erase_counts[page] = h->erase_count_check == erase_count_check(h->erase_count) ? h->erase_count : 0;
+        if (kv.erase_counts[page] > max_count) {
+            max_count = kv.erase_counts[page];
+        }
+        if (h->state == STATE_ACTIVE && h->generation_check == ~h->generation &&
+            (best < 0 || h->generation > page_header((uint32_t)best)->generation)) {
+            best = (int)page;
+        }
+    }
+
+    // Erase count lost or torn by a power failure: assume the highest valid one
+    for (uint32_t page = 0; page < KV_NUM_PAGES; page++) {
+        const struct kv_page_header *h = page_header(page);
+        if (h->erase_count_check != erase_count_check(h->erase_count)) {
+            kv.erase_counts[page] = max_count;
+        }
+    }
+
+    if (best < 0) {
+        // Nothing valid (first boot): format page 0
+        kv.active = 0;
+        kv.generation = 1;
+        if (!page_blank(0) && page_erase(0) != 0) {
+            return -1;
+        }
+        if (page_set_generation(0, kv.generation) != 0 || page_set_state(0, STATE_ACTIVE) != 0) {
+            return -1;
+        }
+    }
+    else {
+        kv.active = (uint32_t)best;
+        kv.generation = page_header(kv.active)->generation;
+    }
+
+    // Anything else is an interrupted compaction or an old page: erase it
+    for (uint32_t page = 0; page < KV_NUM_PAGES; page++) {
+        if (page != kv.active && !page_blank(page) && page_erase(page) != 0) {
+            return -1;
+        }
+    }
+
+    index_build();
+    return 0;
+}
+
+const void *kv_get_ptr(uint16_t key, uint32_t *len) {
+    uint32_t slot = index_slot(key);
+
+    if (kv.keys[slot] == KV_KEY_INVALID) {
+        return NULL;
+    }
+    const struct kv_record *r = record_at(kv.offsets[slot]);
+    if (r->len == 0) {
+        return NULL;
+    }
+    *len = r->len;
+    return r->value;
+}
+
+int kv_get(uint16_t key, void *buf, uint32_t size) {
+    uint32_t len;
+    const uint8_t *value = kv_get_ptr(key, &len);
+    uint8_t *dst = buf;
+
+    if (value == NULL) {
+        return -1;
+    }
+    for (uint32_t i = 0; i < len && i < size; i++) {
+        dst[i] = value[i];
+    }
+    return (int)len;
+}
+
+static int append(uint16_t key, const void *value, uint32_t len) {
+    uint8_t buf[RECORD_SIZE(KV_MAX_VALUE)];
+    struct kv_record *r = (struct kv_record *)buf;
+    const uint8_t *src = value;
+    uint32_t size = RECORD_SIZE(len);
+
+    r->key = key;
+    r->len = (uint16_t)len;
+    for (uint32_t i = 0; i < len; i++) {
+        r->value[i] = src[i];
+    }
+    r->value[len] = 0xFFU; // padding (if any) stays erased
+    uint16_t crc = record_crc(r);
+    buf[size - 2U] = (uint8_t)crc;
+    buf[size - 1U] = (uint8_t)(crc >> 8);
+
+    // Make room: compact once, if it's still full the live data doesn't fit
+    if (kv.write_offset + size > FLASH_PAGE_SIZE) {
+        if (compact() != 0 || kv.write_offset + size > FLASH_PAGE_SIZE) {
+            return -1;
+        }
+    }
+    // The index may be full even though there is room in flash
+    uint32_t slot = index_slot(key);
+    if (kv.keys[slot] == KV_KEY_INVALID && kv.num_keys >= KV_MAX_KEYS) {
+        return -1;
+    }
+
+    uint32_t offset = kv.write_offset;
+    kv.write_offset += size; // skip this space even if programming fails half way
+    if (flash_program(PAGE_ADDR(kv.active) + offset, buf, size) != 0) {
+        return -1;
+    }
+    return index_put(key, offset);
+}
+
+int kv_set(uint16_t key, const void *value, uint32_t len) {
+    if (key == KV_KEY_INVALID || len == 0 || len > KV_MAX_VALUE) {
+        return -1;
+    }
+
+    // Unchanged value: save the flash write
+    uint32_t old_len;
+    const uint8_t *old = kv_get_ptr(key, &old_len);
+    if (old != NULL && old_len == len) {
+        const uint8_t *src = value;
+        uint32_t i = 0;
+        while (i < len && old[i] == src[i]) {
+            i++;
+        }
+        if (i == len) {
+            return 0;
+        }
+    }
+
+    return append(key, value, len);
+}
+
+int kv_delete(uint16_t key) {
+    uint32_t len;
+
+    if (kv_get_ptr(key, &len) == NULL) {
+        return 0;
+    }
+    return append(key, NULL, 0);
+}
+
+uint32_t kv_erase_count(uint32_t page) {
+    return page < KV_NUM_PAGES ? kv.erase_counts[page] : 0;
+}
@@ -0,0 +1,56 @@
+/*
+Flash key-value store (EEPROM emulation)
+
+Persistent settings (blink rate preset, calibration, boot counters) without an
+external EEPROM, in the last KV_NUM_PAGES pages of flash.
+
+- Log structured: kv_set() appends a record to the active page, the newest record
+  for a key wins. Deleting appends a tombstone.
+- When the active page is full, the live records are copied to the next page
+  (page swap compaction) and the old page is erased. Pages are used in turn,
+  which spreads the erases (wear leveling). Each page header keeps its erase count.
+- An in-RAM hash index maps each key to its newest record: reads are one hash
+  lookup plus a read of the memory mapped flash, they never scan flash.
+  The only scan is in kv_init() (one page) and after a compaction.
+- Power-fail safe: page headers go ERASED -> RECEIVING -> ACTIVE (each step only
+  clears bits), records carry a CRC16, and kv_init() finishes or rolls back an
+  interrupted compaction.
+
+A write costs a few hundred microseconds (half-word programming), a compaction two
+page erases (~40 ms) during which the CPU stalls on any flash access.
+*/
+#ifndef KV_H
+#define KV_H
+
+#include <stdint.h>
+
+#define KV_BASE 0x0801F800UL // last 2 KB of flash, excluded from the app in main_memory.ld
+#define KV_NUM_PAGES 2U
+
+#define KV_MAX_VALUE 64U // bytes per value
+#define KV_INDEX_SIZE 64U // hash index slots (power of two)
+#define KV_MAX_KEYS 48U // keep the index at most 3/4 full
+
+// Keys 0x0000 - 0xFFFE (0xFFFF is erased flash)
+#define KV_KEY_INVALID 0xFFFFU
+
+// Find the active page and build the index. Formats the area if there is no valid data.
+// Returns 0, or -1 if flash can't be written.
+int kv_init(void);
+
+// Copy the value of key into buf (at most size bytes). Returns the value length, or -1 if not found.
+int kv_get(uint16_t key, void *buf, uint32_t size);
+
+// Pointer to the value in flash (valid until the next kv_set / kv_delete), NULL if not found
+const void *kv_get_ptr(uint16_t key, uint32_t *len);
+
+// Store 1..KV_MAX_VALUE bytes for key (no flash write if the value is unchanged). Returns 0 or -1.
+int kv_set(uint16_t key, const void *value, uint32_t len);
+
+// Remove key. Returns 0 or -1.
+int kv_delete(uint16_t key);
+
+// Number of times page (0 .. KV_NUM_PAGES - 1) has been erased
+uint32_t kv_erase_count(uint32_t page);
+
+#endif
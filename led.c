@@ -0,0 +1,166 @@
+/*
+Status LED patterns, see led.h
+*/
+
+#include "led.h"
+
+// RCC at 0x4002_1000, GPIOA at 0x4001_0800 (ports 0x400 apart), TIM1 at 0x4001_2C00
+// (Table 3 (Register boundary addresses))
+#define RCC_BASE 0x40021000UL
+#define GPIO_BASE(port) (0x40010800UL + (port) * 0x400UL)
+#define TIM1_BASE 0x40012C00UL
+
+// volatile prevents compiler from optimizing (important for hardware access)
+#define REG32(addr) (*(volatile uint32_t *)(addr))
+
+#define RCC_APB2ENR REG32(RCC_BASE + 0x18UL) // APB2 peripheral clock enable register
+
+// (GPIO register map, RM0008 Table 59)
+#define GPIO_CRL(port) REG32(GPIO_BASE(port) + 0x00UL) // Configuration register low (pins 0..7)
+#define GPIO_CRH(port) REG32(GPIO_BASE(port) + 0x04UL) // Configuration register high (pins 8..15)
+#define GPIO_BSRR(port) REG32(GPIO_BASE(port) + 0x10UL) // Bit set/reset register
+
+// (14.4.21 TIM1&TIM8 register map)
+#define TIM1_CR1 REG32(TIM1_BASE + 0x00UL) // Control register 1
+#define TIM1_DIER REG32(TIM1_BASE + 0x0CUL) // DMA/interrupt enable register
+#define TIM1_SR REG32(TIM1_BASE + 0x10UL) // Status register
+#define TIM1_EGR REG32(TIM1_BASE + 0x14UL) // Event generation register
+#define TIM1_CCMR1 REG32(TIM1_BASE + 0x18UL) // Capture/compare mode register 1
+#define TIM1_PSC REG32(TIM1_BASE + 0x28UL) // Prescaler
+#define TIM1_ARR REG32(TIM1_BASE + 0x2CUL) // Auto-reload register
+#define TIM1_CCR1 REG32(TIM1_BASE + 0x34UL) // Capture/compare register 1
+
+// (PM0056 Table 44 (NVIC register summary)), TIM1 update is IRQ 25, TIM1 capture compare
+// IRQ 27 (RM0008 Table 63 (Vector table))
+#define NVIC_ISER0 REG32(0xE000E100UL) // Interrupt set-enable register for IRQ 0..31
+#define NVIC_IPR(irq) (*(volatile uint8_t *)(0xE000E400UL + (irq))) // Interrupt priority, a byte per IRQ (4.3.7, top 4 bits)
+#define TIM1_UP_IRQ 25U
+#define TIM1_CC_IRQ 27U
+
+// 7.3.7 APB2 peripheral clock enable register
+#define RCC_APB2ENR_IOPAEN_BIT 2U // ports A..E: bits 2..6
+#define RCC_APB2ENR_TIM1EN (1U << 11)
+
+// 9.2.1 / 9.2.2 port configuration: 4 bits per pin, output push-pull 2 MHz: CNF = 00, MODE = 10
+#define GPIO_CR_PIN_MASK 0xFU
+#define GPIO_CR_OUTPUT_2MHZ_PP 0b0010
+
+// 14.4.1 / 14.4.4 / 14.4.5 / 14.4.6 TIM1 control, interrupt enable, status, event generation
+#define TIM_CR1_CEN (1U << 0)
+#define TIM_CR1_ARPE (1U << 7)
+#define TIM_DIER_UIE (1U << 0) // Update interrupt
+#define TIM_DIER_CC1IE (1U << 1) // Compare 1 interrupt
+#define TIM_SR_UIF (1U << 0)
+#define TIM_SR_CC1IF (1U << 1)
+#define TIM_EGR_UG (1U << 0)
+
+// 14.4.7 capture/compare mode register 1: channel 1 output compare (frozen, no pin), CCR1 preloaded
+#define TIM_CCMR1_OC1PE (1U << 3) // the new duty cycle starts with the next period
+
+// 8 MHz / 32 / 250: 1 kHz, 250 levels
+#define PWM_PRESCALER 32U
+#define PWM_LEVELS 250U
+#define PERIODS_PER_UNIT LED_UNIT_MS // 1 ms each
+
+#define STEP_LEVEL(s) ((s) & 0xFFU)
+#define STEP_UNITS(s) (((s) >> 8) & 0x7FU)
+#define STEP_FADE(s) ((s) & 0x8000U)
+
+static uint32_t bsrr_on;
+static uint32_t bsrr_off;
+static volatile uint32_t *bsrr;
+
+/* Shared with the interrupts, written by led_play() with them off */
+static volatile struct {
+    const uint16_t *steps;
+    uint32_t len;
+    uint32_t step;
+    uint32_t elapsed; // periods into the step
+    uint32_t from; // level at the start of the step
+    uint32_t level; // now
+    uint32_t on; // its duty cycle isn't 0
+} pat;
+
+/* Perceived brightness goes roughly with the square root of the duty cycle: duty = level^2 */
+static uint32_t duty(uint32_t level) {
+    return level >= 255U ? PWM_LEVELS + 1U : (level * level) / 261U; // past the end: never off
+}
+
+int led_init(uint32_t port, uint32_t pin) {
+    if (port > LED_PORT_E || pin > 15U) {
+        return -1;
+    }
+    RCC_APB2ENR |= (1U << (RCC_APB2ENR_IOPAEN_BIT + port)) | RCC_APB2ENR_TIM1EN;
+    bsrr = &GPIO_BSRR(port);
+    bsrr_on = 1U << pin;
+    bsrr_off = 1U << (pin + 16U);
+    *bsrr = bsrr_off;
+    uint32_t shift = (pin & 7U) * 4U;
+    if (pin < 8U) {
+        GPIO_CRL(port) = (GPIO_CRL(port) & ~(GPIO_CR_PIN_MASK << shift)) | (GPIO_CR_OUTPUT_2MHZ_PP << shift);
+    }
+    else {
+        GPIO_CRH(port) = (GPIO_CRH(port) & ~(GPIO_CR_PIN_MASK << shift)) | (GPIO_CR_OUTPUT_2MHZ_PP << shift);
+    }
+
+    pat.len = 0; // dark until led_play()
+    pat.level = 0;
+    pat.on = 0;
+    TIM1_CR1 = 0;
+    TIM1_PSC = PWM_PRESCALER - 1U;
+    TIM1_ARR = PWM_LEVELS - 1U;
+    TIM1_CCMR1 = TIM_CCMR1_OC1PE;
+    TIM1_CCR1 = 0;
+    TIM1_EGR = TIM_EGR_UG;
+    TIM1_SR = 0;
+    TIM1_DIER = TIM_DIER_UIE | TIM_DIER_CC1IE;
+    NVIC_IPR(TIM1_UP_IRQ) = LED_IRQ_PRIORITY;
+    NVIC_IPR(TIM1_CC_IRQ) = LED_IRQ_PRIORITY;
+    NVIC_ISER0 = (1U << TIM1_UP_IRQ) | (1U << TIM1_CC_IRQ);
+    TIM1_CR1 = TIM_CR1_ARPE | TIM_CR1_CEN;
+    return 0;
+}
+
+void led_play(const struct led_pattern *p) {
+    TIM1_DIER = TIM_DIER_CC1IE; // the update interrupt reads pat
+    pat.steps = p->steps;
+    pat.len = p->len;
+    pat.step = 0;
+    pat.elapsed = 0;
+    pat.from = pat.level;
+    TIM1_DIER = TIM_DIER_UIE | TIM_DIER_CC1IE;
+}
+
+/* Start of a period: on (off when dark, fully on never reaches the compare), then the level for the next period */
+void TIM1_UP_IRQHandler(void) {
+    TIM1_SR = ~TIM_SR_UIF; // rc_w0: writing 1 leaves the other flags alone
+    *bsrr = pat.on ? bsrr_on : bsrr_off;
+    if (!pat.len) {
+        return;
+    }
+    uint32_t s = pat.steps[pat.step];
+    uint32_t periods = STEP_UNITS(s) * PERIODS_PER_UNIT;
+    uint32_t to = STEP_LEVEL(s);
+
+    if (STEP_FADE(s) && pat.elapsed < periods) {
+        pat.level = to >= pat.from ? pat.from + (to - pat.from) * pat.elapsed / periods :
+            pat.from - (pat.from - to) * pat.elapsed / periods;
+    }
+    else {
+        pat.level = to;
+    }
+    if (++pat.elapsed >= periods) {
+        pat.step = pat.step + 1U < pat.len ? pat.step + 1U : 0U;
+        pat.elapsed = 0;
+        pat.from = to;
+    }
+    uint32_t d = duty(pat.level);
+    TIM1_CCR1 = d; // preloaded: from the next update on
+    pat.on = d != 0;
+}
+
+/* End of the duty cycle: off */
+void TIM1_CC_IRQHandler(void) {
+    TIM1_SR = ~TIM_SR_CC1IF;
+    *bsrr = bsrr_off;
+}
@@ -0,0 +1,54 @@
+/*
+Status LED patterns, played by timer interrupts
+
+A pattern is a short list of steps, each a brightness held or faded to over a time,
+played over and over: blinks, blink codes, breathing. The caller maps its status
+codes to patterns and calls led_play() when the status changes; nothing else runs
+in the main loop.
+
+The LED's brightness is software PWM at 1 kHz with 250 levels on any GPIO pin (the
+Nucleo's PA5 has no timer channel): the TIM1 update interrupt turns the pin on and
+advances the pattern, the compare 1 interrupt turns it off after the duty cycle.
+Levels go through a square law (perceived brightness), so a linear fade looks linear.
+Two short interrupts per millisecond, ~1% of the CPU. Flash erases delay them (a
+brighter or dimmer flicker), the pattern's timing catches up afterwards.
+*/
+#ifndef LED_H
+#define LED_H
+
+#include <stdint.h>
+
+// Ports (GPIOA .. GPIOE)
+#define LED_PORT_A 0U
+#define LED_PORT_B 1U
+#define LED_PORT_C 2U
+#define LED_PORT_D 3U
+#define LED_PORT_E 4U
+
+#define LED_IRQ_PRIORITY 0x40U // NVIC priority of both interrupts (order: ws2812.h)
+
+#define LED_UNIT_MS 10U // step time resolution, at most 127 units (1270 ms) per step
+
+// Steps: level 0 (off) .. 255 (fully on), over ms
+#define LED_SET(level, ms) ((uint16_t)(((level) & 0xFFU) | ((((ms) / LED_UNIT_MS) & 0x7FU) << 8))) // jump to level, hold
+#define LED_FADE(level, ms) ((uint16_t)(LED_SET(level, ms) | 0x8000U)) // from the previous level to level
+
+struct led_pattern {
+    const uint16_t *steps;
+    uint16_t len;
+};
+
+// Initializer for a pattern of an array of steps
+#define LED_PATTERN(steps) { (steps), sizeof(steps) / sizeof((steps)[0]) }
+
+// Make pin of port a push-pull output (off), start the PWM timer. Returns 0, or -1.
+int led_init(uint32_t port, uint32_t pin);
+
+// Play p over and over from its first step (from the current level for a fade)
+void led_play(const struct led_pattern *p);
+
+// Vector table entries (main_memory.ld)
+void TIM1_UP_IRQHandler(void);
+void TIM1_CC_IRQHandler(void);
+
+#endif
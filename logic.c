@@ -0,0 +1,335 @@
+/*
+Logic analyzer, see logic.h
+*/
+
+#include "logic.h"
+#include "cobs.h"
+#include "crc.h"
+#include "uart.h"
+
+// RCC at 0x4002_1000, GPIOA at 0x4001_0800 (ports 0x400 apart), DMA1 at 0x4002_0000,
+// TIM4 at 0x4000_0800 (Table 3 (Register boundary addresses))
+#define RCC_BASE 0x40021000UL
+#define GPIO_BASE(port) (0x40010800UL + (port) * 0x400UL)
+#define DMA1_BASE 0x40020000UL
+#define TIM4_BASE 0x40000800UL
+
+// volatile prevents compiler from optimizing (important for hardware access)
+#define REG32(addr) (*(volatile uint32_t *)(addr))
+
+#define RCC_AHBENR REG32(RCC_BASE + 0x14UL) // AHB peripheral clock enable register
+#define RCC_APB2ENR REG32(RCC_BASE + 0x18UL) // APB2 peripheral clock enable register
+#define RCC_APB1ENR REG32(RCC_BASE + 0x1CUL) // APB1 peripheral clock enable register
+
+// (GPIO register map, RM0008 Table 59)
+#define GPIO_IDR_ADDR(port) (GPIO_BASE(port) + 0x08UL) // Input data register
+
+// (13.4.7 DMA register map), channel x registers at 0x08 + 20 * (x - 1) ...
+#define DMA1_ISR REG32(DMA1_BASE + 0x00UL) // Interrupt status register
+#define DMA1_IFCR REG32(DMA1_BASE + 0x04UL) // Interrupt flag clear register
+#define DMA1_CCR7 REG32(DMA1_BASE + 0x80UL) // Channel 7 configuration register
+#define DMA1_CNDTR7 REG32(DMA1_BASE + 0x84UL) // Channel 7 number of data register
+#define DMA1_CPAR7 REG32(DMA1_BASE + 0x88UL) // Channel 7 peripheral address register
+#define DMA1_CMAR7 REG32(DMA1_BASE + 0x8CUL) // Channel 7 memory address register
+
+// (15.4.19 TIMx register map)
+#define TIM4_CR1 REG32(TIM4_BASE + 0x00UL) // Control register 1
+#define TIM4_DIER REG32(TIM4_BASE + 0x0CUL) // DMA/interrupt enable register
+#define TIM4_EGR REG32(TIM4_BASE + 0x14UL) // Event generation register
+#define TIM4_PSC REG32(TIM4_BASE + 0x28UL) // Prescaler
+#define TIM4_ARR REG32(TIM4_BASE + 0x2CUL) // Auto-reload register
+
+// (PM0056 Table 44 (NVIC register summary)), DMA1 channel 7 is IRQ 17 (RM0008 Table 63 (Vector table))
+#define NVIC_ISER0 REG32(0xE000E100UL) // Interrupt set-enable register for IRQ 0..31
+#define NVIC_IPR(irq) (*(volatile uint8_t *)(0xE000E400UL + (irq))) // Interrupt priority, a byte per IRQ (4.3.7, top 4 bits)
+#define DMA1_CHANNEL7_IRQ 17U
+
+// 7.3.6 - 7.3.8 peripheral clock enable registers
+#define RCC_AHBENR_DMA1EN (1U << 0)
+#define RCC_APB2ENR_IOPAEN_BIT 2U // ports A..E: bits 2..6
+#define RCC_APB1ENR_TIM4EN (1U << 2)
+
+// 13.4.1 / 13.4.2 DMA interrupt status / flag clear register, channel 7
+#define DMA_ISR_TCIF7 (1U << 25) // Transfer complete: second half full
+#define DMA_ISR_HTIF7 (1U << 26) // Half transfer: first half full
+#define DMA_ISR_CH7 (0xFU << 24)
+
+// 13.4.3 DMA channel x configuration register
+#define DMA_CCR_EN (1U << 0)
+#define DMA_CCR_TCIE (1U << 1)
+#define DMA_CCR_HTIE (1U << 2)
+#define DMA_CCR_CIRC (1U << 5)
+#define DMA_CCR_MINC (1U << 7)
+#define DMA_CCR_PSIZE_16 (1U << 8)
+#define DMA_CCR_MSIZE_16 (1U << 10)
+#define DMA_CCR_PL_HIGH (2U << 12) // below the waveform engine's channel (wave.h)
+
+// 15.4.1 / 15.4.4 / 15.4.6 TIMx control, DMA/interrupt enable, event generation
+#define TIM_CR1_CEN (1U << 0)
+#define TIM_CR1_URS (1U << 2) // Only overflows request the DMA (not setting UG)
+#define TIM_DIER_UDE (1U << 8) // Update DMA request
+#define TIM_EGR_UG (1U << 0)
+
+#define NO_TRIGGER 0xFFFFU
+
+static uint16_t *buf;
+static uint32_t len;
+static struct logic_config cfg;
+
+/* Shared with the interrupt. Sample numbers count from the start of the capture. */
+static volatile struct {
+    uint32_t state;
+    uint32_t halves; // halves of the buffer filled
+    uint32_t matched; // the last sample scanned matched the trigger pattern
+    uint32_t trigger; // sample number of the trigger
+    uint32_t stop; // stop at the first half boundary from this sample number on
+    uint32_t end; // samples taken
+} cap;
+
+/* Export (main loop) */
+static struct {
+    uint32_t ready; // samples in order at the start of buf
+    uint32_t count; // samples in the capture
+    uint32_t trigger; // index in them
+    uint32_t words; // to send
+    uint32_t run_bit; // 0: not compressed
+    uint32_t sent; // words sent, header first
+    uint32_t header;
+} out;
+
+static void halt(void) {
+    TIM4_CR1 = 0;
+    TIM4_DIER = 0;
+    DMA1_CCR7 = 0;
+    DMA1_IFCR = DMA_ISR_CH7;
+}
+
+int logic_start(uint16_t *samples, uint16_t n, const struct logic_config *c) {
+    uint32_t min = c->mask ? LOGIC_MIN_ARMED_PERIOD : LOGIC_MIN_PERIOD;
+
+    if (!samples || n < 4U || (n & 1U) || c->port > 4U || c->period < min || c->post > n / 4U) {
+        return -1;
+    }
+    RCC_AHBENR |= RCC_AHBENR_DMA1EN;
+    RCC_APB1ENR |= RCC_APB1ENR_TIM4EN;
+    RCC_APB2ENR |= 1U << (RCC_APB2ENR_IOPAEN_BIT + c->port);
+    halt();
+
+    buf = samples;
+    len = n;
+    cfg = *c;
+    out.ready = 0;
+    out.header = 0;
+    out.sent = 0;
+    cap.halves = 0;
+    cap.matched = 1; // a pattern that holds from the start isn't a trigger
+    cap.trigger = 0;
+    cap.stop = 1U + c->post;
+    cap.end = 0;
+    cap.state = c->mask ? LOGIC_ARMED : LOGIC_TRIGGERED;
+
+    DMA1_CPAR7 = GPIO_IDR_ADDR(c->port);
+    DMA1_CMAR7 = (uint32_t)(uintptr_t)samples;
+    DMA1_CNDTR7 = n;
+    DMA1_CCR7 = DMA_CCR_MINC | DMA_CCR_CIRC | DMA_CCR_PSIZE_16 | DMA_CCR_MSIZE_16 | DMA_CCR_PL_HIGH |
+        DMA_CCR_HTIE | DMA_CCR_TCIE;
+    DMA1_CCR7 |= DMA_CCR_EN;
+    NVIC_IPR(DMA1_CHANNEL7_IRQ) = LOGIC_IRQ_PRIORITY;
+    NVIC_ISER0 = 1U << DMA1_CHANNEL7_IRQ;
+
+    TIM4_PSC = 0;
+    TIM4_ARR = c->period - 1U;
+    TIM4_CR1 = TIM_CR1_URS;
+    TIM4_EGR = TIM_EGR_UG;
+    TIM4_DIER = TIM_DIER_UDE;
+    TIM4_CR1 |= TIM_CR1_CEN;
+    return 0;
+}
+
+enum logic_state logic_state(void) {
+    return (enum logic_state)cap.state;
+}
+
+void logic_stop(void) {
+    halt();
+    cap.state = LOGIC_IDLE;
+}
+
+/* A half of the buffer is full: look for the trigger in it, stop once the post-trigger samples are in */
+void DMA1_Channel7_IRQHandler(void) {
+    uint32_t isr = DMA1_ISR;
+    uint32_t half = len / 2U;
+
+    DMA1_IFCR = DMA_ISR_CH7;
+    if (cap.state != LOGIC_ARMED && cap.state != LOGIC_TRIGGERED) {
+        return;
+    }
+    // The DMA must still be in the other half, or this half has been written over already
+    uint32_t second = (isr & DMA_ISR_TCIF7) != 0;
+    uint32_t pos = len - DMA1_CNDTR7;
+    if ((isr & DMA_ISR_HTIF7) && second) {
+        second = 2U; // both: a whole half went by
+    }
+    if (second == 2U || (second == 1U && pos >= half) || (second == 0U && pos < half)) {
+        halt();
+        cap.state = LOGIC_OVERRUN;
+        return;
+    }
+
+    const uint16_t *s = &buf[second ? half : 0U];
+    uint32_t first = cap.halves * half; // sample number of s[0]
+    cap.halves++;
+    if (cap.state == LOGIC_ARMED) {
+        uint32_t mask = cfg.mask;
+        uint32_t value = cfg.value;
+        uint32_t matched = cap.matched;
+        for (uint32_t i = 0; i < half; i++) {
+            uint32_t m = (s[i] & mask) == value;
+            if (m && !matched) {
+                cap.trigger = first + i;
+                cap.stop = first + i + 1U + cfg.post;
+                cap.state = LOGIC_TRIGGERED;
+                break;
+            }
+            matched = m;
+        }
+        cap.matched = matched;
+    }
+    if (cap.state == LOGIC_TRIGGERED && cap.halves * half >= cap.stop) {
+        TIM4_CR1 = 0; // no more requests
+        pos = len - DMA1_CNDTR7;
+        halt();
+        cap.end = cap.halves * half + pos % half; // and the few samples taken since the boundary
+        cap.state = LOGIC_DONE;
+    }
+}
+
+/* Reverse buf[a .. b - 1] */
+static void reverse(uint32_t a, uint32_t b) {
+    while (a + 1U < b) {
+        uint16_t t = buf[a];
+        buf[a++] = buf[--b];
+        buf[b] = t;
+    }
+}
+
+/* The last len samples, oldest first, at the start of the buffer (rotated in place) */
+static void order(void) {
+    uint32_t end = cap.end;
+
+    if (out.ready) {
+        return;
+    }
+    out.count = end < len ? end : len;
+    uint32_t oldest = end < len ? 0U : end % len;
+    reverse(0, oldest);
+    reverse(oldest, len);
+    reverse(0, len);
+    uint32_t first = end - out.count; // sample number of buf[0]
+    out.trigger = cap.trigger >= first ? cap.trigger - first : NO_TRIGGER;
+    out.words = out.count;
+    out.run_bit = 0;
+    out.ready = 1;
+}
+
+int logic_compress(void) {
+    uint32_t channels = cfg.channels;
+    uint32_t run_bit = 0x8000U;
+
+    if (cap.state != LOGIC_DONE) {
+        return -1;
+    }
+    order();
+    if (out.run_bit) {
+        return (int)out.words;
+    }
+    while (run_bit && (channels & run_bit)) {
+        run_bit >>= 1;
+    }
+    if (!run_bit) {
+        return -1;
+    }
+    // Never longer than the input: a run of 2 or more is 2 words, so writing stays behind reading
+    uint32_t w = 0;
+    for (uint32_t i = 0; i < out.count;) {
+        uint16_t v = (uint16_t)(buf[i] & channels);
+        uint32_t run = 1;
+        while (i + run < out.count && (buf[i + run] & channels) == v && run < 0xFFFFU) {
+            run++;
+        }
+        if (run > 1U) {
+            buf[w++] = (uint16_t)(v | run_bit);
+            buf[w++] = (uint16_t)run;
+        }
+        else {
+            buf[w++] = v;
+        }
+        i += run;
+    }
+    out.words = w;
+    out.run_bit = run_bit;
+    return (int)w;
+}
+
+static void put16(uint8_t *p, uint32_t v) {
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+}
+
+/* type, fields, crc16 big endian (updater.h), COBS encoded with the 0 delimiter */
+static void send_frame(uint8_t *f, uint32_t n) {
+    uint8_t enc[COBS_MAX(3U + 2U * LOGIC_FRAME_WORDS + 2U) + 1U];
+    uint16_t crc = crc16_ccitt(CRC16_CCITT_INIT, f, n);
+
+    f[n++] = (uint8_t)(crc >> 8);
+    f[n++] = (uint8_t)crc;
+    uint32_t m = cobs_encode(enc, f, n);
+    enc[m++] = 0;
+    uart_write(enc, m);
+}
+
+int logic_export_poll(void) {
+    uint8_t f[3U + 2U * LOGIC_FRAME_WORDS + 2U];
+    uint32_t state = cap.state;
+
+    if (state != LOGIC_DONE && state != LOGIC_OVERRUN) {
+        return 0;
+    }
+    if (!out.header) {
+        if (state == LOGIC_DONE && !out.ready) {
+            logic_compress(); // or sent as it is, when every pin is a channel
+            order();
+        }
+        uint32_t ok = state == LOGIC_DONE;
+        f[0] = 'H';
+        f[1] = (uint8_t)cfg.port;
+        put16(&f[2], cfg.period);
+        put16(&f[4], cfg.channels);
+        put16(&f[6], ok ? out.count : 0U);
+        put16(&f[8], ok ? out.trigger : NO_TRIGGER);
+        put16(&f[10], ok ? out.run_bit : 0U);
+        put16(&f[12], ok ? out.words : 0U);
+        send_frame(f, 14U);
+        out.header = 1;
+        out.sent = 0;
+        if (!ok) {
+            cap.state = LOGIC_IDLE; // nothing more to send
+            return 0;
+        }
+        return 1;
+    }
+    uint32_t n = out.words - out.sent;
+    n = n < LOGIC_FRAME_WORDS ? n : LOGIC_FRAME_WORDS;
+    f[0] = 'S';
+    put16(&f[1], out.sent);
+    for (uint32_t i = 0; i < n; i++) {
+        put16(&f[3U + 2U * i], buf[out.sent + i]);
+    }
+    send_frame(f, 3U + 2U * n);
+    out.sent += n;
+    if (out.sent < out.words) {
+        return 1;
+    }
+    cap.state = LOGIC_IDLE; // all sent
+    return 0;
+}
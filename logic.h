@@ -0,0 +1,91 @@
+/*
+Logic analyzer: a GPIO port's input register sampled into RAM by DMA
+
+TIM4 update events request DMA1 channel 7 (RM0008 Table 78), which copies the port's
+IDR (all 16 pins in one half-word) into a circular buffer: one sample every period
+timer cycles, none of them by the CPU.
+
+- Trigger: the capture triggers on the first sample where the pins of mask become
+  value (they didn't match in the sample before), or right away with mask 0. The
+  DMA half-transfer and transfer-complete interrupts scan each half of the buffer
+  once it's full (~8 cycles per sample), so an armed capture keeps up down to
+  LOGIC_MIN_ARMED_PERIOD. On average that is 8 / period of the CPU while it waits,
+  but it comes in one piece per half: ~2 ms of interrupt for 2048 samples, every
+  half buffer's time (4 ms at 500 kHz). The interrupt has the lowest priority
+  (LOGIC_IRQ_PRIORITY, order in ws2812.h), so the others preempt the scan: USART2
+  still takes every byte (one every 87 us) and the strip's refills stay on time,
+  only the main loop waits. After the trigger, sampling goes on for at least post
+  more samples and stops at the next half of the buffer: the buffer holds the last
+  n samples, the trigger among them.
+- logic_compress() run-length encodes a finished capture in place: a run of the same
+  value (on the channels' pins) is one value word with LOGIC_RUN set in a bit that
+  isn't a channel, followed by its length. Slow or idle signals shrink to a few
+  words, and the export only sends those. So at most 15 of the 16 pins can be
+  channels for a compressed capture: with all 16 it is sent as it is, every sample.
+- logic_export_poll() sends the capture over USART2 as frames like the updater's
+  (COBS, crc16 big endian, updater.h), one frame per call so the main loop keeps
+  going (~6 ms each at 115200 baud):
+      'H' port(1) period(2) channels(2) samples(2) trigger(2) run_bit(2) words(2)
+      'S' offset(2) words(LOGIC_FRAME_WORDS at most)
+  Values little endian, offset and words in half-words, trigger is the sample index
+  (0xFFFF: none), run_bit 0: not compressed. tools/logic_vcd.c arms a capture
+  (the 'L' frame of updater.h) and writes what comes back as a VCD file.
+
+Sampling at 8 MHz / period: 1 MHz at LOGIC_MIN_PERIOD with the 8 MHz clock. Flash
+erases stall the CPU but not the DMA (the buffer is in RAM); the scan then falls
+behind and the capture stops with LOGIC_OVERRUN.
+*/
+#ifndef LOGIC_H
+#define LOGIC_H
+
+#include <stdint.h>
+
+// Ports (GPIOA .. GPIOE)
+#define LOGIC_PORT_A 0U
+#define LOGIC_PORT_B 1U
+#define LOGIC_PORT_C 2U
+#define LOGIC_PORT_D 3U
+#define LOGIC_PORT_E 4U
+
+#define LOGIC_MIN_PERIOD 8U // timer cycles per sample: 1 MHz
+#define LOGIC_MIN_ARMED_PERIOD 16U // scanning for the trigger keeps up: 500 kHz
+#define LOGIC_FRAME_WORDS 32U
+#define LOGIC_IRQ_PRIORITY 0xC0U // NVIC priority, below the others (order: ws2812.h)
+
+enum logic_state {
+    LOGIC_IDLE,
+    LOGIC_ARMED, // waiting for the trigger
+    LOGIC_TRIGGERED, // sampling the post-trigger samples
+    LOGIC_DONE, // buffer holds the capture
+    LOGIC_OVERRUN, // the scan fell behind (period too short, or interrupts blocked): stopped
+};
+
+struct logic_config {
+    uint32_t port;
+    uint16_t channels; // pins of interest (exported, compared when compressing)
+    uint16_t mask; // trigger pins, 0: trigger at once
+    uint16_t value; // trigger when (IDR & mask) becomes value
+    uint16_t period; // timer cycles per sample
+    uint16_t post; // samples after the trigger (at most n / 4, so the trigger stays in the buffer)
+};
+
+// Start sampling into buf (n samples, even) for c. Returns 0, or -1.
+int logic_start(uint16_t *buf, uint16_t n, const struct logic_config *c);
+
+enum logic_state logic_state(void);
+
+// Stop sampling (capture lost)
+void logic_stop(void);
+
+// Once LOGIC_DONE: put the samples in order at the start of the buffer, run-length encode
+// them. Returns the words used, or -1 (not done, or every pin is a channel: no run bit).
+int logic_compress(void);
+
+// Send the next frame of a done capture (compressed first when it can be), or a header with no
+// samples for an overrun. Returns 1 while there is more, 0 when all sent (then LOGIC_IDLE).
+int logic_export_poll(void);
+
+// Vector table entry (main_memory.ld)
+void DMA1_Channel7_IRQHandler(void);
+
+#endif
@@ -0,0 +1,143 @@
+/*
+Compile-time generated math tables and interpolating lookups, see lut.h
+*/
+
+#include "lut.h"
+#include "intmath.h"
+
+/* --- Tables --- */
+
+// sin(i * pi / 512), Q15
+#define SIN_ENTRY(i) (int16_t)(LUT_SIN((i) * (LUT_PI / 2.0 / 256.0)) * 32767.0 + 0.5),
+
+const int16_t lut_sin_table[LUT_SIN_QUARTER + 1] = {
+    LUT_R256(SIN_ENTRY, 0)
+    SIN_ENTRY(256)
+};
+
+// 2^(i / 256) for i = 0..256, Q16 (65536 .. 131072)
+#define EXP2_ENTRY(i) (uint32_t)(LUT_EXP((i) * (LUT_LN2 / 256.0)) * 65536.0 + 0.5),
+
+static const uint32_t exp2_table[257] = {
+    LUT_R256(EXP2_ENTRY, 0)
+    EXP2_ENTRY(256)
+};
+
+// log2(1 + i / 256) for i = 0..256, Q16 (0 .. 65536)
+#define LOG2_ENTRY(i) (uint32_t)(LUT_LN1P((i) / 256.0) / LUT_LN2 * 65536.0 + 0.5),
+
+static const uint32_t log2_table[257] = {
+    LUT_R256(LOG2_ENTRY, 0)
+    LOG2_ENTRY(256)
+};
+
+/*
+65535 * (i / 255)^2.2, computed as x^2 * e^(0.2 ln x) so the exponent stays in [-1.2, 0].
+ln(i / 255) = p ln2 + ln(i / 2^p) - ln(255), with p = floor(log2(i)) so that i / 2^p is in [1, 2).
+Each power of two range gets its own entry macro so p is a plain number and not a
+chain of comparisons inside every entry.
+*/
+#define LN255 5.54126354515842994
+
+#define GAMMA_ENTRY(i, p) (uint16_t)(((i) / 255.0) * ((i) / 255.0) * \
+    LUT_EXP(0.2 * ((p) * LUT_LN2 + LUT_LN1P((i) / (double)(1U << (p)) - 1.0) - LN255)) * 65535.0 + 0.5),
+#define GAMMA_P0(i) GAMMA_ENTRY(i, 0)
+#define GAMMA_P1(i) GAMMA_ENTRY(i, 1)
+#define GAMMA_P2(i) GAMMA_ENTRY(i, 2)
+#define GAMMA_P3(i) GAMMA_ENTRY(i, 3)
+#define GAMMA_P4(i) GAMMA_ENTRY(i, 4)
+#define GAMMA_P5(i) GAMMA_ENTRY(i, 5)
+#define GAMMA_P6(i) GAMMA_ENTRY(i, 6)
+#define GAMMA_P7(i) GAMMA_ENTRY(i, 7)
+
+static const uint16_t gamma_table[256] = {
+    0,
+    LUT_R1(GAMMA_P0, 1)
+    LUT_R2(GAMMA_P1, 2)
+    LUT_R4(GAMMA_P2, 4)
+    LUT_R8(GAMMA_P3, 8)
+    LUT_R16(GAMMA_P4, 16)
+    LUT_R32(GAMMA_P5, 32)
+    LUT_R64(GAMMA_P6, 64)
+    LUT_R128(GAMMA_P7, 128)
+};
+
+/* --- Lookups --- */
+
+int16_t lut_sin_q15(uint16_t angle) {
+    uint32_t quadrant = angle >> 14;
+    uint32_t pos = angle & 0x3FFFU;
+
+    // Quadrants 1 and 3 run the quarter wave backwards
+    if (quadrant & 1U) {
+        pos = 0x4000U - pos;
+    }
+
+    // 8-bit table index, 6-bit interpolation fraction (pos = 0x4000 lands exactly on entry 256)
+    uint32_t idx = pos >> 6;
+    uint32_t frac = pos & 0x3FU;
+    int32_t v = lut_sin_table[idx];
+
+    if (frac) {
+        v += ((lut_sin_table[idx + 1U] - v) * (int32_t)frac + 32) >> 6;
+    }
+    return (int16_t)((quadrant & 2U) ? -v : v);
+}
+
+int16_t lut_cos_q15(uint16_t angle) {
+    return lut_sin_q15((uint16_t)(angle + 0x4000U));
+}
+
+uint32_t lut_exp2_q16(int32_t x) {
+    int32_t ip = x >> 16; // floor
+    uint32_t frac = (uint32_t)x & 0xFFFFU;
+    uint32_t idx = frac >> 8;
+    uint32_t f = frac & 0xFFU;
+    uint32_t m = exp2_table[idx] + (((exp2_table[idx + 1U] - exp2_table[idx]) * f + 128U) >> 8); // [1, 2) in Q16
+
+    if (ip >= 16) {
+        return UINT32_MAX;
+    }
+    if (ip >= 0) {
+        return m << ip;
+    }
+    if (ip < -17) {
+        return 0;
+    }
+    return (m + (1UL << (-ip - 1))) >> -ip;
+}
+
+uint32_t lut_exp_q16(int32_t x) {
+    // e^x = 2^(x log2(e)), log2(e) = 94548 in Q16
+    return lut_exp2_q16((int32_t)(((int64_t)x * 94548 + 32768) >> 16));
+}
+
+int32_t lut_log2_q16(uint32_t x) {
+    if (x == 0) {
+        return INT32_MIN;
+    }
+
+    // x = 2^e * m with m in [1, 2)
+    int32_t e = (int32_t)imath_log2(x);
+    uint32_t m = e >= 16 ? x >> (e - 16) : x << (16 - e); // Q16 in [65536, 131072)
+    uint32_t frac = m - 65536U;
+    uint32_t idx = frac >> 8;
+    uint32_t f = frac & 0xFFU;
+    int32_t l = (int32_t)(log2_table[idx] + (((log2_table[idx + 1U] - log2_table[idx]) * f + 128U) >> 8));
+
+    return (e - 16) * 65536 + l; // x is Q16, so subtract 16
+}
+
+int32_t lut_ln_q16(uint32_t x) {
+    int32_t l = lut_log2_q16(x);
+
+    if (l == INT32_MIN) {
+        return l;
+    }
+    // ln(x) = log2(x) ln(2), ln(2) = 45426 in Q16
+    return (int32_t)(((int64_t)l * 45426 + 32768) >> 16);
+}
+
+uint16_t lut_gamma16(uint8_t level) {
+    return gamma_table[level];
+}
@@ -0,0 +1,96 @@
+/*
+Compile-time lookup tables for math kernels
+
+Tables computed at boot cost startup time and RAM, pasted-in magic arrays can't
+be checked or regenerated. Instead every table entry here is a constant
+expression: a series evaluated by the compiler (double precision) and rounded to
+the table format. The tables are `const`, so they end up in .rodata in flash.
+
+The generator macros are in this header so other modules (fft.c, crc.c) can build
+their own tables the same way:
+
+    #define MY_ENTRY(i) (int16_t)(LUT_SIN((i) * (LUT_PI / 512.0)) * 32767.0 + 0.5),
+    static const int16_t my_table[256] = { LUT_R256(MY_ENTRY, 0) };
+
+Keep the series arguments simple (the table index), every use of an argument
+is a copy of it after preprocessing.
+
+Lookups (linear interpolation between entries) vs newlib soft-float libm. The errors
+are measured against double precision libm over every input (tools/lut_test.c, the
+integer code gives the same results on the M3). The cycles are still estimates from
+the ARMv7-M instruction timings, the libm ones typical soft-float figures for an M3:
+a BENCH=1 build measures sin, exp and ln next to sinf, expf and logf (bench.h).
+
+    function            max error                       cycles      libm (soft-float)
+    lut_sin_q15         1.03 LSB of Q15                 ~20         sinf ~1500-2500
+    lut_exp2_q16        x < 0: 1.03 LSB of Q16          ~20         exp2f ~1000-2000
+                        x >= 0: 1.5e-5 relative
+    lut_exp_q16         x < 0: 1.35 LSB of Q16          ~25         expf ~1000-2000
+                        x >= 0: 7e-5 relative
+    lut_log2_q16        2.32 LSB of Q16                 ~25         log2f ~1000-2000
+    lut_ln_q16          3.45 LSB of Q16                 ~30         logf ~1000-2000
+    lut_gamma16         0.5 LSB (rounded, direct index) ~3          powf ~3000+
+
+Below 1.0 the exp results are small Q16 numbers and the error is absolute: e^-4 is
+1200 LSB, so it is good to ~1e-3 relative there, e^-8 (22 LSB) only to ~6%.
+*/
+#ifndef LUT_H
+#define LUT_H
+
+#include <stdint.h>
+
+/* --- Repeat M(n), M(n + 1), ..., a power of two number of times --- */
+#define LUT_R1(M, n) M(n)
+#define LUT_R2(M, n) LUT_R1(M, n) LUT_R1(M, (n) + 1)
+#define LUT_R4(M, n) LUT_R2(M, n) LUT_R2(M, (n) + 2)
+#define LUT_R8(M, n) LUT_R4(M, n) LUT_R4(M, (n) + 4)
+#define LUT_R16(M, n) LUT_R8(M, n) LUT_R8(M, (n) + 8)
+#define LUT_R32(M, n) LUT_R16(M, n) LUT_R16(M, (n) + 16)
+#define LUT_R64(M, n) LUT_R32(M, n) LUT_R32(M, (n) + 32)
+#define LUT_R128(M, n) LUT_R64(M, n) LUT_R64(M, (n) + 64)
+#define LUT_R256(M, n) LUT_R128(M, n) LUT_R128(M, (n) + 128)
+
+/* --- Series for constant expressions --- */
+#define LUT_PI 3.14159265358979323846
+#define LUT_LN2 0.69314718055994530942
+
+// sin(x) for x in [0, pi/2], Taylor series up to x^15 (error < 1e-12)
+#define LUT_SIN_SERIES(x2) (1.0 - (x2) / 6.0 * (1.0 - (x2) / 20.0 * (1.0 - (x2) / 42.0 * (1.0 - (x2) / 72.0 * \
+    (1.0 - (x2) / 110.0 * (1.0 - (x2) / 156.0 * (1.0 - (x2) / 210.0)))))))
+#define LUT_SIN(x) ((x) * LUT_SIN_SERIES((x) * (x)))
+
+// e^x for x in [-1.2, 1.2], Taylor series up to x^13 (error < 1e-10)
+#define LUT_EXP(x) (1.0 + (x) * (1.0 + (x) / 2.0 * (1.0 + (x) / 3.0 * (1.0 + (x) / 4.0 * (1.0 + (x) / 5.0 * \
+    (1.0 + (x) / 6.0 * (1.0 + (x) / 7.0 * (1.0 + (x) / 8.0 * (1.0 + (x) / 9.0 * (1.0 + (x) / 10.0 * \
+    (1.0 + (x) / 11.0 * (1.0 + (x) / 12.0 * (1.0 + (x) / 13.0)))))))))))))
+
+// ln(1 + f) for f in [0, 1], as 2 atanh(z) with z = f / (2 + f) <= 1/3 (error < 1e-9)
+#define LUT_ATANH_SERIES(z2) (1.0 + (z2) * (1.0 / 3.0 + (z2) * (1.0 / 5.0 + (z2) * (1.0 / 7.0 + (z2) * \
+    (1.0 / 9.0 + (z2) * (1.0 / 11.0 + (z2) * (1.0 / 13.0 + (z2) * (1.0 / 15.0))))))))
+#define LUT_LN1P_Z(z) (2.0 * (z) * LUT_ATANH_SERIES((z) * (z)))
+#define LUT_LN1P(f) LUT_LN1P_Z((f) / (2.0 + (f)))
+
+/* --- Tables (lut.c) --- */
+#define LUT_SIN_QUARTER 256U // entries per quarter turn
+
+// sin(i * pi / 512) for i = 0..256, Q15
+extern const int16_t lut_sin_table[LUT_SIN_QUARTER + 1];
+
+/* --- Lookups --- */
+
+// angle: a full turn is 65536. Returns Q15.
+int16_t lut_sin_q15(uint16_t angle);
+int16_t lut_cos_q15(uint16_t angle);
+
+// x in Q16, returns 2^x / e^x in Q16, saturated to UINT32_MAX (2^x >= 65536)
+uint32_t lut_exp2_q16(int32_t x);
+uint32_t lut_exp_q16(int32_t x);
+
+// x in Q16 (x > 0), returns log2(x) / ln(x) in Q16 (INT32_MIN for x = 0)
+int32_t lut_log2_q16(uint32_t x);
+int32_t lut_ln_q16(uint32_t x);
+
+// Gamma 2.2 correction for LED / PWM brightness: 8-bit level -> 16-bit duty
+uint16_t lut_gamma16(uint8_t level);
+
+#endif
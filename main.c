@@ -1,5 +1,6 @@
 /* 
-Bare-metal LED blink for Nucleo-F103RB
+Bare-metal application for Nucleo-F103RB: status LED, boot count and event log,
+firmware updates and logic analyzer captures over USART2
 
 The RM0008 reference manual has most of the information needed. 
 https://www.st.com/resource/en/reference_manual/rm0008-stm32f101xx-stm32f102xx-stm32f103xx-stm32f105xx-and-stm32f107xx-advanced-armbased-32bit-mcus-stmicroelectronics.pdf
@@ -10,15 +11,86 @@ For every register we want to use, we need:
 - The bitfield meaning + bit position (RM0008: register description tables)
 
 This program uses:
-- RCC (to enable GPIOA clock)
+- RCC (to enable the GPIOA and GPIOC clocks)
 - GPIOA (configure and toggle PA5 (LED on nucleo board))
+- GPIOC (the user button on PC13, presses go to the event log)
+- TIM1 (status patterns on the LED, blinks or breathing, from timer interrupts, led.h)
+- Flash (boot counter in the key-value store, kv.h, and the event log, evlog.h)
+- SysTick and IWDG (the main loop checks in with the watchdog, wdg.h)
+- USART2 (firmware download in the background, updater.h, or 'b': reboot into the bootloader)
+- TIM4 and DMA1 (logic analyzer captures asked for over USART2, logic.h)
+
+A DEMO=1 build (build.sh, DEMO_OUTPUTS) adds outputs that drive pins a board may use
+for something else:
+- TIM2 and DMA1 (brightness ramps on PB8..PB15 by binary code modulation, no CPU involvement, bcm.h)
+- TIM3 and DMA1 (a rainbow on a 300 LED WS2812 strip on PA6, ws2812.h)
+
+The main loop never blocks (it only picks the LED's pattern, led.h plays it), so a
+firmware download proceeds while the LED keeps blinking.
 */
 
 #include <stdint.h>
+#include "kv.h"
+#include "evlog.h"
+#include "fault.h"
+#include "noinit.h"
+#include "tick.h"
+#include "wdg.h"
+#include "uart.h"
+#include "reboot.h"
+#include "svc.h"
+#include "update.h"
+#include "updater.h"
+#include "logic.h"
+#include "led.h"
+#ifdef DEMO_OUTPUTS
+#include "wave.h"
+#include "bcm.h"
+#include "ws2812.h"
+#endif
+#ifdef BENCH
+#include "bench.h"
+#endif
 
 #define LED_PIN 5U // LED on Nucleo-F103RB is PA5
 #define BUTTON_PIN 13U // Button on Nucleo-F103RB is PC13
 
+#ifdef DEMO_OUTPUTS
+/* --- Brightness ramps (bcm.h): 8 levels chasing across PB8..PB15, the DMA timing measured first (wave.h) --- */
+#define RAMP_PINS 0xFF00U
+#define RAMP_FIRST_PIN 8U
+#define RAMP_UNIT 16U // timer cycles: a 510 us period
+#define RAMP_STEP_MS 20U
+#define WAVE_PERIOD 16U // timer cycles
+#define WAVE_JITTER_SAMPLES 64U
+
+/* --- LED strip (ws2812.h): a rainbow moving along 300 LEDs on PA6 --- */
+#define STRIP_LEDS 300U
+#define STRIP_FRAME_MS 40U
+#define STRIP_SHIFT 3U // 1/8 brightness
+
+static uint8_t strip[STRIP_LEDS * 3U];
+#endif
+
+/* --- Logic analyzer (logic.h): 8 KB of samples, e.g. the ramps of a DEMO=1 build on port B --- */
+#define LOGIC_SAMPLES 4096U
+
+// Word aligned: a BENCH=1 build lends it to bench_run() as its work buffer
+__attribute__((aligned(4))) static uint16_t logic_buf[LOGIC_SAMPLES];
+
+/* --- Status LED (led.h): one pattern per status --- */
+enum status { STATUS_IDLE, STATUS_BUTTON, STATUS_CAPTURE, STATUS_COUNT };
+
+static const uint16_t led_idle[] = { LED_SET(255, 250), LED_SET(0, 250) }; // slow blink
+static const uint16_t led_button[] = { LED_SET(255, 60), LED_SET(0, 60) }; // fast blink while the button is held
+static const uint16_t led_capture[] = { LED_FADE(255, 1000), LED_FADE(0, 1000) }; // breathing while a capture waits for its trigger
+
+static const struct led_pattern status_led[STATUS_COUNT] = {
+    [STATUS_IDLE] = LED_PATTERN(led_idle),
+    [STATUS_BUTTON] = LED_PATTERN(led_button),
+    [STATUS_CAPTURE] = LED_PATTERN(led_capture),
+};
+
 /* --- Peripheral base addresses --- */
 
 // Peripherals start at 0x4000_0000 (Table 3 (Register boundary addresses))
@@ -80,14 +152,24 @@ For output:
 #define GPIO_CRH_PIN_MASK 0xFU // 4 bit mask
 #define GPIO_CRH_INPUT_F 0b0100 // CNF[3:2] MODE[1:0]
 
-/* Simple delay that just use empty instructions */
-static void delay (volatile uint32_t n) {
-    while (n--) {
-        __asm volatile ("nop"); // No OPeration
-    }
-}
+/* --- Key-value store keys --- */
+#define KV_KEY_BOOT_COUNT 0x0001U
+
+/* --- Event log ids --- */
+#define EVLOG_ID_BOOT 0x0001U // arg: reset flags (RCC_CSR, saved by the bootloader)
+#define EVLOG_ID_BUTTON 0x0002U // arg: 1 pressed, 0 released
+#define EVLOG_ID_REBOOT 0x0003U // going to the bootloader
+#define EVLOG_ID_UPDATE 0x0004U // arg: 0 new image downloaded, 1 running a new image, confirmed
+#define EVLOG_ID_WAVE 0x0005U // DEMO=1 builds, arg: DMA latency after the timer update, max << 16 | min (timer cycles)
+#define EVLOG_ID_STRIP 0x0006U // DEMO=1 builds, arg: CPU used by the first strip frame, per mille of its length
+#define EVLOG_ID_BENCH 0x0007U // BENCH=1 builds, arg: benchmark (bench.h) << 24 | cycles of the kernel
+#define EVLOG_ID_BENCH_REF 0x0008U // arg: benchmark << 24 | cycles of its reference
 
 int main(void) {
+    fault_init();
+    tick_init();
+    __asm volatile ("cpsie i"); // enable interrupts (the bootloader disables them before the jump)
+
     RCC_APB2ENR |= (1U << RCC_APB2ENR_IOPAEN_BIT); // enable peripheral clock to GPIOA
     RCC_APB2ENR |= (1U << RCC_APB2ENR_IOPCEN_BIT); // enable peripheral clock to GPIOC
     
@@ -96,21 +178,151 @@ int main(void) {
 
     GPIOC_CRH &= ~(GPIO_CRH_PIN_MASK << GPIO_CRH_PIN13_SHIFT);
     GPIOC_CRH |= (GPIO_CRH_INPUT_F << GPIO_CRH_PIN13_SHIFT);
-    
-    int delay_time = 200000U;
+
+    /* Flash, CRC and UART drivers come from the bootloader (svc.h) */
+    if (svc_init() != 0) {
+        GPIOA_BSRR = (1U << LED_PIN); // LED steady on: bootloader too old or missing
+        while (1) {
+        }
+    }
+
+    /* Count boots in flash (survives resets and power loss) */
+    uint32_t boot_count = 0;
+    kv_init();
+    kv_get(KV_KEY_BOOT_COUNT, &boot_count, sizeof(boot_count));
+    boot_count++;
+    kv_set(KV_KEY_BOOT_COUNT, &boot_count, sizeof(boot_count));
+
+    evlog_init(boot_count);
+    evlog_write(EVLOG_ID_BOOT, NOINIT->boot.reset_flags);
+    evlog_flush();
+
+#ifdef BENCH
+    // Kernel timings (bench.h), before anything else runs
+    struct bench_result bench[BENCH_COUNT];
+    bench_run(bench, (int16_t *)logic_buf); // no capture before the main loop
+    for (uint32_t i = 0; i < BENCH_COUNT; i++) {
+        evlog_write(EVLOG_ID_BENCH, (i << 24) | bench[i].cycles);
+        evlog_write(EVLOG_ID_BENCH_REF, (i << 24) | bench[i].ref_cycles);
+    }
+    evlog_flush();
+#endif
+
+    uart_init(UART_BAUD);
+    updater_init();
+    wdg_init();
+    int main_task = wdg_register(500U); // a loop iteration takes at most one page erase (~20 ms)
+
+    led_init(LED_PORT_A, LED_PIN);
+
+#ifdef DEMO_OUTPUTS
+    // The pattern's timing is measured first, with the main loop running as usual
+    static uint16_t jitter_samples[WAVE_JITTER_SAMPLES];
+    int measuring = wave_init(WAVE_PORT_B, RAMP_PINS) == 0 &&
+        wave_measure_start(jitter_samples, WAVE_JITTER_SAMPLES, WAVE_PERIOD) == 0;
+    int strip_on = ws2812_init() == 0;
+    uint32_t strip_logged = 0;
+    uint32_t last_frame = tick_ms();
+    uint32_t hue = 0;
+    uint32_t ramping = 0;
+    uint32_t last_ramp = 0;
+    uint32_t phase = 0;
+#endif
+    uint32_t shown = STATUS_COUNT; // none yet
+    uint32_t pressed = 0;
+    uint32_t confirmed = 0;
 
     while(1) {
-        if (GPIOC_IDR & (1U << BUTTON_PIN)) {
-            delay_time = 200000U;
-        } 
-        else {
-            delay_time = 50000U;
+        wdg_checkin(main_task);
+        wdg_service();
+
+        switch (updater_poll()) {
+        case UPDATER_REBOOT:
+            evlog_write(EVLOG_ID_REBOOT, 0);
+            evlog_flush();
+            reboot_to_bootloader();
+        case UPDATER_DONE:
+            evlog_write(EVLOG_ID_UPDATE, 0);
+            evlog_flush();
+            reboot(); // the bootloader installs it
+        case UPDATER_CAPTURE: {
+            struct logic_config capture;
+            updater_capture(&capture);
+            logic_start(logic_buf, LOGIC_SAMPLES, &capture); // settings it refuses: the host times out
+            break;
+        }
+        default:
+            break;
         }
 
-        GPIOA_BSRR = (1U << LED_PIN); // set LED
-        delay(delay_time);
+        // A freshly installed image is kept once it has run healthy (otherwise the bootloader reverts it)
+        if (!confirmed && wdg_healthy()) {
+            if (update_get_state(NULL) == UPDATE_TESTING && update_confirm() == 0) {
+                evlog_write(EVLOG_ID_UPDATE, 1);
+            }
+            confirmed = 1;
+        }
 
-        GPIOA_BSRR = (1U << (LED_PIN + 16)); // reset LED
-        delay(delay_time);
+#ifdef DEMO_OUTPUTS
+        struct wave_jitter jitter;
+        if (measuring && wave_measure_done(jitter_samples, WAVE_JITTER_SAMPLES, &jitter) == 0) {
+            measuring = 0;
+            evlog_write(EVLOG_ID_WAVE, ((uint32_t)jitter.max << 16) | jitter.min);
+            ramping = bcm_start(WAVE_PORT_B, RAMP_PINS, RAMP_UNIT) == 0;
+            last_ramp = tick_ms();
+        }
+
+        // Triangle ramps, each pin an eighth of the way behind the one before
+        if (ramping && tick_ms() - last_ramp >= RAMP_STEP_MS) {
+            last_ramp += RAMP_STEP_MS;
+            phase += 4U;
+            for (uint32_t i = 0; i < 8U; i++) {
+                uint32_t x = (phase + i * 32U) & 0xFFU;
+                bcm_set(RAMP_FIRST_PIN + i, (uint8_t)(x < 128U ? 2U * x : 511U - 2U * x));
+            }
+        }
+#endif
+
+        // A finished capture goes out one frame per iteration
+        logic_export_poll();
+
+        // Log button changes (batched: reaches flash every EVLOG_BATCH events)
+        uint32_t now = (GPIOC_IDR & (1U << BUTTON_PIN)) == 0;
+        if (now != pressed) {
+            pressed = now;
+            evlog_write(EVLOG_ID_BUTTON, pressed);
+        }
+
+#ifdef DEMO_OUTPUTS
+        // Next strip frame once the last one is out (the first one's cost goes to the log)
+        if (strip_on && ws2812_state() != WS2812_BUSY && tick_ms() - last_frame >= STRIP_FRAME_MS) {
+            struct ws2812_load load;
+            if (!strip_logged && ws2812_load(&load) == 0) {
+                strip_logged = 1;
+                evlog_write(EVLOG_ID_STRIP, load.cpu / (load.frame / 1000U + 1U));
+            }
+            last_frame = tick_ms();
+            hue += 8U;
+            for (uint32_t i = 0; i < STRIP_LEDS; i++) {
+                // Hue wheel in 3 x 256 steps: red -> green -> blue -> red
+                uint32_t h = (hue + i * 768U / STRIP_LEDS) % 768U;
+                uint32_t x = h & 0xFFU;
+                uint32_t up = x >> STRIP_SHIFT;
+                uint32_t down = (255U - x) >> STRIP_SHIFT;
+                uint8_t *p = &strip[i * 3U];
+                p[0] = (uint8_t)(h < 256U ? down : h >= 512U ? up : 0U);
+                p[1] = (uint8_t)(h < 256U ? up : h < 512U ? down : 0U);
+                p[2] = (uint8_t)(h < 256U ? 0U : h < 512U ? up : down);
+            }
+            ws2812_show(strip, STRIP_LEDS);
+        }
+#endif
+
+        // The LED shows the status, the pattern plays from timer interrupts (led.h)
+        uint32_t status = logic_state() == LOGIC_ARMED ? STATUS_CAPTURE : pressed ? STATUS_BUTTON : STATUS_IDLE;
+        if (status != shown) {
+            shown = status;
+            led_play(&status_led[status]);
+        }
     } 
 }
@@ -0,0 +1,105 @@
+/*
+RAM shared between the bootloader and the app across resets
+
+The first NOINIT_SIZE bytes of SRAM are left out of both linker scripts (neither
+startup code nor the stack touches them), so what one program leaves there is still
+there after a reset (not after a power cycle: SRAM then holds random values, so every
+record carries a magic number and a CRC and is only trusted when both match).
+
+Both images are linked separately, so the layout is fixed by this header and the
+struct is accessed at a fixed address, like a peripheral.
+*/
+#ifndef NOINIT_H
+#define NOINIT_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "crc.h"
+
+#define NOINIT_BASE 0x20000000UL
+#define NOINIT_SIZE 1024U // the linker scripts start RAM after this
+#define NOINIT_FAULT_STACK 128U // top of the area: stack for the fault handler (fault.c)
+
+/* --- Crash dump (fault.c writes it, the bootloader reports it) --- */
+
+#define CRASH_MAGIC 0xDEADC0DEUL
+#define CRASH_STACK_WORDS 32U
+
+struct crash_dump {
+    uint32_t magic;
+    uint32_t vector; // IPSR: 3 HardFault, 4 MemManage, 5 BusFault, 6 UsageFault
+    // Exception frame stacked by the core
+    uint32_t r0, r1, r2, r3, r12, lr, pc, xpsr;
+    uint32_t sp; // address of the exception frame
+    uint32_t exc_return; // LR on entry (bit 2: frame on PSP)
+    // System control block fault status (PM0056 4.4.14 - 4.4.17)
+    uint32_t cfsr, hfsr, mmfar, bfar;
+    // Stack above the exception frame (the caller's locals and return addresses)
+    uint32_t stack_words;
+    uint32_t stack[CRASH_STACK_WORDS];
+    uint32_t crc; // crc32 of everything above
+};
+
+// 1 if d holds a complete dump (a fault handler finished writing it)
+static inline int crash_dump_valid(const volatile struct crash_dump *d) {
+    return d->magic == CRASH_MAGIC && d->crc == crc32(0, (const void *)d, offsetof(struct crash_dump, crc));
+}
+
+/* --- Watchdog post-mortem (wdg.c writes it on every check-in) --- */
+
+#define WDG_RECORD_MAGIC 0x57444F47UL // "WDOG"
+
+struct wdg_record {
+    uint32_t magic;
+    uint32_t last_task; // id of the last task that checked in
+    uint32_t last_tick; // when (tick_ms())
+    uint32_t overdue; // bit n: task n missed its deadline (the watchdog stopped being fed)
+    uint32_t check; // magic ^ last_task ^ last_tick ^ overdue
+};
+
+static inline int wdg_record_valid(const volatile struct wdg_record *r) {
+    return r->magic == WDG_RECORD_MAGIC && r->check == (r->magic ^ r->last_task ^ r->last_tick ^ r->overdue);
+}
+
+/* --- Boot status (the bootloader writes it on every boot) --- */
+
+struct boot_status {
+    uint32_t reset_flags; // RCC_CSR reset flags of this boot (the bootloader clears them in RCC_CSR)
+    uint32_t wdg_resets; // consecutive watchdog resets, cleared by the app once it has run healthy
+    uint32_t wdg_resets_check; // ~wdg_resets
+};
+
+/* --- Bootloader mailbox (reboot.c writes it, the bootloader reads and clears it) --- */
+
+// Stay in the bootloader on the next reset. A random power-on value matches with a
+// probability of 2^-32, which only costs one boot in the bootloader.
+#define BOOT_REQUEST_MAGIC 0xB00710ADUL
+
+/* --- Warm-boot token (the bootloader writes it after checking the app's signature, image.h) --- */
+
+#define BOOT_TOKEN_MAGIC 0x56524644UL // "VRFD"
+
+struct boot_token {
+    uint32_t magic;
+    uint32_t image; // image_id() of the app that was checked
+    uint32_t cycles; // how long the check took (DWT cycle counter)
+    uint32_t check; // magic ^ image ^ cycles
+};
+
+static inline int boot_token_valid(const volatile struct boot_token *t) {
+    return t->magic == BOOT_TOKEN_MAGIC && t->check == (t->magic ^ t->image ^ t->cycles);
+}
+
+struct noinit {
+    struct crash_dump crash;
+    struct wdg_record wdg;
+    struct boot_status boot;
+    uint32_t boot_request;
+    struct boot_token token;
+};
+
+#define NOINIT ((volatile struct noinit *)NOINIT_BASE)
+
+_Static_assert(sizeof(struct noinit) <= NOINIT_SIZE - NOINIT_FAULT_STACK, "noinit area too small");
+
+#endif
@@ -0,0 +1,31 @@
+/*
+Software reset, see reboot.h
+*/
+
+#include "reboot.h"
+#include "noinit.h"
+
+// volatile prevents compiler from optimizing (important for hardware access)
+#define REG32(addr) (*(volatile uint32_t *)(addr))
+
+// (PM0056 Table 41 (System control block registers summary))
+#define SCB_AIRCR REG32(0xE000ED0CUL) // Application interrupt and reset control register
+
+// PM0056 4.4.5 AIRCR: writes need the key in [31:16]
+#define SCB_AIRCR_VECTKEY (0x05FAUL << 16)
+#define SCB_AIRCR_SYSRESETREQ (1U << 2)
+
+void reboot(void) {
+    __asm volatile ("dsb"); // finish outstanding writes (the noinit request) first
+    SCB_AIRCR = SCB_AIRCR_VECTKEY | SCB_AIRCR_SYSRESETREQ;
+    __asm volatile ("dsb");
+
+    while (1) {
+        // wait for the reset
+    }
+}
+
+void reboot_to_bootloader(void) {
+    NOINIT->boot_request = BOOT_REQUEST_MAGIC;
+    reboot();
+}
@@ -0,0 +1,14 @@
+/*
+Software reset (SYSRESETREQ), optionally into the bootloader
+
+reboot_to_bootloader() leaves a request in noinit RAM (noinit.h) that the bootloader
+checks first thing, so a firmware update can be started remotely without holding
+the button during reset. Flush anything buffered (evlog_flush()) before calling these.
+*/
+#ifndef REBOOT_H
+#define REBOOT_H
+
+__attribute__((noreturn)) void reboot(void);
+__attribute__((noreturn)) void reboot_to_bootloader(void);
+
+#endif
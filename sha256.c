@@ -0,0 +1,166 @@
+/*
+SHA-256, see sha256.h
+
+The compression function is fully unrolled: the eight working variables are never
+moved, each round just uses them under different names (the ROUND arguments rotate),
+and the round constants are addressed with fixed offsets. Written so that GCC maps
+each line to Thumb-2 directly:
+ - ROTR(x, n) ^ ... becomes EOR with a rotated operand (one cycle per term)
+ - big endian loads are LDR + REV (aligned input, which image hashing always is)
+ - CH / MAJ use the 3 / 4 operation forms
+The 16 word message schedule stays on the stack: with the 8 working variables, the
+M3's 13 general purpose registers have room for the few schedule words a step needs,
+not for the whole window.
+
+No .ramfunc copy: at 8 MHz flash has no wait states, and at 72 MHz the straight-line
+code streams through the prefetch buffer (the bootloader also has no RAM init to copy it).
+*/
+
+#include "sha256.h"
+
+#define ROTR(x, n) (((x) >> (n)) | ((x) << (32U - (n))))
+
+#define BSIG0(x) (ROTR(x, 2U) ^ ROTR(x, 13U) ^ ROTR(x, 22U))
+#define BSIG1(x) (ROTR(x, 6U) ^ ROTR(x, 11U) ^ ROTR(x, 25U))
+#define SSIG0(x) (ROTR(x, 7U) ^ ROTR(x, 18U) ^ ((x) >> 3))
+#define SSIG1(x) (ROTR(x, 17U) ^ ROTR(x, 19U) ^ ((x) >> 10))
+#define CH(x, y, z) ((((y) ^ (z)) & (x)) ^ (z))
+#define MAJ(x, y, z) (((x) & (y)) | ((z) & ((x) | (y))))
+
+// 4.2.2 SHA-224 and SHA-256 Constants
+static const uint32_t k[64] = {
+    0x428A2F98UL, 0x71374491UL, 0xB5C0FBCFUL, 0xE9B5DBA5UL, 0x3956C25BUL, 0x59F111F1UL, 0x923F82A4UL, 0xAB1C5ED5UL,
+    0xD807AA98UL, 0x12835B01UL, 0x243185BEUL, 0x550C7DC3UL, 0x72BE5D74UL, 0x80DEB1FEUL, 0x9BDC06A7UL, 0xC19BF174UL,
+    0xE49B69C1UL, 0xEFBE4786UL, 0x0FC19DC6UL, 0x240CA1CCUL, 0x2DE92C6FUL, 0x4A7484AAUL, 0x5CB0A9DCUL, 0x76F988DAUL,
+    0x983E5152UL, 0xA831C66DUL, 0xB00327C8UL, 0xBF597FC7UL, 0xC6E00BF3UL, 0xD5A79147UL, 0x06CA6351UL, 0x14292967UL,
+    0x27B70A85UL, 0x2E1B2138UL, 0x4D2C6DFCUL, 0x53380D13UL, 0x650A7354UL, 0x766A0ABBUL, 0x81C2C92EUL, 0x92722C85UL,
+    0xA2BFE8A1UL, 0xA81A664BUL, 0xC24B8B70UL, 0xC76C51A3UL, 0xD192E819UL, 0xD6990624UL, 0xF40E3585UL, 0x106AA070UL,
+    0x19A4C116UL, 0x1E376C08UL, 0x2748774CUL, 0x34B0BCB5UL, 0x391C0CB3UL, 0x4ED8AA4AUL, 0x5B9CCA4FUL, 0x682E6FF3UL,
+    0x748F82EEUL, 0x78A5636FUL, 0x84C87814UL, 0x8CC70208UL, 0x90BEFFFAUL, 0xA4506CEBUL, 0xBEF9A3F7UL, 0xC67178F2UL,
+};
+
+// Message word i: the first 16 are loaded, the others computed in place (16 word window)
+#define W_LOAD(i) w[i]
+#define W_NEXT(i) (w[(i) & 15U] += SSIG1(w[((i) - 2U) & 15U]) + w[((i) - 7U) & 15U] + SSIG0(w[((i) - 15U) & 15U]))
+
+// One round: d and h are the only variables that change, the next round renames them
+#define ROUND(a, b, c, d, e, f, g, h, i, W) \
+    h += BSIG1(e) + CH(e, f, g) + k[i] + W(i); \
+    d += h; \
+    h += BSIG0(a) + MAJ(a, b, c)
+
+#define ROUND8(i, W) \
+    ROUND(a, b, c, d, e, f, g, h, (i) + 0U, W); \
+    ROUND(h, a, b, c, d, e, f, g, (i) + 1U, W); \
+    ROUND(g, h, a, b, c, d, e, f, (i) + 2U, W); \
+    ROUND(f, g, h, a, b, c, d, e, (i) + 3U, W); \
+    ROUND(e, f, g, h, a, b, c, d, (i) + 4U, W); \
+    ROUND(d, e, f, g, h, a, b, c, (i) + 5U, W); \
+    ROUND(c, d, e, f, g, h, a, b, (i) + 6U, W); \
+    ROUND(b, c, d, e, f, g, h, a, (i) + 7U, W)
+
+void sha256_blocks(uint32_t state[8], const uint8_t *p, uint32_t blocks) {
+    uint32_t w[16];
+
+    while (blocks--) {
+        if (((uintptr_t)p & 3U) == 0) {
+            const uint32_t *p32 = (const uint32_t *)(uintptr_t)p;
+            for (uint32_t i = 0; i < 16U; i++) {
+                w[i] = __builtin_bswap32(p32[i]); // REV
+            }
+        }
+        else {
+            for (uint32_t i = 0; i < 16U; i++) {
+                w[i] = ((uint32_t)p[4U * i] << 24) | ((uint32_t)p[4U * i + 1U] << 16) |
+                    ((uint32_t)p[4U * i + 2U] << 8) | p[4U * i + 3U];
+            }
+        }
+
+        uint32_t a = state[0], b = state[1], c = state[2], d = state[3];
+        uint32_t e = state[4], f = state[5], g = state[6], h = state[7];
+
+        ROUND8(0U, W_LOAD);
+        ROUND8(8U, W_LOAD);
+        ROUND8(16U, W_NEXT);
+        ROUND8(24U, W_NEXT);
+        ROUND8(32U, W_NEXT);
+        ROUND8(40U, W_NEXT);
+        ROUND8(48U, W_NEXT);
+        ROUND8(56U, W_NEXT);
+
+        state[0] += a;
+        state[1] += b;
+        state[2] += c;
+        state[3] += d;
+        state[4] += e;
+        state[5] += f;
+        state[6] += g;
+        state[7] += h;
+        p += SHA256_BLOCK;
+    }
+}
+
+void sha256_init(struct sha256 *s) {
+    // 5.3.3 initial hash value
+    s->h[0] = 0x6A09E667UL;
+    s->h[1] = 0xBB67AE85UL;
+    s->h[2] = 0x3C6EF372UL;
+    s->h[3] = 0xA54FF53AUL;
+    s->h[4] = 0x510E527FUL;
+    s->h[5] = 0x9B05688CUL;
+    s->h[6] = 0x1F83D9ABUL;
+    s->h[7] = 0x5BE0CD19UL;
+    s->bytes = 0;
+    s->used = 0;
+}
+
+void sha256_update(struct sha256 *s, const void *data, uint32_t len) {
+    const uint8_t *p = data;
+
+    s->bytes += len;
+    if (s->used) {
+        while (len && s->used < SHA256_BLOCK) {
+            s->block[s->used++] = *p++;
+            len--;
+        }
+        if (s->used < SHA256_BLOCK) {
+            return;
+        }
+        sha256_blocks(s->h, s->block, 1U);
+        s->used = 0;
+    }
+    // Whole blocks straight from the caller's buffer (flash when hashing an image)
+    sha256_blocks(s->h, p, len / SHA256_BLOCK);
+    p += len & ~(SHA256_BLOCK - 1U);
+    len &= SHA256_BLOCK - 1U;
+    while (len--) {
+        s->block[s->used++] = *p++;
+    }
+}
+
+void sha256_final(struct sha256 *s, uint8_t digest[SHA256_DIGEST]) {
+    uint32_t hi = s->bytes >> 29; // length in bits, 64 bit big endian
+    uint32_t lo = s->bytes << 3;
+
+    // 5.1.1 padding: 0x80, zeros, then the length in the last 8 bytes
+    s->block[s->used++] = 0x80;
+    if (s->used > SHA256_BLOCK - 8U) {
+        while (s->used < SHA256_BLOCK) {
+            s->block[s->used++] = 0;
+        }
+        sha256_blocks(s->h, s->block, 1U);
+        s->used = 0;
+    }
+    while (s->used < SHA256_BLOCK - 8U) {
+        s->block[s->used++] = 0;
+    }
+    for (uint32_t i = 0; i < 4U; i++) {
+        s->block[56U + i] = (uint8_t)(hi >> (24U - 8U * i));
+        s->block[60U + i] = (uint8_t)(lo >> (24U - 8U * i));
+    }
+    sha256_blocks(s->h, s->block, 1U);
+
+    for (uint32_t i = 0; i < 32U; i++) {
+        digest[i] = (uint8_t)(s->h[i / 4U] >> (24U - 8U * (i & 3U)));
+    }
+}
@@ -0,0 +1,64 @@
+/*
+Portable SHA-256 compression function, the reference sha256_blocks() is checked and
+benchmarked against (bench.c, in a BENCH=1 build)
+
+Straight from FIPS 180-4 section 6.2: a 16 word circular message schedule and one
+loop over the 64 rounds, shifting the working variables every round.
+*/
+
+#include "sha256.h"
+
+#define ROTR(x, n) (((x) >> (n)) | ((x) << (32U - (n))))
+
+static const uint32_t k[64] = {
+    0x428A2F98UL, 0x71374491UL, 0xB5C0FBCFUL, 0xE9B5DBA5UL, 0x3956C25BUL, 0x59F111F1UL, 0x923F82A4UL, 0xAB1C5ED5UL,
+    0xD807AA98UL, 0x12835B01UL, 0x243185BEUL, 0x550C7DC3UL, 0x72BE5D74UL, 0x80DEB1FEUL, 0x9BDC06A7UL, 0xC19BF174UL,
+    0xE49B69C1UL, 0xEFBE4786UL, 0x0FC19DC6UL, 0x240CA1CCUL, 0x2DE92C6FUL, 0x4A7484AAUL, 0x5CB0A9DCUL, 0x76F988DAUL,
+    0x983E5152UL, 0xA831C66DUL, 0xB00327C8UL, 0xBF597FC7UL, 0xC6E00BF3UL, 0xD5A79147UL, 0x06CA6351UL, 0x14292967UL,
+    0x27B70A85UL, 0x2E1B2138UL, 0x4D2C6DFCUL, 0x53380D13UL, 0x650A7354UL, 0x766A0ABBUL, 0x81C2C92EUL, 0x92722C85UL,
+    0xA2BFE8A1UL, 0xA81A664BUL, 0xC24B8B70UL, 0xC76C51A3UL, 0xD192E819UL, 0xD6990624UL, 0xF40E3585UL, 0x106AA070UL,
+    0x19A4C116UL, 0x1E376C08UL, 0x2748774CUL, 0x34B0BCB5UL, 0x391C0CB3UL, 0x4ED8AA4AUL, 0x5B9CCA4FUL, 0x682E6FF3UL,
+    0x748F82EEUL, 0x78A5636FUL, 0x84C87814UL, 0x8CC70208UL, 0x90BEFFFAUL, 0xA4506CEBUL, 0xBEF9A3F7UL, 0xC67178F2UL,
+};
+
+void sha256_blocks_ref(uint32_t state[8], const uint8_t *p, uint32_t blocks) {
+    while (blocks--) {
+        uint32_t w[16];
+        uint32_t a = state[0], b = state[1], c = state[2], d = state[3];
+        uint32_t e = state[4], f = state[5], g = state[6], h = state[7];
+
+        for (uint32_t i = 0; i < 64U; i++) {
+            if (i < 16U) {
+                // Big endian words
+                w[i] = ((uint32_t)p[4U * i] << 24) | ((uint32_t)p[4U * i + 1U] << 16) |
+                    ((uint32_t)p[4U * i + 2U] << 8) | p[4U * i + 3U];
+            }
+            else {
+                uint32_t w15 = w[(i - 15U) & 15U];
+                uint32_t w2 = w[(i - 2U) & 15U];
+                uint32_t s0 = ROTR(w15, 7U) ^ ROTR(w15, 18U) ^ (w15 >> 3);
+                uint32_t s1 = ROTR(w2, 17U) ^ ROTR(w2, 19U) ^ (w2 >> 10);
+                w[i & 15U] += s0 + w[(i - 7U) & 15U] + s1;
+            }
+            uint32_t t1 = h + (ROTR(e, 6U) ^ ROTR(e, 11U) ^ ROTR(e, 25U)) + ((e & f) ^ (~e & g)) + k[i] + w[i & 15U];
+            uint32_t t2 = (ROTR(a, 2U) ^ ROTR(a, 13U) ^ ROTR(a, 22U)) + ((a & b) ^ (a & c) ^ (b & c));
+            h = g;
+            g = f;
+            f = e;
+            e = d + t1;
+            d = c;
+            c = b;
+            b = a;
+            a = t1 + t2;
+        }
+        state[0] += a;
+        state[1] += b;
+        state[2] += c;
+        state[3] += d;
+        state[4] += e;
+        state[5] += f;
+        state[6] += g;
+        state[7] += h;
+        p += SHA256_BLOCK;
+    }
+}
@@ -0,0 +1,38 @@
+/*
+Startup code (reset handler)
+
+main() used to be the reset handler, which only works as long as the program has no
+global or static variables. C expects before main() runs:
+- initialised variables (.data) to hold their initial values. The values are stored
+  in flash after the code (the linker script puts .data "AT > FLASH") and copied to RAM here.
+- zero-initialised variables (.bss) to be zero. RAM holds random values after power-up.
+
+The __data_* / __bss_* symbols are defined in the linker script.
+*/
+
+#include <stdint.h>
+
+extern uint32_t __data_load[]; // address of the initial values in flash
+extern uint32_t __data_start[];
+extern uint32_t __data_end[];
+extern uint32_t __bss_start[];
+extern uint32_t __bss_end[];
+
+int main(void);
+
+void Reset_Handler(void) {
+    const uint32_t *src = __data_load;
+
+    for (uint32_t *dst = __data_start; dst < __data_end; dst++) {
+        *dst = *src++;
+    }
+    for (uint32_t *dst = __bss_start; dst < __bss_end; dst++) {
+        *dst = 0;
+    }
+
+    main();
+
+    while (1) {
+        // main() should never return
+    }
+}
@@ -0,0 +1,63 @@
+/*
+App side of the bootloader service table, see svc.h
+
+Same functions as crc.c, flash.c and uart.c, which the app no longer links.
+*/
+
+#include "svc.h"
+#include "crc.h"
+#include "flash.h"
+#include "uart.h"
+
+int svc_init(void) {
+    const struct bl_services *s = BL_SERVICES;
+
+    if (s->magic != BL_SERVICES_MAGIC || s->version < BL_SERVICES_VERSION || s->size < sizeof(struct bl_services)) {
+        return -1;
+    }
+    return 0;
+}
+
+void delay(uint32_t n) {
+    BL_SERVICES->delay(n);
+}
+
+uint32_t crc32(uint32_t crc, const void *data, uint32_t len) {
+    return BL_SERVICES->crc32(crc, data, len);
+}
+
+uint16_t crc16_ccitt(uint16_t crc, const void *data, uint32_t len) {
+    return BL_SERVICES->crc16_ccitt(crc, data, len);
+}
+
+int flash_erase_page(uint32_t addr) {
+    return BL_SERVICES->flash_erase_page(addr);
+}
+
+int flash_program(uint32_t addr, const void *data, uint32_t len) {
+    return BL_SERVICES->flash_program(addr, data, len);
+}
+
+void uart_init(uint32_t baud) {
+    BL_SERVICES->uart_init(baud);
+}
+
+void uart_putc(uint8_t c) {
+    BL_SERVICES->uart_putc(c);
+}
+
+void uart_write(const void *data, uint32_t len) {
+    BL_SERVICES->uart_write(data, len);
+}
+
+void uart_puts(const char *s) {
+    BL_SERVICES->uart_puts(s);
+}
+
+void uart_puthex32(uint32_t v) {
+    BL_SERVICES->uart_puthex32(v);
+}
+
+int uart_getc(void) {
+    return BL_SERVICES->uart_getc();
+}
@@ -0,0 +1,58 @@
+/*
+Bootloader service table (like a ROM API)
+
+The bootloader already contains the CRC, flash and UART drivers. Instead of linking
+its own copies, the app calls them through a table of function pointers that the
+bootloader places at a fixed address (BL_SERVICES_ADDR, right after its vector table).
+
+- The table starts with a magic number, a version and its size. New functions are
+  only ever appended (and the version bumped), so an app built against an older
+  table keeps working with a newer bootloader.
+- svc.c (app side) checks the table once in svc_init(), then provides the usual
+  crc.h / flash.h / uart.h functions as one indirect call each, so the code using
+  them doesn't change.
+- The bootloader's flash functions refuse to touch the bootloader itself and slot A
+  (the running app, only replaced through a signed update, image.h).
+
+Everything here runs from the bootloader's flash, which an app update never erases.
+(A copy in RAM wouldn't help: the F103 has a single flash bank, so during an erase
+every flash fetch stalls, including the interrupt handlers of the app.)
+*/
+#ifndef SVC_H
+#define SVC_H
+
+#include <stdint.h>
+
+#define BL_SERVICES_ADDR 0x08000150UL // bootloader_memory.ld
+#define BL_SERVICES_MAGIC 0x424C5356UL // "BLSV"
+#define BL_SERVICES_VERSION 1U
+
+struct bl_services {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t size; // sizeof(struct bl_services) in the bootloader
+
+    // Version 1
+    void (*delay)(uint32_t n); // busy loop, n iterations
+    uint32_t (*crc32)(uint32_t crc, const void *data, uint32_t len);
+    uint16_t (*crc16_ccitt)(uint16_t crc, const void *data, uint32_t len);
+    int (*flash_erase_page)(uint32_t addr);
+    int (*flash_program)(uint32_t addr, const void *data, uint32_t len);
+    void (*uart_init)(uint32_t baud);
+    void (*uart_putc)(uint8_t c);
+    void (*uart_write)(const void *data, uint32_t len);
+    void (*uart_puts)(const char *s);
+    void (*uart_puthex32)(uint32_t v);
+    int (*uart_getc)(void);
+};
+
+#define BL_SERVICES ((const struct bl_services *)BL_SERVICES_ADDR)
+
+// App side: check the bootloader provides (at least) the table this app was built with.
+// Returns 0, or -1 if the services can't be used.
+int svc_init(void);
+
+// Busy loop (the bootloader exports its own, the app calls it through the table)
+void delay(uint32_t n);
+
+#endif
@@ -0,0 +1,36 @@
+/*
+Millisecond tick, see tick.h
+*/
+
+#include "tick.h"
+
+#define CORE_CLOCK 8000000UL // HSI, reset clock configuration
+
+// volatile prevents compiler from optimizing (important for hardware access)
+#define REG32(addr) (*(volatile uint32_t *)(addr))
+
+// (PM0056 Table 50 (SysTick register map))
+#define SYST_CSR REG32(0xE000E010UL) // Control and status register
+#define SYST_RVR REG32(0xE000E014UL) // Reload value register
+#define SYST_CVR REG32(0xE000E018UL) // Current value register
+
+// PM0056 4.5.1 SysTick control and status register
+#define SYST_CSR_ENABLE (1U << 0)
+#define SYST_CSR_TICKINT (1U << 1) // Interrupt when the counter reaches 0
+#define SYST_CSR_CLKSOURCE (1U << 2) // 1 = processor clock, 0 = processor clock / 8
+
+static volatile uint32_t ticks;
+
+void tick_init(void) {
+    SYST_RVR = CORE_CLOCK / 1000U - 1U; // counts N .. 0, so the period is N + 1
+    SYST_CVR = 0;
+    SYST_CSR = SYST_CSR_CLKSOURCE | SYST_CSR_TICKINT | SYST_CSR_ENABLE;
+}
+
+uint32_t tick_ms(void) {
+    return ticks; // a single 32-bit load, no need to disable interrupts
+}
+
+void SysTick_Handler(void) {
+    ticks++;
+}
@@ -0,0 +1,20 @@
+/*
+Millisecond tick (SysTick)
+
+SysTick counts the 8 MHz core clock down from 8000 and interrupts every millisecond.
+Interrupts must be enabled (the bootloader disables them before jumping to the app).
+*/
+#ifndef TICK_H
+#define TICK_H
+
+#include <stdint.h>
+
+void tick_init(void);
+
+// Milliseconds since tick_init(), wraps after 49 days: compare with (now - then) < d
+uint32_t tick_ms(void);
+
+// Vector table entry (main_memory.ld)
+void SysTick_Handler(void);
+
+#endif
@@ -0,0 +1,472 @@
+/*
+The board's update code built for the host: transfers, resume and rollback without a board
+
+    devsim [-e errors] [-n runs] [-r seed] [-f flash.bin] [-k signing_key.pem] [bench|resume|stall|rollback|all]
+
+The firmware's own updater.c (app side of a transfer), update.c (the bootloader's
+install and revert) and image.c (signature check) run against the simulated flash
+and line of sim.h, with the host side of link.h at the other end of the line:
+- bench: a 51 KB image at line error rates 0, 1e-5, 1e-4 and 1e-3 (or -e): time,
+  line efficiency (the image's byte times over the time from 'R' to 'D', slot B's
+  erase before 'R' is reported on its own),
+  pages sent again, bytes lost to flash stalls
+- resume: transfers cut by power losses at random flash operations (-n of them),
+  each continued by the next boot with the same 'U'
+- stall: a transfer while the main loop also erases a page every 100 ms (as the
+  event log and the key-value store do): the bytes lost meanwhile (USART overruns)
+  must only cost resent pages
+- rollback: install with power losses, a transfer refused while the new app is on
+  trial, the new app never confirmed: started by the
+  bootloader until its watchdog resets add up and it's reverted (with power losses
+  too, which start the count over), then the same install confirmed; an image signed
+  with another key must be refused
+
+Every boot of the board is a forked process: RAM starts over, the flash file
+(default output/devsim_flash.bin) stays. Test images are random apps with the
+image.h header, signed with -k (default keys/signing_key.pem, whose public key
+build.sh built into image.c). The exit status is 0 when every check passed.
+
+Build (host, after build.sh made the keys):
+    cc -O2 -Wall -Wextra -I. -Ioutput tools/devsim.c tools/sim.c tools/link.c tools/sign.c updater.c update.c \
+        image.c ed25519.c sha256.c aes.c crc.c cobs.c -o output/devsim
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include "aes.h"
+#include "crc.h"
+#include "flash.h"
+#include "image.h"
+#include "update.h"
+#include "updater.h"
+#include "link.h"
+#include "sign.h"
+#include "sim.h"
+#include "update_key.h" // UPDATE_AES_KEY, generated by build.sh from keys/
+
+#define POLL_NS 400000U // main loop pass: one keystream chunk (~0.4 ms)
+#define SEC 1000000000ULL
+
+static const uint8_t aes_key[AES128_KEY_SIZE] = UPDATE_AES_KEY;
+
+struct image {
+    uint8_t plain[UPDATE_SLOT_SIZE];
+    uint32_t size;
+    uint32_t crc;
+    uint8_t iv[AES_BLOCK];
+    uint8_t data[LINK_MAX_PAGES * LINK_PAGE]; // encrypted
+};
+
+/* What a boot (child process) reports back */
+struct report {
+    int result; // host: 1 done, -1 device error, 0 gave up
+    int rc; // enum update_boot of a bootloader boot, or update_confirm()
+    uint32_t resumed; // first page the device asked for
+    uint64_t ready_ns; // 'R'
+    uint64_t elapsed_ns;
+    uint32_t frames;
+    uint32_t resent;
+    uint32_t naks;
+    uint32_t timeouts;
+    uint32_t lost; // bytes lost to flash stalls before the last page was in
+    struct sim_stats stats;
+};
+
+static struct report *report; // shared with the boots
+static double errors;
+static const char *sign_key = "keys/signing_key.pem";
+static uint32_t stall_ms; // transfer_boot() erases a spare page this often (0: never)
+static int failures;
+
+static uint8_t line(uint8_t c) {
+    if (errors > 0 && rand() < errors * ((double)RAND_MAX + 1.0)) {
+        c ^= (uint8_t)(1U << (rand() & 7));
+    }
+    return c;
+}
+
+static void check(int ok, const char *what) {
+    if (!ok) {
+        printf("  FAILED: %s\n", what);
+        failures++;
+    }
+}
+
+/* A random app of size bytes (before the trailer), signed with key, encrypted for a transfer */
+static int make_image(struct image *im, uint32_t size, const char *key) {
+    struct image_header hdr = { IMAGE_MAGIC, size, 1U };
+
+    for (uint32_t i = 0; i < size; i++) {
+        im->plain[i] = (uint8_t)rand();
+    }
+    memcpy(&im->plain[IMAGE_HEADER_OFFSET], &hdr, sizeof(hdr));
+    im->size = size;
+    if (image_sign(im->plain, &im->size, key) != 0) {
+        return -1;
+    }
+    im->crc = crc32(0, im->plain, im->size);
+    for (uint32_t i = 0; i < AES_BLOCK; i++) {
+        im->iv[i] = (uint8_t)rand();
+    }
+    struct aes128 a;
+    aes128_init(&a, aes_key);
+    aes128_ctr_keystream(&a, im->iv, 0, im->data, sizeof(im->data) / AES_BLOCK);
+    for (uint32_t i = 0; i < im->size; i++) {
+        im->data[i] ^= im->plain[i];
+    }
+    return 0;
+}
+
+/*
+Boot the board: fn runs in a new process (fresh RAM, same flash) that loses power at
+the fail_at-th flash operation (0: never). Returns its exit status, SIM_EXIT_POWER
+for a power loss.
+*/
+static int boot(void (*fn)(const void *), const void *arg, uint32_t fail_at) {
+    fflush(stdout);
+    memset(report, 0, sizeof(*report));
+    pid_t pid = fork();
+    if (pid == 0) {
+        srand((unsigned)rand());
+        sim_power_fail(fail_at);
+        fn(arg);
+        report->stats = sim_stats;
+        _exit(0);
+    }
+    int status;
+    if (pid < 0 || waitpid(pid, &status, 0) != pid || !WIFEXITED(status)) {
+        return -1;
+    }
+    return WEXITSTATUS(status);
+}
+
+/* --- Boots --- */
+
+/* The app receives im, the host sends it (and the same 'U' again after a timeout) */
+static void transfer_boot(const void *arg) {
+    const struct image *im = arg;
+    static struct host h;
+    uint8_t rx[64];
+    int done = 0;
+
+    updater_init();
+    host_init(&h, im->data, im->size, im->crc, im->iv);
+    uint64_t start = sim_now();
+    uint64_t last = start;
+    uint64_t last_stall = start;
+    while (!h.result && sim_now() - start < 120U * SEC) {
+        while (h.tx_pos < h.tx_len) {
+            sim_rx(line(h.tx[h.tx_pos++]));
+        }
+        uint32_t n = sim_tx(rx, sizeof(rx));
+        for (uint32_t i = 0; i < n; i++) {
+            host_byte(&h, line(rx[i]));
+        }
+        last = n ? sim_now() : last;
+        if (sim_now() - last > (h.ready ? 1U : 3U) * SEC) {
+            host_timeout(&h);
+            last = sim_now();
+        }
+        if (h.ready && !report->ready_ns) {
+            report->ready_ns = sim_now() - start;
+            report->resumed = h.base;
+        }
+        // Done: the app resets (after the last erases, which may stall on pages the host
+        // still sends), the host gets its 'D'
+        if (!done) {
+            report->lost = sim_stats.overruns;
+            done = updater_poll() == UPDATER_DONE;
+        }
+        // Another page erase of the main loop (the event log's page: no update state there)
+        if (stall_ms && sim_now() - last_stall >= stall_ms * 1000000ULL) {
+            flash_erase_page(UPDATE_STATE + FLASH_PAGE_SIZE);
+            last_stall = sim_now();
+        }
+        sim_run(POLL_NS);
+    }
+    report->result = h.result;
+    report->elapsed_ns = sim_now() - start;
+    report->frames = h.frames;
+    report->resent = h.resent;
+    report->naks = h.naks;
+    report->timeouts = h.timeouts;
+}
+
+/* The bootloader's part (check_update() in bootloader.c), arg: the watchdog resets in a row it counted */
+static void bootloader_boot(const void *arg) {
+    report->rc = update_boot(*(const uint32_t *)arg, image_verify);
+    report->elapsed_ns = sim_now();
+}
+
+static void confirm_boot(const void *arg) {
+    (void)arg;
+    report->rc = update_confirm();
+}
+
+/* Boot fn until it completes (arg: a power-on reset starts the watchdog reset count over), losing power at a random one of its first max_ops flash operations each time */
+static int boot_until_done(void (*fn)(const void *), const void *arg, uint32_t max_ops, uint32_t *losses, double *seconds) {
+    *losses = 0;
+    *seconds = 0;
+    for (int i = 0; i < 50; i++) {
+        // Fewer power losses as it goes, so it finishes
+        uint32_t fail_at = i < 8 ? 1U + (uint32_t)rand() % max_ops : 0U;
+        int status = boot(fn, arg, fail_at);
+        if (status != SIM_EXIT_POWER) {
+            *seconds += report->elapsed_ns / 1e9;
+            return status;
+        }
+        (*losses)++;
+    }
+    return -1;
+}
+
+/* --- Scenarios --- */
+
+static int slot_is(uint32_t slot, const struct image *im) {
+    return memcmp((const void *)(uintptr_t)slot, im->plain, im->size) == 0;
+}
+
+/* The pages an install of update swaps: old in slot B up to there (the rest of slot A stays old) */
+static int slot_b_has_old(const struct image *old, const struct image *update) {
+    uint32_t swapped = (update->size + LINK_PAGE - 1U) / LINK_PAGE * LINK_PAGE;
+    uint32_t len = old->size < swapped ? old->size : swapped;
+
+    return memcmp((const void *)(uintptr_t)UPDATE_SLOT_B, old->plain, len) == 0 &&
+        memcmp((const void *)(uintptr_t)(UPDATE_SLOT_A + len), &old->plain[len], old->size - len) == 0;
+}
+
+static void bench(struct image *im) {
+    static const double rates[] = { 0, 1e-5, 1e-4, 1e-3 };
+    double given = errors;
+
+    printf("bench: %u byte image, window %u\n", im->size, UPDATER_WINDOW);
+    for (uint32_t i = 0; i < sizeof(rates) / sizeof(rates[0]); i++) {
+        errors = given > 0 ? given : rates[i];
+        sim_flash_clear();
+        memset((void *)(uintptr_t)UPDATE_SLOT_B, 0, UPDATE_SLOT_SIZE); // an earlier image: erased first
+        int status = boot(transfer_boot, im, 0);
+        struct report *r = report;
+        double from_r = (r->elapsed_ns - r->ready_ns) / 1e9;
+        printf("  errors %-6g %.2f s (%.2f s to ready), %3.0f%% line efficiency, %u pages sent, %u resent, "
+            "%u timeouts, %u bytes lost, %u erases\n", errors, r->elapsed_ns / 1e9, r->ready_ns / 1e9,
+            100.0 * im->size * SIM_BYTE_NS / 1e9 / from_r, r->frames, r->resent, r->timeouts,
+            r->lost, r->stats.erases);
+        check(status == 0 && r->result == 1, "transfer done");
+        check(slot_is(UPDATE_SLOT_B, im) && update_get_state(NULL) == UPDATE_PENDING, "slot B pending");
+        check(r->lost == 0, "no bytes lost to flash stalls");
+        if (given > 0) {
+            break;
+        }
+    }
+    errors = given;
+}
+
+static void resume(struct image *im, int runs) {
+    uint32_t pages = (im->size + LINK_PAGE - 1U) / LINK_PAGE;
+    uint32_t ops = pages * (1U + LINK_PAGE / 2U); // erases and half-words of a transfer
+
+    printf("resume: %d transfers of %u bytes, power lost at random flash operations\n", runs, im->size);
+    for (int run = 0; run < runs; run++) {
+        char resumed[128] = "";
+        uint32_t losses = 0;
+        int status;
+
+        sim_flash_clear();
+        for (int i = 0; i < 20; i++) {
+            uint32_t fail_at = i < 4 ? 1U + (uint32_t)rand() % ops : 0U;
+            status = boot(transfer_boot, im, fail_at);
+            if (i > 0 && strlen(resumed) < sizeof(resumed) - 8U) {
+                snprintf(&resumed[strlen(resumed)], sizeof(resumed) - strlen(resumed), " %u", report->resumed);
+            }
+            if (status != SIM_EXIT_POWER) {
+                break;
+            }
+            losses++;
+        }
+        printf("  run %2d: %u power losses, continued from pages%s, %s\n", run, losses, losses ? resumed : " -",
+            report->result == 1 ? "done" : "not done");
+        check(status == 0 && report->result == 1, "transfer done");
+        check(slot_is(UPDATE_SLOT_B, im) && update_get_state(NULL) == UPDATE_PENDING, "slot B pending");
+    }
+}
+
+static void stall(struct image *im) {
+    printf("stall: %u byte image, the main loop erasing a page every 100 ms\n", im->size);
+    sim_flash_clear();
+    stall_ms = 100U;
+    int status = boot(transfer_boot, im, 0);
+    stall_ms = 0;
+    printf("  %.2f s, %u pages sent, %u resent, %u naks, %u timeouts, %u bytes lost to the erases\n",
+        report->elapsed_ns / 1e9, report->frames, report->resent, report->naks, report->timeouts, report->lost);
+    check(status == 0 && report->result == 1, "transfer done");
+    check(slot_is(UPDATE_SLOT_B, im) && update_get_state(NULL) == UPDATE_PENDING, "slot B pending");
+    check(report->lost > 0, "bytes lost to the erases");
+}
+
+/* Factory state: old in slot A, nothing pending. Then new transferred into slot B. */
+static int prepare_update(const struct image *old, const struct image *new) {
+    sim_flash_clear();
+    memcpy((void *)(uintptr_t)UPDATE_SLOT_A, old->plain, old->size);
+    return boot(transfer_boot, new, 0) == 0 && report->result == 1 ? 0 : -1;
+}
+
+static void rollback(struct image *old, struct image *new) {
+    uint32_t pages = (new->size + LINK_PAGE - 1U) / LINK_PAGE;
+    uint32_t ops = pages * 3U * (1U + LINK_PAGE / 2U + 1U); // 3 page copies and a flag per page
+    uint32_t no_resets = 0;
+    uint32_t wdg_resets = 0;
+    uint32_t started = 0;
+    uint32_t losses;
+    double seconds;
+    int status;
+
+    printf("rollback: %u byte app in slot A, %u byte update\n", old->size, new->size);
+    check(prepare_update(old, new) == 0, "transfer");
+    status = boot_until_done(bootloader_boot, &no_resets, ops, &losses, &seconds);
+    printf("  install: %u power losses, %.1f s of flash work in the last boot\n", losses, seconds);
+    check(status == 0 && report->rc == UPDATE_BOOT_INSTALLED && update_get_state(NULL) == UPDATE_TESTING,
+        "installed, testing");
+    check(slot_is(UPDATE_SLOT_A, new) && slot_b_has_old(old, new), "slots swapped");
+
+    // Another transfer before the new app confirms must not touch the previous one in slot B
+    boot(transfer_boot, old, 0);
+    printf("  transfer while on trial: %s\n", report->result == -1 ? "refused" : "accepted");
+    check(report->result == -1 && slot_b_has_old(old, new) && update_get_state(NULL) == UPDATE_TESTING,
+        "transfer refused while on trial");
+
+    // The new app never confirms: each boot that starts it ends in a watchdog reset (counted
+    // as the bootloader does, a power loss starts the count over) until it's reverted
+    losses = 0;
+    for (int i = 0; i < 50 && update_get_state(NULL) != UPDATE_REVERTED; i++) {
+        uint32_t fail_at = i < 16 && rand() % 2 ? 1U + (uint32_t)rand() % ops : 0U;
+        status = boot(bootloader_boot, &wdg_resets, fail_at);
+        if (status == SIM_EXIT_POWER) {
+            losses++;
+            wdg_resets = 0;
+        }
+        else if (status == 0 && (report->rc == UPDATE_BOOT_INSTALLED || report->rc == UPDATE_BOOT_TESTING)) {
+            started++;
+            wdg_resets++;
+        }
+        else {
+            break; // the app isn't started without the button: nothing more happens
+        }
+    }
+    printf("  revert: new app started %u times unconfirmed, %u power losses, %.1f s of flash work in the last boot\n",
+        started, losses, report->elapsed_ns / 1e9);
+    check(status == 0 && report->rc == UPDATE_BOOT_REVERTED && update_get_state(NULL) == UPDATE_REVERTED, "reverted");
+    check(started >= UPDATE_MAX_WDG_RESETS, "new app started until its watchdog resets add up");
+    check(slot_is(UPDATE_SLOT_A, old), "old app back in slot A");
+
+    // Same update, confirmed this time
+    check(prepare_update(old, new) == 0, "transfer");
+    status = boot_until_done(bootloader_boot, &no_resets, ops, &losses, &seconds);
+    check(status == 0 && report->rc == UPDATE_BOOT_INSTALLED, "installed");
+    boot(confirm_boot, NULL, 0);
+    printf("  install and confirm: %u power losses, %s\n", losses,
+        update_get_state(NULL) == UPDATE_CONFIRMED ? "confirmed" : "not confirmed");
+    check(update_get_state(NULL) == UPDATE_CONFIRMED && slot_is(UPDATE_SLOT_A, new), "new app confirmed");
+}
+
+static void refuse(struct image *old, struct image *other) {
+    printf("refuse: update signed with another key\n");
+    check(prepare_update(old, other) == 0, "transfer");
+    uint32_t no_resets = 0;
+    boot(bootloader_boot, &no_resets, 0);
+    printf("  install: %s, state %d\n", report->rc == UPDATE_BOOT_INSTALLED ? "installed" : "refused",
+        update_get_state(NULL));
+    check(report->rc == UPDATE_BOOT_FAILED && update_get_state(NULL) == UPDATE_NONE, "refused and forgotten");
+    check(slot_is(UPDATE_SLOT_A, old), "old app untouched");
+}
+
+/* --- Command line --- */
+
+static int usage(void) {
+    fprintf(stderr, "usage: devsim [-e errors] [-n runs] [-r seed] [-f flash.bin] [-k signing_key.pem] "
+        "[bench|resume|stall|rollback|all]\n");
+    return 2;
+}
+
+int main(int argc, char **argv) {
+    static struct image big;
+    static struct image old;
+    static struct image new;
+    static struct image other;
+    const char *flash = "output/devsim_flash.bin";
+    const char *what = "all";
+    int runs = 10;
+    int i = 1;
+
+    srand(1);
+    for (; i + 1 < argc && argv[i][0] == '-'; i += 2) {
+        if (strcmp(argv[i], "-e") == 0) {
+            errors = atof(argv[i + 1]);
+        }
+        else if (strcmp(argv[i], "-n") == 0) {
+            runs = atoi(argv[i + 1]);
+        }
+        else if (strcmp(argv[i], "-r") == 0) {
+            srand((unsigned)strtoul(argv[i + 1], NULL, 0));
+        }
+        else if (strcmp(argv[i], "-f") == 0) {
+            flash = argv[i + 1];
+        }
+        else if (strcmp(argv[i], "-k") == 0) {
+            sign_key = argv[i + 1];
+        }
+        else {
+            return usage();
+        }
+    }
+    if (i + 1 == argc) {
+        what = argv[i];
+    }
+    else if (i != argc) {
+        return usage();
+    }
+    int all = strcmp(what, "all") == 0;
+    if (!all && strcmp(what, "bench") != 0 && strcmp(what, "resume") != 0 && strcmp(what, "stall") != 0 &&
+        strcmp(what, "rollback") != 0) {
+        return usage();
+    }
+
+    report = mmap(NULL, sizeof(*report), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (report == MAP_FAILED || sim_init(flash) != 0) {
+        return 1;
+    }
+    if (make_image(&big, UPDATE_SLOT_SIZE - sizeof(struct image_trailer), sign_key) != 0 ||
+        make_image(&old, 40000U, sign_key) != 0 || make_image(&new, 30000U, sign_key) != 0) {
+        return 1;
+    }
+
+    if (all || strcmp(what, "bench") == 0) {
+        bench(&big);
+    }
+    if (all || strcmp(what, "resume") == 0) {
+        resume(&big, runs);
+    }
+    if (all || strcmp(what, "stall") == 0) {
+        stall(&big);
+    }
+    if (all || strcmp(what, "rollback") == 0) {
+        // Another key: a throwaway one from openssl
+        char key[] = "/tmp/devsim_key_XXXXXX";
+        char cmd[128];
+        int fd = mkstemp(key);
+        snprintf(cmd, sizeof(cmd), "openssl genpkey -algorithm ed25519 -out '%s' 2>/dev/null", key);
+        if (fd < 0 || system(cmd) != 0 || make_image(&other, 30000U, key) != 0) {
+            fprintf(stderr, "can't make a key\n");
+            return 1;
+        }
+        close(fd);
+        unlink(key);
+        rollback(&old, &new);
+        refuse(&old, &other);
+    }
+    printf(failures ? "%d checks FAILED\n" : "all checks passed\n", failures);
+    return failures ? 1 : 0;
+}
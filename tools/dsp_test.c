@@ -0,0 +1,298 @@
+/*
+The fixed-point DSP kernels (dsp.h) against a double precision reference, bit for bit
+
+    dsp_test [-n runs] [-r seed]
+
+Each run draws random inputs, lengths, block sizes and coefficients (full scale and
+attenuated, so saturation is hit as well as missed) and feeds them through:
+- dsp_fir_q15 / dsp_fir_q31: several blocks of random sizes (odd and even, and odd
+  and even tap counts: every path of the pairwise loop), state kept across blocks
+- dsp_biquad_q15: 1 .. 4 stages, stable and unstable (saturating) coefficients
+- dsp_movavg_q15: windows of 1 .. 64 samples over several blocks
+- dsp_rms_q15, dsp_dot_q15, dsp_dot_q31: 0 .. 300 elements
+
+The reference is the plain formula in double, filtering the whole signal at once,
+then the kernel's rounding (half an LSB up, then floor) and saturation. Every
+intermediate of the Q15 kernels fits in the 53 bits of a double, so those compare
+exactly. Q31 products need 62 bits: their sums are formed in 128-bit integers
+instead. The exit status is 0 when every output matched.
+
+Build (host): cc -O2 -Wall -Wextra -I. tools/dsp_test.c dsp.c -lm -o output/dsp_test
+*/
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "dsp.h"
+
+#define SIGNAL_LEN 256U
+#define MAX_TAPS 32U
+#define MAX_BLOCK 37U
+#define MAX_STAGES 4U
+#define MAX_WINDOW 64U
+#define MAX_VECTOR 300U
+
+static int failures;
+
+// Count a mismatch, print the first 20
+static void check(const char *kernel, uint32_t run, uint32_t i, int64_t got, int64_t want) {
+    static int printed;
+
+    if (got != want) {
+        if (printed++ < 20) {
+            printf("  FAILED: %s run %u, output %u: %lld, reference %lld\n", kernel, run, i, (long long)got, (long long)want);
+        }
+        failures++;
+    }
+}
+
+/* --- Random inputs --- */
+
+static int32_t rnd32(void) {
+    return (int32_t)(((uint32_t)rand() << 16) ^ (uint32_t)rand());
+}
+
+static uint32_t rnd_range(uint32_t lo, uint32_t hi) {
+    return lo + (uint32_t)rand() % (hi - lo + 1U);
+}
+
+// Full scale, or attenuated by a random number of bits
+static q15_t rnd_q15(uint32_t shift) {
+    return (q15_t)((int16_t)rnd32() >> shift);
+}
+
+static q31_t rnd_q31(uint32_t shift) {
+    return rnd32() >> shift;
+}
+
+/* --- Reference rounding: (acc + half an LSB) >> shift, saturated to bits --- */
+
+static int64_t ref_round(double acc, int shift, int bits) {
+    double v = floor((acc + ldexp(1.0, shift - 1)) / ldexp(1.0, shift));
+    double max = ldexp(1.0, bits - 1) - 1.0;
+
+    return (int64_t)(v > max ? max : (v < -max - 1.0 ? -max - 1.0 : v));
+}
+
+static int64_t ref_round128(__int128 acc, int shift) {
+    __int128 v = (acc + ((__int128)1 << (shift - 1))) >> shift;
+
+    return v > INT32_MAX ? INT32_MAX : (v < INT32_MIN ? INT32_MIN : (int64_t)v);
+}
+
+/* --- Kernels --- */
+
+static void test_fir_q15(uint32_t run) {
+    static q15_t x[SIGNAL_LEN], y[SIGNAL_LEN], coeffs[MAX_TAPS], state[MAX_TAPS + MAX_BLOCK - 1U];
+    struct dsp_fir_q15 f;
+    uint16_t taps = (uint16_t)rnd_range(1U, MAX_TAPS);
+    uint32_t shift = rnd_range(0U, 8U);
+
+    for (uint32_t k = 0; k < taps; k++) {
+        coeffs[k] = rnd_q15(rnd_range(0U, 6U));
+    }
+    for (uint32_t n = 0; n < SIGNAL_LEN; n++) {
+        x[n] = rnd_q15(shift);
+    }
+
+    dsp_fir_q15_init(&f, taps, coeffs, state, MAX_BLOCK);
+    for (uint32_t n = 0; n < SIGNAL_LEN;) {
+        uint32_t block = rnd_range(1U, MAX_BLOCK);
+        if (block > SIGNAL_LEN - n) {
+            block = SIGNAL_LEN - n;
+        }
+        dsp_fir_q15(&f, &x[n], &y[n], block);
+        n += block;
+    }
+
+    // coeffs are time reversed: coeffs[taps - 1] is b[0], it multiplies x[n]
+    for (uint32_t n = 0; n < SIGNAL_LEN; n++) {
+        double acc = 0.0;
+        for (uint32_t k = 0; k < taps; k++) {
+            int32_t t = (int32_t)n - (int32_t)(taps - 1U) + (int32_t)k;
+            acc += t < 0 ? 0.0 : (double)coeffs[k] * x[t];
+        }
+        check("fir_q15", run, n, y[n], ref_round(acc, 15, 16));
+    }
+}
+
+static void test_fir_q31(uint32_t run) {
+    static q31_t x[SIGNAL_LEN], y[SIGNAL_LEN], coeffs[MAX_TAPS], state[MAX_TAPS + MAX_BLOCK - 1U];
+    struct dsp_fir_q31 f;
+    uint16_t taps = (uint16_t)rnd_range(1U, MAX_TAPS);
+    // No guard bits (dsp.h): the input is scaled down by log2(taps) bits. One bit less
+    // still can't overflow the accumulator but can saturate the output: a full scale DC
+    // input through positive coefficients does.
+    uint32_t shift = taps > 1U ? 31U - (uint32_t)__builtin_clz(taps - 1U) : 0U;
+    int dc = rand() % 4 == 0;
+
+    for (uint32_t k = 0; k < taps; k++) {
+        coeffs[k] = dc ? INT32_MAX - (rnd32() & 0xFFFFFF) : rnd_q31(rnd_range(0U, 6U));
+    }
+    for (uint32_t n = 0; n < SIGNAL_LEN; n++) {
+        x[n] = dc ? INT32_MAX >> shift : rnd_q31(shift + 1U + rnd_range(0U, 8U));
+    }
+
+    dsp_fir_q31_init(&f, taps, coeffs, state, MAX_BLOCK);
+    for (uint32_t n = 0; n < SIGNAL_LEN;) {
+        uint32_t block = rnd_range(1U, MAX_BLOCK);
+        if (block > SIGNAL_LEN - n) {
+            block = SIGNAL_LEN - n;
+        }
+        dsp_fir_q31(&f, &x[n], &y[n], block);
+        n += block;
+    }
+
+    for (uint32_t n = 0; n < SIGNAL_LEN; n++) {
+        __int128 acc = 0;
+        for (uint32_t k = 0; k < taps; k++) {
+            int32_t t = (int32_t)n - (int32_t)(taps - 1U) + (int32_t)k;
+            acc += t < 0 ? 0 : (int64_t)coeffs[k] * x[t];
+        }
+        check("fir_q31", run, n, y[n], ref_round128(acc, 31));
+    }
+}
+
+static void test_biquad_q15(uint32_t run) {
+    static q15_t x[SIGNAL_LEN], y[SIGNAL_LEN], coeffs[5U * MAX_STAGES], state[4U * MAX_STAGES];
+    static double ref[SIGNAL_LEN];
+    struct dsp_biquad_q15 f;
+    uint8_t stages = (uint8_t)rnd_range(1U, MAX_STAGES);
+    uint32_t shift = rnd_range(0U, 8U);
+
+    for (uint32_t i = 0; i < 5U * stages; i++) {
+        coeffs[i] = rnd_q15(rnd_range(0U, 4U)); // Q14: [-2, 2) at full scale
+    }
+    for (uint32_t n = 0; n < SIGNAL_LEN; n++) {
+        x[n] = rnd_q15(shift);
+        ref[n] = x[n];
+    }
+
+    dsp_biquad_q15_init(&f, stages, coeffs, state);
+    for (uint32_t n = 0; n < SIGNAL_LEN;) {
+        uint32_t block = rnd_range(1U, MAX_BLOCK);
+        if (block > SIGNAL_LEN - n) {
+            block = SIGNAL_LEN - n;
+        }
+        dsp_biquad_q15(&f, &x[n], &y[n], block);
+        n += block;
+    }
+
+    // Stage by stage over the whole signal, each output rounded to Q15 as the kernel does
+    for (uint32_t s = 0; s < stages; s++) {
+        const q15_t *c = &coeffs[5U * s];
+        double x1 = 0.0, x2 = 0.0, y1 = 0.0, y2 = 0.0;
+
+        for (uint32_t n = 0; n < SIGNAL_LEN; n++) {
+            double x0 = ref[n];
+            double acc = c[0] * x0 + c[1] * x1 + c[2] * x2 + c[3] * y1 + c[4] * y2;
+
+            x2 = x1;
+            x1 = x0;
+            y2 = y1;
+            y1 = (double)ref_round(acc, 14, 16);
+            ref[n] = y1;
+        }
+    }
+    for (uint32_t n = 0; n < SIGNAL_LEN; n++) {
+        check("biquad_q15", run, n, y[n], (int64_t)ref[n]);
+    }
+}
+
+static void test_movavg_q15(uint32_t run) {
+    static q15_t x[SIGNAL_LEN], y[SIGNAL_LEN], history[MAX_WINDOW];
+    struct dsp_movavg_q15 m;
+    uint16_t length = (uint16_t)rnd_range(1U, MAX_WINDOW);
+    uint32_t shift = rnd_range(0U, 8U);
+
+    for (uint32_t n = 0; n < SIGNAL_LEN; n++) {
+        x[n] = rnd_q15(shift);
+    }
+
+    dsp_movavg_q15_init(&m, history, length);
+    for (uint32_t n = 0; n < SIGNAL_LEN;) {
+        uint32_t block = rnd_range(1U, MAX_BLOCK);
+        if (block > SIGNAL_LEN - n) {
+            block = SIGNAL_LEN - n;
+        }
+        dsp_movavg_q15(&m, &x[n], &y[n], block);
+        n += block;
+    }
+
+    // The mean of the last length samples (zeros before the first), truncated like SDIV
+    for (uint32_t n = 0; n < SIGNAL_LEN; n++) {
+        double sum = 0.0;
+        for (uint32_t k = 0; k < length && k <= n; k++) {
+            sum += x[n - k];
+        }
+        check("movavg_q15", run, n, y[n], (int64_t)trunc(sum / length));
+    }
+}
+
+static void test_vectors(uint32_t run) {
+    static q15_t a15[MAX_VECTOR], b15[MAX_VECTOR];
+    static q31_t a31[MAX_VECTOR], b31[MAX_VECTOR];
+    uint32_t n = rnd_range(0U, MAX_VECTOR);
+    uint32_t shift = rnd_range(0U, 8U);
+    double dot15 = 0.0;
+    int64_t dot31 = 0;
+
+    for (uint32_t i = 0; i < n; i++) {
+        a15[i] = rnd_q15(shift);
+        b15[i] = rnd_q15(rnd_range(0U, 8U));
+        a31[i] = rnd_q31(shift);
+        b31[i] = rnd_q31(rnd_range(0U, 8U));
+        dot15 += (double)a15[i] * b15[i];
+        dot31 += ((int64_t)a31[i] * b31[i]) >> 14; // floor, per product (dsp.h)
+    }
+    check("dot_q15", run, n, dsp_dot_q15(a15, b15, n), (int64_t)dot15);
+    check("dot_q31", run, n, dsp_dot_q31(a31, b31, n), dot31);
+
+    // floor(sqrt(floor(mean of the squares))), in Q15
+    double squares = 0.0;
+    for (uint32_t i = 0; i < n; i++) {
+        squares += (double)a15[i] * a15[i];
+    }
+    double rms = n ? floor(sqrt(floor(squares / n))) : 0.0;
+    check("rms_q15", run, n, dsp_rms_q15(a15, n), (int64_t)(rms > 32767.0 ? 32767.0 : rms));
+}
+
+/* --- Command line --- */
+
+static int usage(void) {
+    fprintf(stderr, "usage: dsp_test [-n runs] [-r seed]\n");
+    return 2;
+}
+
+int main(int argc, char **argv) {
+    int runs = 1000;
+    int i = 1;
+
+    srand(1);
+    for (; i + 1 < argc && argv[i][0] == '-'; i += 2) {
+        if (strcmp(argv[i], "-n") == 0) {
+            runs = atoi(argv[i + 1]);
+        }
+        else if (strcmp(argv[i], "-r") == 0) {
+            srand((unsigned)strtoul(argv[i + 1], NULL, 0));
+        }
+        else {
+            return usage();
+        }
+    }
+    if (i != argc) {
+        return usage();
+    }
+
+    for (uint32_t run = 0; run < (uint32_t)runs; run++) {
+        test_fir_q15(run);
+        test_fir_q31(run);
+        test_biquad_q15(run);
+        test_movavg_q15(run);
+        test_vectors(run);
+    }
+    printf("fir_q15, fir_q31, biquad_q15, movavg_q15, rms_q15, dot_q15, dot_q31: %d runs\n", runs);
+    printf(failures ? "%d outputs FAILED\n" : "all outputs matched\n", failures);
+    return failures ? 1 : 0;
+}
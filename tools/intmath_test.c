@@ -0,0 +1,233 @@
+/*
+The intmath.h helpers and their naive forms (intmath_ref.c) against exact host arithmetic
+
+    intmath_test [-n count] [-r seed]
+
+- imath_log2 / imath_log2_ceil: every power of two and its neighbours, random values
+- imath_sqrt32: every perfect square and its neighbours, random values
+- imath_udiv64: random dividends and divisors with hi < d, against 64-bit division
+- imath_recip_div: random and edge divisors (2, 3, powers of two, 2^32 - 1) and
+  dividends (0, 2^32 - 1, multiples of d and their neighbours); IMATH_RECIP() must
+  give what imath_recip_init() does
+- imath_sat_add / sub, s32 and u32: random values and the limits, against 64-bit sums
+- the naive forms against the same references
+
+count (default 1000000) is the number of random values per check. Then the benchmark
+loops of bench.c run on the host, ns per call: only the relative cost on this machine,
+the M3's cycles come from a BENCH=1 build (bench.h). The exit status is 0 when every check passed.
+
+Build (host): cc -O2 -Wall -Wextra -I. tools/intmath_test.c intmath_ref.c -o output/intmath_test
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "intmath.h"
+
+#define BENCH_INPUTS 256U
+#define BENCH_ROUNDS 4000U
+
+static int failures;
+
+static void check(int ok, const char *what, uint32_t a, uint32_t b) {
+    static int printed;
+
+    if (!ok) {
+        if (printed++ < 20) {
+            printf("  FAILED: %s (0x%08X, 0x%08X)\n", what, a, b);
+        }
+        failures++;
+    }
+}
+
+static uint32_t rnd32(void) {
+    return ((uint32_t)rand() << 16) ^ (uint32_t)rand();
+}
+
+// Random value of random bit length
+static uint32_t rnd_width(void) {
+    return rnd32() >> (rand() & 31);
+}
+
+static uint32_t ref_isqrt(uint32_t x) {
+    uint64_t r = 0;
+
+    for (uint64_t bit = 1U << 15; bit; bit >>= 1) {
+        if ((r + bit) * (r + bit) <= x) {
+            r += bit;
+        }
+    }
+    return (uint32_t)r;
+}
+
+/* --- Checks --- */
+
+static void test_log2(uint32_t x) {
+    uint32_t l = 0;
+
+    while (l < 31U && (2ULL << l) <= x) {
+        l++;
+    }
+    check(imath_log2(x) == l, "imath_log2", x, l);
+    check(imath_log2_ref(x) == l, "imath_log2_ref", x, l);
+    check(imath_log2_ceil(x) == l + ((x & (x - 1U)) != 0), "imath_log2_ceil", x, l);
+}
+
+static void test_sqrt32(uint32_t x) {
+    uint32_t r = ref_isqrt(x);
+
+    check(imath_sqrt32(x) == r, "imath_sqrt32", x, r);
+    check(imath_sqrt32_ref(x) == r, "imath_sqrt32_ref", x, r);
+}
+
+static void test_udiv64(uint32_t hi, uint32_t lo, uint32_t d) {
+    uint32_t q = (uint32_t)((((uint64_t)hi << 32) | lo) / d);
+
+    check(imath_udiv64(hi, lo, d) == q, "imath_udiv64", hi, d);
+    check(imath_udiv64_ref(hi, lo, d) == q, "imath_udiv64_ref", hi, d);
+}
+
+static void test_recip(uint32_t d, uint32_t count) {
+    struct imath_recip r = imath_recip_init(d);
+    const uint32_t edges[] = { 0U, 1U, d - 1U, d, d + 1U, 0xFFFFFFFFU, 0xFFFFFFFFU - d, 0x80000000U };
+
+    for (uint32_t i = 0; i < sizeof(edges) / sizeof(edges[0]); i++) {
+        check(imath_recip_div(edges[i], r) == edges[i] / d, "imath_recip_div", edges[i], d);
+    }
+    for (uint32_t i = 0; i < count; i++) {
+        uint32_t x = rnd32();
+        uint32_t m = x - x % d; // a multiple of d
+        check(imath_recip_div(x, r) == x / d, "imath_recip_div", x, d);
+        check(imath_recip_div(m, r) == m / d, "imath_recip_div", m, d);
+        check(m == 0 || imath_recip_div(m - 1U, r) == (m - 1U) / d, "imath_recip_div", m - 1U, d);
+    }
+}
+
+static int32_t clamp_s32(int64_t v) {
+    return v > INT32_MAX ? INT32_MAX : v < INT32_MIN ? INT32_MIN : (int32_t)v;
+}
+
+static void test_sat(uint32_t a, uint32_t b) {
+    int32_t sa = (int32_t)a;
+    int32_t sb = (int32_t)b;
+
+    check(imath_sat_add_s32(sa, sb) == clamp_s32((int64_t)sa + sb), "imath_sat_add_s32", a, b);
+    check(imath_sat_add_s32_ref(sa, sb) == clamp_s32((int64_t)sa + sb), "imath_sat_add_s32_ref", a, b);
+    check(imath_sat_sub_s32(sa, sb) == clamp_s32((int64_t)sa - sb), "imath_sat_sub_s32", a, b);
+    check(imath_sat_add_u32(a, b) == ((uint64_t)a + b > 0xFFFFFFFFU ? 0xFFFFFFFFU : a + b), "imath_sat_add_u32", a, b);
+    check(imath_sat_sub_u32(a, b) == (a < b ? 0U : a - b), "imath_sat_sub_u32", a, b);
+    check(IMATH_SSAT(sa, 16) == (sa > 32767 ? 32767 : sa < -32768 ? -32768 : sa), "IMATH_SSAT", a, 16U);
+    check(IMATH_USAT(sa, 8) == (sa > 255 ? 255 : sa < 0 ? 0 : sa), "IMATH_USAT", a, 8U);
+}
+
+/* --- Benchmark --- */
+
+static double now_ns(void) {
+    struct timespec t;
+
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec * 1e9 + t.tv_nsec;
+}
+
+static double bench(enum imath_bench helper, int ref, const struct imath_bench_input *in, uint32_t *sum) {
+    volatile uint32_t sink = 0;
+    double t = now_ns();
+
+    for (uint32_t k = 0; k < BENCH_ROUNDS; k++) {
+        sink += imath_bench_run(helper, ref, in, BENCH_INPUTS);
+    }
+    t = now_ns() - t;
+    *sum = imath_bench_run(helper, ref, in, BENCH_INPUTS);
+    return t / ((double)BENCH_ROUNDS * BENCH_INPUTS);
+}
+
+/* --- Command line --- */
+
+static int usage(void) {
+    fprintf(stderr, "usage: intmath_test [-n count] [-r seed]\n");
+    return 2;
+}
+
+int main(int argc, char **argv) {
+    static const char *const names[IMATH_BENCH_COUNT] = {
+        "loop", "imath_log2", "imath_sqrt32", "imath_udiv64", "imath_recip_div", "imath_sat_add_s32",
+    };
+    static struct imath_bench_input in[BENCH_INPUTS];
+    uint32_t count = 1000000U;
+    int i = 1;
+
+    srand(1);
+    for (; i + 1 < argc && argv[i][0] == '-'; i += 2) {
+        if (strcmp(argv[i], "-n") == 0) {
+            count = (uint32_t)strtoul(argv[i + 1], NULL, 0);
+        }
+        else if (strcmp(argv[i], "-r") == 0) {
+            srand((unsigned)strtoul(argv[i + 1], NULL, 0));
+        }
+        else {
+            return usage();
+        }
+    }
+    if (i != argc) {
+        return usage();
+    }
+
+    for (uint32_t k = 0; k < 32U; k++) {
+        uint32_t p = 1U << k;
+        test_log2(p);
+        test_log2(p + 1U);
+        if (p > 1U) {
+            test_log2(p - 1U);
+        }
+    }
+    for (uint32_t r = 0; r <= 0xFFFFU; r++) {
+        uint32_t sq = r * r;
+        test_sqrt32(sq);
+        test_sqrt32(sq - 1U);
+        test_sqrt32(sq + 1U);
+    }
+    test_sqrt32(0xFFFFFFFFU);
+    for (uint32_t k = 0; k < count; k++) {
+        uint32_t d = rnd_width() | 1U;
+        test_log2(rnd_width() | 1U);
+        test_sqrt32(rnd_width());
+        test_udiv64(rnd32() % d, rnd32(), d);
+        test_sat(rnd_width() ^ (rand() & 1 ? 0xFFFFFFFFU : 0U), rnd_width() ^ (rand() & 1 ? 0xFFFFFFFFU : 0U));
+    }
+    test_udiv64(0xFFFFFFFEU, 0xFFFFFFFFU, 0xFFFFFFFFU);
+    test_udiv64(0, 0xFFFFFFFFU, 1U);
+    const uint32_t limits[] = { 0U, 1U, 0x7FFFFFFFU, 0x80000000U, 0xFFFFFFFFU };
+    for (uint32_t a = 0; a < 5U; a++) {
+        for (uint32_t b = 0; b < 5U; b++) {
+            test_sat(limits[a], limits[b]);
+        }
+    }
+
+    const uint32_t divisors[] = { 2U, 3U, 5U, 7U, 10U, 1000U, 0x10000U, 0x80000000U, 0x80000001U, 0xFFFFFFFFU };
+    for (uint32_t k = 0; k < sizeof(divisors) / sizeof(divisors[0]); k++) {
+        test_recip(divisors[k], count / 100U);
+    }
+    for (uint32_t k = 0; k < 1000U; k++) {
+        test_recip(rnd_width() | 2U, count / 1000U);
+    }
+    const struct imath_recip r7 = IMATH_RECIP(7U), r1000 = IMATH_RECIP(1000U), rmax = IMATH_RECIP(0xFFFFFFFFU);
+    const struct imath_recip i7 = imath_recip_init(7U), i1000 = imath_recip_init(1000U), imax = imath_recip_init(0xFFFFFFFFU);
+    check(r7.m == i7.m && r7.shift == i7.shift, "IMATH_RECIP", 7U, r7.m);
+    check(r1000.m == i1000.m && r1000.shift == i1000.shift, "IMATH_RECIP", 1000U, r1000.m);
+    check(rmax.m == imax.m && rmax.shift == imax.shift, "IMATH_RECIP", 0xFFFFFFFFU, rmax.m);
+
+    printf(failures ? "%d checks FAILED\n" : "all checks passed\n", failures);
+
+    // The benchmark of bench.c, on the host
+    imath_bench_inputs(in, BENCH_INPUTS, 1U);
+    printf("%-20s %10s %10s (ns per call, host)\n", "helper", "fast", "naive");
+    for (uint32_t h = 0; h < IMATH_BENCH_COUNT; h++) {
+        uint32_t sum, sum_ref;
+        double fast = bench((enum imath_bench)h, 0, in, &sum);
+        double naive = bench((enum imath_bench)h, 1, in, &sum_ref);
+        check(sum == sum_ref, names[h], sum, sum_ref);
+        printf("%-20s %10.2f %10.2f%s\n", names[h], fast, naive, sum == sum_ref ? "" : " MISMATCH");
+    }
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,216 @@
+/*
+The key-value store (kv.c) on the simulated flash, with power losses at random flash operations
+
+    kv_test [-n boots] [-r seed] [-f flash.bin]
+
+Every boot of the board is a forked process on the flash of sim.h (default
+output/kv_test_flash.bin, cleared first): kv_init(), read every key, then a list of
+random kv_set() / kv_delete() calls, with the power lost at a random one of the
+flash operations (half-word programs and page erases, in records, page headers and
+compactions) in 7 boots out of 8. The host keeps what the store must hold:
+- every key must read back as the last value whose call returned before the power
+  was lost
+- the one call cut short may have happened or not, but nothing else: the next boot
+  that reads the keys decides which, and the boots after it must agree
+The values are sized so the live data always fits in a page, so no call may fail on
+a boot that keeps its power, and no page's erase count may be above the erases done
+(a count lost to the power may be guessed high, never torn into garbage). The exit status is 0 when every check passed.
+
+Build (host): cc -O2 -Wall -Wextra -I. tools/kv_test.c tools/sim.c kv.c crc.c -o output/kv_test
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include "sim.h"
+#include "kv.h"
+
+#define KEYS 12U // keys 1 .. KEYS
+#define MAX_LEN 32U // 12 keys of at most 38 bytes of record: at most half a page live
+#define OPS 40U // calls per boot
+#define MAX_FAIL 1500U // the power fails at one of the first MAX_FAIL flash operations
+
+struct value {
+    uint16_t len; // 0: not stored
+    uint8_t data[MAX_LEN];
+};
+
+struct op {
+    uint16_t key;
+    struct value v; // len 0: kv_delete()
+};
+
+/* Shared with the boots */
+struct report {
+    struct op ops[OPS];
+    int init_rc;
+    uint32_t read; // 1: kv_init() returned and values holds every key
+    struct value values[KEYS + 1U];
+    uint32_t done; // calls that returned
+    int op_rc; // of the first one that failed
+    uint32_t erases; // the highest erase count of the store's pages
+    uint32_t sim_erases; // page erases done in this boot
+};
+
+static struct report *report;
+static int failures;
+
+static void check(int ok, const char *what, uint32_t boot, uint32_t key) {
+    if (!ok) {
+        if (failures < 20) {
+            printf("  FAILED: %s (boot %u, key %u)\n", what, boot, key);
+        }
+        failures++;
+    }
+}
+
+static int same(const struct value *a, const struct value *b) {
+    return a->len == b->len && memcmp(a->data, b->data, a->len) == 0;
+}
+
+/* --- The board --- */
+
+static void board(void) {
+    report->init_rc = kv_init();
+    report->sim_erases = sim_stats.erases;
+    if (report->init_rc != 0) {
+        return;
+    }
+    for (uint32_t key = 1; key <= KEYS; key++) {
+        int n = kv_get((uint16_t)key, report->values[key].data, MAX_LEN);
+        report->values[key].len = (uint16_t)(n < 0 ? 0 : n);
+    }
+    report->read = 1;
+    for (uint32_t i = 0; i < OPS; i++) {
+        const struct op *o = &report->ops[i];
+        int rc = o->v.len ? kv_set(o->key, o->v.data, o->v.len) : kv_delete(o->key);
+        if (rc != 0) {
+            report->op_rc = rc;
+            return;
+        }
+        report->done = i + 1U;
+        report->sim_erases = sim_stats.erases;
+    }
+    for (uint32_t page = 0; page < KV_NUM_PAGES; page++) {
+        if (kv_erase_count(page) > report->erases) {
+            report->erases = kv_erase_count(page);
+        }
+    }
+}
+
+/* Boot the board in a new process (fresh RAM, same flash) that loses power at the fail_at-th flash operation (0: never) */
+static int boot(uint32_t fail_at) {
+    fflush(stdout);
+    pid_t pid = fork();
+    if (pid == 0) {
+        srand((unsigned)rand());
+        sim_power_fail(fail_at);
+        board();
+        _exit(0);
+    }
+    int status;
+    if (pid < 0 || waitpid(pid, &status, 0) != pid || !WIFEXITED(status)) {
+        return -1;
+    }
+    return WEXITSTATUS(status);
+}
+
+// No line in this test: sim.c delivers received bytes to the updater's interrupt
+void USART2_IRQHandler(void) {
+}
+
+/* --- Command line --- */
+
+static int usage(void) {
+    fprintf(stderr, "usage: kv_test [-n boots] [-r seed] [-f flash.bin]\n");
+    return 2;
+}
+
+int main(int argc, char **argv) {
+    static struct value model[KEYS + 1U]; // what the store must hold
+    static struct op cut; // the call the power cut short, key 0: none
+    const char *flash = "output/kv_test_flash.bin";
+    uint32_t boots = 400U;
+    uint32_t losses = 0;
+    uint32_t erases = 0;
+    uint32_t sim_erases = 0;
+    int i = 1;
+
+    srand(1);
+    for (; i + 1 < argc && argv[i][0] == '-'; i += 2) {
+        if (strcmp(argv[i], "-n") == 0) {
+            boots = (uint32_t)strtoul(argv[i + 1], NULL, 0);
+        }
+        else if (strcmp(argv[i], "-r") == 0) {
+            srand((unsigned)strtoul(argv[i + 1], NULL, 0));
+        }
+        else if (strcmp(argv[i], "-f") == 0) {
+            flash = argv[i + 1];
+        }
+        else {
+            return usage();
+        }
+    }
+    if (i != argc) {
+        return usage();
+    }
+
+    report = mmap(NULL, sizeof(*report), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (report == MAP_FAILED || sim_init(flash) != 0) {
+        return 1;
+    }
+    sim_flash_clear();
+
+    printf("kv: %u boots of %u calls, the power lost at a random flash operation in 7 of 8\n", boots, OPS);
+    for (uint32_t b = 0; b < boots; b++) {
+        memset(report, 0, sizeof(*report));
+        for (uint32_t k = 0; k < OPS; k++) {
+            struct op *o = &report->ops[k];
+            o->key = (uint16_t)(1U + (uint32_t)rand() % KEYS);
+            o->v.len = (uint16_t)(rand() % 8 == 0 ? 0U : 1U + (uint32_t)rand() % MAX_LEN);
+            for (uint32_t j = 0; j < o->v.len; j++) {
+                o->v.data[j] = (uint8_t)rand();
+            }
+        }
+        // The last boot keeps its power: the store must end up consistent
+        uint32_t fail_at = b + 1U < boots && b % 8U != 7U ? 1U + (uint32_t)rand() % MAX_FAIL : 0U;
+        int status = boot(fail_at);
+
+        check(status == 0 || status == SIM_EXIT_POWER, "board crashed", b, 0);
+        if (status == 0) {
+            check(report->init_rc == 0, "kv_init failed", b, 0);
+            check(report->done == OPS, "a call failed", b, report->ops[report->done].key);
+            erases = report->erases;
+        }
+        else if (status == SIM_EXIT_POWER) {
+            losses++;
+        }
+        // Erases cut short by the power count on the flash but may be lost to the store
+        sim_erases += report->sim_erases + (status == SIM_EXIT_POWER);
+        if (status == 0) {
+            check(erases <= sim_erases, "erase count above the erases done", b, 0);
+        }
+
+        if (report->read) {
+            for (uint32_t key = 1; key <= KEYS; key++) {
+                const struct value *got = &report->values[key];
+                int ok = same(got, &model[key]) || (key == cut.key && same(got, &cut.v));
+                check(ok, key == cut.key ? "value of the cut call is neither old nor new" : "value lost", b, key);
+                model[key] = *got; // the cut call is decided: later boots must agree
+            }
+            cut.key = 0;
+        }
+        for (uint32_t k = 0; k < report->done; k++) {
+            model[report->ops[k].key] = report->ops[k].v;
+        }
+        if (status == SIM_EXIT_POWER && report->read && report->done < OPS) {
+            cut = report->ops[report->done];
+        }
+    }
+    printf("  %u power losses, %u erases of the most worn page by its count, %u done in all\n", losses, erases, sim_erases);
+    printf(failures ? "%d checks FAILED\n" : "all checks passed\n", failures);
+    return failures ? 1 : 0;
+}
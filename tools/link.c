@@ -0,0 +1,134 @@
+/*
+Host side of the windowed update link, see link.h
+*/
+
+#include <string.h>
+#include "link.h"
+#include "crc.h"
+
+static void host_frame(struct host *h, const uint8_t *f, uint32_t n) {
+    uint8_t raw[LINK_FRAME_MAX];
+    uint16_t crc = crc16_ccitt(CRC16_CCITT_INIT, f, n);
+
+    memcpy(raw, f, n);
+    raw[n] = (uint8_t)(crc >> 8);
+    raw[n + 1U] = (uint8_t)crc;
+    // Drop what's sent
+    memmove(h->tx, &h->tx[h->tx_pos], h->tx_len - h->tx_pos);
+    h->tx_len -= h->tx_pos;
+    h->tx_pos = 0;
+    if (h->tx_len + COBS_MAX(LINK_FRAME_MAX) + 1U > sizeof(h->tx)) {
+        return; // can't happen with LINK_QUEUE frames on their way
+    }
+    h->tx_len += cobs_encode(&h->tx[h->tx_len], raw, n + 2U);
+    h->tx[h->tx_len++] = 0;
+}
+
+static void host_begin(struct host *h) {
+    uint8_t f[1U + 24U] = { 'U' };
+
+    for (uint32_t i = 0; i < 4U; i++) {
+        f[1U + i] = (uint8_t)(h->size >> (8U * i));
+        f[5U + i] = (uint8_t)(h->crc >> (8U * i));
+    }
+    memcpy(&f[9], h->iv, sizeof(h->iv));
+    h->tx[h->tx_len++] = 0; // ends whatever the device got before
+    host_frame(h, f, sizeof(f));
+}
+
+static void host_send_page(struct host *h, uint32_t page) {
+    uint8_t f[2U + LINK_PAGE] = { 'P', (uint8_t)page };
+    uint32_t n = h->size - page * LINK_PAGE;
+
+    memcpy(&f[2], &h->data[page * LINK_PAGE], n < LINK_PAGE ? n : LINK_PAGE); // the rest is padding
+    host_frame(h, f, sizeof(f));
+    h->queue[h->queued++] = (uint8_t)page;
+    h->frames++;
+    if (h->sent[page]) {
+        h->resent++;
+    }
+    h->sent[page] = 1;
+}
+
+/* Send the pages of the window that are neither in nor on their way */
+static void host_fill(struct host *h) {
+    for (uint32_t page = h->base; page < h->limit && h->queued < LINK_QUEUE; page++) {
+        int waiting = 0;
+
+        if (h->have & (1U << (page - h->base))) {
+            continue;
+        }
+        for (uint32_t i = 0; i < h->queued; i++) {
+            waiting |= h->queue[i] == page;
+        }
+        if (!waiting) {
+            host_send_page(h, page);
+        }
+    }
+}
+
+static void host_status(struct host *h, const uint8_t *s) {
+    if (s[0] == 'R') {
+        h->ready = 1;
+        h->queued = 0;
+    }
+    if (s[0] == 'E') {
+        h->result = -1; // also a 'U' refused before any 'R'
+        return;
+    }
+    if (!h->ready) {
+        return; // left over from before the 'U'
+    }
+    if (s[0] == 'D') {
+        h->result = 1;
+        return;
+    }
+    if ((s[0] == 'A' || s[0] == 'N') && h->queued) {
+        // The answer to the oldest frame on its way
+        h->queued--;
+        memmove(&h->queue[0], &h->queue[1], h->queued);
+        h->naks += s[0] == 'N';
+    }
+    h->base = s[1];
+    h->limit = s[2] <= h->pages ? s[2] : h->pages;
+    h->have = s[3];
+    host_fill(h);
+}
+
+void host_byte(struct host *h, uint8_t c) {
+    int d = cobs_decode(&h->cobs, c);
+
+    if (d == COBS_END) {
+        if (h->status_len == LINK_STATUS_LEN && crc16_ccitt(CRC16_CCITT_INIT, h->status, LINK_STATUS_LEN) == 0) {
+            host_status(h, h->status);
+        }
+        h->status_len = 0;
+    }
+    else if (d != COBS_SKIP && h->status_len < LINK_STATUS_LEN) {
+        h->status[h->status_len++] = (uint8_t)d;
+    }
+    else if (d != COBS_SKIP) {
+        h->status_len = LINK_STATUS_LEN + 1U; // too long
+    }
+}
+
+/* Nothing received for a while: send again what's missing */
+void host_timeout(struct host *h) {
+    h->timeouts++;
+    if (!h->ready) {
+        host_begin(h);
+        return;
+    }
+    h->queued = 0;
+    host_fill(h);
+}
+
+void host_init(struct host *h, const uint8_t *data, uint32_t size, uint32_t crc, const uint8_t *iv) {
+    memset(h, 0, sizeof(*h));
+    h->data = data;
+    h->size = size;
+    h->crc = crc;
+    h->pages = (size + LINK_PAGE - 1U) / LINK_PAGE;
+    memcpy(h->iv, iv, sizeof(h->iv));
+    host_begin(h);
+}
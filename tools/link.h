@@ -0,0 +1,68 @@
+/*
+Host side of the windowed update link (updater.h)
+
+A state machine fed with the bytes received from the device and with timeouts; it
+queues the frames to send in tx. The serial port loop of update_link.c and the
+simulations (update_link -s, devsim.c) drive it the same way:
+
+    host_init(&h, data, size, crc, iv);       // queues the 'U' frame
+    loop:
+        send h.tx[h.tx_pos .. h.tx_len), advance h.tx_pos
+        host_byte(&h, c) for every byte received
+        host_timeout(&h) when nothing came for a while (~1 s, ~3 s before 'R')
+    until h.result: 1 done, -1 device error
+
+It sends every page of the window the device reported that is neither in nor on
+its way, and takes each 'A' / 'N' as the answer to the oldest frame sent. After a
+timeout it sends everything of the window that's missing (selective repeat).
+*/
+#ifndef LINK_H
+#define LINK_H
+
+#include <stdint.h>
+#include "cobs.h"
+#include "update.h"
+
+#define LINK_PAGE 1024U
+#define LINK_MAX_PAGES (UPDATE_SLOT_SIZE / LINK_PAGE)
+#define LINK_QUEUE 32U // frames on their way
+#define LINK_FRAME_MAX (1U + 1U + LINK_PAGE + 2U) // 'P' frame before COBS
+#define LINK_STATUS_LEN 6U
+#define LINK_TX_MAX (LINK_QUEUE * (COBS_MAX(LINK_FRAME_MAX) + 1U) + 64U)
+
+struct host {
+    const uint8_t *data; // pages as sent (encrypted)
+    uint32_t size;
+    uint32_t crc; // of the plain image
+    uint8_t iv[16];
+    uint32_t pages;
+    int ready; // 'R' received
+    int result; // 1 done, -1 error
+    uint32_t base;
+    uint32_t limit;
+    uint32_t have;
+    uint8_t queue[LINK_QUEUE]; // pages sent and not answered yet, oldest first
+    uint32_t queued;
+    uint8_t sent[LINK_MAX_PAGES];
+    struct cobs_decoder cobs;
+    uint8_t status[LINK_STATUS_LEN];
+    uint32_t status_len;
+    uint8_t tx[LINK_TX_MAX]; // encoded frames to send
+    uint32_t tx_len;
+    uint32_t tx_pos;
+    uint32_t frames;
+    uint32_t resent;
+    uint32_t naks;
+    uint32_t timeouts;
+};
+
+// Start a transfer of size bytes: data are the pages as sent (encrypted), crc and iv go in the 'U' frame
+void host_init(struct host *h, const uint8_t *data, uint32_t size, uint32_t crc, const uint8_t *iv);
+
+// Byte received from the device
+void host_byte(struct host *h, uint8_t c);
+
+// Nothing received for a while: send again what's missing ('U' before 'R')
+void host_timeout(struct host *h);
+
+#endif
@@ -0,0 +1,317 @@
+/*
+Logic analyzer capture over the serial port, written as a VCD file (logic.h)
+
+    logic_vcd [-p port] [-c channels] [-m mask] [-v value] [-P period] [-a post] [-w seconds] <tty> <out.vcd>
+        Arm a capture on the device (the 'L' frame of updater.h), wait up to `seconds`
+        (default 10) for the trigger, receive the capture and write it as a VCD file
+        for GTKWave, PulseView, ... One signal per channel pin, named after it (PB8).
+        port A .. E (default B), channels / mask / value as numbers (0xFF00), period
+        in timer cycles of 125 ns (default 16: 500 kHz), post in samples (default 1024).
+        mask 0 (the default) triggers at once.
+        channels default to 0xFF00 (pins 8 .. 15): the run-length encoding marks runs
+        with the bit of a pin that isn't a channel, so leave at least one pin out.
+        With all 16 (0xFFFF) the capture is sent uncompressed, every sample.
+
+Build (host): cc -O2 -Wall -Wextra -I. tools/logic_vcd.c cobs.c crc.c -o output/logic_vcd
+
+A capture comes back as a header frame and the (run-length encoded) samples, in frames
+of LOGIC_FRAME_WORDS. The device sends each one once: a frame lost to a line error
+loses the capture, the tool says so and it has to be taken again.
+*/
+
+#define _GNU_SOURCE // cfmakeraw()
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+#include <unistd.h>
+#include "cobs.h"
+#include "crc.h"
+#include "logic.h"
+
+#define TIMER_NS 125U // one cycle of the 8 MHz timer clock
+#define FRAME_MAX (3U + 2U * LOGIC_FRAME_WORDS + 2U)
+#define FRAME_TIMEOUT_MS 2000
+#define MAX_WORDS 0x10000U
+
+struct capture {
+    uint32_t port;
+    uint32_t period;
+    uint32_t channels;
+    uint32_t samples;
+    uint32_t trigger;
+    uint32_t run_bit;
+    uint32_t words;
+    uint32_t got; // words received
+    uint16_t data[MAX_WORDS];
+};
+
+static uint32_t get16(const uint8_t *p) {
+    return p[0] | ((uint32_t)p[1] << 8);
+}
+
+static void put16(uint8_t *p, uint32_t v) {
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+}
+
+static int tty_open(const char *path) {
+    struct termios tio;
+    int fd = open(path, O_RDWR | O_NOCTTY);
+
+    if (fd < 0 || tcgetattr(fd, &tio) != 0) {
+        perror(path);
+        return -1;
+    }
+    cfmakeraw(&tio);
+    cfsetspeed(&tio, B115200);
+    tcsetattr(fd, TCSANOW, &tio);
+    tcflush(fd, TCIOFLUSH);
+    return fd;
+}
+
+/* type, fields, crc16 big endian, COBS, delimiter (updater.h) */
+static int send_frame(int fd, uint8_t *f, uint32_t n) {
+    uint8_t enc[COBS_MAX(FRAME_MAX) + 1U];
+    uint16_t crc = crc16_ccitt(CRC16_CCITT_INIT, f, n);
+
+    f[n++] = (uint8_t)(crc >> 8);
+    f[n++] = (uint8_t)crc;
+    uint32_t m = cobs_encode(enc, f, n);
+    enc[m++] = 0;
+    return write(fd, enc, m) == (ssize_t)m ? 0 : -1;
+}
+
+/* Next frame with a good CRC (without it), other frames and garbage skipped. Returns its length, 0 on a timeout, -1 on an error. */
+static int read_frame(int fd, struct cobs_decoder *d, uint8_t *f, int timeout_ms) {
+    uint32_t n = 0;
+    int overflow = 0;
+
+    for (;;) {
+        struct pollfd p = { fd, POLLIN, 0 };
+        uint8_t c;
+        int r = poll(&p, 1, timeout_ms);
+        if (r <= 0) {
+            return r;
+        }
+        if (read(fd, &c, 1) != 1) {
+            return -1;
+        }
+        int b = cobs_decode(d, c);
+        if (b == COBS_SKIP) {
+            continue;
+        }
+        if (b != COBS_END) {
+            if (n < FRAME_MAX) {
+                f[n++] = (uint8_t)b;
+            }
+            else {
+                overflow = 1;
+            }
+            continue;
+        }
+        if (n > 2U && !overflow && crc16_ccitt(CRC16_CCITT_INIT, f, n) == 0) {
+            return (int)n - 2;
+        }
+        if (n > 0) {
+            fprintf(stderr, "bad frame dropped\n");
+        }
+        n = 0;
+        overflow = 0;
+    }
+}
+
+/* Arm the capture, receive it into c. Returns 0, or -1. */
+static int capture(int fd, const struct logic_config *cfg, int wait_s, struct capture *c) {
+    uint8_t f[FRAME_MAX + 2U];
+    struct cobs_decoder d;
+
+    cobs_reset(&d);
+    f[0] = 'L';
+    f[1] = (uint8_t)cfg->port;
+    put16(&f[2], cfg->channels);
+    put16(&f[4], cfg->mask);
+    put16(&f[6], cfg->value);
+    put16(&f[8], cfg->period);
+    put16(&f[10], cfg->post);
+    if (send_frame(fd, f, 12U) != 0) {
+        perror("write");
+        return -1;
+    }
+    fprintf(stderr, "armed, waiting %d s for the trigger\n", wait_s);
+
+    c->words = 0;
+    c->got = 0;
+    int header = 0;
+    int timeout = wait_s * 1000;
+    while (!header || c->got < c->words) {
+        int n = read_frame(fd, &d, f, timeout);
+        if (n < 0) {
+            perror("read");
+            return -1;
+        }
+        if (n == 0) {
+            fprintf(stderr, header ? "frame lost at word %u of %u, capture again\n" : "no capture (not triggered, or settings the device refused)\n", c->got, c->words);
+            return -1;
+        }
+        if (f[0] == 'H' && n == 14) {
+            c->port = f[1];
+            c->period = get16(&f[2]);
+            c->channels = get16(&f[4]);
+            c->samples = get16(&f[6]);
+            c->trigger = get16(&f[8]);
+            c->run_bit = get16(&f[10]);
+            c->words = get16(&f[12]);
+            c->got = 0;
+            header = 1;
+            timeout = FRAME_TIMEOUT_MS;
+            if (c->samples == 0) {
+                fprintf(stderr, "overrun: the device couldn't keep up, try a longer period\n");
+                return -1;
+            }
+        }
+        else if (header && f[0] == 'S' && n >= 3 && (n - 3) % 2 == 0) {
+            uint32_t offset = get16(&f[1]);
+            uint32_t k = (uint32_t)(n - 3) / 2U;
+            if (offset != c->got || offset + k > c->words) {
+                fprintf(stderr, "frame lost at word %u of %u, capture again\n", c->got, c->words);
+                return -1;
+            }
+            for (uint32_t i = 0; i < k; i++) {
+                c->data[offset + i] = (uint16_t)get16(&f[3U + 2U * i]);
+            }
+            c->got += k;
+        }
+        // else a status of the updater: not for us
+    }
+    return 0;
+}
+
+/* Expand the run-length encoding (logic.h) into samples. Returns 0, or -1 if it doesn't add up. */
+static int expand(const struct capture *c, uint16_t *samples) {
+    uint32_t n = 0;
+
+    for (uint32_t i = 0; i < c->words; i++) {
+        uint32_t v = c->data[i];
+        uint32_t run = 1;
+        if (c->run_bit && (v & c->run_bit)) {
+            if (i + 1U == c->words) {
+                return -1;
+            }
+            v &= ~c->run_bit;
+            run = c->data[++i];
+        }
+        if (n + run > c->samples) {
+            return -1;
+        }
+        while (run--) {
+            samples[n++] = (uint16_t)(v & c->channels);
+        }
+    }
+    return n == c->samples ? 0 : -1;
+}
+
+/* One signal per channel, a timestamp for each sample where something changed */
+static int write_vcd(const char *path, const struct capture *c, const uint16_t *samples) {
+    FILE *out = fopen(path, "w");
+    uint32_t ns = c->period * TIMER_NS;
+
+    if (!out) {
+        perror(path);
+        return -1;
+    }
+    fprintf(out, "$comment port %c, %u ns per sample", 'A' + c->port, ns);
+    if (c->trigger < c->samples) {
+        fprintf(out, ", trigger at sample %u (%llu ns)", c->trigger, (unsigned long long)c->trigger * ns);
+    }
+    fprintf(out, " $end\n$timescale 1ns $end\n$scope module logic $end\n");
+    for (uint32_t pin = 0; pin < 16U; pin++) {
+        if (c->channels & (1U << pin)) {
+            fprintf(out, "$var wire 1 %c P%c%u $end\n", 'a' + pin, 'A' + c->port, pin);
+        }
+    }
+    fprintf(out, "$upscope $end\n$enddefinitions $end\n");
+    for (uint32_t i = 0; i < c->samples; i++) {
+        uint32_t changed = i ? (uint32_t)(samples[i] ^ samples[i - 1U]) : c->channels;
+        if (!changed) {
+            continue;
+        }
+        fprintf(out, "#%llu\n", (unsigned long long)i * ns);
+        for (uint32_t pin = 0; pin < 16U; pin++) {
+            if (changed & (1U << pin)) {
+                fprintf(out, "%u%c\n", (samples[i] >> pin) & 1U, 'a' + pin);
+            }
+        }
+    }
+    fprintf(out, "#%llu\n", (unsigned long long)c->samples * ns);
+    return fclose(out) == 0 ? 0 : -1;
+}
+
+static int usage(void) {
+    fprintf(stderr, "usage: logic_vcd [-p port] [-c channels] [-m mask] [-v value] [-P period] [-a post] [-w seconds] <tty> <out.vcd>\n"
+        "  channels (default 0xFF00): leave one pin out, or the capture isn't compressed\n");
+    return 2;
+}
+
+int main(int argc, char **argv) {
+    struct logic_config cfg = { LOGIC_PORT_B, 0xFF00U, 0, 0, LOGIC_MIN_ARMED_PERIOD, 1024U };
+    int wait_s = 10;
+    int i = 1;
+
+    for (; i + 1 < argc && argv[i][0] == '-'; i += 2) {
+        const char *opt = argv[i];
+        const char *v = argv[i + 1];
+        uint32_t x = (uint32_t)strtoul(v, NULL, 0);
+        if (strcmp(opt, "-p") == 0 && v[0] >= 'A' && v[0] <= 'E' && !v[1]) {
+            cfg.port = (uint32_t)(v[0] - 'A');
+        }
+        else if (strcmp(opt, "-c") == 0) {
+            cfg.channels = (uint16_t)x;
+        }
+        else if (strcmp(opt, "-m") == 0) {
+            cfg.mask = (uint16_t)x;
+        }
+        else if (strcmp(opt, "-v") == 0) {
+            cfg.value = (uint16_t)x;
+        }
+        else if (strcmp(opt, "-P") == 0) {
+            cfg.period = (uint16_t)x;
+        }
+        else if (strcmp(opt, "-a") == 0) {
+            cfg.post = (uint16_t)x;
+        }
+        else if (strcmp(opt, "-w") == 0) {
+            wait_s = (int)x;
+        }
+        else {
+            return usage();
+        }
+    }
+    if (i + 2 != argc || cfg.channels == 0) {
+        return usage();
+    }
+    cfg.value &= cfg.mask;
+
+    static struct capture c;
+    static uint16_t samples[MAX_WORDS];
+    int fd = tty_open(argv[i]);
+    if (fd < 0 || capture(fd, &cfg, wait_s, &c) != 0) {
+        return 1;
+    }
+    close(fd);
+    if (expand(&c, samples) != 0) {
+        fprintf(stderr, "capture doesn't decode\n");
+        return 1;
+    }
+    fprintf(stderr, "%u samples in %u words", c.samples, c.words);
+    if (c.trigger < c.samples) {
+        fprintf(stderr, ", trigger at %u", c.trigger);
+    }
+    fprintf(stderr, "\n");
+    return write_vcd(argv[i + 1], &c, samples) == 0 ? 0 : 1;
+}
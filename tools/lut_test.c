@@ -0,0 +1,164 @@
+/*
+The lookups of lut.h against double precision libm: their errors, and timings next to sinf / expf / logf
+
+    lut_test
+
+- lut_sin_q15 / lut_cos_q15: every angle, error in LSB of Q15 (the table's scale is 32767)
+- lut_exp2_q16 / lut_exp_q16: every Q16 input whose result is in range, error in LSB
+  of Q16 and relative error, split at a result of 1.0 (65536): below it the result
+  has few significant bits and the rounding alone is 0.5 LSB
+- lut_log2_q16 / lut_ln_q16: every x up to 2^24 and 2^24 random x above, error in LSB of Q16
+- lut_gamma16: every level against 65535 * (level / 255)^2.2, in LSB
+
+Each error is checked against the bound in lut.h's table (the exit status is 1 when
+one is exceeded). Then the host time per call of each lookup and of the libm float
+function it replaces: only the relative cost on this machine, on the M3 the figures
+come from a BENCH=1 build (bench.h).
+
+Build (host): cc -O2 -Wall -Wextra -I. tools/lut_test.c lut.c -lm -o output/lut_test
+*/
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "lut.h"
+
+#define BENCH_INPUTS 4096U
+#define BENCH_ROUNDS 1000U
+
+static int failures;
+
+struct error {
+    double lsb; // largest absolute error, in LSB of the output
+    double rel; // largest relative error
+    double at; // input of the largest error in LSB
+};
+
+static void track(struct error *e, double got, double want, double at) {
+    double d = fabs(got - want);
+
+    if (d > e->lsb) {
+        e->lsb = d;
+        e->at = at;
+    }
+    if (want != 0.0 && d / fabs(want) > e->rel) {
+        e->rel = d / fabs(want);
+    }
+}
+
+// Check against lut.h's bounds (0: that one isn't stated)
+static void report(const char *name, const struct error *e, double max_lsb, double max_rel) {
+    int ok = (max_lsb == 0.0 || e->lsb <= max_lsb) && (max_rel == 0.0 || e->rel <= max_rel);
+
+    printf("%-30s %8.3f LSB  %9.2e rel  (worst at %.6g)%s\n", name, e->lsb, e->rel, e->at, ok ? "" : "  FAILED");
+    failures += !ok;
+}
+
+/* --- Errors --- */
+
+static void test_sin(void) {
+    struct error s = { 0 }, c = { 0 };
+
+    for (uint32_t a = 0; a < 65536U; a++) {
+        double rad = a * (2.0 * M_PI / 65536.0);
+        track(&s, lut_sin_q15((uint16_t)a), sin(rad) * 32767.0, a);
+        track(&c, lut_cos_q15((uint16_t)a), cos(rad) * 32767.0, a);
+    }
+    report("lut_sin_q15", &s, 1.03, 0.0);
+    report("lut_cos_q15", &c, 1.03, 0.0);
+}
+
+static void test_exp(void) {
+    struct error e2_lo = { 0 }, e2_hi = { 0 }, e_lo = { 0 }, e_hi = { 0 };
+
+    // 2^x < 2^16: x < 16; results below 1 LSB (x < -16) round to 0 or 1
+    for (int32_t x = -16 * 65536; x < 16 * 65536; x++) {
+        double want = exp2(x / 65536.0) * 65536.0;
+        track(x < 0 ? &e2_lo : &e2_hi, lut_exp2_q16(x), want, x / 65536.0);
+    }
+    // e^x < 2^16: x < 11.09
+    for (int32_t x = -11 * 65536; x < 726817; x++) {
+        double want = exp(x / 65536.0) * 65536.0;
+        track(x < 0 ? &e_lo : &e_hi, lut_exp_q16(x), want, x / 65536.0);
+    }
+    report("lut_exp2_q16 (x < 0)", &e2_lo, 1.03, 0.0);
+    report("lut_exp2_q16 (x >= 0)", &e2_hi, 0.0, 1.5e-5);
+    report("lut_exp_q16 (x < 0)", &e_lo, 1.35, 0.0);
+    report("lut_exp_q16 (x >= 0)", &e_hi, 0.0, 7e-5);
+}
+
+static void test_log(void) {
+    struct error l2 = { 0 }, ln = { 0 };
+
+    srand(1);
+    for (uint32_t i = 1; i < (1U << 25); i++) {
+        uint32_t x = i < (1U << 24) ? i : ((uint32_t)rand() << 1 ^ (uint32_t)rand()) | (1U << 24);
+        track(&l2, lut_log2_q16(x), log2(x / 65536.0) * 65536.0, x / 65536.0);
+        track(&ln, lut_ln_q16(x), log(x / 65536.0) * 65536.0, x / 65536.0);
+    }
+    report("lut_log2_q16", &l2, 2.32, 0.0);
+    report("lut_ln_q16", &ln, 3.45, 0.0);
+}
+
+static void test_gamma(void) {
+    struct error g = { 0 };
+
+    for (uint32_t i = 0; i < 256U; i++) {
+        track(&g, lut_gamma16((uint8_t)i), pow(i / 255.0, 2.2) * 65535.0, i);
+    }
+    report("lut_gamma16", &g, 0.5, 0.0);
+}
+
+/* --- Host timings --- */
+
+static double now_ns(void) {
+    struct timespec t;
+
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec * 1e9 + t.tv_nsec;
+}
+
+#define TIME(name, expr) do { \
+    volatile double sink = 0.0; \
+    double t = now_ns(); \
+    for (uint32_t r = 0; r < BENCH_ROUNDS; r++) { \
+        for (uint32_t i = 0; i < BENCH_INPUTS; i++) { \
+            sink += (double)(expr); \
+        } \
+    } \
+    printf("%-30s %8.2f ns\n", name, (now_ns() - t) / ((double)BENCH_ROUNDS * BENCH_INPUTS)); \
+} while (0)
+
+static void bench(void) {
+    static uint16_t angle[BENCH_INPUTS];
+    static int32_t ex[BENCH_INPUTS];
+    static uint32_t lx[BENCH_INPUTS];
+    static float angle_f[BENCH_INPUTS], ex_f[BENCH_INPUTS], lx_f[BENCH_INPUTS];
+
+    srand(2);
+    for (uint32_t i = 0; i < BENCH_INPUTS; i++) {
+        angle[i] = (uint16_t)rand();
+        ex[i] = rand() % (16 * 65536) - 8 * 65536;
+        lx[i] = (uint32_t)rand() | 1U;
+        angle_f[i] = angle[i] * (float)(2.0 * M_PI / 65536.0);
+        ex_f[i] = ex[i] / 65536.0f;
+        lx_f[i] = lx[i] / 65536.0f;
+    }
+    TIME("lut_sin_q15", lut_sin_q15(angle[i]));
+    TIME("sinf", sinf(angle_f[i]));
+    TIME("lut_exp_q16", lut_exp_q16(ex[i]));
+    TIME("expf", expf(ex_f[i]));
+    TIME("lut_ln_q16", lut_ln_q16(lx[i]));
+    TIME("logf", logf(lx_f[i]));
+}
+
+int main(void) {
+    test_sin();
+    test_exp();
+    test_log();
+    test_gamma();
+    bench();
+    printf(failures ? "%d bounds EXCEEDED\n" : "all errors within lut.h's bounds\n", failures);
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,293 @@
+/*
+Factory images and update packages
+
+    pack [-k signing_key.pem] [-K update_key.bin] [-b bootloader.bin -f factory.bin] [-u update.pkg] <app.bin>
+        app.bin is output/main_signed.bin, or output/main.bin signed here with -k.
+        -f: one image of the whole flash contents a new board needs, programmed at
+            0x08000000 in one pass: the bootloader, padded with erased bytes (0xFF) up
+            to slot A at 0x08004000, then the signed app. The other pages stay erased,
+            which is their initial state (no update pending, kv.h and evlog.h format
+            their pages on first use).
+        -u: an update package (package.h) for update_link, encrypted with the update
+            key (default keys/update_key.bin) and a fresh iv.
+    pack -i <factory.bin | update.pkg | app.bin>
+        What's in it, and whether the bootloader will start it.
+
+Before writing anything, the app's header, vector table and signature are checked
+against the public key of this build (output/image_key.h), and the factory image's
+bootloader must be the one carrying that key: a board that would refuse its app
+never leaves the programming station. Compression or delta packages aren't
+offered: updater.c programs the pages it receives as they are.
+
+Build (host, after build.sh made the keys):
+    cc -O2 -Wall -Wextra -I. -Ioutput tools/pack.c tools/sign.c ed25519.c sha256.c aes.c crc.c -o output/pack
+*/
+
+#define _GNU_SOURCE // memmem()
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "aes.h"
+#include "crc.h"
+#include "ed25519.h"
+#include "image.h"
+#include "sha256.h"
+#include "svc.h"
+#include "update.h"
+#include "package.h"
+#include "sign.h"
+#include "image_key.h" // IMAGE_PUBLIC_KEY, generated by build.sh from keys/
+
+#define FLASH_BASE 0x08000000UL
+#define BOOTLOADER_SIZE (UPDATE_SLOT_A - FLASH_BASE) // 16 KB
+#define RAM_BASE 0x20000000UL
+#define RAM_SIZE (20U * 1024U)
+
+static const uint8_t public_key[ED25519_KEY_SIZE] = IMAGE_PUBLIC_KEY;
+
+static uint32_t get32(const uint8_t *p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static int read_file(const char *path, uint8_t *buf, uint32_t max, uint32_t *size) {
+    FILE *f = fopen(path, "rb");
+
+    if (!f) {
+        perror(path);
+        return -1;
+    }
+    *size = (uint32_t)fread(buf, 1, max, f);
+    int more = fgetc(f) != EOF;
+    fclose(f);
+    if (more) {
+        fprintf(stderr, "%s: larger than %u bytes\n", path, max);
+        return -1;
+    }
+    return 0;
+}
+
+static int write_file(const char *path, const void *a, uint32_t a_len, const void *b, uint32_t b_len) {
+    FILE *f = fopen(path, "wb");
+
+    if (!f || fwrite(a, 1, a_len, f) != a_len || fwrite(b, 1, b_len, f) != b_len) {
+        perror(path);
+        if (f) {
+            fclose(f);
+        }
+        return -1;
+    }
+    return fclose(f) == 0 ? 0 : -1;
+}
+
+/* --- Checks --- */
+
+/*
+A signed app for slot A: header inside the file, trailer right after the bytes it
+covers, a vector table that starts it from slot A, a signature by this build's key.
+Prints what it found. Returns 0, or -1.
+*/
+static int check_app(const char *name, const uint8_t *app, uint32_t size) {
+    struct image_header h;
+    struct sha256 s;
+    uint8_t digest[SHA256_DIGEST];
+
+    if (size < IMAGE_HEADER_OFFSET + sizeof(h)) {
+        fprintf(stderr, "%s: not an app image\n", name);
+        return -1;
+    }
+    memcpy(&h, &app[IMAGE_HEADER_OFFSET], sizeof(h));
+    if (h.magic != IMAGE_MAGIC || h.size > UPDATE_SLOT_SIZE - sizeof(struct image_trailer) || (h.size & 3U)) {
+        fprintf(stderr, "%s: no image header at 0x%lx\n", name, IMAGE_HEADER_OFFSET);
+        return -1;
+    }
+    if (size != h.size + sizeof(struct image_trailer) || get32(&app[h.size]) != IMAGE_SIG_MAGIC) {
+        fprintf(stderr, "%s: not signed (or its size doesn't match the header)\n", name);
+        return -1;
+    }
+    uint32_t sp = get32(&app[0]);
+    uint32_t reset = get32(&app[4]);
+    if (sp < RAM_BASE || sp > RAM_BASE + RAM_SIZE || !(reset & 1U) ||
+        reset < UPDATE_SLOT_A || reset >= UPDATE_SLOT_A + h.size) {
+        fprintf(stderr, "%s: vector table doesn't start it from slot A (sp 0x%08x, reset 0x%08x)\n", name, sp, reset);
+        return -1;
+    }
+    sha256_init(&s);
+    sha256_update(&s, app, h.size);
+    sha256_final(&s, digest);
+    int ok = ed25519_verify(&app[h.size + 4U], digest, sizeof(digest), public_key) == 0;
+    printf("%s: app version %u, %u bytes, crc32 0x%08x, signature %s\n", name, h.version, size,
+        crc32(0, app, size), ok ? "ok" : "BAD (modified, or not this build's key)");
+    return ok ? 0 : -1;
+}
+
+/* The bootloader built with this key: its service table, reset vector and public key */
+static int check_bootloader(const char *name, const uint8_t *bl, uint32_t size) {
+    uint32_t table = BL_SERVICES_ADDR - FLASH_BASE;
+
+    if (size > BOOTLOADER_SIZE) {
+        fprintf(stderr, "%s: %u bytes, larger than the %lu before slot A\n", name, size, BOOTLOADER_SIZE);
+        return -1;
+    }
+    uint32_t reset = size >= 8U ? get32(&bl[4]) : 0;
+    if (size < table + 4U || get32(&bl[table]) != BL_SERVICES_MAGIC ||
+        reset < FLASH_BASE || reset >= FLASH_BASE + size) {
+        fprintf(stderr, "%s: not a bootloader (no service table at 0x%08lx)\n", name, BL_SERVICES_ADDR);
+        return -1;
+    }
+    if (!memmem(bl, size, public_key, sizeof(public_key))) {
+        fprintf(stderr, "%s: built with another signing key, it wouldn't start the app\n", name);
+        return -1;
+    }
+    printf("%s: bootloader, %u bytes, crc32 0x%08x\n", name, size, crc32(0, bl, size));
+    return 0;
+}
+
+/* --- Outputs --- */
+
+static int factory(const char *path, const uint8_t *bl, uint32_t bl_size, const uint8_t *app, uint32_t size) {
+    static uint8_t head[BOOTLOADER_SIZE];
+
+    memset(head, 0xFF, sizeof(head));
+    memcpy(head, bl, bl_size);
+    if (write_file(path, head, sizeof(head), app, size) != 0) {
+        return -1;
+    }
+    uint32_t crc = crc32(crc32(0, head, sizeof(head)), app, size);
+    printf("%s: %lu bytes at 0x%08lx, crc32 0x%08x\n", path, BOOTLOADER_SIZE + size, FLASH_BASE, crc);
+    return 0;
+}
+
+static int package(const char *path, const uint8_t *app, uint32_t size, const char *key_path) {
+    static uint8_t data[UPDATE_SLOT_SIZE + AES_BLOCK];
+    struct package p = { PACKAGE_MAGIC, 0, size, crc32(0, app, size), { 0 } };
+    struct image_header h;
+    uint8_t key[AES128_KEY_SIZE];
+    uint32_t n;
+
+    memcpy(&h, &app[IMAGE_HEADER_OFFSET], sizeof(h));
+    p.version = h.version;
+    if (read_file(key_path, key, sizeof(key), &n) != 0 || n != sizeof(key)) {
+        fprintf(stderr, "%s: expected a %u byte update key\n", key_path, AES128_KEY_SIZE);
+        return -1;
+    }
+    int fd = open("/dev/urandom", O_RDONLY);
+    if (fd < 0 || read(fd, p.iv, sizeof(p.iv)) != (ssize_t)sizeof(p.iv)) {
+        perror("/dev/urandom");
+        return -1;
+    }
+    close(fd);
+    struct aes128 a;
+    aes128_init(&a, key);
+    aes128_ctr_keystream(&a, p.iv, 0, data, (size + AES_BLOCK - 1U) / AES_BLOCK);
+    for (uint32_t i = 0; i < size; i++) {
+        data[i] ^= app[i];
+    }
+    if (write_file(path, &p, sizeof(p), data, size) != 0) {
+        return -1;
+    }
+    printf("%s: update package, app version %u, %u bytes\n", path, p.version, size);
+    return 0;
+}
+
+/* Describe a factory image, an update package or an app */
+static int info(const char *path) {
+    static uint8_t buf[BOOTLOADER_SIZE + UPDATE_SLOT_SIZE];
+    struct package p;
+    uint32_t size;
+
+    if (read_file(path, buf, sizeof(buf), &size) != 0) {
+        return -1;
+    }
+    if (size >= sizeof(p) && get32(buf) == PACKAGE_MAGIC) {
+        memcpy(&p, buf, sizeof(p));
+        printf("%s: update package, app version %u, %u bytes, crc32 0x%08x%s\n", path, p.version, p.size, p.crc,
+            size == sizeof(p) + p.size ? "" : ", TRUNCATED");
+        return size == sizeof(p) + p.size ? 0 : -1;
+    }
+    if (size > BOOTLOADER_SIZE && get32(&buf[BL_SERVICES_ADDR - FLASH_BASE]) == BL_SERVICES_MAGIC) {
+        // The bootloader's padding isn't part of it
+        uint32_t bl_size = BOOTLOADER_SIZE;
+        while (bl_size > 0 && buf[bl_size - 1U] == 0xFFU) {
+            bl_size--;
+        }
+        printf("%s: factory image, %u bytes\n", path, size);
+        int rc = check_bootloader("  0x08000000", buf, bl_size);
+        return check_app("  0x08004000", &buf[BOOTLOADER_SIZE], size - BOOTLOADER_SIZE) | rc;
+    }
+    return check_app(path, buf, size);
+}
+
+static int usage(void) {
+    fprintf(stderr, "usage: pack [-k signing_key.pem] [-K update_key.bin] [-b bootloader.bin -f factory.bin] "
+        "[-u update.pkg] <app.bin>\n"
+        "       pack -i <factory.bin | update.pkg | app.bin>\n");
+    return 2;
+}
+
+int main(int argc, char **argv) {
+    static uint8_t app[UPDATE_SLOT_SIZE];
+    static uint8_t bl[BOOTLOADER_SIZE + 1U];
+    const char *sign_key = NULL;
+    const char *key_path = "keys/update_key.bin";
+    const char *bl_path = NULL;
+    const char *factory_path = NULL;
+    const char *package_path = NULL;
+    uint32_t size;
+    uint32_t bl_size = 0;
+    int i = 1;
+
+    for (; i + 1 < argc && argv[i][0] == '-'; i += 2) {
+        const char *v = argv[i + 1];
+        if (strcmp(argv[i], "-i") == 0 && i + 2 == argc) {
+            return info(v) == 0 ? 0 : 1;
+        }
+        else if (strcmp(argv[i], "-k") == 0) {
+            sign_key = v;
+        }
+        else if (strcmp(argv[i], "-K") == 0) {
+            key_path = v;
+        }
+        else if (strcmp(argv[i], "-b") == 0) {
+            bl_path = v;
+        }
+        else if (strcmp(argv[i], "-f") == 0) {
+            factory_path = v;
+        }
+        else if (strcmp(argv[i], "-u") == 0) {
+            package_path = v;
+        }
+        else {
+            return usage();
+        }
+    }
+    if (i + 1 != argc || !bl_path != !factory_path) {
+        return usage();
+    }
+
+    if (read_file(argv[i], app, sizeof(app), &size) != 0) {
+        return 1;
+    }
+    // An unsigned build (output/main.bin): header size = file size
+    if (sign_key && size >= IMAGE_HEADER_OFFSET + sizeof(struct image_header) &&
+        get32(&app[IMAGE_HEADER_OFFSET]) == IMAGE_MAGIC && get32(&app[IMAGE_HEADER_OFFSET + 4U]) == size &&
+        image_sign(app, &size, sign_key) != 0) {
+        return 1;
+    }
+    if (check_app(argv[i], app, size) != 0) {
+        return 1;
+    }
+    if (bl_path && (read_file(bl_path, bl, sizeof(bl), &bl_size) != 0 || check_bootloader(bl_path, bl, bl_size) != 0)) {
+        return 1;
+    }
+
+    if (factory_path && factory(factory_path, bl, bl_size, app, size) != 0) {
+        return 1;
+    }
+    if (package_path && package(package_path, app, size, key_path) != 0) {
+        return 1;
+    }
+    return 0;
+}
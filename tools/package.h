@@ -0,0 +1,29 @@
+/*
+Update package: a signed app already encrypted for a transfer (updater.h)
+
+tools/pack.c makes them on the build machine, update_link sends them as they are, so
+the machine on the production line or in the field needs neither the signing key
+nor the update key. Layout:
+    0x00  struct package
+    0x20  the signed image (image.h) encrypted with the update key, AES-128-CTR from
+          iv, size bytes
+size, crc and iv are the fields of the 'U' command, version is the image's (image.h),
+for display only: the device checks the image itself.
+*/
+#ifndef PACKAGE_H
+#define PACKAGE_H
+
+#include <stdint.h>
+#include "aes.h"
+
+#define PACKAGE_MAGIC 0x474B5055UL // "UPKG"
+
+struct package {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t size; // signed image, bytes
+    uint32_t crc; // crc32 of the signed image (not of the encrypted one)
+    uint8_t iv[AES_BLOCK];
+};
+
+#endif
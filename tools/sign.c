@@ -0,0 +1,47 @@
+/*
+Image signing, see sign.h
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "sign.h"
+#include "image.h"
+#include "sha256.h"
+#include "update.h"
+
+/* Ed25519 signature of the SHA-256 digest (image.h), by openssl from a temporary file */
+int image_sign(uint8_t *image, uint32_t *size, const char *key) {
+    struct sha256 s;
+    struct image_trailer t = { IMAGE_SIG_MAGIC, { 0 } };
+    uint8_t digest[SHA256_DIGEST];
+    char path[] = "/tmp/image_sign_XXXXXX";
+    char cmd[512];
+
+    if (*size + sizeof(t) > UPDATE_SLOT_SIZE) {
+        fprintf(stderr, "no room for the signature in a slot\n");
+        return -1;
+    }
+    sha256_init(&s);
+    sha256_update(&s, image, *size);
+    sha256_final(&s, digest);
+    int fd = mkstemp(path);
+    if (fd < 0 || write(fd, digest, sizeof(digest)) != (ssize_t)sizeof(digest)) {
+        perror(path);
+        return -1;
+    }
+    close(fd);
+    snprintf(cmd, sizeof(cmd), "openssl pkeyutl -sign -rawin -inkey '%s' -in '%s'", key, path);
+    FILE *p = popen(cmd, "r");
+    size_t n = p ? fread(t.sig, 1, sizeof(t.sig), p) : 0;
+    int rc = p ? pclose(p) : -1;
+    unlink(path);
+    if (n != sizeof(t.sig) || rc != 0) {
+        fprintf(stderr, "signing with %s failed\n", key);
+        return -1;
+    }
+    memcpy(&image[*size], &t, sizeof(t));
+    *size += sizeof(t);
+    return 0;
+}
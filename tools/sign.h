@@ -0,0 +1,15 @@
+/*
+Image signing on the host (image.h layout), the same as build.sh does
+
+openssl makes the Ed25519 signature with the private key (keys/signing_key.pem);
+the digest is computed with the firmware's sha256.c.
+*/
+#ifndef SIGN_H
+#define SIGN_H
+
+#include <stdint.h>
+
+// Append the trailer to the size bytes of image (room for it up to UPDATE_SLOT_SIZE). Returns 0, or -1.
+int image_sign(uint8_t *image, uint32_t *size, const char *key);
+
+#endif
@@ -0,0 +1,242 @@
+/*
+Host-native board, see sim.h
+*/
+
+#define _GNU_SOURCE // MAP_FIXED_NOREPLACE
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "sim.h"
+#include "flash.h"
+#include "uart.h"
+#include "updater.h"
+
+// The pages the firmware's REG32 macros point into (updater.c)
+#define USART2_PAGE 0x40004000UL
+#define USART2_SR (*(volatile uint32_t *)0x40004400UL)
+#define USART2_DR (*(volatile uint32_t *)0x40004404UL)
+#define USART_SR_ORE (1U << 3)
+#define USART_SR_RXNE (1U << 5)
+#define NVIC_PAGE 0xE000E000UL
+
+#define LINE_QUEUE 65536U // bytes on their way, each way
+
+struct line_byte {
+    uint64_t at; // arrival, ns
+    uint8_t c;
+};
+
+struct sim_stats sim_stats;
+
+static uint64_t now;
+static struct line_byte rx_line[LINE_QUEUE];
+static uint32_t rx_head;
+static uint32_t rx_tail;
+static uint64_t rx_last; // arrival of the last byte queued
+static struct line_byte tx_line[LINE_QUEUE];
+static uint32_t tx_head;
+static uint32_t tx_tail;
+static uint64_t tx_last;
+static uint32_t fail_in; // flash operations until the power fails, 0: never
+
+static void *map_at(uintptr_t addr, size_t len, int prot, int flags, int fd) {
+    void *p = mmap((void *)addr, len, prot, flags | MAP_FIXED_NOREPLACE, fd, 0);
+
+    if (p == MAP_FAILED || p != (void *)addr) {
+        perror("sim: mmap");
+        return NULL;
+    }
+    return p;
+}
+
+int sim_init(const char *flash_path) {
+    struct stat st;
+    int fd = open(flash_path, O_RDWR | O_CREAT, 0644);
+
+    if (fd < 0 || fstat(fd, &st) != 0) {
+        perror(flash_path);
+        return -1;
+    }
+    int fresh = st.st_size != (off_t)SIM_FLASH_SIZE;
+    if (fresh && ftruncate(fd, SIM_FLASH_SIZE) != 0) {
+        perror(flash_path);
+        return -1;
+    }
+    if (!map_at(SIM_FLASH_BASE, SIM_FLASH_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, fd) ||
+        !map_at(USART2_PAGE, 4096U, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1) ||
+        !map_at(NVIC_PAGE, 4096U, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1)) {
+        return -1;
+    }
+    close(fd);
+    if (fresh) {
+        sim_flash_clear();
+    }
+    return 0;
+}
+
+void sim_flash_clear(void) {
+    memset((void *)SIM_FLASH_BASE, 0xFF, SIM_FLASH_SIZE);
+}
+
+uint64_t sim_now(void) {
+    return now;
+}
+
+static void deliver(uint8_t c, uint32_t flags) {
+    USART2_SR = USART_SR_RXNE | flags;
+    USART2_DR = c;
+    sim_stats.rx++;
+    USART2_IRQHandler();
+}
+
+/*
+Time passes. Running, each byte is taken when it arrives. Stalled by the flash, the
+interrupt waits for the end: the data register and the shift register hold the first
+two bytes, the others are lost.
+*/
+static void advance(uint64_t ns, int stalled) {
+    uint64_t end = now + ns;
+
+    if (stalled) {
+        uint8_t held[2];
+        uint32_t kept = 0;
+        uint32_t lost = 0;
+
+        for (; rx_tail != rx_head && rx_line[rx_tail % LINE_QUEUE].at <= end; rx_tail++) {
+            if (kept < 2U) {
+                held[kept++] = rx_line[rx_tail % LINE_QUEUE].c;
+            }
+            else {
+                sim_stats.overruns++;
+                lost = 1;
+            }
+        }
+        now = end;
+        // The USART flags the loss with ORE, seen with the first byte
+        for (uint32_t i = 0; i < kept; i++) {
+            deliver(held[i], i == 0 && lost ? USART_SR_ORE : 0U);
+        }
+        return;
+    }
+    for (; rx_tail != rx_head && rx_line[rx_tail % LINE_QUEUE].at <= end; rx_tail++) {
+        struct line_byte b = rx_line[rx_tail % LINE_QUEUE];
+        now = b.at > now ? b.at : now;
+        deliver(b.c, 0);
+    }
+    now = end;
+}
+
+void sim_run(uint64_t ns) {
+    advance(ns, 0);
+}
+
+void sim_rx(uint8_t c) {
+    uint64_t start = rx_last > now ? rx_last : now;
+
+    if (rx_head - rx_tail < LINE_QUEUE) {
+        rx_last = start + SIM_BYTE_NS;
+        rx_line[rx_head % LINE_QUEUE] = (struct line_byte){ rx_last, c };
+        rx_head++;
+    }
+}
+
+uint32_t sim_tx(uint8_t *buf, uint32_t max) {
+    uint32_t n = 0;
+
+    for (; n < max && tx_tail != tx_head && tx_line[tx_tail % LINE_QUEUE].at <= now; tx_tail++) {
+        buf[n++] = tx_line[tx_tail % LINE_QUEUE].c;
+    }
+    return n;
+}
+
+void sim_power_fail(uint32_t n) {
+    fail_in = n;
+}
+
+/* --- uart.h, transmit side: the CPU waits until the previous byte is out --- */
+
+void uart_putc(uint8_t c) {
+    if (tx_last > now + SIM_BYTE_NS) {
+        advance(tx_last - now - SIM_BYTE_NS, 0);
+    }
+    uint64_t start = tx_last > now ? tx_last : now;
+    tx_last = start + SIM_BYTE_NS;
+    if (tx_head - tx_tail < LINE_QUEUE) {
+        tx_line[tx_head % LINE_QUEUE] = (struct line_byte){ tx_last, c };
+        tx_head++;
+    }
+    sim_stats.tx++;
+}
+
+void uart_write(const void *data, uint32_t len) {
+    const uint8_t *p = data;
+
+    while (len--) {
+        uart_putc(*p++);
+    }
+}
+
+void uart_puts(const char *s) {
+    while (*s) {
+        uart_putc((uint8_t)*s++);
+    }
+}
+
+/* --- flash.h --- */
+
+/* 1 if the power fails during this operation */
+static int power_fails(void) {
+    return fail_in && --fail_in == 0;
+}
+
+int flash_erase_page(uint32_t addr) {
+    if (addr < SIM_FLASH_BASE || addr >= SIM_FLASH_BASE + SIM_FLASH_SIZE) {
+        return -1;
+    }
+    uint8_t *page = (uint8_t *)(uintptr_t)(addr & ~(FLASH_PAGE_SIZE - 1U));
+
+    if (power_fails()) {
+        // Half erased: some bytes already 0xFF, the others anything
+        for (uint32_t i = 0; i < FLASH_PAGE_SIZE; i++) {
+            page[i] = rand() & 1 ? 0xFFU : (uint8_t)rand();
+        }
+        _exit(SIM_EXIT_POWER);
+    }
+    advance(SIM_ERASE_NS, 1);
+    memset(page, 0xFF, FLASH_PAGE_SIZE);
+    sim_stats.erases++;
+    return 0;
+}
+
+int flash_program(uint32_t addr, const void *data, uint32_t len) {
+    const uint8_t *src = data;
+
+    if ((addr & 1U) || addr < SIM_FLASH_BASE || addr + len > SIM_FLASH_BASE + SIM_FLASH_SIZE) {
+        return -1;
+    }
+    for (uint32_t i = 0; i < len; i += 2U) {
+        volatile uint16_t *dst = (volatile uint16_t *)(uintptr_t)(addr + i);
+        uint16_t half = (uint16_t)(src[i] | ((i + 1U < len ? src[i + 1U] : 0xFFU) << 8));
+
+        if (*dst != 0xFFFFU && half != 0) {
+            return -1; // PGERR: not erased
+        }
+        if (power_fails()) {
+            // Half programmed: only some of the bits to clear are cleared
+            *dst &= (uint16_t)(half | rand());
+            _exit(SIM_EXIT_POWER);
+        }
+        advance(SIM_HALFWORD_NS, 1);
+        *dst &= half;
+        sim_stats.halfwords++;
+        if (*dst != half) {
+            return -1;
+        }
+    }
+    return 0;
+}
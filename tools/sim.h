@@ -0,0 +1,70 @@
+/*
+Host-native board for the update code (devsim.c)
+
+The firmware reaches flash and peripherals by absolute address, so the simulation
+maps memory at those addresses and the firmware sources compile unchanged:
+- Flash: a file, mapped shared at 0x08000000 (128 KB). A forked process sees the
+  same flash, so a reset of the simulated board is a new process (RAM starts over,
+  flash stays), and a power loss is that process exiting in the middle of a flash
+  operation.
+- USART2 and NVIC pages: plain memory. Bytes from the host arrive on a modeled
+  115200 baud line and the receive interrupt (USART2_IRQHandler, updater.h) is
+  called for each of them.
+
+flash.h is implemented here with the PM0075 rules (erase sets a page to 0xFF, a
+half-word can only be programmed when erased or to 0) and its timings: every
+operation advances the simulated clock and stalls the CPU, so no interrupt is taken
+during it. Like the USART (data register + shift register), at most two bytes
+survive a stall, the rest are overruns: a 20 ms erase while the host sends loses
+~230 bytes, and the first byte after it comes with ORE set in USART2_SR.
+
+Simulated time only advances through sim_run() (the CPU running), flash operations
+and transmitted bytes. Computation isn't timed, the caller accounts for it.
+*/
+#ifndef SIM_H
+#define SIM_H
+
+#include <stdint.h>
+
+#define SIM_FLASH_BASE 0x08000000UL
+#define SIM_FLASH_SIZE 0x20000UL // 128 KB
+
+// Timings in ns
+#define SIM_BYTE_NS 86806U // 10 bits at 115200 baud
+#define SIM_ERASE_NS 20000000U // page erase
+#define SIM_HALFWORD_NS 52000U // half-word program
+
+#define SIM_EXIT_POWER 3 // exit status of a board process that lost power
+
+struct sim_stats {
+    uint32_t erases;
+    uint32_t halfwords;
+    uint32_t rx; // bytes received by the device
+    uint32_t overruns; // bytes lost while the CPU was stalled
+    uint32_t tx; // bytes sent by the device
+};
+
+extern struct sim_stats sim_stats;
+
+// Map the flash file (created erased if it doesn't exist) and the peripheral pages. Returns 0, or -1.
+int sim_init(const char *flash_path);
+
+// Erase the whole simulated flash
+void sim_flash_clear(void);
+
+// Simulated time, ns
+uint64_t sim_now(void);
+
+// The CPU runs for ns (interrupts are taken as bytes arrive)
+void sim_run(uint64_t ns);
+
+// Host -> device: c goes on the line, it arrives one byte time after the previous one
+void sim_rx(uint8_t c);
+
+// Device -> host: bytes that have arrived by now, at most max. Returns their number.
+uint32_t sim_tx(uint8_t *buf, uint32_t max);
+
+// Lose power at the n-th flash operation from now (erase, or half-word program), 0: never
+void sim_power_fail(uint32_t n);
+
+#endif
@@ -0,0 +1,823 @@
+/*
+Host side of the windowed update link (updater.h), and simulated devices to try it on
+
+    update_link [-k signing_key.pem] [-K update_key.bin] <tty>... <image.bin | update.pkg>
+        Send an update over serial ports at 115200 baud, to all of them at once (a
+        production line). image.bin is output/main_signed.bin, or output/main.bin
+        signed here with -k (openssl, as in build.sh). It's encrypted with the update
+        key (default keys/update_key.bin) and a fresh iv for every run. An update
+        package (package.h, output/main_update.pkg) is encrypted already: no key needed.
+    update_link -d [-n devices] [-w window] [-e errors] [-K update_key.bin]
+        Simulated devices on pseudo terminals, paced at the 115200 baud byte rate (a
+        pseudo terminal itself has none): prints their paths to give the first form
+        and serves transfers until killed.
+    update_link -s [-w window] [-e errors] [-r seed] <image.bin>
+        Send the image to a simulated device in the same process, in byte times of the
+        line. The device has `window` page buffers (default: compare 1, 2 and 4).
+
+Both simulated devices take the flash and keystream times of updater.h, -e corrupts
+one bit of a byte with that probability (e.g. 1e-4), both ways.
+
+Build (host): cc -O2 -Wall -Wextra -I. tools/update_link.c tools/link.c tools/sign.c cobs.c crc.c aes.c sha256.c -o output/update_link
+
+The host side is the state machine of link.h, the serial port loop and the
+simulation drive it alike. The serial ports are non-blocking behind one
+epoll set: status frames are handled as soon as they arrive and the next pages queued
+right away, so no device's page buffers wait for the host, however many there are.
+*/
+
+#define _GNU_SOURCE // posix_openpt(), cfmakeraw()
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+#include "aes.h"
+#include "cobs.h"
+#include "crc.h"
+#include "image.h"
+#include "link.h"
+#include "package.h"
+#include "sign.h"
+#include "update.h"
+
+#define PAGE LINK_PAGE
+#define MAX_PAGES LINK_MAX_PAGES
+#define MAX_WINDOW 8U
+#define FRAME_MAX LINK_FRAME_MAX
+#define STATUS_LEN LINK_STATUS_LEN
+
+/* --- Simulated device --- */
+
+// Byte times at 115200 baud (86.8 us), flash and keystream times from updater.h
+#define ERASE_TICKS 230U // 20 ms page erase
+#define PROGRAM_TICKS 310U // 1024 bytes at ~210 cycles
+#define KEYSTREAM_TICKS 74U // 1024 bytes at ~50 cycles
+
+enum job { JOB_NONE, JOB_ERASE, JOB_PROGRAM, JOB_KEYSTREAM };
+
+struct sim {
+    uint32_t window; // page buffers
+    uint32_t size;
+    uint32_t crc;
+    uint32_t pages;
+    const uint8_t *key; // update key, NULL: pages aren't encrypted
+    uint8_t iv[AES_BLOCK];
+    int receiving;
+    int done;
+    struct cobs_decoder cobs;
+    uint8_t frame[FRAME_MAX + 1U];
+    uint32_t len;
+    uint8_t buf[MAX_WINDOW][PAGE]; // page n in buf[n % window]
+    int full[MAX_WINDOW];
+    uint32_t base;
+    uint32_t limit;
+    enum job job;
+    uint32_t busy; // ticks left of the job
+    uint8_t slot[MAX_PAGES * PAGE];
+    uint8_t tx[4096];
+    uint32_t tx_len;
+    uint32_t tx_pos;
+};
+
+static void sim_status(struct sim *d, uint8_t kind) {
+    uint8_t s[STATUS_LEN] = { kind, (uint8_t)d->base, (uint8_t)d->limit, 0 };
+
+    for (uint32_t i = 0; i < d->window; i++) {
+        if (d->base + i < d->limit && d->full[(d->base + i) % d->window]) {
+            s[3] |= (uint8_t)(1U << i);
+        }
+    }
+    uint16_t crc = crc16_ccitt(CRC16_CCITT_INIT, s, STATUS_LEN - 2U);
+    s[4] = (uint8_t)(crc >> 8);
+    s[5] = (uint8_t)crc;
+    if (d->tx_pos == d->tx_len) {
+        d->tx_pos = 0;
+        d->tx_len = 0;
+    }
+    if (d->tx_len + COBS_MAX(STATUS_LEN) + 1U <= sizeof(d->tx)) {
+        d->tx_len += cobs_encode(&d->tx[d->tx_len], s, STATUS_LEN);
+        d->tx[d->tx_len++] = 0;
+    }
+}
+
+static uint32_t get32(const uint8_t *p) {
+    return p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static void sim_frame(struct sim *d) {
+    uint32_t len = d->len;
+
+    d->len = 0;
+    if (len == 0) {
+        return;
+    }
+    if (len > FRAME_MAX || crc16_ccitt(CRC16_CCITT_INIT, d->frame, len) != 0) {
+        sim_status(d, 'N');
+        return;
+    }
+    if (d->frame[0] == 'U' && len == 1U + 24U + 2U) {
+        d->size = get32(&d->frame[1]);
+        d->crc = get32(&d->frame[5]);
+        d->pages = (d->size + PAGE - 1U) / PAGE;
+        memcpy(d->iv, &d->frame[9], AES_BLOCK);
+        d->receiving = 0;
+        d->base = 0;
+        d->limit = 0;
+        memset(d->full, 0, sizeof(d->full));
+        d->job = JOB_ERASE;
+        d->busy = d->pages * ERASE_TICKS;
+    }
+    else if (d->frame[0] == 'P' && len == FRAME_MAX) {
+        uint32_t page = d->frame[1];
+
+        if (d->receiving && page >= d->base && page < d->limit && !d->full[page % d->window]) {
+            memcpy(d->buf[page % d->window], &d->frame[2], PAGE);
+            d->full[page % d->window] = 1;
+        }
+        sim_status(d, 'A');
+    }
+    else {
+        sim_status(d, 'N');
+    }
+}
+
+static void sim_byte(struct sim *d, uint8_t c) {
+    int v = cobs_decode(&d->cobs, c);
+
+    if (v == COBS_END) {
+        sim_frame(d);
+    }
+    else if (v != COBS_SKIP) {
+        if (d->len < sizeof(d->frame)) {
+            d->frame[d->len] = (uint8_t)v;
+        }
+        d->len++;
+    }
+}
+
+/* The main loop: one flash or keystream job at a time */
+static void sim_tick(struct sim *d) {
+    if (d->busy && --d->busy) {
+        return;
+    }
+    switch (d->job) {
+    case JOB_ERASE:
+        d->job = JOB_KEYSTREAM; // of the first page, then 'R'
+        d->busy = KEYSTREAM_TICKS;
+        return;
+    case JOB_PROGRAM:
+        memcpy(&d->slot[d->base * PAGE], d->buf[d->base % d->window], PAGE);
+        if (d->key) {
+            struct aes128 a;
+            uint8_t ks[PAGE];
+            aes128_init(&a, d->key);
+            aes128_ctr_keystream(&a, d->iv, d->base * (PAGE / AES_BLOCK), ks, PAGE / AES_BLOCK);
+            for (uint32_t i = 0; i < PAGE; i++) {
+                d->slot[d->base * PAGE + i] ^= ks[i];
+            }
+        }
+        d->full[d->base % d->window] = 0;
+        d->base++;
+        if (d->base == d->pages) {
+            d->done = 1;
+            sim_status(d, crc32(0, d->slot, d->size) == d->crc ? 'D' : 'E');
+            d->receiving = 0;
+        }
+        else {
+            sim_status(d, 'W');
+        }
+        break;
+    case JOB_KEYSTREAM:
+        d->limit++;
+        if (!d->receiving) {
+            d->receiving = 1;
+            sim_status(d, 'R');
+        }
+        else {
+            sim_status(d, 'W');
+        }
+        break;
+    default:
+        break;
+    }
+    d->job = JOB_NONE;
+    if (!d->receiving) {
+        return;
+    }
+    if (d->full[d->base % d->window]) {
+        d->job = JOB_PROGRAM;
+        d->busy = PROGRAM_TICKS;
+    }
+    else if (d->limit < d->base + d->window && d->limit < d->pages) {
+        d->job = JOB_KEYSTREAM;
+        d->busy = KEYSTREAM_TICKS;
+    }
+}
+
+static uint32_t rng_state = 1;
+
+static uint32_t rng(void) {
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 17;
+    rng_state ^= rng_state << 5;
+    return rng_state;
+}
+
+static uint8_t line(uint8_t c, double errors) {
+    if (errors > 0 && rng() < errors * 4294967296.0) {
+        c ^= (uint8_t)(1U << (rng() & 7U));
+    }
+    return c;
+}
+
+static int simulate(const uint8_t *image, uint32_t size, uint32_t window, double errors) {
+    static struct host h;
+    static struct sim d;
+    uint8_t iv[16] = { 0 };
+    uint32_t crc = crc32(0, image, size);
+    uint32_t quiet = 0;
+    uint32_t ticks = 0;
+    uint32_t ready = 0; // when 'R' came
+    uint32_t pages = (size + PAGE - 1U) / PAGE;
+
+    memset(&d, 0, sizeof(d));
+    d.window = window;
+    host_init(&h, image, size, crc, iv);
+    while (h.result == 0 && ticks < 100U * pages * (PAGE + PROGRAM_TICKS)) {
+        ticks++;
+        // One byte each way per byte time
+        if (h.tx_pos < h.tx_len) {
+            sim_byte(&d, line(h.tx[h.tx_pos++], errors));
+        }
+        if (d.tx_pos < d.tx_len) {
+            host_byte(&h, line(d.tx[d.tx_pos++], errors));
+            quiet = 0;
+        }
+        sim_tick(&d);
+        ready = h.ready && !ready ? ticks : ready;
+        // Timeout: a window of frames plus programming, or the erase before 'R'
+        uint32_t timeout = h.ready ? (window + 2U) * (PAGE + PROGRAM_TICKS) : pages * ERASE_TICKS + 2000U;
+        if (++quiet > timeout && h.tx_pos == h.tx_len) {
+            host_timeout(&h);
+            quiet = 0;
+        }
+    }
+
+    // From 'R' on (the erase before it is the same for any window)
+    double seconds = (ticks - ready) / 11520.0;
+    int ok = h.result == 1 && memcmp(d.slot, image, size) == 0;
+    printf("window %u: %u bytes in %.2f s + %.2f s erase, %.0f B/s (%.0f%% of the line), %u pages sent, "
+        "%u resent, %u corrupted, %u timeouts, %s\n", window, size, seconds, ready / 11520.0, size / seconds,
+        100.0 * size / (ticks - ready), h.frames, h.resent, h.naks, h.timeouts, ok ? "slot B ok" : "FAILED");
+    return ok ? 0 : -1;
+}
+
+
+/* --- Image --- */
+
+struct upload {
+    const uint8_t *plain; // signed image: the file mapped, or a signed copy of it (NULL for a package)
+    uint32_t size;
+    uint32_t crc; // of plain
+    uint8_t iv[AES_BLOCK];
+    uint8_t *data; // encrypted, whole pages: the one copy every port sends from
+};
+
+static int read_file(const char *path, uint8_t *buf, uint32_t max, uint32_t *size) {
+    FILE *f = fopen(path, "rb");
+
+    if (!f) {
+        perror(path);
+        return -1;
+    }
+    *size = (uint32_t)fread(buf, 1, max, f);
+    int more = fgetc(f) != EOF;
+    fclose(f);
+    if (more) {
+        fprintf(stderr, "%s: larger than %u bytes\n", path, max);
+        return -1;
+    }
+    return 0;
+}
+
+/* An update package (package.h, tools/pack.c): encrypted already, sent as it is */
+static int prepare_package(struct upload *u, const char *path, const uint8_t *file) {
+    struct package p;
+
+    memcpy(&p, file, sizeof(p));
+    if (u->size != sizeof(p) + p.size || p.size > UPDATE_SLOT_SIZE) {
+        fprintf(stderr, "%s: truncated update package\n", path);
+        return -1;
+    }
+    u->data = mmap(NULL, MAX_PAGES * PAGE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (u->data == MAP_FAILED) {
+        perror("mmap");
+        return -1;
+    }
+    memcpy(u->data, &file[sizeof(p)], p.size);
+    mprotect(u->data, MAX_PAGES * PAGE, PROT_READ);
+    munmap((void *)file, u->size);
+    u->plain = NULL;
+    u->size = p.size;
+    u->crc = p.crc;
+    memcpy(u->iv, p.iv, sizeof(u->iv));
+    printf("%s: app version %u\n", path, p.version);
+    return 0;
+}
+
+/*
+Map a signed image (or sign a copy), encrypt it with the update key and a fresh iv.
+Every device gets the same ciphertext (same image, key and iv: nothing more to learn
+from two copies of it), so however many ports there are, the image is read and
+encrypted once.
+*/
+static int prepare(struct upload *u, const char *path, const char *sign_key, const char *key_path) {
+    struct image_header hdr;
+    struct stat st;
+    uint8_t key[AES128_KEY_SIZE];
+    uint32_t n;
+    int fd = open(path, O_RDONLY);
+
+    if (fd < 0 || fstat(fd, &st) != 0) {
+        perror(path);
+        return -1;
+    }
+    if (st.st_size < (off_t)(IMAGE_HEADER_OFFSET + sizeof(hdr)) ||
+        st.st_size > (off_t)(UPDATE_SLOT_SIZE + sizeof(struct package))) {
+        fprintf(stderr, "%s: not an app image, or larger than a slot\n", path);
+        return -1;
+    }
+    u->size = (uint32_t)st.st_size;
+    uint8_t *file = mmap(NULL, u->size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (file == MAP_FAILED) {
+        perror(path);
+        return -1;
+    }
+    if (get32(file) == PACKAGE_MAGIC) {
+        return prepare_package(u, path, file);
+    }
+    memcpy(&hdr, &file[IMAGE_HEADER_OFFSET], sizeof(hdr));
+    if (u->size > UPDATE_SLOT_SIZE) {
+        fprintf(stderr, "%s: larger than a slot\n", path);
+        return -1;
+    }
+    if (hdr.magic != IMAGE_MAGIC || hdr.size > u->size) {
+        fprintf(stderr, "%s: not an app image (no header at 0x%lx)\n", path, IMAGE_HEADER_OFFSET);
+        return -1;
+    }
+    if (u->size == hdr.size + sizeof(struct image_trailer) && get32(&file[hdr.size]) == IMAGE_SIG_MAGIC) {
+        u->plain = file; // signed already (output/main_signed.bin)
+    }
+    else if (u->size == hdr.size && sign_key) {
+        uint8_t *copy = malloc(UPDATE_SLOT_SIZE);
+        if (!copy) {
+            return -1;
+        }
+        memcpy(copy, file, u->size);
+        munmap(file, u->size);
+        if (image_sign(copy, &u->size, sign_key) != 0) {
+            return -1;
+        }
+        u->plain = copy;
+    }
+    else if (u->size == hdr.size) {
+        fprintf(stderr, "%s: not signed, the bootloader won't start it (sign it with -k keys/signing_key.pem)\n", path);
+        return -1;
+    }
+    else {
+        fprintf(stderr, "%s: size doesn't match its header\n", path);
+        return -1;
+    }
+
+    if (read_file(key_path, key, sizeof(key), &n) != 0 || n != sizeof(key)) {
+        fprintf(stderr, "%s: expected a %u byte update key\n", key_path, AES128_KEY_SIZE);
+        return -1;
+    }
+    fd = open("/dev/urandom", O_RDONLY);
+    if (fd < 0 || read(fd, u->iv, sizeof(u->iv)) != (ssize_t)sizeof(u->iv)) {
+        perror("/dev/urandom");
+        return -1;
+    }
+    close(fd);
+    u->data = mmap(NULL, MAX_PAGES * PAGE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (u->data == MAP_FAILED) {
+        perror("mmap");
+        return -1;
+    }
+    struct aes128 a;
+    aes128_init(&a, key);
+    aes128_ctr_keystream(&a, u->iv, 0, u->data, MAX_PAGES * PAGE / AES_BLOCK);
+    for (uint32_t i = 0; i < u->size; i++) {
+        u->data[i] ^= u->plain[i];
+    }
+    mprotect(u->data, MAX_PAGES * PAGE, PROT_READ);
+    u->crc = crc32(0, u->plain, u->size);
+    return 0;
+}
+
+/* --- Serial port --- */
+
+static uint32_t now_ms(void) {
+    struct timespec t;
+
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (uint32_t)(t.tv_sec * 1000 + t.tv_nsec / 1000000);
+}
+
+static int tty_open(const char *path) {
+    struct termios tio;
+    int fd = open(path, O_RDWR | O_NOCTTY | O_NONBLOCK);
+
+    if (fd < 0 || tcgetattr(fd, &tio) != 0) {
+        int err = errno; // reported with the results
+
+        if (fd >= 0) {
+            close(fd);
+        }
+        errno = err;
+        return -1;
+    }
+    cfmakeraw(&tio);
+    cfsetspeed(&tio, B115200);
+    tcsetattr(fd, TCSANOW, &tio);
+    tcflush(fd, TCIOFLUSH);
+    return fd;
+}
+
+/* Write what the port takes now. Returns -1 on an error. */
+static int tty_flush(int fd, struct host *h) {
+    while (h->tx_pos < h->tx_len) {
+        ssize_t n = write(fd, &h->tx[h->tx_pos], h->tx_len - h->tx_pos);
+        if (n < 0) {
+            return errno == EAGAIN || errno == EINTR ? 0 : -1;
+        }
+        h->tx_pos += (uint32_t)n;
+    }
+    return 0;
+}
+
+/* Read what arrived. Returns the number of bytes, -1 on an error. */
+static int tty_read(int fd, struct host *h) {
+    uint8_t rx[256];
+    int total = 0;
+
+    for (;;) {
+        ssize_t n = read(fd, rx, sizeof(rx));
+        if (n <= 0) {
+            return n == 0 || errno == EAGAIN || errno == EINTR ? total : -1;
+        }
+        for (ssize_t i = 0; i < n; i++) {
+            host_byte(h, rx[i]);
+        }
+        total += (int)n;
+    }
+}
+
+/*
+One port of a (production line) run: every port has its own host state machine,
+and they all send from the same encrypted image. One thread and one epoll set for
+all of them, a port only costs its ~35 KB of transmit buffer.
+*/
+struct port {
+    const char *path;
+    int fd;
+    int writing; // EPOLLOUT asked for
+    int err; // errno that ended it
+    struct host h;
+    uint32_t last; // something received
+    uint32_t ready; // 'R' received
+    uint32_t end;
+};
+
+static uint32_t port_pages(const struct port *p) {
+    return p->h.result == 1 ? p->h.pages : p->h.ready ? p->h.base : 0U;
+}
+
+static void progress(const struct port *ports, int n, uint32_t ms, char end) {
+    uint32_t done = 0;
+    uint32_t pages = 0;
+    int finished = 0;
+
+    for (int i = 0; i < n; i++) {
+        done += port_pages(&ports[i]);
+        pages += ports[i].h.pages;
+        finished += ports[i].fd < 0;
+    }
+    fprintf(stderr, "\r%3u%% %4u/%u pages %7.0f B/s, %d/%d ports finished%c", pages ? done * 100U / pages : 0U,
+        done, pages, ms ? done * PAGE * 1000.0 / ms : 0.0, finished, n, end);
+}
+
+/* What epoll reported for a port: statuses in, then the pages they asked for out right away */
+static void port_event(struct port *p, uint32_t events, uint32_t now) {
+    if (events & (EPOLLERR | EPOLLHUP)) {
+        p->err = EIO;
+        return;
+    }
+    if (events & EPOLLIN) {
+        int r = tty_read(p->fd, &p->h);
+        p->err = r < 0 ? errno : p->err;
+        p->last = r > 0 ? now : p->last;
+    }
+    if (tty_flush(p->fd, &p->h) != 0) {
+        p->err = errno;
+    }
+}
+
+/* Timeouts, and writability only while frames wait (the port buffer was full) */
+static void port_tick(struct port *p, int ep, uint32_t now) {
+    // Up to 51 page erases before 'R', a window of frames (~90 ms each) after it
+    if (now - p->last > (p->h.ready ? 1000U : 3000U)) {
+        host_timeout(&p->h);
+        p->last = now;
+        if (tty_flush(p->fd, &p->h) != 0) {
+            p->err = errno;
+        }
+    }
+    p->ready = p->h.ready && !p->ready ? now : p->ready;
+    int want = p->h.tx_pos < p->h.tx_len;
+    if (want != p->writing) {
+        struct epoll_event ev = { EPOLLIN | (want ? EPOLLOUT : 0U), { .ptr = p } };
+        epoll_ctl(ep, EPOLL_CTL_MOD, p->fd, &ev);
+        p->writing = want;
+    }
+}
+
+static int upload(char **paths, int n, const struct upload *u) {
+    struct port *ports = calloc((size_t)n, sizeof(*ports));
+    int ep = epoll_create1(0);
+    uint32_t start = now_ms();
+    int running = 0;
+
+    if (!ports || ep < 0) {
+        perror("upload");
+        return -1;
+    }
+    for (int i = 0; i < n; i++) {
+        struct port *p = &ports[i];
+        p->path = paths[i];
+        p->fd = tty_open(p->path);
+        p->end = start;
+        if (p->fd < 0) {
+            p->err = errno;
+            continue;
+        }
+        struct epoll_event ev = { EPOLLIN, { .ptr = p } };
+        epoll_ctl(ep, EPOLL_CTL_ADD, p->fd, &ev);
+        host_init(&p->h, u->data, u->size, u->crc, u->iv);
+        p->last = start;
+        p->err = tty_flush(p->fd, &p->h) != 0 ? errno : 0;
+        running++;
+    }
+
+    uint32_t shown = start;
+    while (running) {
+        struct epoll_event got[16];
+        int k = epoll_wait(ep, got, 16, 100);
+        uint32_t now = now_ms();
+
+        for (int j = 0; j < k; j++) {
+            port_event(got[j].data.ptr, got[j].events, now);
+        }
+        for (int i = 0; i < n; i++) {
+            struct port *p = &ports[i];
+            if (p->fd < 0) {
+                continue;
+            }
+            if (!p->err && !p->h.result) {
+                port_tick(p, ep, now);
+            }
+            if (p->err || p->h.result) {
+                epoll_ctl(ep, EPOLL_CTL_DEL, p->fd, NULL);
+                close(p->fd);
+                p->fd = -1;
+                p->end = now;
+                running--;
+            }
+        }
+        if (now - shown >= 500U) {
+            progress(ports, n, now - start, ' ');
+            shown = now;
+        }
+    }
+    uint32_t now = now_ms();
+    close(ep);
+    progress(ports, n, now - start, '\n');
+
+    int updated = 0;
+    for (int i = 0; i < n; i++) {
+        struct port *p = &ports[i];
+        if (p->err) {
+            printf("%s: %s\n", p->path, strerror(p->err));
+            continue;
+        }
+        printf("%s: %s, %u bytes in %.1f s (%.1f s erase), %u pages sent, %u resent, %u corrupted, %u timeouts\n",
+            p->path, p->h.result == 1 ? "done" : "device error", u->size, (p->end - start) / 1000.0,
+            p->ready ? (p->ready - start) / 1000.0 : 0.0, p->h.frames, p->h.resent, p->h.naks, p->h.timeouts);
+        updated += p->h.result == 1;
+    }
+    if (n > 1) {
+        printf("%d of %d devices updated, %u bytes in %.1f s: %.0f B/s together\n", updated, n,
+            updated * u->size, (now - start) / 1000.0, updated * u->size * 1000.0 / (now - start));
+    }
+    free(ports);
+    return updated == n ? 0 : -1;
+}
+
+/* --- Simulated device on a pseudo terminal --- */
+
+struct pty_device {
+    struct sim d;
+    int master;
+    int slave; // kept open: without a slave the master only reads EIO
+    uint8_t rx[16]; // like a UART FIFO, the rest waits in the pseudo terminal (so the host's writes block)
+    uint32_t rx_len;
+    uint32_t rx_pos;
+    uint64_t ticks;
+};
+
+static uint64_t now_us(void) {
+    struct timespec t;
+
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (uint64_t)t.tv_sec * 1000000U + (uint64_t)t.tv_nsec / 1000U;
+}
+
+static int pty_open(struct pty_device *p, uint32_t window, const uint8_t *key) {
+    struct termios tio;
+
+    memset(p, 0, sizeof(*p));
+    p->d.window = window;
+    p->d.key = key;
+    p->master = posix_openpt(O_RDWR | O_NOCTTY | O_NONBLOCK);
+    if (p->master < 0 || grantpt(p->master) != 0 || unlockpt(p->master) != 0) {
+        return -1;
+    }
+    const char *name = ptsname(p->master);
+    p->slave = name ? open(name, O_RDWR | O_NOCTTY) : -1;
+    if (p->slave < 0 || tcgetattr(p->slave, &tio) != 0) {
+        return -1;
+    }
+    // Raw already, so nothing is echoed before the uploader sets its own mode
+    cfmakeraw(&tio);
+    tcsetattr(p->slave, TCSANOW, &tio);
+    printf("%s\n", name);
+    fflush(stdout);
+    return 0;
+}
+
+/* Catch up with the line: one byte in and one main loop step per byte time */
+static void pty_step(struct pty_device *p, uint64_t ticks, double errors) {
+    while (p->ticks < ticks) {
+        p->ticks++;
+        if (p->rx_pos == p->rx_len) {
+            ssize_t n = read(p->master, p->rx, sizeof(p->rx));
+            p->rx_len = n > 0 ? (uint32_t)n : 0;
+            p->rx_pos = 0;
+        }
+        if (p->rx_pos < p->rx_len) {
+            sim_byte(&p->d, line(p->rx[p->rx_pos++], errors));
+        }
+        sim_tick(&p->d);
+    }
+    while (p->d.tx_pos < p->d.tx_len) {
+        ssize_t n = write(p->master, &p->d.tx[p->d.tx_pos], p->d.tx_len - p->d.tx_pos);
+        if (n <= 0) {
+            break;
+        }
+        p->d.tx_pos += (uint32_t)n;
+    }
+}
+
+static int serve(int n, uint32_t window, double errors, const uint8_t *key) {
+    struct pty_device *dev = calloc((size_t)n, sizeof(*dev));
+    struct pollfd *fds = calloc((size_t)n, sizeof(*fds));
+
+    if (!dev || !fds) {
+        perror("serve");
+        return -1;
+    }
+    for (int i = 0; i < n; i++) {
+        if (pty_open(&dev[i], window, key) != 0) {
+            perror("pseudo terminal");
+            return -1;
+        }
+        fds[i].fd = dev[i].master;
+        fds[i].events = POLLIN;
+    }
+    uint64_t start = now_us();
+    for (;;) {
+        poll(fds, (nfds_t)n, 1);
+        uint64_t ticks = (now_us() - start) * 11520U / 1000000U;
+        for (int i = 0; i < n; i++) {
+            pty_step(&dev[i], ticks, errors);
+        }
+    }
+}
+
+/* --- Command line --- */
+
+static int usage(void) {
+    fprintf(stderr, "usage: update_link [-k signing_key.pem] [-K update_key.bin] <tty>... <image.bin | update.pkg>\n"
+        "       update_link -d [-n devices] [-w window] [-e errors] [-K update_key.bin]\n"
+        "       update_link -s [-w window] [-e errors] [-r seed] <image.bin>\n");
+    return 2;
+}
+
+int main(int argc, char **argv) {
+    int mode = 0; // 's' simulation, 'd' device, else upload
+    uint32_t window = 0;
+    int devices = 1;
+    double errors = 0;
+    const char *sign_key = NULL;
+    const char *key_path = "keys/update_key.bin";
+    int i = 1;
+
+    for (; i < argc && argv[i][0] == '-'; i++) {
+        const char *opt = argv[i];
+        if (strcmp(opt, "-s") == 0 || strcmp(opt, "-d") == 0) {
+            mode = opt[1];
+            continue;
+        }
+        if (i + 1 == argc) {
+            return usage();
+        }
+        const char *v = argv[++i];
+        if (strcmp(opt, "-w") == 0) {
+            window = (uint32_t)atoi(v);
+        }
+        else if (strcmp(opt, "-n") == 0) {
+            devices = atoi(v);
+        }
+        else if (strcmp(opt, "-e") == 0) {
+            errors = atof(v);
+        }
+        else if (strcmp(opt, "-r") == 0) {
+            rng_state = (uint32_t)strtoul(v, NULL, 0) | 1U;
+        }
+        else if (strcmp(opt, "-k") == 0) {
+            sign_key = v;
+        }
+        else if (strcmp(opt, "-K") == 0) {
+            key_path = v;
+        }
+        else {
+            return usage();
+        }
+    }
+    if (window > MAX_WINDOW || devices < 1) {
+        return usage();
+    }
+
+    if (mode == 'd') {
+        static uint8_t key[AES128_KEY_SIZE];
+        uint32_t n;
+        if (i != argc) {
+            return usage();
+        }
+        if (read_file(key_path, key, sizeof(key), &n) != 0 || n != sizeof(key)) {
+            fprintf(stderr, "%s: expected a %u byte update key\n", key_path, AES128_KEY_SIZE);
+            return 1;
+        }
+        return serve(devices, window ? window : 2U, errors, key) == 0 ? 0 : 1;
+    }
+
+    if (mode == 's') {
+        static uint8_t image[UPDATE_SLOT_SIZE];
+        uint32_t size;
+        if (i + 1 != argc) {
+            return usage();
+        }
+        if (read_file(argv[i], image, sizeof(image), &size) != 0 || size == 0) {
+            return 1;
+        }
+        if (window) {
+            return simulate(image, size, window, errors) == 0 ? 0 : 1;
+        }
+        int failed = 0;
+        for (window = 1; window <= 4U; window *= 2U) {
+            failed |= simulate(image, size, window, errors);
+        }
+        return failed ? 1 : 0;
+    }
+
+    // Ports, then the image last
+    static struct upload u;
+    if (i + 2 > argc) {
+        return usage();
+    }
+    if (prepare(&u, argv[argc - 1], sign_key, key_path) != 0) {
+        return 1;
+    }
+    return upload(&argv[i], argc - 1 - i, &u) == 0 ? 0 : 1;
+}
@@ -0,0 +1,98 @@
+/*
+Polled USART2 driver, see uart.h
+*/
+
+#include "uart.h"
+
+// The core and the APB1 bus run from the 8 MHz HSI (reset clock configuration)
+#define UART_PCLK 8000000UL
+
+// RCC starts at 0x4002_1000, GPIOA at 0x4001_0800 (Table 3 (Register boundary addresses))
+#define RCC_BASE 0x40021000UL
+#define GPIOA_BASE 0x40010800UL
+
+// USART2 starts at 0x4000_4400 (USART2 in Table 3 (Register boundary addresses))
+#define USART2_BASE 0x40004400UL
+
+// volatile prevents compiler from optimizing (important for hardware access)
+#define REG32(addr) (*(volatile uint32_t *)(addr))
+
+#define RCC_APB2ENR REG32(RCC_BASE + 0x18UL) // APB2 peripheral clock enable register
+#define RCC_APB1ENR REG32(RCC_BASE + 0x1CUL) // APB1 peripheral clock enable register
+
+#define GPIOA_CRL REG32(GPIOA_BASE + 0x00UL) // Configuration Register Low
+
+// (USART register map, RM0008 Table 198)
+#define USART2_SR REG32(USART2_BASE + 0x00UL) // Status register
+#define USART2_DR REG32(USART2_BASE + 0x04UL) // Data register
+#define USART2_BRR REG32(USART2_BASE + 0x08UL) // Baud rate register
+#define USART2_CR1 REG32(USART2_BASE + 0x0CUL) // Control register 1
+
+// 7.3.7 / 7.3.8 peripheral clock enable registers
+#define RCC_APB2ENR_IOPAEN_BIT 2U
+#define RCC_APB1ENR_USART2EN_BIT 17U
+
+/* 9.2.1 port configuration register low
+ - PA2 (TX): alternate function push-pull, 2 MHz: CNF = 10, MODE = 10 -> 0b1010
+ - PA3 (RX): floating input: CNF = 01, MODE = 00 -> 0b0100
+*/
+#define GPIO_CRL_PIN2_SHIFT 8U
+#define GPIO_CRL_PIN3_SHIFT 12U
+#define GPIO_CRL_PIN_MASK 0xFU
+#define GPIO_CRL_AF_2MHZ_PP 0b1010
+#define GPIO_CRL_INPUT_F 0b0100
+
+// 27.6.1 Status register
+#define USART_SR_RXNE (1U << 5) // Read data register not empty
+#define USART_SR_TXE (1U << 7) // Transmit data register empty
+
+// 27.6.4 Control register 1
+#define USART_CR1_RE (1U << 2) // Receiver enable
+#define USART_CR1_TE (1U << 3) // Transmitter enable
+#define USART_CR1_UE (1U << 13) // USART enable
+
+void uart_init(uint32_t baud) {
+    RCC_APB2ENR |= (1U << RCC_APB2ENR_IOPAEN_BIT);
+    RCC_APB1ENR |= (1U << RCC_APB1ENR_USART2EN_BIT);
+
+    GPIOA_CRL &= ~((GPIO_CRL_PIN_MASK << GPIO_CRL_PIN2_SHIFT) | (GPIO_CRL_PIN_MASK << GPIO_CRL_PIN3_SHIFT));
+    GPIOA_CRL |= (GPIO_CRL_AF_2MHZ_PP << GPIO_CRL_PIN2_SHIFT) | (GPIO_CRL_INPUT_F << GPIO_CRL_PIN3_SHIFT);
+
+    // 27.3.4: BRR = PCLK / baud as a 12.4 fixed-point number, which is just the rounded quotient
+    USART2_BRR = (UART_PCLK + baud / 2U) / baud;
+    USART2_CR1 = USART_CR1_UE | USART_CR1_TE | USART_CR1_RE;
+}
+
+void uart_putc(uint8_t c) {
+    while (!(USART2_SR & USART_SR_TXE)) {
+    }
+    USART2_DR = c;
+}
+
+void uart_write(const void *data, uint32_t len) {
+    const uint8_t *p = data;
+
+    while (len--) {
+        uart_putc(*p++);
+    }
+}
+
+void uart_puts(const char *s) {
+    while (*s) {
+        uart_putc((uint8_t)*s++);
+    }
+}
+
+void uart_puthex32(uint32_t v) {
+    for (int shift = 28; shift >= 0; shift -= 4) {
+        uint32_t digit = (v >> shift) & 0xFU;
+        uart_putc((uint8_t)(digit < 10U ? '0' + digit : 'a' + digit - 10U));
+    }
+}
+
+int uart_getc(void) {
+    if (!(USART2_SR & USART_SR_RXNE)) {
+        return -1;
+    }
+    return (int)(USART2_DR & 0xFFU);
+}
@@ -0,0 +1,27 @@
+/*
+Polled USART2 driver (PA2 TX, PA3 RX)
+
+On the Nucleo-F103RB USART2 is wired to the ST-LINK, which shows up on the PC as a
+virtual COM port: no extra hardware is needed to talk to the board.
+8N1, no flow control.
+*/
+#ifndef UART_H
+#define UART_H
+
+#include <stdint.h>
+
+#define UART_BAUD 115200U
+
+// Enable the clocks, configure PA2 / PA3 and the USART
+void uart_init(uint32_t baud);
+
+// Blocking send
+void uart_putc(uint8_t c);
+void uart_write(const void *data, uint32_t len);
+void uart_puts(const char *s);
+void uart_puthex32(uint32_t v); // 8 hex digits
+
+// Received byte, or -1 if none is waiting
+int uart_getc(void);
+
+#endif
@@ -0,0 +1,193 @@
+/*
+Update state page and slot swap, see update.h
+
+State page layout:
+    0x000  header: magic, size, crc, ~(magic ^ size ^ crc)
+    0x010  flags, one half-word each (0xFFFF not reached, 0x0000 reached):
+           swapped, confirmed, revert started, reverted
+    0x040  install progress: 3 half-words per page (the 3 steps of the swap)
+    0x180  revert progress, same layout
+
+Swapping page i (each step's source stays intact until the next step, so a step
+interrupted by a power loss is simply done again):
+    1. scratch <- A[i]
+    2. A[i] <- B[i]
+    3. B[i] <- scratch
+*/
+
+#include <stddef.h>
+#include "update.h"
+#include "flash.h"
+#include "crc.h"
+
+// volatile prevents compiler from optimizing (flash changes under our feet)
+#define REG16(addr) (*(volatile uint16_t *)(uintptr_t)(addr))
+#define REG32(addr) (*(volatile uint32_t *)(uintptr_t)(addr))
+
+#define STATE_MAGIC 0x55504454UL // "UPDT"
+
+#define HDR_MAGIC (UPDATE_STATE + 0x00UL)
+#define HDR_SIZE (UPDATE_STATE + 0x04UL)
+#define HDR_CRC (UPDATE_STATE + 0x08UL)
+#define HDR_CHECK (UPDATE_STATE + 0x0CUL)
+
+#define FLAG_SWAPPED (UPDATE_STATE + 0x10UL)
+#define FLAG_CONFIRMED (UPDATE_STATE + 0x12UL)
+#define FLAG_REVERT_STARTED (UPDATE_STATE + 0x14UL)
+#define FLAG_REVERTED (UPDATE_STATE + 0x16UL)
+
+#define PROGRESS_INSTALL (UPDATE_STATE + 0x040UL)
+#define PROGRESS_REVERT (UPDATE_STATE + 0x180UL)
+
+#define SLOT_PAGES (UPDATE_SLOT_SIZE / FLASH_PAGE_SIZE)
+
+_Static_assert(PROGRESS_INSTALL + 3U * 2U * SLOT_PAGES <= PROGRESS_REVERT, "install progress overlaps");
+_Static_assert(PROGRESS_REVERT + 3U * 2U * SLOT_PAGES <= UPDATE_STATE + FLASH_PAGE_SIZE, "revert progress doesn't fit");
+
+static int flag_set(uint32_t addr) {
+    uint16_t zero = 0;
+
+    return flash_program(addr, &zero, sizeof(zero));
+}
+
+static int flag_is_set(uint32_t addr) {
+    return REG16(addr) == 0;
+}
+
+enum update_state update_get_state(struct update_image *image) {
+    uint32_t magic = REG32(HDR_MAGIC);
+    uint32_t size = REG32(HDR_SIZE);
+    uint32_t crc = REG32(HDR_CRC);
+
+    if (magic != STATE_MAGIC || REG32(HDR_CHECK) != ~(magic ^ size ^ crc) || size == 0 || size > UPDATE_SLOT_SIZE) {
+        return UPDATE_NONE;
+    }
+    if (image) {
+        image->size = size;
+        image->crc = crc;
+    }
+
+    if (flag_is_set(FLAG_REVERTED)) {
+        return UPDATE_REVERTED;
+    }
+    if (flag_is_set(FLAG_REVERT_STARTED)) {
+        return UPDATE_REVERTING;
+    }
+    if (flag_is_set(FLAG_CONFIRMED)) {
+        return UPDATE_CONFIRMED;
+    }
+    if (flag_is_set(FLAG_SWAPPED)) {
+        return UPDATE_TESTING;
+    }
+    return UPDATE_PENDING;
+}
+
+int update_set_pending(uint32_t size, uint32_t crc) {
+    uint32_t header[4] = { STATE_MAGIC, size, crc, ~(STATE_MAGIC ^ size ^ crc) };
+
+    if (size == 0 || size > UPDATE_SLOT_SIZE) {
+        return -1;
+    }
+    if (flash_erase_page(UPDATE_STATE) != 0) {
+        return -1;
+    }
+    return flash_program(UPDATE_STATE, header, sizeof(header));
+}
+
+int update_confirm(void) {
+    if (update_get_state(NULL) != UPDATE_TESTING) {
+        return 0;
+    }
+    return flag_set(FLAG_CONFIRMED);
+}
+
+/* --- Swap (bootloader) --- */
+
+static int page_is_blank(uint32_t addr) {
+    for (uint32_t i = 0; i < FLASH_PAGE_SIZE; i += 4U) {
+        if (REG32(addr + i) != 0xFFFFFFFFUL) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+static int page_copy(uint32_t dst, uint32_t src) {
+    if (!page_is_blank(dst) && flash_erase_page(dst) != 0) {
+        return -1;
+    }
+    return flash_program(dst, (const void *)(uintptr_t)src, FLASH_PAGE_SIZE);
+}
+
+static int swap(uint32_t progress, uint32_t size) {
+    uint32_t pages = (size + FLASH_PAGE_SIZE - 1U) / FLASH_PAGE_SIZE;
+
+    for (uint32_t i = 0; i < pages; i++) {
+        uint32_t a = UPDATE_SLOT_A + i * FLASH_PAGE_SIZE;
+        uint32_t b = UPDATE_SLOT_B + i * FLASH_PAGE_SIZE;
+        uint32_t mark = progress + i * 3U * 2U;
+
+        if (!flag_is_set(mark)) {
+            if (page_copy(UPDATE_SCRATCH, a) != 0 || flag_set(mark) != 0) {
+                return -1;
+            }
+        }
+        if (!flag_is_set(mark + 2U)) {
+            if (page_copy(a, b) != 0 || flag_set(mark + 2U) != 0) {
+                return -1;
+            }
+        }
+        if (!flag_is_set(mark + 4U)) {
+            if (page_copy(b, UPDATE_SCRATCH) != 0 || flag_set(mark + 4U) != 0) {
+                return -1;
+            }
+        }
+    }
+    return 0;
+}
+
+int update_install(int (*check)(uint32_t slot)) {
+    struct update_image image;
+
+    if (update_get_state(&image) != UPDATE_PENDING) {
+        return -1;
+    }
+    // Before the first step slot B must still match (afterwards it's half swapped)
+    if (!flag_is_set(PROGRESS_INSTALL) &&
+        (crc32(0, (const void *)UPDATE_SLOT_B, image.size) != image.crc || check(UPDATE_SLOT_B) != 0)) {
+        flash_erase_page(UPDATE_STATE); // forget the broken or unsigned image (back to NONE)
+        return -1;
+    }
+    if (swap(PROGRESS_INSTALL, image.size) != 0) {
+        return -1;
+    }
+    return flag_set(FLAG_SWAPPED);
+}
+
+int update_revert(void) {
+    struct update_image image;
+    enum update_state state = update_get_state(&image);
+
+    if (state != UPDATE_TESTING && state != UPDATE_REVERTING) {
+        return -1;
+    }
+    if (state == UPDATE_TESTING && flag_set(FLAG_REVERT_STARTED) != 0) {
+        return -1;
+    }
+    if (swap(PROGRESS_REVERT, image.size) != 0) {
+        return -1;
+    }
+    return flag_set(FLAG_REVERTED);
+}
+
+enum update_boot update_boot(uint32_t wdg_resets, int (*check)(uint32_t slot)) {
+    enum update_state state = update_get_state(NULL);
+
+    if (state == UPDATE_PENDING) {
+        return update_install(check) == 0 ? UPDATE_BOOT_INSTALLED : UPDATE_BOOT_FAILED;
+    }
+    if ((state == UPDATE_TESTING && wdg_resets >= UPDATE_MAX_WDG_RESETS) || state == UPDATE_REVERTING) {
+        return update_revert() == 0 ? UPDATE_BOOT_REVERTED : UPDATE_BOOT_FAILED;
+    }
+    return state == UPDATE_TESTING ? UPDATE_BOOT_TESTING : UPDATE_BOOT_NONE;
+}
@@ -0,0 +1,88 @@
+/*
+Firmware update: flash layout and update state (shared by the app and the bootloader)
+
+Flash map after the 16 KB bootloader (1 KB pages):
+    0x08004000  slot A, 51 KB: the app that runs (main_memory.ld)
+    0x08010C00  slot B, 51 KB: a new image is downloaded here (updater.h), and the
+                previous app ends up here after an update (for the rollback)
+    0x0801D800  transfer journal (updater.c, resumes an interrupted download), 1 KB spare
+    0x0801E000  swap scratch page
+    0x0801E400  update state page (below)
+    0x0801E800  event log (evlog.h), 0x0801F800 key-value store (kv.h)
+
+An update goes through these states, kept in the state page:
+    NONE -> PENDING     the app downloaded and checked an image in slot B
+            TESTING     the bootloader swapped slot A and B page by page
+            CONFIRMED   the new app ran healthy for a while (update_confirm())
+ or TESTING -> REVERTING -> REVERTED
+                        it didn't (watchdog resets): the bootloader swapped back
+
+The state page is only erased when a new image is marked pending. After that every
+step programs one more half-word to 0x0000, so a power loss at any point leaves a
+state the bootloader can resume from.
+*/
+#ifndef UPDATE_H
+#define UPDATE_H
+
+#include <stdint.h>
+
+#define UPDATE_SLOT_A 0x08004000UL
+#define UPDATE_SLOT_B 0x08010C00UL
+#define UPDATE_SLOT_SIZE (51U * 1024U)
+#define UPDATE_JOURNAL 0x0801D800UL
+#define UPDATE_SCRATCH 0x0801E000UL
+#define UPDATE_STATE 0x0801E400UL
+
+#define UPDATE_MAX_WDG_RESETS 3U // watchdog resets in a row that revert a new app on trial
+
+enum update_state {
+    UPDATE_NONE,
+    UPDATE_PENDING, // swap not started or interrupted
+    UPDATE_TESTING,
+    UPDATE_CONFIRMED,
+    UPDATE_REVERTING,
+    UPDATE_REVERTED,
+};
+
+// Image described by the state page
+struct update_image {
+    uint32_t size;
+    uint32_t crc; // crc32 of the size bytes
+};
+
+enum update_state update_get_state(struct update_image *image);
+
+// Mark the image in slot B (already checked against crc) for installation on the next boot
+int update_set_pending(uint32_t size, uint32_t crc);
+
+// The app runs fine: keep it. Does nothing unless the state is TESTING.
+int update_confirm(void);
+
+/*
+Bootloader only: swap the first pages of slot A and B that hold image (through the
+scratch page), resuming an interrupted swap. Swapping the same pages again undoes it,
+which is how a revert works. Each page costs 3 erases and 3 page writes (~150 ms).
+update_install() first calls check(UPDATE_SLOT_B) (the signature check, image.h) and
+drops the image unless it returns 0.
+*/
+int update_install(int (*check)(uint32_t slot));
+int update_revert(void);
+
+enum update_boot {
+    UPDATE_BOOT_NONE, // no update going on
+    UPDATE_BOOT_INSTALLED, // the new app is in slot A, on trial
+    UPDATE_BOOT_TESTING, // the new app is still on trial
+    UPDATE_BOOT_REVERTED, // the previous app is back in slot A
+    UPDATE_BOOT_FAILED, // install or revert failed (a refused image is forgotten: NONE next time)
+};
+
+/*
+Bootloader only, at every boot: install a pending image, or revert the new app if
+it ran into UPDATE_MAX_WDG_RESETS watchdog resets in a row (wdg_resets) before
+confirming itself, or if a revert was interrupted. INSTALLED, TESTING and REVERTED: start the app without the button.
+A new app on trial that waited for it could neither confirm itself nor run up the
+watchdog resets that revert it.
+*/
+enum update_boot update_boot(uint32_t wdg_resets, int (*check)(uint32_t slot));
+
+#endif
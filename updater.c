@@ -0,0 +1,536 @@
+/*
+Background firmware download, see updater.h
+*/
+
+#include <stddef.h>
+#include "updater.h"
+#include "update.h"
+#include "flash.h"
+#include "crc.h"
+#include "uart.h"
+#include "aes.h"
+#include "cobs.h"
+#include "update_key.h" // UPDATE_AES_KEY, generated by build.sh from keys/
+
+// USART2 starts at 0x4000_4400 (USART2 in Table 3 (Register boundary addresses)), driver in uart.c
+#define USART2_BASE 0x40004400UL
+
+// volatile prevents compiler from optimizing (important for hardware access)
+#define REG32(addr) (*(volatile uint32_t *)(addr))
+
+#define USART2_SR REG32(USART2_BASE + 0x00UL) // Status register
+#define USART2_DR REG32(USART2_BASE + 0x04UL) // Data register
+#define USART2_CR1 REG32(USART2_BASE + 0x0CUL) // Control register 1
+
+// 27.6.1 Status register: reading it, then DR, clears these
+#define USART_SR_ORE (1U << 3) // Overrun: bytes lost while DR was full (e.g. during a flash erase)
+#define USART_SR_NE (1U << 2) // Noise on the line
+#define USART_SR_FE (1U << 1) // Framing error
+
+// 27.6.4 Control register 1
+#define USART_CR1_RXNEIE (1U << 5) // Interrupt when a byte is received
+
+// (PM0056 Table 44 (NVIC register summary)), USART2 is IRQ 38 (RM0008 Table 63 (Vector table))
+#define NVIC_ISER1 REG32(0xE000E104UL) // Interrupt set-enable register for IRQ 32..63
+#define NVIC_IPR(irq) (*(volatile uint8_t *)(0xE000E400UL + (irq))) // Interrupt priority, a byte per IRQ (4.3.7, top 4 bits)
+#define USART2_IRQ 38U
+
+#define PAGE FLASH_PAGE_SIZE
+
+static const uint8_t aes_key[AES128_KEY_SIZE] = UPDATE_AES_KEY;
+
+/*
+Transfer journal (first page of UPDATE_JOURNAL): which transfer, then one entry per
+page programmed into slot B, with the running CRC32 of the image up to that page.
+The header's check is written last and an entry holds its page number twice, so a
+power loss while writing one leaves something that is simply ignored.
+*/
+#define JOURNAL_MAGIC 0x4C4E524AUL // "JRNL"
+
+struct journal_header {
+    uint32_t magic;
+    uint32_t size;
+    uint32_t crc;
+    uint8_t iv[AES_BLOCK];
+    uint32_t check; // ~(magic ^ size ^ crc ^ iv words)
+};
+
+struct journal_entry {
+    uint16_t page;
+    uint16_t page_check; // ~page
+    uint32_t crc; // running CRC32 of pages 0 .. page
+};
+
+#define JOURNAL_ENTRIES ((PAGE - sizeof(struct journal_header)) / sizeof(struct journal_entry))
+
+_Static_assert(JOURNAL_ENTRIES >= UPDATE_SLOT_SIZE / PAGE, "journal too small");
+
+/*
+Frames (updater.h): type, fields, CRC16. The CRC goes out big endian, so the CRC16
+over a whole frame is 0.
+*/
+#define FRAME_BEGIN_LEN (1U + 24U + 2U)
+#define FRAME_PAGE_LEN (1U + 1U + PAGE + 2U)
+#define FRAME_REBOOT_LEN (1U + 2U)
+#define FRAME_CAPTURE_LEN (1U + 11U + 2U)
+#define STATUS_LEN 6U
+
+#define NO_BUFFER 0xFFU
+
+_Static_assert(UPDATE_SLOT_SIZE / PAGE <= 0xFFU, "page numbers are one byte");
+_Static_assert(UPDATER_WINDOW == 2U, "one page buffer per page in flight");
+
+enum phase { PHASE_IDLE, PHASE_ERASING, PHASE_RECEIVING };
+
+/* Shared with the interrupt */
+static uint8_t pages[UPDATER_WINDOW][PAGE]; // page n goes into pages[n & 1]
+static uint8_t keystream[UPDATER_WINDOW][PAGE]; // for the page received into pages[i] next
+static struct cobs_decoder link; // interrupt only
+static volatile struct {
+    uint32_t len; // decoded bytes of the current frame
+    uint16_t crc; // of them
+    uint8_t type;
+    uint8_t target; // page buffer the current 'P' frame goes to, NO_BUFFER to drop it
+    uint8_t dropping; // bytes of the current frame were lost: skip to its end, answer 'N'
+    uint32_t full[UPDATER_WINDOW]; // page buffer waiting to be programmed
+    uint32_t base; // window: pages base .. limit - 1 are accepted (set by the main loop)
+    uint32_t limit;
+    uint32_t begin; // 'U' frame complete
+    uint32_t reboot; // 'b' frame complete
+    uint32_t capture; // 'L' frame complete
+    uint8_t events[4]; // 'A' / 'N' for each frame, answered from the main loop
+    uint32_t ev_head;
+    uint32_t ev_tail;
+    uint8_t args[24];
+    uint8_t capture_args[11];
+} rx;
+
+/* Main loop side */
+static struct {
+    uint32_t phase;
+    uint32_t size;
+    uint32_t crc; // expected
+    uint32_t running_crc;
+    uint32_t erase_addr;
+    uint32_t erase_end;
+    uint32_t num_pages;
+    uint32_t page; // page being programmed
+    uint32_t offset; // in that page
+    uint32_t buf;
+    struct aes128 aes;
+    uint8_t iv[AES_BLOCK];
+    uint32_t ks_page; // page whose keystream is being computed
+    uint32_t ks_offset; // in that page
+    uint32_t journal_slot; // next free journal entry
+    uint32_t sent_base; // window in the last status sent
+    uint32_t sent_limit;
+} up;
+
+void updater_init(void) {
+    cobs_reset(&link);
+    rx.crc = CRC16_CCITT_INIT;
+    USART2_CR1 |= USART_CR1_RXNEIE;
+    NVIC_IPR(USART2_IRQ) = UPDATER_IRQ_PRIORITY;
+    NVIC_ISER1 = 1U << (USART2_IRQ - 32U);
+}
+
+static void rx_event(uint8_t kind) {
+    uint32_t head = rx.ev_head;
+
+    if (head - rx.ev_tail < sizeof(rx.events)) { // else dropped, the host times out
+        rx.events[head % sizeof(rx.events)] = kind;
+        rx.ev_head = head + 1U;
+    }
+}
+
+static void frame_end(void) {
+    uint32_t len = rx.len;
+    uint16_t crc = rx.crc;
+
+    rx.len = 0;
+    rx.crc = CRC16_CCITT_INIT;
+    if (len == 0) {
+        return; // extra delimiter
+    }
+    if (crc != 0) {
+        rx_event('N');
+        return;
+    }
+    if (rx.type == 'P' && len == FRAME_PAGE_LEN) {
+        if (rx.target != NO_BUFFER) {
+            rx.full[rx.target] = 1;
+        }
+        rx_event('A'); // also for a page outside the window (already in, or too early)
+    }
+    else if (rx.type == 'U' && len == FRAME_BEGIN_LEN) {
+        rx.begin = 1; // answered with 'R'
+    }
+    else if (rx.type == 'b' && len == FRAME_REBOOT_LEN) {
+        rx.reboot = 1;
+    }
+    else if (rx.type == 'L' && len == FRAME_CAPTURE_LEN) {
+        rx.capture = 1;
+    }
+    else {
+        rx_event('N');
+    }
+}
+
+void USART2_IRQHandler(void) {
+    // SR then DR: clears RXNE and the error flags (an ORE left set keeps the interrupt pending)
+    uint32_t sr = USART2_SR;
+    int d = cobs_decode(&link, (uint8_t)USART2_DR);
+
+    if (sr & (USART_SR_ORE | USART_SR_NE | USART_SR_FE)) {
+        // The frame in progress is damaged: drop it, the host sends it again on the 'N'
+        if (d != COBS_END) {
+            cobs_reset(&link);
+        }
+        rx.len = 0;
+        rx.crc = CRC16_CCITT_INIT;
+        rx.dropping = 1;
+    }
+    if (d == COBS_END) {
+        if (rx.dropping) {
+            rx.dropping = 0;
+            rx.len = 0;
+            rx.crc = CRC16_CCITT_INIT;
+            rx_event('N');
+            return;
+        }
+        frame_end();
+        return;
+    }
+    if (d == COBS_SKIP || rx.dropping) {
+        return;
+    }
+    uint8_t c = (uint8_t)d;
+    uint32_t n = rx.len;
+
+    rx.len = n + 1U;
+    rx.crc = crc16_ccitt(rx.crc, &c, 1);
+    if (n == 0) {
+        rx.type = c;
+        rx.target = NO_BUFFER;
+    }
+    else if (rx.type == 'P') {
+        if (n == 1) {
+            // Only a page of the window whose buffer is free. A bad frame may have written
+            // into a free buffer, but it never becomes full: the page comes again.
+            if (c >= rx.base && c < rx.limit && !rx.full[c & 1U]) {
+                rx.target = c & 1U;
+            }
+        }
+        else if (rx.target != NO_BUFFER && n - 2U < PAGE) {
+            // Decrypted on the way into the page buffer: one XOR with the precomputed keystream
+            pages[rx.target][n - 2U] = c ^ keystream[rx.target][n - 2U];
+        }
+    }
+    else if (rx.type == 'U' && n - 1U < sizeof(rx.args)) {
+        rx.args[n - 1U] = c;
+    }
+    else if (rx.type == 'L' && n - 1U < sizeof(rx.capture_args)) {
+        rx.capture_args[n - 1U] = c;
+    }
+}
+
+static uint16_t get16(const volatile uint8_t *p) {
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+static uint32_t get32(const volatile uint8_t *p) {
+    return p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+/* Status frame: kind, the window and which of its pages are in (updater.h) */
+static void send_status(uint8_t kind) {
+    uint8_t s[STATUS_LEN] = { kind, (uint8_t)rx.base, (uint8_t)rx.limit, 0 };
+    uint8_t out[COBS_MAX(STATUS_LEN) + 1U];
+
+    for (uint32_t i = 0; i < UPDATER_WINDOW; i++) {
+        uint32_t page = rx.base + i;
+        if (page < rx.limit && rx.full[page & 1U]) {
+            s[3] |= (uint8_t)(1U << i);
+        }
+    }
+    uint16_t crc = crc16_ccitt(CRC16_CCITT_INIT, s, STATUS_LEN - 2U);
+    s[4] = (uint8_t)(crc >> 8);
+    s[5] = (uint8_t)crc;
+    uint32_t n = cobs_encode(out, s, STATUS_LEN);
+    out[n++] = 0;
+    uart_write(out, n);
+    up.sent_base = rx.base;
+    up.sent_limit = rx.limit;
+}
+
+static void fail(void) {
+    rx.limit = rx.base; // nothing accepted any more
+    send_status('E');
+    up.phase = PHASE_IDLE;
+}
+
+static int page_blank(uint32_t addr) {
+    const uint32_t *p = (const uint32_t *)(uintptr_t)addr;
+
+    for (uint32_t i = 0; i < PAGE / 4U; i++) {
+        if (p[i] != 0xFFFFFFFFUL) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+/* --- Journal --- */
+
+static uint32_t journal_check(const struct journal_header *h) {
+    uint32_t check = h->magic ^ h->size ^ h->crc;
+
+    for (uint32_t i = 0; i < AES_BLOCK; i += 4U) {
+        check ^= get32(&h->iv[i]);
+    }
+    return ~check;
+}
+
+/*
+Pages of the transfer up.size / up.crc / up.iv that are already in slot B (0 if the
+journal is about another transfer, or slot B doesn't match it). Sets up.running_crc
+and up.journal_slot.
+*/
+static uint32_t journal_resume(void) {
+    const struct journal_header *h = (const struct journal_header *)UPDATE_JOURNAL;
+    const struct journal_entry *e = (const struct journal_entry *)(UPDATE_JOURNAL + sizeof(*h));
+    uint32_t pages = 0;
+    uint32_t crc = 0;
+
+    if (h->magic != JOURNAL_MAGIC || h->check != journal_check(h) || h->size != up.size || h->crc != up.crc) {
+        return 0;
+    }
+    for (uint32_t i = 0; i < AES_BLOCK; i++) {
+        if (h->iv[i] != up.iv[i]) {
+            return 0;
+        }
+    }
+    uint32_t slot = 0;
+    for (; slot < JOURNAL_ENTRIES; slot++) {
+        if (e[slot].page == 0xFFFFU && e[slot].page_check == 0xFFFFU && e[slot].crc == 0xFFFFFFFFUL) {
+            break; // first blank entry
+        }
+        // Anything else than the next page is a torn write
+        if (e[slot].page == pages && e[slot].page_check == (uint16_t)~pages) {
+            pages++;
+            crc = e[slot].crc;
+        }
+    }
+    // The pages themselves must still be what was received
+    if (pages > up.num_pages || crc32(0, (const void *)UPDATE_SLOT_B, pages * PAGE < up.size ? pages * PAGE : up.size) != crc) {
+        return 0;
+    }
+    up.journal_slot = slot;
+    up.running_crc = crc;
+    return pages;
+}
+
+/* Start the journal of a new transfer */
+static int journal_begin(void) {
+    struct journal_header h;
+
+    h.magic = JOURNAL_MAGIC;
+    h.size = up.size;
+    h.crc = up.crc;
+    for (uint32_t i = 0; i < AES_BLOCK; i++) {
+        h.iv[i] = up.iv[i];
+    }
+    h.check = journal_check(&h);
+    up.journal_slot = 0;
+    up.running_crc = 0;
+    if (!page_blank(UPDATE_JOURNAL) && flash_erase_page(UPDATE_JOURNAL) != 0) {
+        return -1;
+    }
+    return flash_program(UPDATE_JOURNAL, &h, sizeof(h));
+}
+
+/* Page is in slot B (a full journal only costs the resume point) */
+static int journal_append(uint32_t page) {
+    struct journal_entry e = { (uint16_t)page, (uint16_t)~page, up.running_crc };
+    uint32_t addr = UPDATE_JOURNAL + sizeof(struct journal_header) + up.journal_slot * sizeof(e);
+
+    if (up.journal_slot >= JOURNAL_ENTRIES) {
+        return 0;
+    }
+    up.journal_slot++;
+    return flash_program(addr, &e, sizeof(e));
+}
+
+/* --- Transfer --- */
+
+static void start(void) {
+    uint32_t size = get32(&rx.args[0]);
+    uint32_t num_pages = (size + PAGE - 1U) / PAGE;
+
+    // While a new app is on trial or being reverted, slot B holds the previous one (the way back)
+    enum update_state state = update_get_state(NULL);
+    if (state != UPDATE_NONE && state != UPDATE_CONFIRMED && state != UPDATE_REVERTED) {
+        fail();
+        return;
+    }
+    if (size == 0 || size > UPDATE_SLOT_SIZE) {
+        fail();
+        return;
+    }
+    up.size = size;
+    up.crc = get32(&rx.args[4]);
+    up.num_pages = num_pages;
+    for (uint32_t i = 0; i < AES_BLOCK; i++) {
+        up.iv[i] = rx.args[8U + i];
+    }
+
+    // The same transfer again (same image, same iv): continue after the journaled pages
+    uint32_t first = journal_resume();
+    if (first == 0 && journal_begin() != 0) {
+        fail();
+        return;
+    }
+    up.erase_addr = UPDATE_SLOT_B + first * PAGE;
+    up.erase_end = UPDATE_SLOT_B + num_pages * PAGE;
+    up.page = first;
+    up.offset = 0;
+    up.buf = first & 1U; // page n always goes through buffer n & 1
+    aes128_init(&up.aes, aes_key);
+    up.ks_page = first;
+    up.ks_offset = 0;
+    // Empty window until 'R' (the host waits for it before sending pages)
+    rx.base = first;
+    rx.limit = first;
+    rx.full[0] = 0;
+    rx.full[1] = 0;
+    up.phase = PHASE_ERASING;
+}
+
+/*
+Compute UPDATER_CHUNK bytes of keystream. Page n is received into buffer n & 1, so its
+keystream can be written there once page n - 2 is programmed (out of the window).
+Pages before up.ks_page have their keystream: that's the end of the window.
+*/
+static void keystream_step(void) {
+    if (up.ks_page >= up.num_pages || up.ks_page >= up.page + UPDATER_WINDOW) {
+        return;
+    }
+    uint32_t block = (up.ks_page * PAGE + up.ks_offset) / AES_BLOCK;
+    aes128_ctr_keystream(&up.aes, up.iv, block, &keystream[up.ks_page & 1U][up.ks_offset], UPDATER_CHUNK / AES_BLOCK);
+    up.ks_offset += UPDATER_CHUNK;
+    if (up.ks_offset == PAGE) {
+        up.ks_page++;
+        up.ks_offset = 0;
+    }
+}
+
+/* One step of the receiving phase. Returns 1 when the image is complete and pending. */
+static int program_step(void) {
+    if (rx.full[up.buf]) {
+        uint32_t done = up.page * PAGE + up.offset;
+        uint32_t n = up.size - done;
+
+        if (n > PAGE - up.offset) {
+            n = PAGE - up.offset;
+        }
+        if (n > UPDATER_CHUNK) {
+            n = UPDATER_CHUNK;
+        }
+        const uint8_t *src = &pages[up.buf][up.offset];
+        if (flash_program(UPDATE_SLOT_B + done, src, n) != 0) {
+            fail();
+            return 0;
+        }
+        up.running_crc = crc32(up.running_crc, src, n);
+        up.offset += n;
+
+        if (up.offset == PAGE || done + n == up.size) {
+            if (journal_append(up.page) != 0) {
+                fail();
+                return 0;
+            }
+            up.page++;
+            rx.base = up.page; // first, so the interrupt doesn't take this page again into the freed buffer
+            rx.full[up.buf] = 0;
+            up.buf ^= 1U;
+            up.offset = 0;
+        }
+    }
+
+    if (up.page * PAGE >= up.size) {
+        if (up.running_crc != up.crc || update_set_pending(up.size, up.crc) != 0) {
+            fail();
+            return 0;
+        }
+        flash_erase_page(UPDATE_JOURNAL); // done, nothing to resume (slot B is swapped next)
+        send_status('D');
+        up.phase = PHASE_IDLE;
+        return 1;
+    }
+
+    // Answer every frame (the host matches them with what it sent), then tell it when the
+    // window moves: a page programmed, or the next page's keystream ready
+    while (rx.ev_tail != rx.ev_head) {
+        send_status(rx.events[rx.ev_tail % sizeof(rx.events)]);
+        rx.ev_tail++;
+    }
+    rx.limit = up.ks_page;
+    if (rx.base != up.sent_base || rx.limit != up.sent_limit) {
+        send_status('W');
+    }
+    return 0;
+}
+
+int updater_poll(void) {
+    if (rx.reboot) {
+        rx.reboot = 0;
+        return UPDATER_REBOOT;
+    }
+    if (rx.capture) {
+        rx.capture = 0;
+        return UPDATER_CAPTURE;
+    }
+    if (rx.begin) {
+        rx.begin = 0;
+        start();
+    }
+
+    switch (up.phase) {
+    case PHASE_ERASING:
+        // One page per call, so the main loop keeps running between the 20 ms stalls
+        if (up.erase_addr < up.erase_end) {
+            if (!page_blank(up.erase_addr) && flash_erase_page(up.erase_addr) != 0) {
+                fail();
+                break;
+            }
+            up.erase_addr += PAGE;
+        }
+        keystream_step();
+        // The first page can come once its keystream is there (unless every page is already in)
+        if (up.erase_addr == up.erase_end && (up.ks_page > up.page || up.page == up.num_pages)) {
+            up.phase = PHASE_RECEIVING;
+            rx.ev_tail = rx.ev_head; // nothing to answer from before
+            rx.limit = up.ks_page;
+            send_status('R'); // base: where the host starts (after the pages of an interrupted transfer)
+        }
+        break;
+    case PHASE_RECEIVING:
+        keystream_step();
+        if (program_step()) {
+            return UPDATER_DONE;
+        }
+        break;
+    default:
+        break;
+    }
+    return UPDATER_IDLE;
+}
+
+void updater_capture(struct logic_config *c) {
+    c->port = rx.capture_args[0];
+    c->channels = get16(&rx.capture_args[1]);
+    c->mask = get16(&rx.capture_args[3]);
+    c->value = get16(&rx.capture_args[5]);
+    c->period = get16(&rx.capture_args[7]);
+    c->post = get16(&rx.capture_args[9]);
+}
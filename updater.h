@@ -0,0 +1,100 @@
+/*
+Background firmware download (app side of an update)
+
+The app keeps running while a new image arrives over USART2 and is written into
+slot B (update.h):
+- The image travels encrypted (AES-128-CTR, aes.h, key from build.sh). The USART
+  receive interrupt decrypts each byte as it stores it into one of two 1 KB page
+  buffers (so the next page arrives while the previous one is programmed): CTR
+  keystream doesn't depend on the data, so updater_poll() computes it ahead, one
+  page per buffer, and the interrupt only XORs. No extra pass over the data.
+- updater_poll(), called from the main loop, does the flash work in small steps:
+  one page erase or UPDATER_CHUNK bytes of programming per call. A half-word write
+  stalls flash fetches (so every interrupt) for ~50 us, less than one UART byte
+  time (87 us at 115200), so no byte is lost while the data flows. The 20 ms page
+  erases all happen before the first page is requested, when the line is quiet
+  (SysTick loses ticks during them).
+- The CRC32 of the (decrypted) image is computed from the page buffers as they are written
+  (no second pass over flash). When it matches, the image is marked pending and
+  the app resets (when it's ready to): the bootloader then only checks and swaps it in.
+- Every page written to slot B is recorded in a flash journal (UPDATE_JOURNAL) with
+  the running CRC32 up to it. If the link or the power drops, the host sends the same
+  'U' again (same image and iv) and the transfer continues after the last journaled
+  page, once its CRC over slot B still matches.
+
+Link: a sliding window of UPDATER_WINDOW pages, one per page buffer. The host sends
+the pages of the window back to back without waiting for each one to be acknowledged,
+so the line stays busy while the device programs the previous page. A corrupted page
+is sent again on its own (selective repeat), not with everything after it.
+
+Frames both ways are COBS encoded (cobs.h) and end with a 0 byte:
+    type(1) fields... crc16(2)
+crc16 is crc16_ccitt over type and fields, big endian. Values are little endian.
+
+Host -> device:
+    'U' size(4) crc32(4) iv(16)    start an update (or continue an interrupted one)
+    'P' page(1) data(1024)         page of the image (pages of the window only, others are dropped)
+    'b'                            reboot into the bootloader
+    'L' port(1) channels(2) mask(2) value(2) period(2) post(2)
+                                   arm a logic analyzer capture (logic.h), answered with its frames
+Device -> host, a status:
+    kind(1) base(1) limit(1) have(1)
+    kind: 'R' slot B erased, send pages from base on (0, or where an interrupted
+              transfer of this image stopped)
+          'A' a frame came in ('N': corrupted, bad CRC or length), one for every frame in order
+          'W' the window moved (a page programmed, or the next page's keystream ready)
+          'D' all pages in and the image pending (then it resets), 'E' error, transfer stopped
+              ('U' refused: an image is already pending, or the running one is on trial
+              and slot B holds the previous app until update_confirm())
+    pages base .. limit - 1 can be sent, bit i of have: page base + i is in (don't send it again)
+
+The host keeps the frames it sent in order: every 'A' / 'N' is the answer to the oldest
+one. After each status it sends the pages of the window that are neither in nor on
+their way, and when nothing comes for a while (lost delimiter, lost status) everything
+of the window that isn't in. tools/update_link.c does this over a serial port, or
+against a simulated device to compare window sizes under line errors.
+
+The last page is padded to 1024 bytes (the padding isn't part of the CRC). Pages are
+`openssl enc -aes-128-ctr -K <key> -iv <iv>` of the image, size and crc32 are those of
+the plain image. Use a fresh random iv for every image: two images encrypted with the
+same key and iv give away their XOR.
+
+Throughput (8 MHz, estimated from the instruction timings):
+
+    stage                           cycles/byte     bytes/s
+    UART at 115200 baud             ~690            11520 (framing costs ~0.8%: 1034 bytes per page)
+    AES-128 keystream (aes.c)       ~50             ~160000 (14x the line rate, ~7% CPU)
+    receive interrupt               ~80             COBS, CRC16 (service table), decrypt (~12% CPU)
+    flash programming               ~210 (stall)    ~38000 (the CPU is stalled ~30% of the time)
+
+Stop-and-wait (one page, then wait for its answer) leaves the line idle while each page
+is programmed, ~30 ms of every ~120 ms; with the window the line only idles on errors.
+*/
+#ifndef UPDATER_H
+#define UPDATER_H
+
+#include <stdint.h>
+#include "logic.h"
+
+#define UPDATER_WINDOW 2U // pages in flight, one per page buffer
+#define UPDATER_CHUNK 64U // bytes programmed (~1.7 ms) and keystream computed (~0.4 ms) per updater_poll() call
+#define UPDATER_IRQ_PRIORITY 0x80U // NVIC priority of USART2 (order: ws2812.h)
+
+// Enable the USART2 receive interrupt (after uart_init())
+void updater_init(void);
+
+#define UPDATER_IDLE 0
+#define UPDATER_REBOOT 1 // 'b' received: the caller should reboot_to_bootloader()
+#define UPDATER_DONE 2 // new image pending: the caller should reboot()
+#define UPDATER_CAPTURE 3 // 'L' received: the caller should logic_start() with updater_capture()
+
+// The capture asked for by the last 'L' frame
+void updater_capture(struct logic_config *c);
+
+// Flash work and replies, call from the main loop. Returns one of the above.
+int updater_poll(void);
+
+// Vector table entry (main_memory.ld)
+void USART2_IRQHandler(void);
+
+#endif
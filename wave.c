@@ -0,0 +1,212 @@
+/*
+DMA waveform engine, see wave.h
+*/
+
+#include "wave.h"
+
+// RCC at 0x4002_1000, GPIOA at 0x4001_0800 (ports 0x400 apart), DMA1 at 0x4002_0000,
+// TIM2 at 0x4000_0000 (Table 3 (Register boundary addresses))
+#define RCC_BASE 0x40021000UL
+#define GPIO_BASE(port) (0x40010800UL + (port) * 0x400UL)
+#define DMA1_BASE 0x40020000UL
+#define TIM2_BASE 0x40000000UL
+
+// volatile prevents compiler from optimizing (important for hardware access)
+#define REG32(addr) (*(volatile uint32_t *)(addr))
+
+#define RCC_AHBENR REG32(RCC_BASE + 0x14UL) // AHB peripheral clock enable register
+#define RCC_APB2ENR REG32(RCC_BASE + 0x18UL) // APB2 peripheral clock enable register
+#define RCC_APB1ENR REG32(RCC_BASE + 0x1CUL) // APB1 peripheral clock enable register
+
+// (GPIO register map, RM0008 Table 59)
+#define GPIO_CRL(port) REG32(GPIO_BASE(port) + 0x00UL) // Configuration register low (pins 0..7)
+#define GPIO_CRH(port) REG32(GPIO_BASE(port) + 0x04UL) // Configuration register high (pins 8..15)
+#define GPIO_BSRR_ADDR(port) (GPIO_BASE(port) + 0x10UL) // Bit set/reset register
+
+// (13.4.7 DMA register map), channel x registers at 0x08 + 20 * (x - 1) ...
+#define DMA1_IFCR REG32(DMA1_BASE + 0x04UL) // Interrupt flag clear register
+#define DMA1_CCR1 REG32(DMA1_BASE + 0x08UL) // Channel 1 configuration register
+#define DMA1_CNDTR1 REG32(DMA1_BASE + 0x0CUL) // Channel 1 number of data register
+#define DMA1_CPAR1 REG32(DMA1_BASE + 0x10UL) // Channel 1 peripheral address register
+#define DMA1_CMAR1 REG32(DMA1_BASE + 0x14UL) // Channel 1 memory address register
+#define DMA1_CCR2 REG32(DMA1_BASE + 0x1CUL) // Channel 2 configuration register
+#define DMA1_CNDTR2 REG32(DMA1_BASE + 0x20UL) // Channel 2 number of data register
+#define DMA1_CPAR2 REG32(DMA1_BASE + 0x24UL) // Channel 2 peripheral address register
+#define DMA1_CMAR2 REG32(DMA1_BASE + 0x28UL) // Channel 2 memory address register
+
+// (15.4.19 TIMx register map)
+#define TIM2_CR1 REG32(TIM2_BASE + 0x00UL) // Control register 1
+#define TIM2_DIER REG32(TIM2_BASE + 0x0CUL) // DMA/interrupt enable register
+#define TIM2_EGR REG32(TIM2_BASE + 0x14UL) // Event generation register
+#define TIM2_CNT_ADDR (TIM2_BASE + 0x24UL) // Counter
+#define TIM2_PSC REG32(TIM2_BASE + 0x28UL) // Prescaler
+#define TIM2_ARR REG32(TIM2_BASE + 0x2CUL) // Auto-reload register
+#define TIM2_ARR_ADDR (TIM2_BASE + 0x2CUL)
+#define TIM2_CCR3 REG32(TIM2_BASE + 0x3CUL) // Capture/compare register 3
+
+// 7.3.6 - 7.3.8 peripheral clock enable registers
+#define RCC_AHBENR_DMA1EN (1U << 0)
+#define RCC_APB2ENR_IOPAEN_BIT 2U // ports A..E: bits 2..6
+#define RCC_APB1ENR_TIM2EN (1U << 0)
+
+// 9.2.1 / 9.2.2 port configuration: 4 bits per pin, output push-pull 50 MHz: CNF = 00, MODE = 11
+#define GPIO_CR_PIN_MASK 0xFU
+#define GPIO_CR_OUTPUT_50MHZ_PP 0b0011
+
+// 13.4.2 DMA interrupt flag clear register: the 4 flags of channels 1 and 2
+#define DMA_IFCR_CH1 (0xFU << 0)
+#define DMA_IFCR_CH2 (0xFU << 4)
+
+// 13.4.3 DMA channel x configuration register
+#define DMA_CCR_EN (1U << 0)
+#define DMA_CCR_DIR (1U << 4) // 1: memory -> peripheral
+#define DMA_CCR_CIRC (1U << 5) // Circular: restart at the first word
+#define DMA_CCR_MINC (1U << 7) // Memory increment
+#define DMA_CCR_PSIZE_16 (1U << 8)
+#define DMA_CCR_PSIZE_32 (2U << 8)
+#define DMA_CCR_MSIZE_16 (1U << 10)
+#define DMA_CCR_MSIZE_32 (2U << 10)
+#define DMA_CCR_PL_VERY_HIGH (3U << 12) // Priority over the other channels
+
+// 15.4.1 TIMx control register 1
+#define TIM_CR1_CEN (1U << 0) // Counter enable
+#define TIM_CR1_URS (1U << 2) // Only overflows request the DMA (not setting UG)
+#define TIM_CR1_ARPE (1U << 7) // ARR preloaded: a new value counts from the next update on
+
+// 15.4.4 TIMx DMA/interrupt enable register
+#define TIM_DIER_UDE (1U << 8) // Update DMA request
+#define TIM_DIER_CC3DE (1U << 11) // Capture/compare 3 DMA request (channel 3 is output compare, frozen, after reset)
+
+// 15.4.6 TIMx event generation register
+#define TIM_EGR_UG (1U << 0) // Load PSC and ARR, restart the counter
+
+#define MAX_PERIOD 0x10000U // 16-bit counter
+
+static uint32_t bsrr_addr;
+
+/* Stop the timer and the channels */
+static void halt(void) {
+    TIM2_CR1 = 0;
+    TIM2_DIER = 0;
+    DMA1_CCR1 = 0;
+    DMA1_CCR2 = 0;
+    DMA1_IFCR = DMA_IFCR_CH1 | DMA_IFCR_CH2;
+}
+
+/* Channel 2 set up for n transfers between periph and mem */
+static void channel(uint32_t ccr, uint32_t periph, const void *mem, uint16_t n) {
+    DMA1_CPAR2 = periph;
+    DMA1_CMAR2 = (uint32_t)(uintptr_t)mem;
+    DMA1_CNDTR2 = n;
+    DMA1_CCR2 = ccr | DMA_CCR_MINC | DMA_CCR_PL_VERY_HIGH;
+    DMA1_CCR2 |= DMA_CCR_EN;
+}
+
+/* The timer: period cycles until the first update, then the requests of dier */
+static void count(uint32_t period, uint32_t dier, uint32_t cr1) {
+    TIM2_PSC = 0;
+    TIM2_ARR = period - 1U;
+    TIM2_CR1 = TIM_CR1_URS | cr1;
+    TIM2_EGR = TIM_EGR_UG; // counter from 0 with the new period, no request (URS)
+    TIM2_DIER = dier;
+    TIM2_CR1 |= TIM_CR1_CEN; // first word after one period
+}
+
+/* Channel 2 and the timer for one request every period */
+static void run(uint32_t ccr, uint32_t periph, const void *mem, uint16_t n, uint32_t period) {
+    halt();
+    channel(ccr, periph, mem, n);
+    count(period, TIM_DIER_UDE, 0);
+}
+
+int wave_init(uint32_t port, uint16_t pins) {
+    if (port > WAVE_PORT_E) {
+        return -1;
+    }
+    RCC_AHBENR |= RCC_AHBENR_DMA1EN;
+    RCC_APB1ENR |= RCC_APB1ENR_TIM2EN;
+    RCC_APB2ENR |= 1U << (RCC_APB2ENR_IOPAEN_BIT + port);
+    halt();
+
+    for (uint32_t pin = 0; pin < 16U; pin++) {
+        if (!(pins & (1U << pin))) {
+            continue;
+        }
+        uint32_t shift = (pin & 7U) * 4U;
+        if (pin < 8U) {
+            GPIO_CRL(port) = (GPIO_CRL(port) & ~(GPIO_CR_PIN_MASK << shift)) | (GPIO_CR_OUTPUT_50MHZ_PP << shift);
+        }
+        else {
+            GPIO_CRH(port) = (GPIO_CRH(port) & ~(GPIO_CR_PIN_MASK << shift)) | (GPIO_CR_OUTPUT_50MHZ_PP << shift);
+        }
+    }
+    bsrr_addr = GPIO_BSRR_ADDR(port);
+    return 0;
+}
+
+int wave_start(const uint32_t *table, uint16_t len, uint32_t period, int repeat) {
+    if (!bsrr_addr || len == 0 || period < WAVE_MIN_PERIOD || period > MAX_PERIOD) {
+        return -1;
+    }
+    run(DMA_CCR_DIR | DMA_CCR_PSIZE_32 | DMA_CCR_MSIZE_32 | (repeat ? DMA_CCR_CIRC : 0U), bsrr_addr, table, len, period);
+    return 0;
+}
+
+int wave_start_timed(const uint32_t *table, const uint16_t *reload, uint16_t len, int repeat) {
+    if (!bsrr_addr || len == 0) {
+        return -1;
+    }
+    for (uint32_t i = 0; i < len; i++) {
+        if (reload[i] < WAVE_MIN_TIMED_PERIOD - 1U) {
+            return -1;
+        }
+    }
+    uint32_t circ = repeat ? DMA_CCR_CIRC : 0U;
+    halt();
+    channel(DMA_CCR_DIR | DMA_CCR_PSIZE_32 | DMA_CCR_MSIZE_32 | circ, bsrr_addr, table, len);
+
+    // The compare 3 request, one cycle after each update, writes the next step's reload value
+    // into the preloaded ARR: word i and reload[i] take effect at the same update (the first
+    // one comes before the first update, which is reload[0] + 1 cycles after the start)
+    DMA1_CPAR1 = TIM2_ARR_ADDR;
+    DMA1_CMAR1 = (uint32_t)(uintptr_t)reload;
+    DMA1_CNDTR1 = len;
+    DMA1_CCR1 = DMA_CCR_DIR | DMA_CCR_PSIZE_32 | DMA_CCR_MSIZE_16 | circ | DMA_CCR_MINC | DMA_CCR_PL_VERY_HIGH;
+    DMA1_CCR1 |= DMA_CCR_EN;
+    TIM2_CCR3 = 1;
+    count(reload[0] + 1U, TIM_DIER_UDE | TIM_DIER_CC3DE, TIM_CR1_ARPE);
+    return 0;
+}
+
+int wave_busy(void) {
+    return (DMA1_CCR2 & DMA_CCR_EN) && DMA1_CNDTR2 != 0;
+}
+
+void wave_stop(void) {
+    halt();
+}
+
+int wave_measure_start(uint16_t *samples, uint16_t n, uint32_t period) {
+    if (n == 0 || period < WAVE_MIN_PERIOD || period > MAX_PERIOD) {
+        return -1;
+    }
+    RCC_AHBENR |= RCC_AHBENR_DMA1EN;
+    RCC_APB1ENR |= RCC_APB1ENR_TIM2EN;
+    // Peripheral -> memory: the transfer reads the counter at the moment the DMA gets the bus
+    run(DMA_CCR_PSIZE_16 | DMA_CCR_MSIZE_16, TIM2_CNT_ADDR, samples, n, period);
+    return 0;
+}
+
+int wave_measure_done(const uint16_t *samples, uint16_t n, struct wave_jitter *j) {
+    if (DMA1_CNDTR2 != 0) {
+        return -1;
+    }
+    halt();
+    j->min = 0xFFFFU;
+    j->max = 0;
+    for (uint32_t i = 0; i < n; i++) {
+        j->min = samples[i] < j->min ? samples[i] : j->min;
+        j->max = samples[i] > j->max ? samples[i] : j->max;
+    }
+    return 0;
+}
@@ -0,0 +1,89 @@
+/*
+DMA waveform engine: a table of GPIO BSRR words played out at a fixed rate
+
+Every TIM2 update event requests a DMA1 transfer (channel 2, RM0008 Table 78) of the
+next table word into the port's BSRR: any of the port's 16 pins set, cleared or left
+alone at each step, all in the same bus write. Once started the CPU does nothing;
+the table repeats (circular) or plays once.
+
+- The step is period cycles of the 8 MHz timer clock, at least WAVE_MIN_PERIOD (a
+  DMA transfer to the APB2 GPIO port takes a few AHB cycles, and the next request
+  must not come before it's done). Every edge is a whole number of cycles after
+  the timer update; the only jitter is the DMA's wait for the bus when the CPU or
+  another channel holds it. wave_measure() measures exactly that path.
+- Tables in flash stall while flash is erased or programmed (the updater, kv.h,
+  evlog.h): the DMA can't fetch either. A table that must keep time through that
+  goes in RAM.
+- wave_start_timed() gives every step its own length: a second request of the same
+  timer, compare 3 one cycle after each update, has DMA1 channel 1 copy the next
+  step's length from a second table into the (preloaded) auto-reload register. A
+  step holds a level as long as it needs to, with two transfers, instead of one
+  transfer per unit of time (bcm.h).
+- WAVE_OUT() and WAVE_TABLE*() build tables at compile time, e.g. an 8-bit Gray
+  code counter on PB8..PB15:
+      #define GRAY(i) WAVE_OUT(0xFF00U, ((i) ^ ((i) >> 1)) << 8)
+      static const uint32_t gray[256] = { WAVE_TABLE256(GRAY, 0U) };
+*/
+#ifndef WAVE_H
+#define WAVE_H
+
+#include <stdint.h>
+
+// Ports (GPIOA .. GPIOE)
+#define WAVE_PORT_A 0U
+#define WAVE_PORT_B 1U
+#define WAVE_PORT_C 2U
+#define WAVE_PORT_D 3U
+#define WAVE_PORT_E 4U
+
+#define WAVE_MIN_PERIOD 8U // timer cycles per step: 1 MHz at 8 MHz
+#define WAVE_MIN_TIMED_PERIOD 16U // both transfers of a step done before the next one
+
+// BSRR words: set pins, clear pins, drive pins to the matching bits of value
+#define WAVE_SET(pins) ((uint32_t)(pins) & 0xFFFFU)
+#define WAVE_RESET(pins) (((uint32_t)(pins) & 0xFFFFU) << 16)
+#define WAVE_OUT(pins, value) (WAVE_SET((pins) & (value)) | WAVE_RESET((pins) & ~(value)))
+
+// f(n), f(n + 1), ... for table initializers
+#define WAVE_TABLE4(f, n) f(n), f((n) + 1U), f((n) + 2U), f((n) + 3U)
+#define WAVE_TABLE16(f, n) WAVE_TABLE4(f, n), WAVE_TABLE4(f, (n) + 4U), WAVE_TABLE4(f, (n) + 8U), WAVE_TABLE4(f, (n) + 12U)
+#define WAVE_TABLE64(f, n) WAVE_TABLE16(f, n), WAVE_TABLE16(f, (n) + 16U), WAVE_TABLE16(f, (n) + 32U), WAVE_TABLE16(f, (n) + 48U)
+#define WAVE_TABLE256(f, n) WAVE_TABLE64(f, n), WAVE_TABLE64(f, (n) + 64U), WAVE_TABLE64(f, (n) + 128U), WAVE_TABLE64(f, (n) + 192U)
+
+// DMA latency after the timer update, timer cycles (125 ns)
+struct wave_jitter {
+    uint16_t min;
+    uint16_t max;
+};
+
+// Clock the port, timer and DMA, make pins push-pull outputs (50 MHz edges). Returns 0, or -1.
+int wave_init(uint32_t port, uint16_t pins);
+
+// Play len words of table, one every period timer cycles, over and over if repeat. Returns 0, or -1.
+int wave_start(const uint32_t *table, uint16_t len, uint32_t period, int repeat);
+
+/*
+Play len words of table, word i for reload[i] + 1 timer cycles (at least
+WAVE_MIN_TIMED_PERIOD), over and over if repeat. Both tables are read while they play:
+a word changed in place shows from its next step on. Returns 0, or -1.
+*/
+int wave_start_timed(const uint32_t *table, const uint16_t *reload, uint16_t len, int repeat);
+
+// 1 while a table is playing (always, once a repeating one is started)
+int wave_busy(void);
+
+// Stop after the current step, the pins keep their levels
+void wave_stop(void);
+
+/*
+Start a measurement in place of the table: the same DMA request and channel record
+the timer count (cycles since the update) at each of n transfers, one every period
+cycles. The main loop keeps running meanwhile, so the numbers include its load.
+Valid while the latency is below period. Returns 0, or -1.
+*/
+int wave_measure_start(uint16_t *samples, uint16_t n, uint32_t period);
+
+// 0 with the result once the n samples are in, -1 while still measuring
+int wave_measure_done(const uint16_t *samples, uint16_t n, struct wave_jitter *j);
+
+#endif
@@ -0,0 +1,110 @@
+/*
+Independent watchdog with per-task check-ins, see wdg.h
+*/
+
+#include "wdg.h"
+#include "tick.h"
+#include "noinit.h"
+
+// IWDG starts at 0x4000_3000 (Independent watchdog in Table 3 (Register boundary addresses))
+#define IWDG_BASE 0x40003000UL
+
+// volatile prevents compiler from optimizing (important for hardware access)
+#define REG32(addr) (*(volatile uint32_t *)(addr))
+
+// (IWDG register map, RM0008 Table 93)
+#define IWDG_KR REG32(IWDG_BASE + 0x00UL) // Key register
+#define IWDG_PR REG32(IWDG_BASE + 0x04UL) // Prescaler register
+#define IWDG_RLR REG32(IWDG_BASE + 0x08UL) // Reload register (12 bits)
+#define IWDG_SR REG32(IWDG_BASE + 0x0CUL) // Status register (PVU, RVU: update in progress)
+
+// 19.4.1 Key register
+#define IWDG_KEY_RELOAD 0xAAAAU // reload the counter from RLR ("kick")
+#define IWDG_KEY_ACCESS 0x5555U // unlock PR and RLR
+#define IWDG_KEY_START 0xCCCCU
+
+// 19.4.2 Prescaler register: 4 = /64, the counter runs at 40 kHz / 64 = 625 Hz
+#define IWDG_PR_DIV64 4U
+#define LSI_HZ 40000U
+
+static struct {
+    uint32_t num_tasks;
+    uint32_t deadline[WDG_MAX_TASKS];
+    uint32_t last[WDG_MAX_TASKS]; // tick of the last check-in
+    uint32_t overdue; // latched: once a task was late the IWDG is never fed again
+    uint32_t start;
+    uint32_t healthy; // wdg_resets cleared
+} wdg;
+
+static void record_update(uint32_t task, uint32_t now, uint32_t overdue) {
+    volatile struct wdg_record *r = &NOINIT->wdg;
+
+    r->magic = WDG_RECORD_MAGIC;
+    r->last_task = task;
+    r->last_tick = now;
+    r->overdue = overdue;
+    r->check = WDG_RECORD_MAGIC ^ task ^ now ^ overdue;
+}
+
+void wdg_init(void) {
+    IWDG_KR = IWDG_KEY_START;
+    IWDG_KR = IWDG_KEY_ACCESS;
+    IWDG_PR = IWDG_PR_DIV64;
+    IWDG_RLR = WDG_TIMEOUT_MS * (LSI_HZ / 1000U) / 64U;
+    while (IWDG_SR != 0) {
+        // wait for the new values to reach the LSI clock domain
+    }
+    IWDG_KR = IWDG_KEY_RELOAD;
+
+    wdg.start = tick_ms();
+    record_update(0xFFFFFFFFUL, wdg.start, 0);
+}
+
+int wdg_register(uint32_t deadline_ms) {
+    if (wdg.num_tasks >= WDG_MAX_TASKS) {
+        return -1;
+    }
+    wdg.deadline[wdg.num_tasks] = deadline_ms;
+    wdg.last[wdg.num_tasks] = tick_ms();
+    return (int)wdg.num_tasks++;
+}
+
+void wdg_checkin(int id) {
+    uint32_t now = tick_ms();
+
+    if (id < 0 || (uint32_t)id >= wdg.num_tasks) {
+        return; // not registered (wdg_register() failed): nothing to kick
+    }
+    wdg.last[id] = now;
+    record_update((uint32_t)id, now, wdg.overdue);
+}
+
+void wdg_service(void) {
+    uint32_t now = tick_ms();
+    uint32_t overdue = 0;
+
+    for (uint32_t i = 0; i < wdg.num_tasks; i++) {
+        if (now - wdg.last[i] > wdg.deadline[i]) {
+            overdue |= 1U << i;
+        }
+    }
+
+    if (overdue & ~wdg.overdue) {
+        wdg.overdue |= overdue;
+        record_update(NOINIT->wdg.last_task, NOINIT->wdg.last_tick, wdg.overdue);
+    }
+    if (wdg.overdue) {
+        return; // stop feeding: the IWDG resets the chip within WDG_TIMEOUT_MS
+    }
+    IWDG_KR = IWDG_KEY_RELOAD;
+
+    if (!wdg.healthy && now - wdg.start >= WDG_HEALTHY_MS) {
+        NOINIT->boot.wdg_resets = 0;
+        NOINIT->boot.wdg_resets_check = ~0U;
+        wdg.healthy = 1;
+    }
+}
+
+int wdg_healthy(void) {
+    return (int)wdg.healthy;
+}
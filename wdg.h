@@ -0,0 +1,42 @@
+/*
+Independent watchdog (IWDG) with per-task check-ins
+
+A single watchdog kick in the main loop only proves that the loop runs, not that
+every part of the program makes progress. Here each task registers with a deadline
+and checks in when it has done its work; wdg_service() feeds the IWDG only while
+every registered task has checked in within its deadline. If one doesn't, the IWDG
+runs out and resets the chip.
+
+Each check-in is recorded in noinit RAM (noinit.h): after a watchdog reset the
+bootloader can tell which task checked in last and which ones were overdue.
+The bootloader counts consecutive watchdog resets (RCC_CSR); the app clears that
+count once it has run for WDG_HEALTHY_MS with every task on time.
+
+The IWDG runs from the ~40 kHz LSI (30 - 60 kHz over temperature, so keep timeouts
+generous). Once started it can't be stopped, and it keeps running during flash erases.
+*/
+#ifndef WDG_H
+#define WDG_H
+
+#include <stdint.h>
+
+#define WDG_MAX_TASKS 8U
+#define WDG_TIMEOUT_MS 2000U // IWDG timeout, max ~6500 with the /64 prescaler
+#define WDG_HEALTHY_MS 30000U
+
+// Start the IWDG (needs tick_init() for the deadlines)
+void wdg_init(void);
+
+// Add a task that must check in at least every deadline_ms. Returns its id, or -1 if full.
+int wdg_register(uint32_t deadline_ms);
+
+// Task id is alive (ids wdg_register() didn't hand out, such as -1, are ignored)
+void wdg_checkin(int id);
+
+// Feed the IWDG if every task is on time. Call it more often than WDG_TIMEOUT_MS.
+void wdg_service(void);
+
+// 1 once every task has been on time for WDG_HEALTHY_MS (the bootloader's watchdog reset count is then cleared)
+int wdg_healthy(void);
+
+#endif
@@ -0,0 +1,243 @@
+/*
+WS2812 LED strip driver, see ws2812.h
+*/
+
+#include "ws2812.h"
+#include "lut.h"
+
+// RCC at 0x4002_1000, GPIOA at 0x4001_0800, DMA1 at 0x4002_0000, TIM3 at 0x4000_0400
+// (Table 3 (Register boundary addresses))
+#define RCC_BASE 0x40021000UL
+#define GPIOA_BASE 0x40010800UL
+#define DMA1_BASE 0x40020000UL
+#define TIM3_BASE 0x40000400UL
+
+// volatile prevents compiler from optimizing (important for hardware access)
+#define REG32(addr) (*(volatile uint32_t *)(addr))
+
+#define RCC_AHBENR REG32(RCC_BASE + 0x14UL) // AHB peripheral clock enable register
+#define RCC_APB2ENR REG32(RCC_BASE + 0x18UL) // APB2 peripheral clock enable register
+#define RCC_APB1ENR REG32(RCC_BASE + 0x1CUL) // APB1 peripheral clock enable register
+
+// (GPIO register map, RM0008 Table 59)
+#define GPIOA_CRL REG32(GPIOA_BASE + 0x00UL) // Configuration register low (pins 0..7)
+
+// (13.4.7 DMA register map), channel x registers at 0x08 + 20 * (x - 1) ...
+#define DMA1_ISR REG32(DMA1_BASE + 0x00UL) // Interrupt status register
+#define DMA1_IFCR REG32(DMA1_BASE + 0x04UL) // Interrupt flag clear register
+#define DMA1_CCR3 REG32(DMA1_BASE + 0x30UL) // Channel 3 configuration register
+#define DMA1_CNDTR3 REG32(DMA1_BASE + 0x34UL) // Channel 3 number of data register
+#define DMA1_CPAR3 REG32(DMA1_BASE + 0x38UL) // Channel 3 peripheral address register
+#define DMA1_CMAR3 REG32(DMA1_BASE + 0x3CUL) // Channel 3 memory address register
+
+// (15.4.19 TIMx register map)
+#define TIM3_CR1 REG32(TIM3_BASE + 0x00UL) // Control register 1
+#define TIM3_DIER REG32(TIM3_BASE + 0x0CUL) // DMA/interrupt enable register
+#define TIM3_EGR REG32(TIM3_BASE + 0x14UL) // Event generation register
+#define TIM3_CCMR1 REG32(TIM3_BASE + 0x18UL) // Capture/compare mode register 1
+#define TIM3_CCER REG32(TIM3_BASE + 0x20UL) // Capture/compare enable register
+#define TIM3_PSC REG32(TIM3_BASE + 0x28UL) // Prescaler
+#define TIM3_ARR REG32(TIM3_BASE + 0x2CUL) // Auto-reload register
+#define TIM3_CCR1 REG32(TIM3_BASE + 0x34UL) // Capture/compare register 1
+#define TIM3_CCR1_ADDR (TIM3_BASE + 0x34UL)
+
+// (PM0056 Table 44 (NVIC register summary)), DMA1 channel 3 is IRQ 13 (RM0008 Table 63 (Vector table))
+#define NVIC_ISER0 REG32(0xE000E100UL) // Interrupt set-enable register for IRQ 0..31
+#define NVIC_IPR(irq) (*(volatile uint8_t *)(0xE000E400UL + (irq))) // Interrupt priority, a byte per IRQ (4.3.7, top 4 bits)
+#define DMA1_CHANNEL3_IRQ 13U
+
+// Cycle counter (ARMv7-M ARM C1.6.5 Debug Exception and Monitor Control Register, C1.8 DWT)
+#define DEMCR REG32(0xE000EDFCUL)
+#define DEMCR_TRCENA (1U << 24) // enables the DWT
+#define DWT_CTRL REG32(0xE0001000UL)
+#define DWT_CTRL_CYCCNTENA (1U << 0)
+#define DWT_CYCCNT REG32(0xE0001004UL)
+
+// 7.3.6 - 7.3.8 peripheral clock enable registers
+#define RCC_AHBENR_DMA1EN (1U << 0)
+#define RCC_APB2ENR_IOPAEN (1U << 2)
+#define RCC_APB1ENR_TIM3EN (1U << 1)
+
+// 9.2.1 port configuration register low: PA6 is [27:24], alternate function push-pull 50 MHz: CNF = 10, MODE = 11
+#define GPIO_CRL_PIN6_SHIFT 24U
+#define GPIO_CR_PIN_MASK 0xFU
+#define GPIO_CR_AF_50MHZ_PP 0b1011
+
+// 13.4.1 / 13.4.2 DMA interrupt status / flag clear register, channel 3
+#define DMA_ISR_TCIF3 (1U << 9) // Transfer complete: second half sent
+#define DMA_ISR_HTIF3 (1U << 10) // Half transfer: first half sent
+#define DMA_ISR_CH3 (0xFU << 8)
+
+// 13.4.3 DMA channel x configuration register
+#define DMA_CCR_EN (1U << 0)
+#define DMA_CCR_TCIE (1U << 1)
+#define DMA_CCR_HTIE (1U << 2)
+#define DMA_CCR_DIR (1U << 4) // memory -> peripheral
+#define DMA_CCR_CIRC (1U << 5)
+#define DMA_CCR_MINC (1U << 7)
+#define DMA_CCR_PSIZE_16 (1U << 8) // bytes from memory, zero extended into CCR1
+#define DMA_CCR_PL_VERY_HIGH (3U << 12) // a late bit breaks the frame
+
+// 15.4.1 / 15.4.4 / 15.4.6 TIMx control, DMA/interrupt enable, event generation
+#define TIM_CR1_CEN (1U << 0)
+#define TIM_CR1_URS (1U << 2) // Only overflows request the DMA (not setting UG)
+#define TIM_DIER_UDE (1U << 8) // Update DMA request
+#define TIM_EGR_UG (1U << 0)
+
+// 15.4.7 capture/compare mode register 1, 15.4.9 capture/compare enable register
+#define TIM_CCMR1_OC1PE (1U << 3) // CCR1 preloaded: the new duty cycle starts with the next period
+#define TIM_CCMR1_OC1M_FORCE_LOW (4U << 4)
+#define TIM_CCMR1_OC1M_PWM1 (6U << 4) // high while the counter is below CCR1
+#define TIM_CCER_CC1E (1U << 0)
+
+#define HALF_BYTES (WS2812_LEDS_PER_HALF * 24U)
+#define HALF_NS (HALF_BYTES * 1250U)
+#define LATCH_NS 300000U
+#define LATCH_HALVES ((LATCH_NS + HALF_NS - 1U) / HALF_NS) // whole halves of zeros sent before stopping
+#define IRQ_ENTRY_EXIT 24U // cycles the counter doesn't see: 12 to stack and fetch the vector, ~12 to return
+
+// 4 bits, MSB first, to 4 duty cycles in one little endian word: a byte is 2 lookups and 2 stores
+#define DUTY(bit) ((bit) ? WS2812_T1H : WS2812_T0H)
+#define NIBBLE(n) (DUTY((n) & 8U) | (DUTY((n) & 4U) << 8) | (DUTY((n) & 2U) << 16) | (DUTY((n) & 1U) << 24)),
+
+static const uint32_t nibble[16] = { LUT_R16(NIBBLE, 0U) };
+
+static uint32_t codes[2U * HALF_BYTES / 4U]; // duty cycles, bytes read by the DMA
+
+/* Shared with the interrupt */
+static volatile struct {
+    uint32_t state;
+    const uint8_t *rgb; // next LED
+    uint32_t left; // LEDs to encode
+    uint32_t zero[2]; // half holds no LED
+    uint32_t quiet; // all-zero halves sent in a row
+    uint32_t start; // cycle count at ws2812_show()
+    uint32_t cpu;
+    uint32_t frame;
+} tx;
+
+static void halt(void) {
+    TIM3_CCMR1 = TIM_CCMR1_OC1M_FORCE_LOW; // line low right away, even mid-bit
+    TIM3_CR1 = 0;
+    TIM3_DIER = 0;
+    DMA1_CCR3 = 0;
+    DMA1_IFCR = DMA_ISR_CH3;
+}
+
+static uint32_t *put(uint32_t *w, uint32_t byte) {
+    w[0] = nibble[byte >> 4];
+    w[1] = nibble[byte & 0xFU];
+    return w + 2;
+}
+
+/* Encode the next LEDs into half h, zeros after the last one */
+static void fill(uint32_t h) {
+    uint32_t *w = &codes[h * (HALF_BYTES / 4U)];
+    const uint8_t *rgb = tx.rgb;
+    uint32_t n = tx.left < WS2812_LEDS_PER_HALF ? tx.left : WS2812_LEDS_PER_HALF;
+
+    for (uint32_t i = 0; i < n; i++, rgb += 3) {
+        w = put(w, rgb[1]); // green, red, blue
+        w = put(w, rgb[0]);
+        w = put(w, rgb[2]);
+    }
+    for (uint32_t i = n * 6U; i < HALF_BYTES / 4U; i++) {
+        *w++ = 0;
+    }
+    tx.rgb = rgb;
+    tx.left -= n;
+    tx.zero[h] = n == 0;
+}
+
+int ws2812_init(void) {
+    RCC_AHBENR |= RCC_AHBENR_DMA1EN;
+    RCC_APB1ENR |= RCC_APB1ENR_TIM3EN;
+    RCC_APB2ENR |= RCC_APB2ENR_IOPAEN;
+    halt();
+    TIM3_PSC = 0;
+    TIM3_ARR = WS2812_PERIOD - 1U;
+    TIM3_CCER = TIM_CCER_CC1E;
+    GPIOA_CRL = (GPIOA_CRL & ~(GPIO_CR_PIN_MASK << GPIO_CRL_PIN6_SHIFT)) | (GPIO_CR_AF_50MHZ_PP << GPIO_CRL_PIN6_SHIFT);
+
+    DEMCR |= DEMCR_TRCENA;
+    DWT_CTRL |= DWT_CTRL_CYCCNTENA;
+    NVIC_IPR(DMA1_CHANNEL3_IRQ) = WS2812_IRQ_PRIORITY;
+    NVIC_ISER0 = 1U << DMA1_CHANNEL3_IRQ;
+    tx.state = WS2812_IDLE;
+    tx.frame = 0;
+    return 0;
+}
+
+int ws2812_show(const uint8_t *rgb, uint32_t n) {
+    uint32_t start = DWT_CYCCNT;
+
+    if (tx.state == WS2812_BUSY) {
+        return -1;
+    }
+    tx.start = start;
+    tx.rgb = rgb;
+    tx.left = n;
+    tx.quiet = 0;
+    tx.frame = 0;
+    fill(0);
+    fill(1);
+
+    DMA1_CPAR3 = TIM3_CCR1_ADDR;
+    DMA1_CMAR3 = (uint32_t)(uintptr_t)codes;
+    DMA1_CNDTR3 = 2U * HALF_BYTES;
+    DMA1_CCR3 = DMA_CCR_DIR | DMA_CCR_CIRC | DMA_CCR_MINC | DMA_CCR_PSIZE_16 | DMA_CCR_PL_VERY_HIGH |
+        DMA_CCR_HTIE | DMA_CCR_TCIE;
+    DMA1_CCR3 |= DMA_CCR_EN;
+
+    // One low period, then the first bit: each update has the DMA write the next period's duty cycle
+    TIM3_CCR1 = 0;
+    TIM3_CCMR1 = TIM_CCMR1_OC1M_PWM1 | TIM_CCMR1_OC1PE;
+    TIM3_CR1 = TIM_CR1_URS;
+    TIM3_EGR = TIM_EGR_UG;
+    tx.state = WS2812_BUSY;
+    TIM3_DIER = TIM_DIER_UDE;
+    TIM3_CR1 |= TIM_CR1_CEN;
+    tx.cpu = DWT_CYCCNT - start;
+    return 0;
+}
+
+enum ws2812_state ws2812_state(void) {
+    return (enum ws2812_state)tx.state;
+}
+
+int ws2812_load(struct ws2812_load *l) {
+    if (tx.state == WS2812_BUSY || tx.frame == 0) {
+        return -1;
+    }
+    l->cpu = tx.cpu;
+    l->frame = tx.frame;
+    return 0;
+}
+
+/* A half was sent: refill it (the DMA is in the other one), or stop once the latch is long enough */
+void DMA1_Channel3_IRQHandler(void) {
+    uint32_t start = DWT_CYCCNT;
+    uint32_t isr = DMA1_ISR;
+
+    DMA1_IFCR = DMA_ISR_CH3;
+    if (tx.state != WS2812_BUSY) {
+        return;
+    }
+    uint32_t h = (isr & DMA_ISR_TCIF3) != 0;
+    uint32_t pos = 2U * HALF_BYTES - DMA1_CNDTR3;
+    if (((isr & DMA_ISR_HTIF3) && h) || (h ? pos >= HALF_BYTES : pos < HALF_BYTES)) {
+        halt(); // the DMA is past the half being refilled: stale bits went out
+        tx.state = WS2812_LATE;
+        return;
+    }
+    tx.quiet = tx.zero[h] ? tx.quiet + 1U : 0U;
+    if (tx.quiet >= LATCH_HALVES) {
+        halt();
+        tx.frame = DWT_CYCCNT - tx.start;
+        tx.state = WS2812_IDLE;
+    }
+    else {
+        fill(h);
+    }
+    tx.cpu += DWT_CYCCNT - start + IRQ_ENTRY_EXIT;
+}
@@ -0,0 +1,71 @@
+/*
+WS2812 (NeoPixel) LED strip driver: timer PWM fed by DMA
+
+A WS2812 bit is one 1.25 us (800 kHz) period, high for ~0.4 us (0) or ~0.8 us (1),
+24 bits per LED (green, red, blue, MSB first), then >= 280 us low to latch. TIM3
+makes the periods on PA6 (TIM3_CH1, PWM): 10 cycles of the 8 MHz clock, high for
+WS2812_T0H or WS2812_T1H of them. Its update event requests DMA1 channel 3
+(RM0008 Table 78), which writes the next bit's duty cycle into the preloaded CCR1.
+
+The duty cycles come from a small circular buffer instead of one byte per bit of
+the whole strip (24 bytes per LED, 7200 for 300 LEDs): two halves of
+WS2812_LEDS_PER_HALF LEDs. While the DMA plays one half, the half-transfer or
+transfer-complete interrupt encodes the next LEDs into the other (a table lookup
+per 4 bits), then zeros (line low) for the latch, and stops the timer.
+
+- ws2812_load() reports what a frame cost: cycles in the interrupt (measured with
+  the DWT cycle counter, plus the entry and exit) against the frame's length.
+  Estimated from the instruction timings, ~15 cycles per LED byte, so ~1/5 of the
+  CPU at 8 MHz while a frame goes out (300 LEDs: 9 ms).
+- The interrupt has one half's time (120 us) to refill the other. Flash erases
+  stall the CPU for ~20 ms: a frame sent meanwhile is cut short (WS2812_LATE),
+  show it again.
+- So no other interrupt may hold it up for that long. The NVIC priorities (the
+  *_IRQ_PRIORITY of each driver, most urgent first; equal ones don't preempt each
+  other):
+      0x00  DMA1 channel 3, this driver (~30 us per half), and SysTick (tick.h)
+      0x40  TIM1, status LED PWM (led.h, a few us every 1 ms)
+      0x80  USART2, updater receive (updater.h, a byte every 87 us, no FIFO: it
+            copes with one preemption of up to a byte time)
+      0xC0  DMA1 channel 7, logic analyzer (logic.h, ~2 ms trigger scans)
+- Colors are sent as stored, with no gamma or brightness limit. 300 LEDs at full
+  white draw ~18 A: power the strip separately.
+*/
+#ifndef WS2812_H
+#define WS2812_H
+
+#include <stdint.h>
+
+#define WS2812_LEDS_PER_HALF 4U // 96 bytes of duty cycles per half, an interrupt every 120 us
+#define WS2812_T0H 3U // timer cycles high: 375 ns
+#define WS2812_T1H 6U // 750 ns
+#define WS2812_PERIOD 10U // 1.25 us
+#define WS2812_IRQ_PRIORITY 0x00U // NVIC priority, the most urgent (order above)
+
+enum ws2812_state {
+    WS2812_IDLE, // done (or never started)
+    WS2812_BUSY, // sending a frame
+    WS2812_LATE, // a half wasn't refilled in time: the frame was stopped
+};
+
+// Cycles of the last frame, from ws2812_show() to the end of the latch
+struct ws2812_load {
+    uint32_t cpu; // in ws2812_show() and the interrupt
+    uint32_t frame;
+};
+
+// Clock TIM3, DMA1 and GPIOA, PA6 as the timer's output (low). Returns 0, or -1.
+int ws2812_init(void);
+
+// Send n LEDs of rgb (3 bytes per LED: red, green, blue), read as it goes (don't change it until done). Returns 0, or -1 (busy).
+int ws2812_show(const uint8_t *rgb, uint32_t n);
+
+enum ws2812_state ws2812_state(void);
+
+// Cost of the last frame (once done). Returns 0, or -1.
+int ws2812_load(struct ws2812_load *l);
+
+// Vector table entry (main_memory.ld)
+void DMA1_Channel3_IRQHandler(void);
+
+#endif